@@ -0,0 +1,191 @@
+#define _CRT_SECURE_NO_DEPRECATE
+#include "AssetManager.h"
+#include "ResidencyManager.h"
+#include "MeshCodec.h"
+#include "MeshStreamer.h"
+#include "JobSystem.h"
+#include "Tracer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <map>
+#include <string>
+
+struct MeshEntry {
+	Mesh* mesh;					// Only for finding the entries of a mesh being freed
+	std::weak_ptr<Mesh> handle;
+	size_t vertex_count, normal_count, index_count;
+};
+
+// Every path a mesh was requested by, and one entry per unique mesh by content
+std::map<std::string, MeshEntry> asset_paths;
+std::multimap<uint64_t, MeshEntry> asset_contents;
+AssetStats asset_stats = AssetStats();
+// Parses started by prefetch and not yet picked up by load_mesh
+struct Prefetch {
+	Job* job;
+	Mesh* mesh;
+	bool parsed;				// Set by the job, false if the file could not be read
+};
+std::map<std::string, Prefetch> asset_prefetches;
+
+static size_t entry_bytes(const MeshEntry& entry)
+{
+	return (entry.vertex_count + entry.normal_count) * sizeof(glm::vec3) + entry.index_count * sizeof(GLuint);
+}
+
+// Deleter of the shared handles, runs when the last OBJObject using the mesh is gone
+static void free_mesh(Mesh* mesh)
+{
+	for (std::map<std::string, MeshEntry>::iterator it = asset_paths.begin(); it != asset_paths.end();)
+		it = it->second.mesh == mesh ? asset_paths.erase(it) : ++it;
+	for (std::multimap<uint64_t, MeshEntry>::iterator it = asset_contents.begin(); it != asset_contents.end();)
+		it = it->second.mesh == mesh ? asset_contents.erase(it) : ++it;
+	MeshStreamer::cancel(mesh);
+	ResidencyManager::remove(mesh);
+	delete mesh;
+}
+
+std::shared_ptr<Mesh> AssetManager::load_mesh(const char* path, bool upload)
+{
+	TRACE_SCOPE("AssetManager::load_mesh");
+	asset_stats.loads++;
+
+	std::map<std::string, MeshEntry>::iterator known = asset_paths.find(path);
+	std::shared_ptr<Mesh> mesh = known != asset_paths.end() ? known->second.handle.lock() : std::shared_ptr<Mesh>();
+	if (mesh)
+	{
+		asset_stats.path_hits++;
+		if (upload)
+			ResidencyManager::use(mesh.get(), true);
+		return mesh;
+	}
+
+	Mesh* parsed = NULL;
+	std::map<std::string, Prefetch>::iterator prefetched = asset_prefetches.find(path);
+	if (prefetched != asset_prefetches.end())
+	{
+		JobSystem::wait(prefetched->second.job);
+		parsed = prefetched->second.mesh;
+		bool readable = prefetched->second.parsed;
+		asset_prefetches.erase(prefetched);
+		if (!readable)
+		{
+			delete parsed;
+			return std::shared_ptr<Mesh>();
+		}
+	}
+	bool was_prefetched = parsed != NULL;
+	if (parsed == NULL)
+		parsed = new Mesh();
+	MeshEntry entry = { parsed, std::weak_ptr<Mesh>(), 0, 0, 0 };
+	// The header of a .mesh file has the hash, so it is only decoded if it is not a duplicate
+	bool header_only = MeshCodec::is_mesh_file(path);
+	if (header_only)
+	{
+		MeshFileInfo info;
+		if (!MeshCodec::read_header(path, info))
+		{
+			delete parsed;
+			return std::shared_ptr<Mesh>();
+		}
+		parsed->path = path;
+		parsed->hash = info.hash;
+		parsed->bounds_min = info.bounds_min;
+		parsed->bounds_max = info.bounds_max;
+		entry.vertex_count = info.vertex_count;
+		entry.normal_count = info.has_normals ? info.vertex_count : 0;
+		entry.index_count = info.index_count;
+	}
+	else
+	{
+		if (!was_prefetched)
+		{
+			if (!parsed->parse(path))
+			{
+				delete parsed;
+				return std::shared_ptr<Mesh>();
+			}
+			parsed->hash = MeshCodec::hash(parsed->vertices, parsed->normals, parsed->indices);
+		}
+		entry.vertex_count = parsed->vertices.size();
+		entry.normal_count = parsed->normals.size();
+		entry.index_count = parsed->indices.size();
+	}
+
+	// The copy in memory may be gone, so equal geometry means equal hash and sizes
+	typedef std::multimap<uint64_t, MeshEntry>::iterator ContentIterator;
+	std::pair<ContentIterator, ContentIterator> same = asset_contents.equal_range(parsed->hash);
+	for (ContentIterator it = same.first; it != same.second; ++it)
+	{
+		const MeshEntry& other = it->second;
+		if (other.vertex_count != entry.vertex_count || other.normal_count != entry.normal_count
+			|| other.index_count != entry.index_count || !(mesh = other.handle.lock()))
+			continue;
+		asset_stats.content_hits++;
+		asset_stats.bytes_saved += entry_bytes(entry);
+		printf("%s has the same geometry as %s, sharing it\n", path, mesh->path.c_str());
+		delete parsed;
+		asset_paths[path] = other;
+		if (upload)
+			ResidencyManager::use(mesh.get(), true);
+		return mesh;
+	}
+
+	mesh = std::shared_ptr<Mesh>(parsed, free_mesh);
+	entry.handle = mesh;
+	asset_paths[path] = entry;
+	asset_contents.insert(std::make_pair(parsed->hash, entry));
+	// Progressive files are drawn while they stream in
+	if (header_only && !(upload && (MeshStreamer::open(parsed) || parsed->upload_from_file())) && !parsed->parse(path))
+	{
+		// The deleter takes the entries out again
+		mesh.reset();
+		return mesh;
+	}
+	if (upload && !parsed->has_gpu())
+		mesh->upload();
+	ResidencyManager::add(mesh.get());
+	return mesh;
+}
+
+void AssetManager::prefetch(const char* const* paths, int count)
+{
+	for (int i = 0; i < count; i++)
+	{
+		// .mesh files are checked by their header first and decode in parallel anyway
+		std::map<std::string, MeshEntry>::iterator known = asset_paths.find(paths[i]);
+		if (MeshCodec::is_mesh_file(paths[i]) || asset_prefetches.count(paths[i]) != 0
+			|| (known != asset_paths.end() && !known->second.handle.expired()))
+			continue;
+		Mesh* mesh = new Mesh();
+		std::string path = paths[i];
+		// The entry stays in place until load_mesh has waited for the job
+		Prefetch* prefetch = &asset_prefetches[path];
+		prefetch->mesh = mesh;
+		prefetch->parsed = false;
+		prefetch->job = JobSystem::create([mesh, path, prefetch]
+		{
+			if (!mesh->parse(path.c_str()))
+				return;
+			mesh->hash = MeshCodec::hash(mesh->vertices, mesh->normals, mesh->indices);
+			prefetch->parsed = true;
+		});
+		JobSystem::submit(prefetch->job);
+	}
+}
+
+AssetStats AssetManager::stats()
+{
+	AssetStats stats = asset_stats;
+	stats.meshes = (int)asset_contents.size();
+	return stats;
+}
+
+void AssetManager::print_summary()
+{
+	if (asset_stats.loads == 0)
+		return;
+	printf("Assets: %d mesh loads, %d of already loaded paths, %d shared by content (%.1f MB saved), %d unique meshes\n",
+		asset_stats.loads, asset_stats.path_hits, asset_stats.content_hits, asset_stats.bytes_saved / (1024.0 * 1024.0),
+		(int)asset_contents.size());
+}
@@ -0,0 +1,34 @@
+#ifndef _ASSETMANAGER_H_
+#define _ASSETMANAGER_H_
+
+#include "Mesh.h"
+#include <memory>
+
+struct AssetStats {
+	int loads;				// load_mesh calls
+	int path_hits;			// Answered with the mesh already loaded from the same path
+	int content_hits;		// Parsed, then answered with a mesh of identical geometry from another path
+	int meshes;				// Unique meshes alive
+	size_t bytes_saved;		// CPU bytes of the geometry that content hits did not keep
+};
+
+// Hands out shared meshes. A path that is already loaded gets the same mesh without touching the
+// file, and a new file whose parsed geometry matches a loaded mesh (same hash and sizes) gets that
+// mesh instead of a copy, so memory grows with the unique geometry only. Meshes are reference
+// counted by their handles and freed, GL buffers included, when the last handle goes away.
+class AssetManager
+{
+public:
+	// upload creates the GL buffers if the mesh has none yet, needs the GL context. Null if the file
+	// cannot be read, the reason is printed.
+	static std::shared_ptr<Mesh> load_mesh(const char* path, bool upload);
+	// Starts parsing the .obj files among paths on the JobSystem, each in parallel with the others and
+	// with the caller. load_mesh of such a path waits for its parse instead of parsing, and only the
+	// upload stays on the calling thread. Load every prefetched path afterwards.
+	static void prefetch(const char* const* paths, int count);
+
+	static AssetStats stats();
+	static void print_summary();
+};
+
+#endif
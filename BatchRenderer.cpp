@@ -0,0 +1,399 @@
+#define _CRT_SECURE_NO_DEPRECATE
+#include "BatchRenderer.h"
+#include "OBJObject.h"
+#include "Headless.h"
+#include "MeshStreamer.h"
+#include "UniformRing.h"
+#include "GLState.h"
+#include "JobSystem.h"
+#include "Tracer.h"
+#include "Window.h"
+#include "shader.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+const size_t BATCH_NO_JOB = (size_t)-1;
+
+// A readback in flight
+struct BatchSlot {
+	GLuint PBO;
+	GLsync fence;
+	size_t job;
+};
+
+// A run of one mesh's jobs, the unit the workers are given
+struct BatchPiece {
+	size_t group, first, count;
+};
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool next_float(float& value)
+{
+	const char* token = strtok(NULL, " \t\r\n");
+	if (token == NULL)
+		return false;
+	char* end;
+	value = strtof(token, &end);
+	return *end == '\0';
+}
+
+static bool next_vector(glm::vec3& value)
+{
+	return next_float(value.x) && next_float(value.y) && next_float(value.z);
+}
+
+bool BatchRenderer::load(const char* path, std::vector<BatchJob>& jobs)
+{
+	FILE* fp = fopen(path, "r");
+	if (fp == NULL)
+	{
+		fprintf(stderr, "Cannot open %s\n", path);
+		return false;
+	}
+	char line[1024];
+	int number = 0;
+	bool valid = true;
+	while (valid && fgets(line, sizeof(line), fp))
+	{
+		number++;
+		const char* mesh = strtok(line, " \t\r\n");
+		if (mesh == NULL || mesh[0] == '#')
+			continue;
+		const char* output = strtok(NULL, " \t\r\n");
+		if (output == NULL)
+		{
+			fprintf(stderr, "%s:%d: no output path\n", path, number);
+			valid = false;
+			break;
+		}
+		BatchJob job;
+		job.mesh = mesh;
+		job.output = output;
+		job.line = number;
+		Light& light = job.light;
+		while (const char* key = strtok(NULL, " \t\r\n"))
+		{
+			if (strcmp(key, "yaw") == 0)
+				valid = next_float(job.yaw);
+			else if (strcmp(key, "pitch") == 0)
+				valid = next_float(job.pitch);
+			else if (strcmp(key, "distance") == 0)
+				valid = next_float(job.distance);
+			else if (strcmp(key, "dir") == 0)
+				valid = next_vector(light.d_direction);
+			else if (strcmp(key, "point") == 0)
+				valid = next_vector(light.p_position);
+			else if (strcmp(key, "spot") == 0)
+				valid = next_vector(light.s_position);
+			else if (strcmp(key, "cutoff") == 0 && (valid = next_float(light.cutOff)))
+			{
+				// The outer cone keeps its distance to the inner one, as when it is changed with the mouse
+				light.outerCutOff = light.cutOff + (Light().outerCutOff - Light().cutOff);
+				light.cos_cutOff = pow(glm::cos(glm::radians(light.cutOff)), light.cos_exp);
+				light.cos_outerCutOff = pow(glm::cos(glm::radians(light.outerCutOff)), light.cos_exp);
+			}
+			else
+				valid = false;
+			if (!valid)
+			{
+				fprintf(stderr, "%s:%d: bad or incomplete %s\n", path, number, key);
+				break;
+			}
+		}
+		jobs.push_back(job);
+	}
+	fclose(fp);
+	if (valid && jobs.empty())
+	{
+		fprintf(stderr, "%s has no jobs\n", path);
+		valid = false;
+	}
+	return valid;
+}
+
+std::vector<size_t> BatchRenderer::share(const std::vector<BatchJob>& jobs, int worker, int workers)
+{
+	// The jobs of each mesh, meshes in the order they first appear
+	std::map<std::string, size_t> group_of;
+	std::vector<std::vector<size_t> > groups;
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		std::map<std::string, size_t>::iterator it = group_of.find(jobs[i].mesh);
+		if (it == group_of.end())
+		{
+			it = group_of.insert(std::make_pair(jobs[i].mesh, groups.size())).first;
+			groups.push_back(std::vector<size_t>());
+		}
+		groups[it->second].push_back(i);
+	}
+
+	size_t even = (jobs.size() + workers - 1) / workers;
+	std::vector<BatchPiece> pieces;
+	for (size_t g = 0; g < groups.size(); g++)
+	{
+		for (size_t first = 0; first < groups[g].size(); first += even)
+		{
+			BatchPiece piece = { g, first, std::min(even, groups[g].size() - first) };
+			pieces.push_back(piece);
+		}
+	}
+
+	// Largest first, each to the worker with the fewest jobs so far
+	std::stable_sort(pieces.begin(), pieces.end(), [](const BatchPiece& a, const BatchPiece& b) { return a.count > b.count; });
+	std::vector<size_t> assigned(workers, 0);
+	std::vector<BatchPiece> mine;
+	for (size_t p = 0; p < pieces.size(); p++)
+	{
+		int w = (int)(std::min_element(assigned.begin(), assigned.end()) - assigned.begin());
+		assigned[w] += pieces[p].count;
+		if (w == worker)
+			mine.push_back(pieces[p]);
+	}
+
+	// Pieces of the same mesh one after the other, so it is loaded once
+	std::sort(mine.begin(), mine.end(), [](const BatchPiece& a, const BatchPiece& b) {
+		return a.group != b.group ? a.group < b.group : a.first < b.first; });
+	std::vector<size_t> indices;
+	for (size_t p = 0; p < mine.size(); p++)
+		for (size_t i = 0; i < mine[p].count; i++)
+			indices.push_back(groups[mine[p].group][mine[p].first + i]);
+	return indices;
+}
+
+int BatchRenderer::run_workers(const char* executable, const char* path, int workers, const std::string& arguments)
+{
+	std::vector<BatchJob> jobs;
+	if (!load(path, jobs))
+		return EXIT_FAILURE;
+	if (workers <= 0)
+		workers = std::max(1, (int)std::thread::hardware_concurrency());
+	workers = std::min(workers, (int)jobs.size());
+	printf("Batch: %zu jobs for %d workers\n", jobs.size(), workers);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::vector<FILE*> pipes(workers, (FILE*)NULL);
+	for (int w = 0; w < workers; w++)
+	{
+		char worker[64];
+		snprintf(worker, sizeof(worker), " --batch-worker %d --batch-workers %d", w, workers);
+		std::string command = "\"" + std::string(executable) + "\" --batch \"" + path + "\"" + worker + arguments + " 2>&1";
+#ifdef _WIN32
+		// cmd.exe drops the first and last quote of the whole line
+		command = "\"" + command + "\"";
+#endif
+		pipes[w] = popen(command.c_str(), "r");
+		if (pipes[w] == NULL)
+			fprintf(stderr, "Cannot start batch worker %d\n", w);
+	}
+
+	// A thread per worker passes its output on, so no pipe fills up and stalls a worker
+	std::mutex output;
+	std::vector<int> status(workers, -1);
+	// From the summary line of each worker, which also counts a failed worker's images
+	std::vector<size_t> written(workers, 0);
+	std::vector<std::thread> readers;
+	for (int w = 0; w < workers; w++)
+	{
+		if (pipes[w] == NULL)
+			continue;
+		readers.push_back(std::thread([w, &pipes, &status, &written, &output] {
+			char line[1024];
+			while (fgets(line, sizeof(line), pipes[w]))
+			{
+				size_t images;
+				if (sscanf(line, "Batch worker %*d of %*d: %zu images", &images) == 1)
+					written[w] = images;
+				std::lock_guard<std::mutex> lock(output);
+				printf("[worker %d] %s", w, line);
+				fflush(stdout);
+			}
+			status[w] = pclose(pipes[w]);
+		}));
+	}
+	for (size_t i = 0; i < readers.size(); i++)
+		readers[i].join();
+	double seconds = seconds_since(start);
+
+	size_t images = 0;
+	bool failed = false;
+	for (int w = 0; w < workers; w++)
+	{
+		images += written[w];
+		if (status[w] != 0)
+		{
+			fprintf(stderr, "Batch worker %d failed\n", w);
+			failed = true;
+		}
+	}
+	printf("Batch: %zu images by %d workers in %.2f s, %.1f images/s (%.1f per worker)\n", images, workers, seconds,
+		images / seconds, images / seconds / workers);
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static void draw(const BatchJob& job, OBJObject* object, GLuint program, const glm::mat4& projection)
+{
+	TRACE_SCOPE("BatchRenderer::draw");
+	Headless::bind_framebuffer();
+	UniformRing::begin_frame();
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	// Orbits the viewer's camera around the origin, short of the poles where up is undefined
+	float yaw = glm::radians(job.yaw);
+	float pitch = glm::radians(std::max(-89.0f, std::min(89.0f, job.pitch)));
+	glm::vec3 eye = job.distance * glm::vec3(cosf(pitch) * sinf(yaw), sinf(pitch), cosf(pitch) * cosf(yaw));
+	glm::mat4 view = glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+	GLState::use_program(program);
+	Light light = job.light;
+	light.update(program);
+	object->draw(program, object->toWorld, view, projection);
+	UniformRing::end_frame();
+}
+
+int BatchRenderer::render(const char* path, int worker, int workers)
+{
+	TRACE_SCOPE("BatchRenderer::render");
+	std::vector<BatchJob> jobs;
+	if (!load(path, jobs))
+		return EXIT_FAILURE;
+	std::vector<size_t> mine;
+	if (worker < 0)
+		for (size_t i = 0; i < jobs.size(); i++)
+			mine.push_back(i);
+	else
+		mine = share(jobs, worker, workers);
+
+	// Stills are rendered once, there is no later frame for finer levels
+	MeshStreamer::enabled = false;
+	GLuint program = LoadShaders(VERTEX_SHADER_PATH, FRAGMENT_SHADER_PATH);
+	int width = Headless::width, height = Headless::height;
+	// Same projection as the viewer, so stills look like what it shows
+	glm::mat4 projection = glm::perspective(45.0f, (float)width / (float)height, 0.1f, 1000.0f);
+	size_t bytes = (size_t)width * height * 3;
+
+	BatchSlot slots[RING_DEPTH];
+	for (int i = 0; i < RING_DEPTH; i++)
+	{
+		glGenBuffers(1, &slots[i].PBO);
+		GLState::bind_buffer(GL_PIXEL_PACK_BUFFER, slots[i].PBO);
+		glBufferData(GL_PIXEL_PACK_BUFFER, bytes, NULL, GL_STREAM_READ);
+		slots[i].fence = 0;
+		slots[i].job = BATCH_NO_JOB;
+	}
+	GLState::bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	// Copies a finished readback and hands it to a job that writes the file
+	std::atomic<int> unwritten(0);
+	std::deque<Job*> writes;
+	size_t max_writes = 2 * JobSystem::threads();
+	auto finish = [&](BatchSlot& slot) {
+		if (slot.job == BATCH_NO_JOB)
+			return;
+		GLenum result = GL_TIMEOUT_EXPIRED;
+		while (result == GL_TIMEOUT_EXPIRED)
+			result = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+		glDeleteSync(slot.fence);
+		slot.fence = 0;
+
+		std::shared_ptr<std::vector<unsigned char> > pixels(new std::vector<unsigned char>(bytes));
+		GLState::bind_buffer(GL_PIXEL_PACK_BUFFER, slot.PBO);
+		const void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+		if (mapped != NULL)
+			memcpy(pixels->data(), mapped, bytes);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		GLState::bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		std::string output = jobs[slot.job].output;
+		bool copied = mapped != NULL;
+		writes.push_back(JobSystem::create([pixels, output, width, height, copied, &unwritten] {
+			if (!copied || !Headless::write_ppm(output.c_str(), pixels->data(), width, height))
+				unwritten++;
+		}));
+		JobSystem::submit(writes.back());
+		slot.job = BATCH_NO_JOB;
+		// A slow disk must not pile up images in memory
+		while (writes.size() > max_writes)
+		{
+			JobSystem::wait(writes.front());
+			writes.pop_front();
+		}
+	};
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	OBJObject* object = NULL;
+	std::string loaded;
+	int meshes = 0, unloaded = 0;
+	size_t rendered = 0;
+	for (size_t k = 0; k < mine.size(); k++)
+	{
+		const BatchJob& job = jobs[mine[k]];
+		if (object == NULL || loaded != job.mesh)
+		{
+			// The last mesh goes with its object, nothing else uses it
+			delete object;
+			object = new OBJObject(job.mesh.c_str());
+			loaded = job.mesh;
+			meshes++;
+		}
+		// Every job of a mesh that cannot be read fails, the others still run
+		if (!object->mesh)
+		{
+			fprintf(stderr, "%s:%d: cannot load %s\n", path, job.line, job.mesh.c_str());
+			unloaded++;
+			continue;
+		}
+
+		// The slot read RING_DEPTH images ago is written out while the GPU renders this one
+		BatchSlot& slot = slots[rendered % RING_DEPTH];
+		finish(slot);
+		draw(job, object, program, projection);
+		GLState::bind_buffer(GL_PIXEL_PACK_BUFFER, slot.PBO);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, 0);
+		GLState::bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+		slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		glFlush();
+		slot.job = mine[k];
+		rendered++;
+	}
+	for (int i = 0; i < RING_DEPTH; i++)
+		finish(slots[(rendered + i) % RING_DEPTH]);
+	while (!writes.empty())
+	{
+		JobSystem::wait(writes.front());
+		writes.pop_front();
+	}
+	double seconds = seconds_since(start);
+
+	delete object;
+	for (int i = 0; i < RING_DEPTH; i++)
+		GLState::delete_buffers(1, &slots[i].PBO);
+	UniformRing::clean_up();
+	glDeleteProgram(program);
+
+	size_t images = rendered - unwritten;
+	if (worker >= 0)
+		printf("Batch worker %d of %d: ", worker, workers);
+	else
+		printf("Batch: ");
+	printf("%zu images of %d meshes at %dx%d in %.2f s, %.1f images/s\n", images, meshes, width, height, seconds,
+		images / seconds);
+	return unloaded > 0 || unwritten > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
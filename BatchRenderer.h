@@ -0,0 +1,50 @@
+#ifndef _BATCHRENDERER_H_
+#define _BATCHRENDERER_H_
+
+#define GLFW_INCLUDE_GLEXT
+#ifdef __APPLE__
+#define GLFW_INCLUDE_GLCOREARB
+#else
+#include <GL/glew.h>
+#endif
+#include <GLFW/glfw3.h>
+#include <string>
+#include <vector>
+#include "Light.h"
+
+// One still: a mesh seen from a point on a sphere around the origin, under a light setup
+struct BatchJob
+{
+	std::string mesh;
+	std::string output;
+	float yaw = 0.0f, pitch = 0.0f;		// Degrees, 0 0 is the viewer's camera on the +z axis
+	float distance = 20.0f;
+	Light light;						// The viewer's defaults unless the line sets them
+	int line = 0;
+};
+
+// Renders a job file into PPM stills, one job per line:
+//   mesh.obj out.ppm [yaw deg] [pitch deg] [distance d] [dir x y z] [point x y z] [spot x y z] [cutoff deg]
+// The work is split among worker processes, copies of this executable that each render their share
+// into their own headless context. A mesh's jobs stay in one worker so it is uploaded once; only a
+// mesh with more than an even share of the jobs is split, into pieces of that size. Every process
+// computes the same split from the file, so the workers need nothing but their index.
+// A worker reads images back through a ring of pixel buffers and writes them as jobs, so the GPU
+// renders the next image while the last ones are copied and saved.
+class BatchRenderer
+{
+public:
+	static const int RING_DEPTH = 3;
+
+	// Job lines in file order, false after reporting the first bad line
+	static bool load(const char* path, std::vector<BatchJob>& jobs);
+	// Indices of the jobs worker renders out of workers, grouped by mesh
+	static std::vector<size_t> share(const std::vector<BatchJob>& jobs, int worker, int workers);
+	// Starts workers copies of executable on the job file, adding arguments to their command lines,
+	// and waits for all of them. Returns the exit code for the whole batch.
+	static int run_workers(const char* executable, const char* path, int workers, const std::string& arguments);
+	// Renders the share of worker, or every job for -1, with the current headless context
+	static int render(const char* path, int worker, int workers);
+};
+
+#endif
@@ -0,0 +1,136 @@
+#define _CRT_SECURE_NO_DEPRECATE
+#include "Benchmark.h"
+#include "Window.h"
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+typedef std::chrono::steady_clock bench_clock;
+
+static double ms_between(bench_clock::time_point a, bench_clock::time_point b)
+{
+	return std::chrono::duration<double, std::milli>(b - a).count();
+}
+
+static double percentile(const std::vector<double>& sorted, double p)
+{
+	if (sorted.empty())
+		return 0.0;
+	size_t index = (size_t)(p / 100.0 * (sorted.size() - 1) + 0.5);
+	return sorted[std::min(index, sorted.size() - 1)];
+}
+
+static double average(const std::vector<double>& values)
+{
+	double sum = 0.0;
+	for (size_t i = 0; i < values.size(); i++)
+		sum += values[i];
+	return values.empty() ? 0.0 : sum / values.size();
+}
+
+static void write_string(FILE* fp, const char* name, const char* value)
+{
+	fprintf(fp, "  \"%s\": \"", name);
+	for (const char* c = value ? value : ""; *c; c++)
+	{
+		if (*c == '"' || *c == '\\')
+			fputc('\\', fp);
+		fputc(*c, fp);
+	}
+	fprintf(fp, "\",\n");
+}
+
+static void write_stats(FILE* fp, const char* name, std::vector<double> values, bool last)
+{
+	std::sort(values.begin(), values.end());
+	fprintf(fp, "    \"%s\": { \"min\": %.4f, \"avg\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"max\": %.4f }%s\n",
+		name, values.empty() ? 0.0 : values.front(), average(values), percentile(values, 50), percentile(values, 90),
+		percentile(values, 99), values.empty() ? 0.0 : values.back(), last ? "" : ",");
+}
+
+void Benchmark::run(GLFWwindow* window, const std::vector<InputEvent>& events, int frames,
+	const char* source, const char* report_path)
+{
+	std::vector<double> frame_ms, update_ms, render_ms, input_ms, present_ms;
+	frame_ms.reserve(frames);
+	update_ms.reserve(frames);
+	render_ms.reserve(frames);
+	input_ms.reserve(frames);
+	present_ms.reserve(frames);
+
+	size_t next_event = 0;
+	bench_clock::time_point start = bench_clock::now();
+
+	// Same order as the interactive loop: display (render, input, swap), then idle
+	for (int frame = 0; frame < frames; frame++)
+	{
+		bench_clock::time_point t0 = bench_clock::now();
+		Window::render();
+		bench_clock::time_point t1 = bench_clock::now();
+
+		while (next_event < events.size() && events[next_event].frame <= frame)
+			InputRecorder::dispatch(window, events[next_event++]);
+		bench_clock::time_point t2 = bench_clock::now();
+
+		if (window)
+		{
+			glfwSwapBuffers(window);
+			// Keeps the window responsive. Live input callbacks are not installed while benchmarking.
+			glfwPollEvents();
+		}
+		bench_clock::time_point t3 = bench_clock::now();
+
+		Window::idle_callback();
+		bench_clock::time_point t4 = bench_clock::now();
+
+		render_ms.push_back(ms_between(t0, t1));
+		input_ms.push_back(ms_between(t1, t2));
+		present_ms.push_back(ms_between(t2, t3));
+		update_ms.push_back(ms_between(t3, t4));
+		frame_ms.push_back(ms_between(t0, t4));
+	}
+	// Count the work still queued on the GPU
+	if (!Window::software && !Window::raytrace)
+		glFinish();
+	double wall_s = ms_between(start, bench_clock::now()) / 1000.0;
+
+	FILE* fp = stdout;
+	if (report_path)
+	{
+		fp = fopen(report_path, "w");
+		if (fp == NULL)
+		{
+			fprintf(stderr, "Could not write %s, printing the report instead\n", report_path);
+			fp = stdout;
+		}
+	}
+
+	fprintf(fp, "{\n");
+	write_string(fp, "source", source);
+	write_string(fp, "renderer", Window::raytrace ? "ray tracer" : Window::software ? "software rasterizer" :
+		(const char*)glGetString(GL_RENDERER));
+	fprintf(fp, "  \"resolution\": [%d, %d],\n", Window::width, Window::height);
+	fprintf(fp, "  \"frames\": %d,\n", frames);
+	fprintf(fp, "  \"events\": %d,\n", (int)next_event);
+	fprintf(fp, "  \"wall_time_s\": %.4f,\n", wall_s);
+	fprintf(fp, "  \"fps\": %.2f,\n", wall_s > 0.0 ? frames / wall_s : 0.0);
+	if (Window::raytrace)
+		fprintf(fp, "  \"mrays_per_s\": %.3f,\n", RayTracer::rays_per_second() / 1e6);
+	fprintf(fp, "  \"frame_ms\": {\n");
+	write_stats(fp, "total", frame_ms, true);
+	fprintf(fp, "  },\n");
+	fprintf(fp, "  \"cpu_phase_ms\": {\n");
+	write_stats(fp, "render", render_ms, false);
+	write_stats(fp, "input", input_ms, false);
+	write_stats(fp, "present", present_ms, false);
+	write_stats(fp, "update", update_ms, true);
+	fprintf(fp, "  }\n");
+	fprintf(fp, "}\n");
+
+	if (fp != stdout)
+	{
+		fclose(fp);
+		printf("Benchmark report written to %s (%.1f fps)\n", report_path, wall_s > 0.0 ? frames / wall_s : 0.0);
+	}
+}
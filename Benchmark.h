@@ -0,0 +1,17 @@
+#ifndef _BENCHMARK_H_
+#define _BENCHMARK_H_
+
+#include "InputRecorder.h"
+
+// Plays a fixed list of input events over a fixed number of frames and reports frame time
+// percentiles, wall time and per-phase CPU time as JSON, so builds can be compared on identical work.
+class Benchmark
+{
+public:
+	// window may be NULL for headless runs, then nothing is swapped or polled.
+	// report_path NULL prints the report to stdout.
+	static void run(GLFWwindow* window, const std::vector<InputEvent>& events, int frames,
+		const char* source, const char* report_path);
+};
+
+#endif
@@ -1,5 +1,6 @@
 #include "Cube.h"
 #include "Window.h"
+#include <string.h>
 
 Cube::Cube()
 {
@@ -12,11 +13,11 @@ Cube::Cube()
 	
 	// Bind the Vertex Array Object (VAO) first, then bind the associated buffers to it.
 	// Consider the VAO as a container for all your buffers.
-	glBindVertexArray(VAO);
+	GLState::bind_vertex_array(VAO);
 
 	// Now bind a VBO to it as a GL_ARRAY_BUFFER. The GL_ARRAY_BUFFER is an array containing relevant data to what
 	// you want to draw, such as vertices, normals, colors, etc.
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	GLState::bind_buffer(GL_ARRAY_BUFFER, VBO);
 	// glBufferData populates the most recently bound buffer with data starting at the 3rd argument and ending after
 	// the 2nd argument number of indices. How does OpenGL know how long an index spans? Go to glVertexAttribPointer.
 	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
@@ -31,47 +32,43 @@ Cube::Cube()
 
 	// We've sent the vertex data over to OpenGL, but there's still something missing.
 	// In what order should it draw those vertices? That's why we'll need a GL_ELEMENT_ARRAY_BUFFER for this.
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	GLState::bind_buffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
 
 	// Unbind the currently bound buffer so that we don't accidentally make unwanted changes to it.
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	GLState::bind_buffer(GL_ARRAY_BUFFER, 0);
 	// Unbind the VAO now so we don't accidentally tamper with it.
 	// NOTE: You must NEVER unbind the element array buffer associated with a VAO!
-	glBindVertexArray(0);
+	GLState::bind_vertex_array(0);
 }
 
 Cube::~Cube()
 {
 	// Delete previously generated buffers. Note that forgetting to do this can waste GPU memory in a 
 	// large project! This could crash the graphics driver due to memory leaks, or slow down application performance!
-	glDeleteVertexArrays(1, &VAO);
-	glDeleteBuffers(1, &VBO);
-	glDeleteBuffers(1, &EBO);
+	GLState::delete_vertex_arrays(1, &VAO);
+	GLState::delete_buffers(1, &VBO);
+	GLState::delete_buffers(1, &EBO);
 }
 
 void Cube::draw(GLuint shaderProgram)
 { 
-	// Calculate the combination of the model and view (camera inverse) matrices
-	glm::mat4 modelview = Window::V * toWorld;
-	// We need to calcullate this because modern OpenGL does not keep track of any matrix other than the viewport (D)
-	// Consequently, we need to forward the projection, view, and model matrices to the shader programs
-	// Get the location of the uniform variables "projection" and "modelview"
-	uProjection = glGetUniformLocation(shaderProgram, "projection");
-	uModelview = glGetUniformLocation(shaderProgram, "modelview");
-	uModel = glGetUniformLocation(shaderProgram, "model");
-	uView = glGetUniformLocation(shaderProgram, "view");
-	// Now send these values to the shader program
-	glUniformMatrix4fv(uProjection, 1, GL_FALSE, &Window::P[0][0]);
-	glUniformMatrix4fv(uModelview, 1, GL_FALSE, &modelview[0][0]);
-	glUniformMatrix4fv(uModel, 1, GL_FALSE, &toWorld[0][0]);
-	glUniformMatrix4fv(uView, 1, GL_FALSE, &Window::V[0][0]);
+	// Matrices for the shader, in this frame's part of the uniform ring. The cube has no material.
+	DrawUniforms uniforms = DrawUniforms();
+	uniforms.projection = Window::P;
+	uniforms.modelview = Window::V * toWorld;
+	uniforms.model = toWorld;
+	uniforms.view = Window::V;
+	GLintptr offset;
+	void* data = UniformRing::allocate(sizeof(uniforms), offset);
+	if (data == NULL)
+		return;
+	memcpy(data, &uniforms, sizeof(uniforms));
+	UniformRing::bind(DRAW_DATA_BINDING, offset, sizeof(uniforms));
 	// Now draw the cube. We simply need to bind the VAO associated with it.
-	glBindVertexArray(VAO);
+	GLState::bind_vertex_array(VAO);
 	// Tell OpenGL to draw with triangles, using 36 indices, the type of the indices, and the offset to start from
 	glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-	// Unbind the VAO when we're done so we don't accidentally draw extra stuff or tamper with its bound buffers
-	glBindVertexArray(0);
 }
 
 void Cube::update()
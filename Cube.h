@@ -27,9 +27,8 @@ public:
 	void update();
 	void spin(float);
 
-	// These variables are needed for the shader program
+	// Buffers of the cube, the shader gets its matrices from the uniform ring
 	GLuint VBO, VAO, EBO;
-	GLuint uProjection, uModelview, uView, uModel;
 };
 
 // Define the coordinates and indices needed to draw the cube. Note that it is not necessary
@@ -0,0 +1,227 @@
+#define _CRT_SECURE_NO_DEPRECATE
+#include "DepthPrepass.h"
+#include "shader.h"
+#include "GLState.h"
+#include "QueryRing.h"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+DepthPrepass::Mode DepthPrepass::mode = DepthPrepass::AUTO;
+float DepthPrepass::threshold = 1.5f;
+
+// Once on, AUTO keeps the pre-pass until the overdraw drops this far below the threshold,
+// so a scene right at the threshold doesn't switch every frame
+const float HYSTERESIS = 0.9f;
+
+struct PrepassFrame {
+	bool pending;
+	bool prepass;
+	double samples;				// Samples in the viewport, for per pixel figures
+	QueryPool depth, color;		// Samples passed by each draw of the two passes
+};
+
+QueryRing<PrepassFrame, DepthPrepass::FRAME_LATENCY> pp_ring;
+bool pp_in_depth = false;
+GLenum pp_depth_func_before = GL_LEQUAL;
+
+GLuint pp_program = 0;
+
+// AUTO state, decided from the frames read back
+bool pp_auto_on = false;
+int pp_frames_since_probe = 0;
+
+// Latest frame read back, per pixel of the viewport
+bool pp_last_prepass = false;
+float pp_last_shaded = 0.0f, pp_last_without = 0.0f, pp_overdraw = 0.0f;
+double pp_total_with = 0.0, pp_total_without = 0.0;
+int pp_frames_with = 0, pp_frames_counted = 0;
+
+// gl_Position is invariant here and in the lighting shaders, so GL_EQUAL matches exactly
+static const char* DepthVertexShader =
+	"#version 330 core\n"
+	"layout (location = 0) in vec3 position;\n"
+	// The start of the DrawData block of shader.vert
+	"layout (std140) uniform DrawData {\n"
+	"    mat4 projection;\n"
+	"    mat4 modelview;\n"
+	"    mat4 model;\n"
+	"    mat4 view;\n"
+	"};\n"
+	"invariant gl_Position;\n"
+	"void main()\n"
+	"{\n"
+	"    gl_Position = projection * view * model * vec4(position.x, position.y, position.z, 1.0);\n"
+	"}\n";
+
+static const char* DepthFragmentShader =
+	"#version 330 core\n"
+	"void main()\n"
+	"{\n"
+	"}\n";
+
+static GLuint sum_queries(const QueryPool& pool)
+{
+	GLuint total = 0;
+	for (size_t q = 0; q < pool.used; q++)
+	{
+		GLuint passed = 0;
+		glGetQueryObjectuiv(pool.queries[q], GL_QUERY_RESULT, &passed);
+		total += passed;
+	}
+	return total;
+}
+
+// The lighting pass comes after the pre-pass
+static bool frame_ready(const PrepassFrame& frame)
+{
+	return query_ready(frame.color.used > 0 ? frame.color.last() : frame.depth.last());
+}
+
+// Takes the counts of a finished frame and makes the AUTO decision
+static void read_frame(const PrepassFrame& frame)
+{
+	GLuint depth = sum_queries(frame.depth);
+	GLuint color = sum_queries(frame.color);
+	double samples = std::max(frame.samples, 1.0);
+	pp_last_prepass = frame.prepass;
+	pp_last_shaded = (float)(color / samples);
+	// Without a pre-pass the lighting pass sees the same fragments the pre-pass did
+	pp_last_without = (float)((frame.prepass ? depth : color) / samples);
+	pp_total_without += pp_last_without;
+	pp_frames_counted++;
+	if (frame.prepass)
+	{
+		pp_total_with += pp_last_shaded;
+		pp_frames_with++;
+		// After a pre-pass only the visible fragments are lit, which gives the overdraw
+		pp_overdraw = color > 0 ? depth / (float)color : 0.0f;
+		float limit = pp_auto_on ? DepthPrepass::threshold * HYSTERESIS : DepthPrepass::threshold;
+		pp_auto_on = color > 0 && pp_overdraw > limit;
+	}
+}
+
+bool DepthPrepass::begin_frame()
+{
+	PrepassFrame& frame = pp_ring.advance(frame_ready, read_frame);
+	frame.depth.used = 0;
+	frame.color.used = 0;
+
+	GLint viewport[4], samples = 0;
+	GLState::get_viewport(viewport);
+	glGetIntegerv(GL_SAMPLES, &samples);
+	frame.samples = (double)viewport[2] * viewport[3] * std::max(samples, 1);
+
+	bool active = mode == ON;
+	if (mode == AUTO)
+	{
+		active = pp_auto_on || ++pp_frames_since_probe >= PROBE_INTERVAL;
+		if (active)
+			pp_frames_since_probe = 0;
+	}
+	frame.prepass = active;
+	pp_in_depth = active;
+	if (!active)
+		return false;
+
+	if (pp_program == 0)
+		pp_program = LoadShaderSource(DepthVertexShader, DepthFragmentShader, "depth pre-pass");
+	GLState::color_mask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	return true;
+}
+
+GLuint DepthPrepass::program()
+{
+	return pp_program;
+}
+
+void DepthPrepass::begin_color()
+{
+	pp_in_depth = false;
+	if (!pp_ring.now().prepass)
+		return;
+	GLState::color_mask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	pp_depth_func_before = GLState::get_depth_func();
+	GLState::depth_func(GL_EQUAL);
+	GLState::depth_mask(GL_FALSE);
+}
+
+void DepthPrepass::end_frame()
+{
+	if (!pp_ring.now().prepass)
+		return;
+	GLState::depth_func(pp_depth_func_before);
+	GLState::depth_mask(GL_TRUE);
+}
+
+void DepthPrepass::begin_draw()
+{
+	PrepassFrame& frame = pp_ring.now();
+	QueryPool& pool = pp_in_depth ? frame.depth : frame.color;
+	glBeginQuery(GL_SAMPLES_PASSED, pool.next());
+}
+
+void DepthPrepass::end_draw()
+{
+	glEndQuery(GL_SAMPLES_PASSED);
+}
+
+const char* DepthPrepass::mode_name()
+{
+	return mode == ON ? "on" : mode == OFF ? "off" : "auto";
+}
+
+bool DepthPrepass::parse_mode(const char* name)
+{
+	if (strcmp(name, "on") == 0)
+		mode = ON;
+	else if (strcmp(name, "off") == 0)
+		mode = OFF;
+	else if (strcmp(name, "auto") == 0)
+		mode = AUTO;
+	else
+		return false;
+	return true;
+}
+
+std::string DepthPrepass::overlay_text()
+{
+	if (pp_frames_counted == 0)
+		return std::string();
+	const char* state = mode != AUTO ? mode_name() : pp_last_prepass ? "auto, on" : "auto, off";
+	char text[128];
+	if (pp_last_prepass)
+		snprintf(text, sizeof(text), "pre-pass %s, %.2f frag/px (%.2f without), overdraw %.1fx",
+			state, pp_last_shaded, pp_last_without, pp_overdraw);
+	else
+		snprintf(text, sizeof(text), "pre-pass %s, %.2f frag/px", state, pp_last_shaded);
+	return text;
+}
+
+void DepthPrepass::print_summary()
+{
+	if (pp_frames_counted == 0)
+		return;
+	printf("Depth pre-pass (%s) on %d of %d frames, shaded fragments per pixel: ", mode_name(), pp_frames_with,
+		pp_frames_counted);
+	if (pp_frames_with > 0)
+		printf("%.2f with the pre-pass, ", pp_total_with / pp_frames_with);
+	printf("%.2f without\n", pp_total_without / pp_frames_counted);
+}
+
+void DepthPrepass::clean_up()
+{
+	for (int i = 0; i < FRAME_LATENCY; i++)
+	{
+		PrepassFrame& frame = pp_ring.frames[i];
+		frame.depth.clean_up();
+		frame.color.clean_up();
+		frame.pending = false;
+	}
+	if (pp_program != 0)
+	{
+		glDeleteProgram(pp_program);
+		pp_program = 0;
+	}
+}
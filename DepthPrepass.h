@@ -0,0 +1,47 @@
+#ifndef _DEPTHPREPASS_H_
+#define _DEPTHPREPASS_H_
+
+#define GLFW_INCLUDE_GLEXT
+#ifdef __APPLE__
+#define GLFW_INCLUDE_GLCOREARB
+#else
+#include <GL/glew.h>
+#endif
+#include <GLFW/glfw3.h>
+#include <string>
+
+// Lays down depth with a position-only shader before the lighting pass, which then runs with
+// GL_EQUAL and depth writes off, so every pixel is lit once no matter how many layers of a mesh
+// cover it. Every draw call is wrapped in a samples-passed query: the pre-pass counts the fragments
+// the lighting shader would have run for without it, the lighting pass the ones it actually ran for.
+// In AUTO the pre-pass is used while the overdraw (fragments per visible pixel) is above threshold.
+// With the pre-pass off, a probe frame every PROBE_INTERVAL frames keeps the overdraw up to date.
+class DepthPrepass
+{
+public:
+	enum Mode { OFF, ON, AUTO };
+	static const int FRAME_LATENCY = 4;
+	static const int PROBE_INTERVAL = 120;
+
+	static Mode mode;			// --prepass, D cycles
+	static float threshold;		// Overdraw above which AUTO uses the pre-pass
+
+	// Call with the scene framebuffer bound. true if the scene should be drawn with program()
+	// before begin_color.
+	static bool begin_frame();
+	static GLuint program();
+	// Switches from depth to lighting, with GL_EQUAL and no depth writes after a pre-pass
+	static void begin_color();
+	static void end_frame();
+	// Around every draw call of both passes
+	static void begin_draw();
+	static void end_draw();
+
+	static const char* mode_name();
+	static bool parse_mode(const char* name);
+	static std::string overlay_text();
+	static void print_summary();
+	static void clean_up();
+};
+
+#endif
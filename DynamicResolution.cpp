@@ -0,0 +1,216 @@
+#define _CRT_SECURE_NO_DEPRECATE
+#include "DynamicResolution.h"
+#include "GpuProfiler.h"
+#include "shader.h"
+#include "GLState.h"
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+
+bool DynamicResolution::enabled = false;
+float DynamicResolution::target_ms = 16.0f;
+float DynamicResolution::min_scale = 0.5f;
+float DynamicResolution::max_scale = 1.0f;
+float DynamicResolution::sharpness = 0.5f;
+float DynamicResolution::scale = 1.0f;
+
+// Frame times between DEADBAND and 1 times the target leave the scale alone, so it doesn't flicker
+const float DEADBAND = 0.85f;
+// The scale moves a quarter of the way each frame, GPU timings arrive a few frames late
+const float GAIN = 0.25f;
+
+GLuint dr_fbo = 0;
+GLuint dr_color = 0;
+GLuint dr_depth = 0;
+GLuint dr_program = 0;
+GLuint dr_vao = 0;
+GLint dr_uSource, dr_uExtent, dr_uTexel, dr_uSharpness;
+
+// The target is allocated for max_scale and only a corner of it is drawn into,
+// so changing the scale never reallocates anything
+int dr_texture_width = 0, dr_texture_height = 0;
+int dr_output_width = 0, dr_output_height = 0;
+int dr_render_width = 0, dr_render_height = 0;
+GLuint dr_previous_draw = 0, dr_previous_read = 0;
+int dr_last_sample = -1;
+bool dr_active = false;
+
+// One triangle covering the screen, positions come from gl_VertexID
+static const char* UpscaleVertexShader =
+	"#version 330 core\n"
+	"out vec2 uv;\n"
+	"void main()\n"
+	"{\n"
+	"    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);\n"
+	"    uv = corner;\n"
+	"    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);\n"
+	"}\n";
+
+// Bilinear upscale plus a cross-shaped unsharp mask. The result is clamped to the neighborhood,
+// which keeps the sharpening from ringing around edges.
+static const char* UpscaleFragmentShader =
+	"#version 330 core\n"
+	"in vec2 uv;\n"
+	"uniform sampler2D source;\n"
+	"uniform vec2 extent;\n"
+	"uniform vec2 texel;\n"
+	"uniform float sharpness;\n"
+	"out vec4 color;\n"
+	"vec3 fetch(vec2 p)\n"
+	"{\n"
+	"    return texture(source, clamp(p, 0.5 * texel, extent - 0.5 * texel)).rgb;\n"
+	"}\n"
+	"void main()\n"
+	"{\n"
+	"    vec2 p = uv * extent;\n"
+	"    vec3 c = fetch(p);\n"
+	"    vec3 n = fetch(p + vec2(0.0, texel.y));\n"
+	"    vec3 s = fetch(p - vec2(0.0, texel.y));\n"
+	"    vec3 e = fetch(p + vec2(texel.x, 0.0));\n"
+	"    vec3 w = fetch(p - vec2(texel.x, 0.0));\n"
+	"    vec3 lo = min(c, min(min(n, s), min(e, w)));\n"
+	"    vec3 hi = max(c, max(max(n, s), max(e, w)));\n"
+	"    vec3 sharpened = c + sharpness * (4.0 * c - (n + s + e + w));\n"
+	"    color = vec4(clamp(sharpened, lo, hi), 1.0);\n"
+	"}\n";
+
+static void create_target(int width, int height)
+{
+	dr_texture_width = std::max(1, (int)ceilf(width * DynamicResolution::max_scale));
+	dr_texture_height = std::max(1, (int)ceilf(height * DynamicResolution::max_scale));
+
+	if (dr_fbo == 0)
+	{
+		glGenFramebuffers(1, &dr_fbo);
+		glGenTextures(1, &dr_color);
+		glGenRenderbuffers(1, &dr_depth);
+	}
+
+	GLState::bind_texture(GL_TEXTURE_2D, dr_color);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, dr_texture_width, dr_texture_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	GLState::bind_texture(GL_TEXTURE_2D, 0);
+
+	glBindRenderbuffer(GL_RENDERBUFFER, dr_depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, dr_texture_width, dr_texture_height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	GLState::bind_framebuffer(GL_FRAMEBUFFER, dr_fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, dr_color, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, dr_depth);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		fprintf(stderr, "Dynamic resolution target is incomplete, rendering at full resolution\n");
+		DynamicResolution::enabled = false;
+	}
+
+	if (dr_program == 0)
+	{
+		dr_program = LoadShaderSource(UpscaleVertexShader, UpscaleFragmentShader, "upscale");
+		dr_uSource = glGetUniformLocation(dr_program, "source");
+		dr_uExtent = glGetUniformLocation(dr_program, "extent");
+		dr_uTexel = glGetUniformLocation(dr_program, "texel");
+		dr_uSharpness = glGetUniformLocation(dr_program, "sharpness");
+		// Core profiles need a vertex array object bound even without attributes
+		glGenVertexArrays(1, &dr_vao);
+	}
+}
+
+// GPU time scales with the pixel count, that is with the square of the scale
+static void adapt()
+{
+	int frame;
+	float gpu_ms = GpuProfiler::last("frame", &frame);
+	if (frame == dr_last_sample || gpu_ms <= 0.0f)
+		return;
+	dr_last_sample = frame;
+
+	float ratio = DynamicResolution::target_ms / gpu_ms;
+	if (ratio >= 1.0f && ratio <= 1.0f / DEADBAND)
+		return;
+
+	float wanted = DynamicResolution::scale * sqrtf(ratio * (1.0f + DEADBAND) / 2.0f);
+	float scale = DynamicResolution::scale + GAIN * (wanted - DynamicResolution::scale);
+	DynamicResolution::scale = std::min(DynamicResolution::max_scale, std::max(DynamicResolution::min_scale, scale));
+}
+
+void DynamicResolution::begin_scene(int width, int height)
+{
+	if (!enabled || width <= 0 || height <= 0)
+		return;
+
+	if (dr_fbo == 0 || width != dr_output_width || height != dr_output_height)
+	{
+		dr_output_width = width;
+		dr_output_height = height;
+		create_target(width, height);
+		if (!enabled)
+			return;
+	}
+
+	adapt();
+	dr_render_width = std::max(1, std::min(dr_texture_width, (int)(width * scale + 0.5f)));
+	dr_render_height = std::max(1, std::min(dr_texture_height, (int)(height * scale + 0.5f)));
+
+	// Headless rendering has its own framebuffer bound, put back whatever was there
+	dr_previous_draw = GLState::get_framebuffer(GL_DRAW_FRAMEBUFFER);
+	dr_previous_read = GLState::get_framebuffer(GL_READ_FRAMEBUFFER);
+	GLState::bind_framebuffer(GL_FRAMEBUFFER, dr_fbo);
+	GLState::viewport(0, 0, dr_render_width, dr_render_height);
+	dr_active = true;
+}
+
+void DynamicResolution::end_scene()
+{
+	if (!dr_active)
+		return;
+	dr_active = false;
+
+	GLState::bind_framebuffer(GL_DRAW_FRAMEBUFFER, dr_previous_draw);
+	GLState::bind_framebuffer(GL_READ_FRAMEBUFFER, dr_previous_read);
+	GLState::viewport(0, 0, dr_output_width, dr_output_height);
+
+	GLState::disable(GL_DEPTH_TEST);
+	GLState::use_program(dr_program);
+	GLState::active_texture(GL_TEXTURE0);
+	GLState::bind_texture(GL_TEXTURE_2D, dr_color);
+	glUniform1i(dr_uSource, 0);
+	glUniform2f(dr_uExtent, (float)dr_render_width / dr_texture_width, (float)dr_render_height / dr_texture_height);
+	glUniform2f(dr_uTexel, 1.0f / dr_texture_width, 1.0f / dr_texture_height);
+	// Nothing to sharpen at full resolution
+	glUniform1f(dr_uSharpness, dr_render_width < dr_output_width ? sharpness : 0.0f);
+	GLState::bind_vertex_array(dr_vao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	GLState::bind_texture(GL_TEXTURE_2D, 0);
+	GLState::enable(GL_DEPTH_TEST);
+}
+
+std::string DynamicResolution::overlay_text()
+{
+	if (!enabled)
+		return std::string();
+	char text[64];
+	snprintf(text, sizeof(text), "scale %.0f%% for %.1f ms", scale * 100.0f, target_ms);
+	return text;
+}
+
+void DynamicResolution::clean_up()
+{
+	if (dr_fbo != 0)
+	{
+		GLState::delete_framebuffers(1, &dr_fbo);
+		GLState::delete_textures(1, &dr_color);
+		glDeleteRenderbuffers(1, &dr_depth);
+		dr_fbo = dr_color = dr_depth = 0;
+	}
+	if (dr_program != 0)
+	{
+		glDeleteProgram(dr_program);
+		GLState::delete_vertex_arrays(1, &dr_vao);
+		dr_program = dr_vao = 0;
+	}
+	dr_output_width = dr_output_height = 0;
+}
@@ -0,0 +1,35 @@
+#ifndef _DYNAMICRESOLUTION_H_
+#define _DYNAMICRESOLUTION_H_
+
+#define GLFW_INCLUDE_GLEXT
+#ifdef __APPLE__
+#define GLFW_INCLUDE_GLCOREARB
+#else
+#include <GL/glew.h>
+#endif
+#include <GLFW/glfw3.h>
+#include <string>
+
+// Renders the scene into an offscreen target at a fraction of the framebuffer size and upscales it
+// with a sharpening filter. The scale follows the GPU frame time measured by GpuProfiler, so frames
+// stay within target_ms on large framebuffers and go back to full resolution when there is headroom.
+class DynamicResolution
+{
+public:
+	static bool enabled;
+	static float target_ms;		// GPU frame time to hold
+	static float min_scale;		// Bounds of the scale per axis
+	static float max_scale;
+	static float sharpness;		// 0 is plain bilinear upscaling
+	static float scale;			// Current scale per axis
+
+	// Redirects drawing into the scaled target. width and height are the size of the real framebuffer.
+	static void begin_scene(int width, int height);
+	// Upscales into the framebuffer that was bound before begin_scene and adjusts the scale
+	static void end_scene();
+
+	static std::string overlay_text();
+	static void clean_up();
+};
+
+#endif
@@ -0,0 +1,265 @@
+#define _CRT_SECURE_NO_DEPRECATE
+#include "FrameCapture.h"
+#include "GLState.h"
+#include <string.h>
+
+FrameCapture::FrameCapture()
+{
+	frames_captured = 0;
+	frames_written = 0;
+	frames_dropped = 0;
+	capturing = false;
+	y4m = false;
+	width = height = fps = 0;
+	video = NULL;
+	head = tail = next_frame = 0;
+	quit = false;
+	for (int i = 0; i < RING_DEPTH; i++)
+	{
+		slots[i].PBO = 0;
+		slots[i].fence = 0;
+		slots[i].pixels = NULL;
+		slots[i].frame = 0;
+		slots[i].state = SLOT_FREE;
+	}
+}
+
+FrameCapture::~FrameCapture()
+{
+	// stop() needs a current context, so it has to be called before the context goes away
+	if (capturing)
+		fprintf(stderr, "FrameCapture destroyed while still capturing\n");
+}
+
+bool FrameCapture::start(const char* path, int width, int height, int fps)
+{
+	if (capturing)
+		stop();
+
+	this->path = path;
+	this->width = width;
+	this->height = height;
+	this->fps = fps;
+	y4m = this->path.size() >= 4 && this->path.compare(this->path.size() - 4, 4, ".y4m") == 0;
+	if (!y4m && this->path.find('%') == std::string::npos)
+		this->path += "%05d.ppm";
+
+	if (y4m)
+	{
+		video = fopen(path, "wb");
+		if (video == NULL)
+		{
+			fprintf(stderr, "Could not open %s for capture\n", path);
+			return false;
+		}
+		// 4:4:4 keeps the conversion trivial and avoids chroma subsampling artifacts on thin edges
+		fprintf(video, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", width, height, fps);
+	}
+
+	// One pixel buffer per ring slot, big enough for a full RGBA frame
+	for (int i = 0; i < RING_DEPTH; i++)
+	{
+		glGenBuffers(1, &slots[i].PBO);
+		GLState::bind_buffer(GL_PIXEL_PACK_BUFFER, slots[i].PBO);
+		glBufferData(GL_PIXEL_PACK_BUFFER, width * height * 4, NULL, GL_STREAM_READ);
+		slots[i].state = SLOT_FREE;
+	}
+	GLState::bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	frames_captured = 0;
+	frames_written = 0;
+	frames_dropped = 0;
+	head = tail = next_frame = 0;
+	quit = false;
+	writer = std::thread(&FrameCapture::writer_loop, this);
+	capturing = true;
+	printf("Capturing %dx%d frames to %s\n", width, height, this->path.c_str());
+	return true;
+}
+
+bool FrameCapture::active() const
+{
+	return capturing;
+}
+
+void FrameCapture::capture()
+{
+	if (!capturing)
+		return;
+
+	harvest(false);
+
+	// Never wait for the GPU: if the ring is full this frame is simply not recorded
+	Slot& slot = slots[head];
+	if (slot.state != SLOT_FREE)
+	{
+		frames_dropped++;
+		return;
+	}
+
+	// With a pack buffer bound glReadPixels only queues the copy and returns immediately
+	GLState::bind_buffer(GL_PIXEL_PACK_BUFFER, slot.PBO);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+	GLState::bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	// Make sure the fence reaches the GPU even when nothing swaps buffers (headless)
+	glFlush();
+
+	slot.frame = next_frame++;
+	slot.state = SLOT_READING;
+	head = (head + 1) % RING_DEPTH;
+	frames_captured++;
+}
+
+void FrameCapture::harvest(bool wait)
+{
+	// Buffers the writer is done with can be unmapped and reused
+	for (int i = 0; i < RING_DEPTH; i++)
+	{
+		if (slots[i].state == SLOT_WRITTEN)
+		{
+			GLState::bind_buffer(GL_PIXEL_PACK_BUFFER, slots[i].PBO);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+			slots[i].pixels = NULL;
+			slots[i].state = SLOT_FREE;
+		}
+	}
+
+	// Map finished readbacks oldest first, so frames reach the writer in order
+	while (slots[tail].state == SLOT_READING)
+	{
+		Slot& slot = slots[tail];
+		GLenum result = glClientWaitSync(slot.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? 1000000000 : 0);
+		if (result == GL_TIMEOUT_EXPIRED)
+			break;
+		glDeleteSync(slot.fence);
+		slot.fence = 0;
+
+		GLState::bind_buffer(GL_PIXEL_PACK_BUFFER, slot.PBO);
+		slot.pixels = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, width * height * 4, GL_MAP_READ_BIT);
+		slot.state = SLOT_WRITING;
+		{
+			std::lock_guard<std::mutex> lock(queue_mutex);
+			queue.push_back(&slot);
+		}
+		queue_wake.notify_one();
+		tail = (tail + 1) % RING_DEPTH;
+	}
+	GLState::bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void FrameCapture::stop()
+{
+	if (!capturing)
+		return;
+
+	// Drain everything that is still in flight
+	for (;;)
+	{
+		harvest(true);
+		bool busy = false;
+		for (int i = 0; i < RING_DEPTH; i++)
+			if (slots[i].state != SLOT_FREE)
+				busy = true;
+		if (!busy)
+			break;
+		std::this_thread::yield();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(queue_mutex);
+		quit = true;
+	}
+	queue_wake.notify_one();
+	writer.join();
+
+	for (int i = 0; i < RING_DEPTH; i++)
+	{
+		GLState::delete_buffers(1, &slots[i].PBO);
+		slots[i].PBO = 0;
+	}
+	if (video)
+	{
+		fclose(video);
+		video = NULL;
+	}
+	capturing = false;
+	printf("Capture finished: %d frames written, %d dropped\n", (int)frames_written, frames_dropped);
+}
+
+void FrameCapture::writer_loop()
+{
+	for (;;)
+	{
+		Slot* slot;
+		{
+			std::unique_lock<std::mutex> lock(queue_mutex);
+			queue_wake.wait(lock, [this] { return quit || !queue.empty(); });
+			if (queue.empty())
+				break;
+			slot = queue.front();
+			queue.pop_front();
+		}
+
+		if (slot->pixels)
+			write_frame(slot->pixels, slot->frame);
+		// The GL thread unmaps the buffer on its next harvest
+		slot->state = SLOT_WRITTEN;
+	}
+}
+
+void FrameCapture::write_frame(const unsigned char* pixels, int frame)
+{
+	int pixel_count = width * height;
+	converted.resize(pixel_count * 3);
+
+	if (y4m)
+	{
+		// RGBA to planar BT.601 YCbCr. OpenGL rows start at the bottom, video rows at the top.
+		unsigned char* Y = &converted[0];
+		unsigned char* U = Y + pixel_count;
+		unsigned char* V = U + pixel_count;
+		for (int y = 0; y < height; y++)
+		{
+			const unsigned char* row = pixels + (height - 1 - y) * width * 4;
+			for (int x = 0; x < width; x++)
+			{
+				int r = row[x * 4], g = row[x * 4 + 1], b = row[x * 4 + 2];
+				int i = y * width + x;
+				Y[i] = (unsigned char)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+				U[i] = (unsigned char)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+				V[i] = (unsigned char)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+			}
+		}
+		fputs("FRAME\n", video);
+		fwrite(&converted[0], 1, converted.size(), video);
+	}
+	else
+	{
+		for (int y = 0; y < height; y++)
+		{
+			const unsigned char* row = pixels + (height - 1 - y) * width * 4;
+			unsigned char* out = &converted[y * width * 3];
+			for (int x = 0; x < width; x++)
+			{
+				out[x * 3] = row[x * 4];
+				out[x * 3 + 1] = row[x * 4 + 1];
+				out[x * 3 + 2] = row[x * 4 + 2];
+			}
+		}
+
+		char filename[1024];
+		snprintf(filename, sizeof(filename), path.c_str(), frame);
+		FILE* fp = fopen(filename, "wb");
+		if (fp == NULL)
+		{
+			fprintf(stderr, "Could not write %s\n", filename);
+			return;
+		}
+		fprintf(fp, "P6\n%d %d\n255\n", width, height);
+		fwrite(&converted[0], 1, converted.size(), fp);
+		fclose(fp);
+	}
+	frames_written++;
+}
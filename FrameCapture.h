@@ -0,0 +1,79 @@
+#ifndef _FRAMECAPTURE_H_
+#define _FRAMECAPTURE_H_
+
+#define GLFW_INCLUDE_GLEXT
+#ifdef __APPLE__
+#define GLFW_INCLUDE_GLCOREARB
+#else
+#include <GL/glew.h>
+#endif
+#include <GLFW/glfw3.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <atomic>
+
+// Streams rendered frames to disk without stalling the GPU.
+// Every frame is read into one of RING_DEPTH pixel buffer objects, and a fence tells us when the
+// copy has landed. Only then is the buffer mapped and handed to a writer thread, so a frame
+// reaches the disk at most RING_DEPTH frames after it was rendered. If all buffers are still
+// busy the frame is dropped instead of waiting.
+class FrameCapture
+{
+public:
+	static const int RING_DEPTH = 3;
+
+	FrameCapture();
+	~FrameCapture();
+
+	// A path ending in .y4m writes one Y4M video, anything else a PPM sequence.
+	// PPM paths may contain a printf pattern for the frame number, e.g. "frames/%05d.ppm".
+	bool start(const char* path, int width, int height, int fps = 60);
+	// Call once per frame after drawing, reads from the current read framebuffer
+	void capture();
+	// Waits for the frames still in flight and closes the output
+	void stop();
+	bool active() const;
+
+	int frames_captured;
+	std::atomic<int> frames_written;
+	int frames_dropped;
+
+private:
+	enum SlotState { SLOT_FREE, SLOT_READING, SLOT_WRITING, SLOT_WRITTEN };
+
+	struct Slot {
+		GLuint PBO;
+		GLsync fence;
+		const unsigned char* pixels;
+		int frame;
+		std::atomic<int> state;
+	};
+
+	void harvest(bool wait);
+	void writer_loop();
+	void write_frame(const unsigned char* pixels, int frame);
+
+	bool capturing;
+	bool y4m;
+	std::string path;
+	int width, height, fps;
+	FILE* video;
+	Slot slots[RING_DEPTH];
+	int head;			// Next slot to read into
+	int tail;			// Oldest slot still waiting for its fence
+	int next_frame;
+	std::vector<unsigned char> converted;
+
+	std::thread writer;
+	std::mutex queue_mutex;
+	std::condition_variable queue_wake;
+	std::deque<Slot*> queue;
+	bool quit;
+};
+
+#endif
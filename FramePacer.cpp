@@ -0,0 +1,136 @@
+#define _CRT_SECURE_NO_DEPRECATE
+#include "FramePacer.h"
+#include <stdio.h>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+
+struct PacerSamples {
+	float values[FramePacer::WINDOW];
+	int count;
+	int next;
+};
+
+bool FramePacer::enabled = false;
+
+// Frames that cost more than their recent maximum plus this still make the deadline
+const double SAFETY_MARGIN = 0.0015;
+// How many recent frames the cost prediction looks at
+const int COST_HISTORY = 32;
+// Sleeping is coarse, spin for the last part
+const double SPIN_TIME = 0.002;
+
+double refresh_interval = 1.0 / 60.0;
+double last_present = 0.0;
+double frame_start = 0.0;
+PacerSamples frame_cost = PacerSamples();
+PacerSamples latency = PacerSamples();
+int latency_total = 0;
+
+static void add_sample(PacerSamples& samples, double ms)
+{
+	samples.values[samples.next] = (float)ms;
+	samples.next = (samples.next + 1) % FramePacer::WINDOW;
+	samples.count = std::min(samples.count + 1, (int)FramePacer::WINDOW);
+}
+
+static bool latency_stats(float& avg, float& p99)
+{
+	if (latency.count == 0)
+		return false;
+	std::vector<float> sorted(latency.values, latency.values + latency.count);
+	std::sort(sorted.begin(), sorted.end());
+
+	float sum = 0.0f;
+	for (size_t i = 0; i < sorted.size(); i++)
+		sum += sorted[i];
+	avg = sum / sorted.size();
+	p99 = sorted[std::min(sorted.size() - 1, (size_t)(sorted.size() * 0.99f))];
+	return true;
+}
+
+// Seconds the next frame is expected to take from sampling input until the GPU is done
+static double predicted_cost()
+{
+	double worst = 0.0;
+	int n = std::min(frame_cost.count, COST_HISTORY);
+	for (int i = 1; i <= n; i++)
+		worst = std::max(worst, (double)frame_cost.values[(frame_cost.next - i + FramePacer::WINDOW) % FramePacer::WINDOW]);
+	return worst / 1000.0;
+}
+
+void FramePacer::initialize()
+{
+	GLFWmonitor* monitor = glfwGetPrimaryMonitor();
+	const GLFWvidmode* mode = monitor ? glfwGetVideoMode(monitor) : NULL;
+	if (mode && mode->refreshRate > 0)
+		refresh_interval = 1.0 / mode->refreshRate;
+}
+
+void FramePacer::wait()
+{
+	if (!enabled || last_present == 0.0)
+	{
+		frame_start = glfwGetTime();
+		return;
+	}
+
+	// The last swap returned at a vsync, the following ones are a refresh interval apart
+	double cost = predicted_cost() + SAFETY_MARGIN;
+	double now = glfwGetTime();
+	double deadline = last_present + refresh_interval;
+	while (deadline - cost < now)
+		deadline += refresh_interval;
+	double wake = deadline - cost;
+
+	if (wake - now > SPIN_TIME)
+		std::this_thread::sleep_for(std::chrono::duration<double>(wake - now - SPIN_TIME));
+	while (glfwGetTime() < wake)
+		std::this_thread::yield();
+
+	frame_start = glfwGetTime();
+}
+
+void FramePacer::finish_frame()
+{
+	if (!enabled)
+		return;
+
+	// Keep the GPU queue at this one frame, so the swap shows it at the next vsync
+	GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 100000000);
+	glDeleteSync(fence);
+
+	add_sample(frame_cost, (glfwGetTime() - frame_start) * 1000.0);
+}
+
+void FramePacer::presented(double input_time)
+{
+	// With vsync on the swap returns once the frame is on its way to the screen
+	last_present = glfwGetTime();
+	if (input_time > 0.0)
+	{
+		add_sample(latency, (last_present - input_time) * 1000.0);
+		latency_total++;
+	}
+}
+
+std::string FramePacer::overlay_text()
+{
+	float avg, p99;
+	if (!latency_stats(avg, p99))
+		return std::string();
+	char text[96];
+	snprintf(text, sizeof(text), "input latency %.1f/%.1f ms%s", avg, p99, enabled ? " (low latency)" : "");
+	return text;
+}
+
+void FramePacer::print_summary()
+{
+	float avg, p99;
+	if (!latency_stats(avg, p99))
+		return;
+	printf("Input to present latency over the last %d of %d inputs: avg %.2f ms, p99 %.2f ms%s\n",
+		latency.count, latency_total, avg, p99, enabled ? " (low latency mode)" : "");
+}
@@ -0,0 +1,36 @@
+#ifndef _FRAMEPACER_H_
+#define _FRAMEPACER_H_
+
+#define GLFW_INCLUDE_GLEXT
+#ifdef __APPLE__
+#define GLFW_INCLUDE_GLCOREARB
+#else
+#include <GL/glew.h>
+#endif
+#include <GLFW/glfw3.h>
+#include <string>
+
+// Paces frames for latency instead of throughput and measures input-to-present latency.
+// With vsync the loop would otherwise render right after the previous swap, with input that is
+// almost a refresh old when the frame is shown. In low latency mode the frame starts as late as
+// its measured CPU+GPU cost allows, and the GPU never has more than the current frame queued.
+class FramePacer
+{
+public:
+	static const int WINDOW = 240;	// Samples kept for the statistics
+	static bool enabled;			// Low latency mode, --low-latency or L
+
+	// Reads the monitor refresh rate, main thread only
+	static void initialize();
+
+	// Call these on the thread that renders, in this order
+	static void wait();				// Sleeps until the frame has to start, before input is sampled
+	static void finish_frame();		// After rendering, waits on a fence for the GPU to finish the frame
+	// After the swap. input_time is the glfwGetTime of the oldest input shown in this frame, 0 for none
+	static void presented(double input_time);
+
+	static std::string overlay_text();
+	static void print_summary();
+};
+
+#endif
@@ -0,0 +1,524 @@
+#define _CRT_SECURE_NO_DEPRECATE
+#include "GLState.h"
+#include <stdio.h>
+#include <string.h>
+#include <set>
+
+const GLuint STATE_UNKNOWN = 0xFFFFFFFFu;
+const int STATE_TEXTURE_UNITS = 16;
+
+struct TrackedBuffer {
+	GLenum target, binding;
+	GLuint buffer;
+};
+
+struct TrackedCapability {
+	GLenum capability;
+	int enabled;	// -1 while unknown
+};
+
+TrackedBuffer state_buffers[] = {
+	{ GL_ARRAY_BUFFER, GL_ARRAY_BUFFER_BINDING, STATE_UNKNOWN },
+	{ GL_ELEMENT_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER_BINDING, STATE_UNKNOWN },
+	{ GL_PIXEL_PACK_BUFFER, GL_PIXEL_PACK_BUFFER_BINDING, STATE_UNKNOWN },
+	{ GL_PIXEL_UNPACK_BUFFER, GL_PIXEL_UNPACK_BUFFER_BINDING, STATE_UNKNOWN },
+	{ GL_UNIFORM_BUFFER, GL_UNIFORM_BUFFER_BINDING, STATE_UNKNOWN },
+};
+const int STATE_BUFFER_TARGETS = sizeof(state_buffers) / sizeof(state_buffers[0]);
+
+TrackedCapability state_capabilities[] = {
+	{ GL_DEPTH_TEST, -1 }, { GL_CULL_FACE, -1 }, { GL_BLEND, -1 }, { GL_SCISSOR_TEST, -1 },
+	{ GL_STENCIL_TEST, -1 }, { GL_PROGRAM_POINT_SIZE, -1 },
+};
+const int STATE_CAPABILITIES = sizeof(state_capabilities) / sizeof(state_capabilities[0]);
+
+GLuint state_program = STATE_UNKNOWN;
+GLuint state_vao = STATE_UNKNOWN;
+GLenum state_active_texture = 0;	// 0 while unknown
+GLuint state_textures[STATE_TEXTURE_UNITS];
+GLuint state_draw_framebuffer = STATE_UNKNOWN, state_read_framebuffer = STATE_UNKNOWN;
+GLenum state_depth_func = 0;
+int state_depth_mask = -1;
+int state_color_mask[4] = { -1, -1, -1, -1 };
+GLenum state_blend_source = 0, state_blend_destination = 0;
+GLenum state_cull_face = 0;
+GLint state_viewport[4] = { -1, -1, -1, -1 };
+
+unsigned long long state_issued = 0, state_skipped = 0;
+int state_frame_issued = 0, state_frame_skipped = 0;
+int state_last_issued = 0, state_last_skipped = 0;
+bool state_initialized = false;
+
+static void issued()
+{
+	state_issued++;
+	state_frame_issued++;
+}
+
+static void skipped()
+{
+	state_skipped++;
+	state_frame_skipped++;
+}
+
+static void initialize()
+{
+	if (state_initialized)
+		return;
+	state_initialized = true;
+	for (int i = 0; i < STATE_TEXTURE_UNITS; i++)
+		state_textures[i] = STATE_UNKNOWN;
+}
+
+#ifndef NDEBUG
+// A skipped call is only right if GL really has the cached value
+static void validate(const char* what, GLenum query, GLint expected)
+{
+	static std::set<const char*> reported;
+	GLint actual = 0;
+	glGetIntegerv(query, &actual);
+	if (actual != expected && reported.insert(what).second)
+		fprintf(stderr, "GLState: %s is %d in GL but %d in the cache, a call bypassed GLState\n", what, actual, expected);
+}
+#define VALIDATE(what, query, expected) validate(what, query, (GLint)(expected))
+#else
+#define VALIDATE(what, query, expected) ((void)0)
+#endif
+
+static TrackedBuffer* tracked_buffer(GLenum target)
+{
+	for (int i = 0; i < STATE_BUFFER_TARGETS; i++)
+		if (state_buffers[i].target == target)
+			return &state_buffers[i];
+	return NULL;
+}
+
+static TrackedCapability* tracked_capability(GLenum capability)
+{
+	for (int i = 0; i < STATE_CAPABILITIES; i++)
+		if (state_capabilities[i].capability == capability)
+			return &state_capabilities[i];
+	return NULL;
+}
+
+void GLState::use_program(GLuint program)
+{
+	if (state_program == program)
+	{
+		skipped();
+		VALIDATE("program", GL_CURRENT_PROGRAM, program);
+		return;
+	}
+	issued();
+	state_program = program;
+	glUseProgram(program);
+}
+
+void GLState::bind_vertex_array(GLuint vao)
+{
+	if (state_vao == vao)
+	{
+		skipped();
+		VALIDATE("vertex array", GL_VERTEX_ARRAY_BINDING, vao);
+		return;
+	}
+	issued();
+	state_vao = vao;
+	tracked_buffer(GL_ELEMENT_ARRAY_BUFFER)->buffer = STATE_UNKNOWN;
+	glBindVertexArray(vao);
+}
+
+void GLState::bind_buffer(GLenum target, GLuint buffer)
+{
+	TrackedBuffer* tracked = tracked_buffer(target);
+	if (tracked != NULL && tracked->buffer == buffer)
+	{
+		skipped();
+		VALIDATE("buffer binding", tracked->binding, buffer);
+		return;
+	}
+	issued();
+	if (tracked != NULL)
+		tracked->buffer = buffer;
+	glBindBuffer(target, buffer);
+}
+
+void GLState::bind_buffer_range(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	issued();
+	TrackedBuffer* tracked = tracked_buffer(target);
+	if (tracked != NULL)
+		tracked->buffer = buffer;
+	glBindBufferRange(target, index, buffer, offset, size);
+}
+
+void GLState::bind_buffer_base(GLenum target, GLuint index, GLuint buffer)
+{
+	issued();
+	TrackedBuffer* tracked = tracked_buffer(target);
+	if (tracked != NULL)
+		tracked->buffer = buffer;
+	glBindBufferBase(target, index, buffer);
+}
+
+void GLState::active_texture(GLenum unit)
+{
+	initialize();
+	if (state_active_texture == unit)
+	{
+		skipped();
+		VALIDATE("active texture", GL_ACTIVE_TEXTURE, unit);
+		return;
+	}
+	issued();
+	state_active_texture = unit;
+	glActiveTexture(unit);
+}
+
+void GLState::bind_texture(GLenum target, GLuint texture)
+{
+	initialize();
+	int unit = (int)state_active_texture - GL_TEXTURE0;
+	bool tracked = target == GL_TEXTURE_2D && state_active_texture != 0 && unit >= 0 && unit < STATE_TEXTURE_UNITS;
+	if (tracked && state_textures[unit] == texture)
+	{
+		skipped();
+		VALIDATE("texture binding", GL_TEXTURE_BINDING_2D, texture);
+		return;
+	}
+	issued();
+	if (tracked)
+		state_textures[unit] = texture;
+	else if (target == GL_TEXTURE_2D && state_active_texture == 0)
+	{
+		// Some unit changed, but not knowing which, none of them is known anymore
+		for (int i = 0; i < STATE_TEXTURE_UNITS; i++)
+			state_textures[i] = STATE_UNKNOWN;
+	}
+	glBindTexture(target, texture);
+}
+
+void GLState::bind_framebuffer(GLenum target, GLuint framebuffer)
+{
+	bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+	bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+	if ((!draw || state_draw_framebuffer == framebuffer) && (!read || state_read_framebuffer == framebuffer))
+	{
+		skipped();
+		if (draw)
+			VALIDATE("draw framebuffer", GL_DRAW_FRAMEBUFFER_BINDING, framebuffer);
+		if (read)
+			VALIDATE("read framebuffer", GL_READ_FRAMEBUFFER_BINDING, framebuffer);
+		return;
+	}
+	issued();
+	if (draw)
+		state_draw_framebuffer = framebuffer;
+	if (read)
+		state_read_framebuffer = framebuffer;
+	glBindFramebuffer(target, framebuffer);
+}
+
+static void set_capability(GLenum capability, bool enabled)
+{
+	TrackedCapability* tracked = tracked_capability(capability);
+	if (tracked != NULL && tracked->enabled == (int)enabled)
+	{
+		skipped();
+#ifndef NDEBUG
+		static std::set<GLenum> reported;
+		if ((glIsEnabled(capability) == GL_TRUE) != enabled && reported.insert(capability).second)
+			fprintf(stderr, "GLState: capability 0x%x is %s in GL but %s in the cache, a call bypassed GLState\n",
+				capability, enabled ? "disabled" : "enabled", enabled ? "enabled" : "disabled");
+#endif
+		return;
+	}
+	issued();
+	if (tracked != NULL)
+		tracked->enabled = enabled;
+	if (enabled)
+		glEnable(capability);
+	else
+		glDisable(capability);
+}
+
+void GLState::enable(GLenum capability)
+{
+	set_capability(capability, true);
+}
+
+void GLState::disable(GLenum capability)
+{
+	set_capability(capability, false);
+}
+
+void GLState::depth_func(GLenum func)
+{
+	if (state_depth_func == func)
+	{
+		skipped();
+		VALIDATE("depth func", GL_DEPTH_FUNC, func);
+		return;
+	}
+	issued();
+	state_depth_func = func;
+	glDepthFunc(func);
+}
+
+void GLState::depth_mask(GLboolean mask)
+{
+	if (state_depth_mask == (int)mask)
+	{
+		skipped();
+#ifndef NDEBUG
+		static bool reported = false;
+		GLboolean actual;
+		glGetBooleanv(GL_DEPTH_WRITEMASK, &actual);
+		if (actual != mask && !reported)
+		{
+			reported = true;
+			fprintf(stderr, "GLState: depth mask differs between GL and the cache, a call bypassed GLState\n");
+		}
+#endif
+		return;
+	}
+	issued();
+	state_depth_mask = mask;
+	glDepthMask(mask);
+}
+
+void GLState::color_mask(GLboolean r, GLboolean g, GLboolean b, GLboolean a)
+{
+	if (state_color_mask[0] == (int)r && state_color_mask[1] == (int)g && state_color_mask[2] == (int)b
+		&& state_color_mask[3] == (int)a)
+	{
+		skipped();
+#ifndef NDEBUG
+		static bool reported = false;
+		GLboolean actual[4];
+		glGetBooleanv(GL_COLOR_WRITEMASK, actual);
+		if ((actual[0] != r || actual[1] != g || actual[2] != b || actual[3] != a) && !reported)
+		{
+			reported = true;
+			fprintf(stderr, "GLState: color mask differs between GL and the cache, a call bypassed GLState\n");
+		}
+#endif
+		return;
+	}
+	issued();
+	state_color_mask[0] = r;
+	state_color_mask[1] = g;
+	state_color_mask[2] = b;
+	state_color_mask[3] = a;
+	glColorMask(r, g, b, a);
+}
+
+void GLState::blend_func(GLenum source, GLenum destination)
+{
+	if (state_blend_source == source && state_blend_destination == destination)
+	{
+		skipped();
+		VALIDATE("blend source", GL_BLEND_SRC_RGB, source);
+		VALIDATE("blend destination", GL_BLEND_DST_RGB, destination);
+		return;
+	}
+	issued();
+	state_blend_source = source;
+	state_blend_destination = destination;
+	glBlendFunc(source, destination);
+}
+
+void GLState::cull_face(GLenum mode)
+{
+	if (state_cull_face == mode)
+	{
+		skipped();
+		VALIDATE("cull face", GL_CULL_FACE_MODE, mode);
+		return;
+	}
+	issued();
+	state_cull_face = mode;
+	glCullFace(mode);
+}
+
+void GLState::viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	if (state_viewport[0] == x && state_viewport[1] == y && state_viewport[2] == width && state_viewport[3] == height)
+	{
+		skipped();
+#ifndef NDEBUG
+		static bool reported = false;
+		GLint actual[4];
+		glGetIntegerv(GL_VIEWPORT, actual);
+		if (memcmp(actual, state_viewport, sizeof(actual)) != 0 && !reported)
+		{
+			reported = true;
+			fprintf(stderr, "GLState: viewport differs between GL and the cache, a call bypassed GLState\n");
+		}
+#endif
+		return;
+	}
+	issued();
+	state_viewport[0] = x;
+	state_viewport[1] = y;
+	state_viewport[2] = width;
+	state_viewport[3] = height;
+	glViewport(x, y, width, height);
+}
+
+GLuint GLState::get_program()
+{
+	if (state_program == STATE_UNKNOWN)
+	{
+		GLint program = 0;
+		glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+		state_program = (GLuint)program;
+	}
+	return state_program;
+}
+
+GLuint GLState::get_framebuffer(GLenum target)
+{
+	GLuint& cached = target == GL_READ_FRAMEBUFFER ? state_read_framebuffer : state_draw_framebuffer;
+	if (cached == STATE_UNKNOWN)
+	{
+		GLint framebuffer = 0;
+		glGetIntegerv(target == GL_READ_FRAMEBUFFER ? GL_READ_FRAMEBUFFER_BINDING : GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+		cached = (GLuint)framebuffer;
+	}
+	return cached;
+}
+
+GLenum GLState::get_depth_func()
+{
+	if (state_depth_func == 0)
+	{
+		GLint func = GL_LESS;
+		glGetIntegerv(GL_DEPTH_FUNC, &func);
+		state_depth_func = (GLenum)func;
+	}
+	return state_depth_func;
+}
+
+GLboolean GLState::get_depth_mask()
+{
+	if (state_depth_mask < 0)
+	{
+		GLboolean mask = GL_TRUE;
+		glGetBooleanv(GL_DEPTH_WRITEMASK, &mask);
+		state_depth_mask = mask;
+	}
+	return (GLboolean)state_depth_mask;
+}
+
+void GLState::get_color_mask(GLboolean mask[4])
+{
+	if (state_color_mask[0] < 0 || state_color_mask[1] < 0 || state_color_mask[2] < 0 || state_color_mask[3] < 0)
+	{
+		GLboolean actual[4] = { GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE };
+		glGetBooleanv(GL_COLOR_WRITEMASK, actual);
+		for (int i = 0; i < 4; i++)
+			state_color_mask[i] = actual[i];
+	}
+	for (int i = 0; i < 4; i++)
+		mask[i] = (GLboolean)state_color_mask[i];
+}
+
+void GLState::get_viewport(GLint viewport[4])
+{
+	if (state_viewport[2] < 0)
+		glGetIntegerv(GL_VIEWPORT, state_viewport);
+	memcpy(viewport, state_viewport, sizeof(state_viewport));
+}
+
+void GLState::delete_vertex_arrays(GLsizei count, const GLuint* vaos)
+{
+	for (GLsizei i = 0; i < count; i++)
+		if (vaos[i] != 0 && vaos[i] == state_vao)
+		{
+			state_vao = 0;
+			tracked_buffer(GL_ELEMENT_ARRAY_BUFFER)->buffer = STATE_UNKNOWN;
+		}
+	glDeleteVertexArrays(count, vaos);
+}
+
+void GLState::delete_buffers(GLsizei count, const GLuint* buffers)
+{
+	for (GLsizei i = 0; i < count; i++)
+		for (int t = 0; t < STATE_BUFFER_TARGETS; t++)
+			if (buffers[i] != 0 && state_buffers[t].buffer == buffers[i])
+				state_buffers[t].buffer = 0;
+	glDeleteBuffers(count, buffers);
+}
+
+void GLState::delete_textures(GLsizei count, const GLuint* textures)
+{
+	initialize();
+	for (GLsizei i = 0; i < count; i++)
+		for (int unit = 0; unit < STATE_TEXTURE_UNITS; unit++)
+			if (textures[i] != 0 && state_textures[unit] == textures[i])
+				state_textures[unit] = 0;
+	glDeleteTextures(count, textures);
+}
+
+void GLState::delete_framebuffers(GLsizei count, const GLuint* framebuffers)
+{
+	for (GLsizei i = 0; i < count; i++)
+	{
+		if (framebuffers[i] == 0)
+			continue;
+		if (state_draw_framebuffer == framebuffers[i])
+			state_draw_framebuffer = 0;
+		if (state_read_framebuffer == framebuffers[i])
+			state_read_framebuffer = 0;
+	}
+	glDeleteFramebuffers(count, framebuffers);
+}
+
+void GLState::invalidate()
+{
+	state_initialized = false;
+	initialize();
+	state_program = STATE_UNKNOWN;
+	state_vao = STATE_UNKNOWN;
+	for (int i = 0; i < STATE_BUFFER_TARGETS; i++)
+		state_buffers[i].buffer = STATE_UNKNOWN;
+	for (int i = 0; i < STATE_CAPABILITIES; i++)
+		state_capabilities[i].enabled = -1;
+	state_active_texture = 0;
+	state_draw_framebuffer = state_read_framebuffer = STATE_UNKNOWN;
+	state_depth_func = 0;
+	state_depth_mask = -1;
+	for (int i = 0; i < 4; i++)
+	{
+		state_color_mask[i] = -1;
+		state_viewport[i] = -1;
+	}
+	state_blend_source = state_blend_destination = 0;
+	state_cull_face = 0;
+}
+
+void GLState::begin_frame()
+{
+	state_last_issued = state_frame_issued;
+	state_last_skipped = state_frame_skipped;
+	state_frame_issued = state_frame_skipped = 0;
+}
+
+std::string GLState::overlay_text()
+{
+	if (state_issued == 0)
+		return "";
+	char text[64];
+	snprintf(text, sizeof(text), "state calls %d, %d skipped", state_last_issued, state_last_skipped);
+	return text;
+}
+
+void GLState::print_summary()
+{
+	unsigned long long total = state_issued + state_skipped;
+	if (total == 0)
+		return;
+	printf("GL state: %llu calls issued, %llu redundant ones skipped (%.0f%%)\n", state_issued, state_skipped,
+		100.0 * state_skipped / total);
+}
@@ -0,0 +1,67 @@
+#ifndef _GLSTATE_H_
+#define _GLSTATE_H_
+
+#define GLFW_INCLUDE_GLEXT
+#ifdef __APPLE__
+#define GLFW_INCLUDE_GLCOREARB
+#else
+#include <GL/glew.h>
+#endif
+#include <GLFW/glfw3.h>
+#include <string>
+
+// Shadow copy of the GL state the renderer changes, so setting a value that is already current costs
+// no driver call. Every bind, enable and delete of these objects on the render context has to go
+// through here, or the copy goes stale; invalidate forgets it after anything else touched the state.
+// Values start out unknown, and the first set always reaches GL. Builds without NDEBUG check every
+// skipped call against glGet and report a stale value once per kind.
+// Only the main context is tracked, the shader compiler's shared context does its own binds.
+class GLState
+{
+public:
+	static void use_program(GLuint program);
+	static void bind_vertex_array(GLuint vao);
+	// GL_ELEMENT_ARRAY_BUFFER belongs to the bound VAO, it is unknown again after a VAO change
+	static void bind_buffer(GLenum target, GLuint buffer);
+	// Indexed bindings are not tracked, but this also sets the target's general binding
+	static void bind_buffer_range(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+	static void bind_buffer_base(GLenum target, GLuint index, GLuint buffer);
+	static void active_texture(GLenum unit);
+	// Only GL_TEXTURE_2D is tracked, on units GL_TEXTURE0 to GL_TEXTURE0 + 15
+	static void bind_texture(GLenum target, GLuint texture);
+	// GL_FRAMEBUFFER sets both the draw and the read binding
+	static void bind_framebuffer(GLenum target, GLuint framebuffer);
+	static void enable(GLenum capability);
+	static void disable(GLenum capability);
+	static void depth_func(GLenum func);
+	static void depth_mask(GLboolean mask);
+	static void color_mask(GLboolean r, GLboolean g, GLboolean b, GLboolean a);
+	static void blend_func(GLenum source, GLenum destination);
+	static void cull_face(GLenum mode);
+	static void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+	// Current values for saving and restoring, read from GL only while unknown
+	static GLuint get_program();
+	static GLuint get_framebuffer(GLenum target);
+	static GLenum get_depth_func();
+	static GLboolean get_depth_mask();
+	static void get_color_mask(GLboolean mask[4]);
+	static void get_viewport(GLint viewport[4]);
+
+	// Deleting unbinds the objects in GL, and their names can come back for new ones. Programs are
+	// left out, GL keeps the current one alive until another is used.
+	static void delete_vertex_arrays(GLsizei count, const GLuint* vaos);
+	static void delete_buffers(GLsizei count, const GLuint* buffers);
+	static void delete_textures(GLsizei count, const GLuint* textures);
+	static void delete_framebuffers(GLsizei count, const GLuint* framebuffers);
+
+	// For a new context, or after code that changed the state behind the cache's back
+	static void invalidate();
+
+	// Call counts are per frame in the overlay and totals at exit
+	static void begin_frame();
+	static std::string overlay_text();
+	static void print_summary();
+};
+
+#endif
@@ -0,0 +1,240 @@
+#define _CRT_SECURE_NO_DEPRECATE
+#include "GpuProfiler.h"
+#include "QueryRing.h"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+struct GpuQuery {
+	const char* name;
+	int depth;
+	GLuint begin;
+	GLuint end;
+};
+
+struct GpuFrame {
+	int number;
+	bool pending;
+	QueryPool pool;
+	std::vector<GpuQuery> queries;
+};
+
+struct ScopeStats {
+	float samples[GpuProfiler::WINDOW];
+	int count;
+	int next;
+	float last;
+	int last_frame;
+};
+
+bool GpuProfiler::enabled = false;
+
+QueryRing<GpuFrame, GpuProfiler::FRAME_LATENCY> gpu_ring;
+int gpu_frame_number = 0;
+int gpu_dropped = 0;
+std::vector<int> gpu_stack;
+std::map<std::string, ScopeStats> gpu_stats;
+// Keeps the order scopes were first seen in, for stable output
+std::vector<std::string> gpu_scope_order;
+FILE* gpu_csv = NULL;
+
+static void record(const GpuQuery& query, int frame_number, double ms)
+{
+	std::map<std::string, ScopeStats>::iterator it = gpu_stats.find(query.name);
+	if (it == gpu_stats.end())
+	{
+		ScopeStats empty;
+		empty.count = 0;
+		empty.next = 0;
+		empty.last = 0.0f;
+		empty.last_frame = -1;
+		it = gpu_stats.insert(std::make_pair(std::string(query.name), empty)).first;
+		gpu_scope_order.push_back(query.name);
+	}
+
+	ScopeStats& stats = it->second;
+	stats.samples[stats.next] = (float)ms;
+	stats.next = (stats.next + 1) % GpuProfiler::WINDOW;
+	stats.count = std::min(stats.count + 1, (int)GpuProfiler::WINDOW);
+	stats.last = (float)ms;
+	stats.last_frame = frame_number;
+
+	if (gpu_csv)
+		fprintf(gpu_csv, "%d,%s,%d,%.4f\n", frame_number, query.name, query.depth, ms);
+}
+
+// Done once every scope has its end timestamp
+static bool frame_ready(const GpuFrame& frame)
+{
+	for (size_t q = 0; q < frame.queries.size(); q++)
+		if (!query_ready(frame.queries[q].end))
+			return false;
+	return true;
+}
+
+static void read_frame(const GpuFrame& frame)
+{
+	// A scope entered several times in a frame, like a model drawn in every row of the crowd,
+	// is one sample of the time of all of them
+	std::vector<std::pair<const GpuQuery*, double> > totals;
+	for (size_t q = 0; q < frame.queries.size(); q++)
+	{
+		GLuint64 begin = 0, end = 0;
+		glGetQueryObjectui64v(frame.queries[q].begin, GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(frame.queries[q].end, GL_QUERY_RESULT, &end);
+		size_t t = 0;
+		while (t < totals.size() && strcmp(totals[t].first->name, frame.queries[q].name) != 0)
+			t++;
+		if (t == totals.size())
+			totals.push_back(std::make_pair(&frame.queries[q], 0.0));
+		totals[t].second += (end - begin) / 1000000.0;
+	}
+	for (size_t t = 0; t < totals.size(); t++)
+		record(*totals[t].first, frame.number, totals[t].second);
+}
+
+void GpuProfiler::begin_frame()
+{
+	if (!enabled)
+		return;
+
+	bool dropped = false;
+	GpuFrame& frame = gpu_ring.advance(frame_ready, read_frame, &dropped);
+	if (dropped)
+		gpu_dropped++;
+	frame.pool.used = 0;
+	frame.queries.clear();
+	frame.number = gpu_frame_number++;
+	gpu_stack.clear();
+
+	push("frame");
+}
+
+void GpuProfiler::end_frame()
+{
+	if (!enabled)
+		return;
+
+	while (!gpu_stack.empty())
+		pop();
+}
+
+void GpuProfiler::push(const char* name)
+{
+	if (!enabled)
+		return;
+
+	GpuFrame& frame = gpu_ring.now();
+	GpuQuery query;
+	query.name = name;
+	query.depth = (int)gpu_stack.size();
+	query.begin = frame.pool.next();
+	query.end = frame.pool.next();
+	glQueryCounter(query.begin, GL_TIMESTAMP);
+
+	gpu_stack.push_back((int)frame.queries.size());
+	frame.queries.push_back(query);
+}
+
+void GpuProfiler::pop()
+{
+	if (!enabled || gpu_stack.empty())
+		return;
+
+	GpuFrame& frame = gpu_ring.now();
+	glQueryCounter(frame.queries[gpu_stack.back()].end, GL_TIMESTAMP);
+	gpu_stack.pop_back();
+}
+
+bool GpuProfiler::open_csv(const char* path)
+{
+	close_csv();
+	gpu_csv = fopen(path, "w");
+	if (gpu_csv == NULL)
+	{
+		fprintf(stderr, "Could not open %s for GPU timings\n", path);
+		return false;
+	}
+	fprintf(gpu_csv, "frame,scope,depth,gpu_ms\n");
+	return true;
+}
+
+void GpuProfiler::close_csv()
+{
+	if (gpu_csv)
+	{
+		fclose(gpu_csv);
+		gpu_csv = NULL;
+	}
+}
+
+bool GpuProfiler::stats(const char* name, float& min, float& avg, float& p99)
+{
+	std::map<std::string, ScopeStats>::iterator it = gpu_stats.find(name);
+	if (it == gpu_stats.end() || it->second.count == 0)
+		return false;
+
+	ScopeStats& stats = it->second;
+	std::vector<float> sorted(stats.samples, stats.samples + stats.count);
+	std::sort(sorted.begin(), sorted.end());
+
+	float sum = 0.0f;
+	for (size_t i = 0; i < sorted.size(); i++)
+		sum += sorted[i];
+	min = sorted.front();
+	avg = sum / sorted.size();
+	p99 = sorted[std::min(sorted.size() - 1, (size_t)(sorted.size() * 0.99f))];
+	return true;
+}
+
+float GpuProfiler::last(const char* name, int* frame)
+{
+	std::map<std::string, ScopeStats>::iterator it = gpu_stats.find(name);
+	if (frame)
+		*frame = it == gpu_stats.end() ? -1 : it->second.last_frame;
+	return it == gpu_stats.end() ? 0.0f : it->second.last;
+}
+
+std::string GpuProfiler::overlay_text()
+{
+	std::string text;
+	for (size_t i = 0; i < gpu_scope_order.size(); i++)
+	{
+		float min, avg, p99;
+		if (!stats(gpu_scope_order[i].c_str(), min, avg, p99))
+			continue;
+		char line[160];
+		snprintf(line, sizeof(line), "%s%s %.2f/%.2f/%.2f ms", text.empty() ? "" : " | ", gpu_scope_order[i].c_str(), min, avg, p99);
+		text += line;
+	}
+	return text;
+}
+
+void GpuProfiler::print_summary()
+{
+	if (gpu_scope_order.empty())
+		return;
+
+	printf("%-28s %10s %10s %10s\n", "GPU scope", "min ms", "avg ms", "p99 ms");
+	for (size_t i = 0; i < gpu_scope_order.size(); i++)
+	{
+		float min, avg, p99;
+		if (stats(gpu_scope_order[i].c_str(), min, avg, p99))
+			printf("%-28s %10.3f %10.3f %10.3f\n", gpu_scope_order[i].c_str(), min, avg, p99);
+	}
+	if (gpu_dropped > 0)
+		printf("%d frames of GPU timings were dropped because the GPU fell behind\n", gpu_dropped);
+}
+
+void GpuProfiler::clean_up()
+{
+	for (int i = 0; i < FRAME_LATENCY; i++)
+	{
+		gpu_ring.frames[i].pool.clean_up();
+		gpu_ring.frames[i].queries.clear();
+		gpu_ring.frames[i].pending = false;
+	}
+	close_csv();
+}
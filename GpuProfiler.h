@@ -0,0 +1,57 @@
+#ifndef _GPUPROFILER_H_
+#define _GPUPROFILER_H_
+
+#define GLFW_INCLUDE_GLEXT
+#ifdef __APPLE__
+#define GLFW_INCLUDE_GLCOREARB
+#else
+#include <GL/glew.h>
+#endif
+#include <GLFW/glfw3.h>
+#include <string>
+
+// GPU timing of named scopes with GL_TIMESTAMP queries.
+// Timestamps are used instead of GL_TIME_ELAPSED because elapsed-time queries cannot be nested.
+// Results are read FRAME_LATENCY frames later, once the GPU has caught up, so reading them never stalls.
+// Every scope keeps a rolling window of samples for min/avg/p99, and each frame can be appended to a CSV file.
+class GpuProfiler
+{
+public:
+	static const int FRAME_LATENCY = 4;
+	static const int WINDOW = 240;
+
+	static bool enabled;
+
+	static void begin_frame();
+	static void end_frame();
+	// Scope names must outlive the profiler, string literals are the intended use
+	static void push(const char* name);
+	static void pop();
+
+	static bool open_csv(const char* path);
+	static void close_csv();
+
+	// One line per scope, for the window title overlay and the summary at exit
+	static std::string overlay_text();
+	static void print_summary();
+	// Rolling statistics of a scope in milliseconds, false if it has no samples yet
+	static bool stats(const char* name, float& min, float& avg, float& p99);
+	// Most recent sample of a scope in milliseconds, 0 if it has none.
+	// frame receives the number of the frame it was measured in, -1 if none.
+	static float last(const char* name, int* frame = NULL);
+	static void clean_up();
+};
+
+// Times the GPU work issued in the enclosing C++ scope
+class GpuScope
+{
+public:
+	GpuScope(const char* name) { GpuProfiler::push(name); }
+	~GpuScope() { GpuProfiler::pop(); }
+};
+
+#define GPU_SCOPE_CONCAT2(a, b) a##b
+#define GPU_SCOPE_CONCAT(a, b) GPU_SCOPE_CONCAT2(a, b)
+#define GPU_SCOPE(name) GpuScope GPU_SCOPE_CONCAT(gpu_scope_, __LINE__)(name)
+
+#endif
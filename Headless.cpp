@@ -0,0 +1,275 @@
+#define _CRT_SECURE_NO_DEPRECATE
+#include "Headless.h"
+#include "GLState.h"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#ifdef HEADLESS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+#ifdef HEADLESS_OSMESA
+#include <GL/osmesa.h>
+#endif
+
+int Headless::width;
+int Headless::height;
+const char* Headless::backend = "none";
+
+GLuint Headless::FBO = 0;
+GLuint Headless::colorRBO = 0;
+GLuint Headless::depthRBO = 0;
+
+#ifdef HEADLESS_EGL
+EGLDisplay egl_display = EGL_NO_DISPLAY;
+EGLContext egl_context = EGL_NO_CONTEXT;
+EGLSurface egl_surface = EGL_NO_SURFACE;
+#endif
+#ifdef HEADLESS_OSMESA
+OSMesaContext osmesa_context = NULL;
+// OSMesa always needs a client-side color buffer, even though we render into our own FBO
+std::vector<unsigned char> osmesa_buffer;
+#endif
+
+bool Headless::create_context(int width, int height)
+{
+	if (create_egl_context(width, height))
+		backend = "EGL";
+	else if (create_osmesa_context(width, height))
+		backend = "OSMesa";
+	else
+	{
+		fprintf(stderr, "Failed to create a headless OpenGL context.\n");
+		fprintf(stderr, "Build with HEADLESS_EGL and/or HEADLESS_OSMESA and make sure the libraries are installed.\n");
+		return false;
+	}
+	fprintf(stdout, "Headless backend: %s\n", backend);
+	return true;
+}
+
+bool Headless::create_egl_context(int width, int height)
+{
+#ifdef HEADLESS_EGL
+	// Prefer the surfaceless platform, it needs neither a display server nor a GPU device node
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	const char* client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	if (getPlatformDisplay && client_extensions && strstr(client_extensions, "EGL_MESA_platform_surfaceless"))
+		egl_display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	if (egl_display == EGL_NO_DISPLAY)
+		egl_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	EGLint major, minor;
+	if (egl_display == EGL_NO_DISPLAY || !eglInitialize(egl_display, &major, &minor))
+	{
+		fprintf(stderr, "EGL: no display available\n");
+		egl_display = EGL_NO_DISPLAY;
+		return false;
+	}
+
+	const EGLint config_attribs[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8,
+		EGL_DEPTH_SIZE, 24,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint num_configs = 0;
+	if (!eglBindAPI(EGL_OPENGL_API) ||
+		!eglChooseConfig(egl_display, config_attribs, &config, 1, &num_configs) || num_configs == 0)
+	{
+		fprintf(stderr, "EGL: no OpenGL capable config\n");
+		eglTerminate(egl_display);
+		egl_display = EGL_NO_DISPLAY;
+		return false;
+	}
+
+	// Same context version as the windowed path on OSX
+	const EGLint context_attribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	egl_context = eglCreateContext(egl_display, config, EGL_NO_CONTEXT, context_attribs);
+	if (egl_context == EGL_NO_CONTEXT)
+	{
+		fprintf(stderr, "EGL: could not create an OpenGL 3.3 context\n");
+		eglTerminate(egl_display);
+		egl_display = EGL_NO_DISPLAY;
+		return false;
+	}
+
+	// Everything is drawn into our FBO, so only fall back to a pbuffer if surfaceless contexts are unsupported
+	const char* extensions = eglQueryString(egl_display, EGL_EXTENSIONS);
+	if (!extensions || !strstr(extensions, "EGL_KHR_surfaceless_context"))
+	{
+		const EGLint pbuffer_attribs[] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+		egl_surface = eglCreatePbufferSurface(egl_display, config, pbuffer_attribs);
+	}
+
+	if (!eglMakeCurrent(egl_display, egl_surface, egl_surface, egl_context))
+	{
+		fprintf(stderr, "EGL: could not make the context current\n");
+		destroy_context();
+		return false;
+	}
+
+	if (!create_framebuffer(width, height))
+	{
+		destroy_context();
+		return false;
+	}
+	return true;
+#else
+	(void)width;
+	(void)height;
+	return false;
+#endif
+}
+
+bool Headless::create_osmesa_context(int width, int height)
+{
+#ifdef HEADLESS_OSMESA
+	const int attribs[] = {
+		OSMESA_FORMAT, OSMESA_RGBA,
+		OSMESA_DEPTH_BITS, 24,
+		OSMESA_PROFILE, OSMESA_CORE_PROFILE,
+		OSMESA_CONTEXT_MAJOR_VERSION, 3,
+		OSMESA_CONTEXT_MINOR_VERSION, 3,
+		0
+	};
+	osmesa_context = OSMesaCreateContextAttribs(attribs, NULL);
+	if (!osmesa_context)
+	{
+		fprintf(stderr, "OSMesa: could not create an OpenGL 3.3 context\n");
+		return false;
+	}
+
+	osmesa_buffer.resize(width * height * 4);
+	if (!OSMesaMakeCurrent(osmesa_context, osmesa_buffer.data(), GL_UNSIGNED_BYTE, width, height))
+	{
+		fprintf(stderr, "OSMesa: could not make the context current\n");
+		destroy_context();
+		return false;
+	}
+
+	if (!create_framebuffer(width, height))
+	{
+		destroy_context();
+		return false;
+	}
+	return true;
+#else
+	(void)width;
+	(void)height;
+	return false;
+#endif
+}
+
+bool Headless::create_framebuffer(int width, int height)
+{
+	// Function pointers are only available once the context is current
+#ifndef __APPLE__
+	glewExperimental = true;
+	if (glewInit() != GLEW_OK && glewContextInit() != GLEW_OK)
+	{
+		// glewInit insists on a GLX display when GLEW was built for GLX, glewContextInit does not
+		fprintf(stderr, "Headless: GLEW could not load OpenGL entry points\n");
+		return false;
+	}
+#endif
+
+	Headless::width = width;
+	Headless::height = height;
+
+	glGenFramebuffers(1, &FBO);
+	glGenRenderbuffers(1, &colorRBO);
+	glGenRenderbuffers(1, &depthRBO);
+
+	glBindRenderbuffer(GL_RENDERBUFFER, colorRBO);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthRBO);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	GLState::bind_framebuffer(GL_FRAMEBUFFER, FBO);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRBO);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRBO);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		fprintf(stderr, "Headless: %dx%d framebuffer is incomplete\n", width, height);
+		return false;
+	}
+
+	GLState::viewport(0, 0, width, height);
+	return true;
+}
+
+void Headless::bind_framebuffer()
+{
+	GLState::bind_framebuffer(GL_FRAMEBUFFER, FBO);
+}
+
+bool Headless::save_ppm(const char* path)
+{
+	std::vector<unsigned char> pixels(width * height * 3);
+	GLState::bind_framebuffer(GL_READ_FRAMEBUFFER, FBO);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+	return write_ppm(path, pixels.data(), width, height);
+}
+
+bool Headless::write_ppm(const char* path, const unsigned char* pixels, int width, int height)
+{
+	FILE* fp = fopen(path, "wb");
+	if (fp == NULL)
+	{
+		fprintf(stderr, "Could not write %s\n", path);
+		return false;
+	}
+	fprintf(fp, "P6\n%d %d\n255\n", width, height);
+	// OpenGL rows start at the bottom, PPM rows at the top
+	for (int y = height - 1; y >= 0; y--)
+		fwrite(&pixels[y * width * 3], 1, width * 3, fp);
+	fclose(fp);
+	return true;
+}
+
+void Headless::destroy_context()
+{
+	if (FBO)
+	{
+		GLState::delete_framebuffers(1, &FBO);
+		glDeleteRenderbuffers(1, &colorRBO);
+		glDeleteRenderbuffers(1, &depthRBO);
+		FBO = colorRBO = depthRBO = 0;
+	}
+
+#ifdef HEADLESS_EGL
+	if (egl_display != EGL_NO_DISPLAY)
+	{
+		eglMakeCurrent(egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if (egl_surface != EGL_NO_SURFACE)
+			eglDestroySurface(egl_display, egl_surface);
+		if (egl_context != EGL_NO_CONTEXT)
+			eglDestroyContext(egl_display, egl_context);
+		eglTerminate(egl_display);
+		egl_display = EGL_NO_DISPLAY;
+		egl_context = EGL_NO_CONTEXT;
+		egl_surface = EGL_NO_SURFACE;
+	}
+#endif
+#ifdef HEADLESS_OSMESA
+	if (osmesa_context)
+	{
+		OSMesaDestroyContext(osmesa_context);
+		osmesa_context = NULL;
+	}
+#endif
+}
@@ -0,0 +1,39 @@
+#ifndef _HEADLESS_H_
+#define _HEADLESS_H_
+
+#define GLFW_INCLUDE_GLEXT
+#ifdef __APPLE__
+#define GLFW_INCLUDE_GLCOREARB
+#else
+#include <GL/glew.h>
+#endif
+#include <GLFW/glfw3.h>
+
+// Offscreen rendering without a window or display server.
+// Build with HEADLESS_EGL (EGL surfaceless/pbuffer) and/or HEADLESS_OSMESA (software llvmpipe fallback).
+class Headless
+{
+public:
+	static int width;
+	static int height;
+	static const char* backend;
+
+	// Framebuffer everything is drawn into instead of the default framebuffer
+	static GLuint FBO, colorRBO, depthRBO;
+
+	// Creates an offscreen GL 3.3 core context, makes it current and sets up the FBO
+	static bool create_context(int width, int height);
+	static void destroy_context();
+	static void bind_framebuffer();
+	// Writes the current contents of the FBO as a binary PPM
+	static bool save_ppm(const char* path);
+	// RGB rows bottom to top as glReadPixels returns them, safe to call from any thread
+	static bool write_ppm(const char* path, const unsigned char* pixels, int width, int height);
+
+private:
+	static bool create_egl_context(int width, int height);
+	static bool create_osmesa_context(int width, int height);
+	static bool create_framebuffer(int width, int height);
+};
+
+#endif
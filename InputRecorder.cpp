@@ -0,0 +1,154 @@
+#define _CRT_SECURE_NO_DEPRECATE
+#include "InputRecorder.h"
+#include "Window.h"
+#include <stdio.h>
+#include <string.h>
+
+int InputRecorder::frame = 0;
+
+FILE* recording_file = NULL;
+
+bool InputRecorder::start_recording(const char* path, int width, int height)
+{
+	recording_file = fopen(path, "w");
+	if (recording_file == NULL)
+	{
+		fprintf(stderr, "Could not open %s for recording\n", path);
+		return false;
+	}
+	// Trackball math depends on the window size, so remember it
+	fprintf(recording_file, "# input recording\n");
+	fprintf(recording_file, "size %d %d\n", width, height);
+	frame = 0;
+	printf("Recording input to %s\n", path);
+	return true;
+}
+
+void InputRecorder::stop_recording()
+{
+	if (recording_file)
+	{
+		fclose(recording_file);
+		recording_file = NULL;
+	}
+}
+
+bool InputRecorder::recording()
+{
+	return recording_file != NULL;
+}
+
+void InputRecorder::key(int key, int scancode, int action, int mods)
+{
+	if (recording_file)
+		fprintf(recording_file, "%d %.6f K %d %d %d %d\n", frame, glfwGetTime(), key, scancode, action, mods);
+}
+
+void InputRecorder::mouse(int button, int action, int mods)
+{
+	if (recording_file)
+		fprintf(recording_file, "%d %.6f M %d %d %d\n", frame, glfwGetTime(), button, action, mods);
+}
+
+void InputRecorder::scroll(double xoffset, double yoffset)
+{
+	if (recording_file)
+		fprintf(recording_file, "%d %.6f S %.17g %.17g\n", frame, glfwGetTime(), xoffset, yoffset);
+}
+
+void InputRecorder::cursor(double xpos, double ypos)
+{
+	if (recording_file)
+		fprintf(recording_file, "%d %.6f C %.17g %.17g\n", frame, glfwGetTime(), xpos, ypos);
+}
+
+void InputRecorder::next_frame()
+{
+	frame++;
+}
+
+bool InputRecorder::load(const char* path, std::vector<InputEvent>& events, int& width, int& height)
+{
+	FILE* fp = fopen(path, "r");
+	if (fp == NULL)
+	{
+		fprintf(stderr, "Could not open recording %s\n", path);
+		return false;
+	}
+
+	char line[256];
+	while (fgets(line, sizeof(line), fp))
+	{
+		InputEvent event = InputEvent();
+		if (line[0] == '#')
+			continue;
+		if (sscanf(line, "size %d %d", &width, &height) == 2)
+			continue;
+		if (sscanf(line, "%d %lf %c", &event.frame, &event.time, &event.type) != 3)
+			continue;
+
+		const char* args = strchr(line, event.type) + 1;
+		bool valid = false;
+		if (event.type == 'K')
+			valid = sscanf(args, "%d %d %d %d", &event.key, &event.scancode, &event.action, &event.mods) == 4;
+		else if (event.type == 'M')
+			valid = sscanf(args, "%d %d %d", &event.key, &event.action, &event.mods) == 3;
+		else if (event.type == 'S' || event.type == 'C')
+			valid = sscanf(args, "%lf %lf", &event.x, &event.y) == 2;
+		if (valid)
+			events.push_back(event);
+	}
+	fclose(fp);
+	return true;
+}
+
+std::vector<InputEvent> InputRecorder::orbit_script(int model, int frames)
+{
+	std::vector<InputEvent> events;
+	InputEvent event = InputEvent();
+	event.type = 'K';
+	event.action = GLFW_PRESS;
+
+	// Show the model and put the point light under control
+	event.key = GLFW_KEY_F1 + model - 1;
+	events.push_back(event);
+	event.key = GLFW_KEY_2;
+	events.push_back(event);
+
+	for (int i = 0; i < frames; i++)
+	{
+		event = InputEvent();
+		event.frame = i;
+		event.type = 'K';
+		event.key = GLFW_KEY_O;
+		event.action = GLFW_PRESS;
+		events.push_back(event);
+
+		// Point light travels 30 units away and back every 60 frames
+		event = InputEvent();
+		event.frame = i;
+		event.type = 'S';
+		event.y = (i / 30) % 2 == 0 ? -1.0 : 1.0;
+		events.push_back(event);
+	}
+	return events;
+}
+
+void InputRecorder::dispatch(GLFWwindow* window, const InputEvent& event)
+{
+	switch (event.type)
+	{
+	case 'K':
+		Window::key_callback(window, event.key, event.scancode, event.action, event.mods);
+		break;
+	case 'M':
+		Window::mouse_callback(window, event.key, event.action, event.mods);
+		break;
+	case 'S':
+		Window::scroll_callback(window, event.x, event.y);
+		break;
+	case 'C':
+		Window::cursor_callback(window, event.x, event.y);
+		break;
+	}
+}
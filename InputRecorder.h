@@ -0,0 +1,48 @@
+#ifndef _INPUTRECORDER_H_
+#define _INPUTRECORDER_H_
+
+#define GLFW_INCLUDE_GLEXT
+#ifdef __APPLE__
+#define GLFW_INCLUDE_GLCOREARB
+#else
+#include <GL/glew.h>
+#endif
+#include <GLFW/glfw3.h>
+#include <vector>
+
+// One input callback invocation. Events are replayed by frame number, the timestamp is informational.
+struct InputEvent
+{
+	int frame;
+	double time;
+	char type;		// K = key, M = mouse button, S = scroll, C = cursor
+	int key, scancode, action, mods;
+	double x, y;
+};
+
+// Records the Window input callbacks to a text file and plays them back.
+class InputRecorder
+{
+public:
+	// Frame the next recorded events belong to
+	static int frame;
+
+	static bool start_recording(const char* path, int width, int height);
+	static void stop_recording();
+	static bool recording();
+
+	// Called at the top of the matching Window callbacks
+	static void key(int key, int scancode, int action, int mods);
+	static void mouse(int button, int action, int mods);
+	static void scroll(double xoffset, double yoffset);
+	static void cursor(double xpos, double ypos);
+	static void next_frame();
+
+	static bool load(const char* path, std::vector<InputEvent>& events, int& width, int& height);
+	// Scripted turntable: shows the model, orbits it every frame and moves the point light back and forth
+	static std::vector<InputEvent> orbit_script(int model, int frames);
+	// Calls the Window callback the event was recorded from
+	static void dispatch(GLFWwindow* window, const InputEvent& event);
+};
+
+#endif
@@ -0,0 +1,373 @@
+#define _CRT_SECURE_NO_DEPRECATE
+#include "JobSystem.h"
+#include "Tracer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+struct Job {
+	std::function<void()> work;
+	std::atomic<int> pending;		// Unfinished dependencies, plus one until submitted
+	std::atomic<int> references;	// The caller's handle, plus the scheduler's until it has run
+	std::atomic<bool> finished;
+	std::mutex mutex;
+	std::vector<Job*> dependents;	// Released when this one finishes, guarded by mutex
+};
+
+struct JobQueue {
+	std::mutex mutex;
+	std::deque<Job*> jobs;
+};
+
+// Ranges of one parallel_for still to run, on the stack of the calling thread
+struct JobRange {
+	const std::function<void(size_t, size_t)>* body;
+	size_t grain;
+	std::atomic<size_t> remaining;
+};
+
+int JobSystem::thread_count = 0;
+bool JobSystem::pin_threads = false;
+
+// Queue i belongs to worker i, the last one is shared by the threads that are not workers
+std::vector<std::thread> job_workers;
+std::unique_ptr<JobQueue[]> job_queues;
+int job_queue_count = 0;
+std::atomic<bool> job_running(false);
+std::mutex job_start_mutex;
+
+// Idle workers sleep until a job is queued, waiting threads also until what they wait for is done
+std::mutex job_mutex;
+std::condition_variable job_wake;
+bool job_quit = false;
+std::atomic<int> job_queued(0);
+std::atomic<int> job_sleepers(0);
+std::atomic<int> job_waiters(0);
+
+std::atomic<unsigned long long> job_run_count(0);
+std::atomic<unsigned long long> job_stolen_count(0);
+
+thread_local int job_worker = -1;
+
+static int own_queue()
+{
+	return job_worker >= 0 ? job_worker : job_queue_count - 1;
+}
+
+static void wake(const std::atomic<int>& sleeping)
+{
+	if (sleeping.load() == 0)
+		return;
+	// Taking the mutex orders this after a sleeper's last look at the condition
+	std::lock_guard<std::mutex> lock(job_mutex);
+	job_wake.notify_all();
+}
+
+static void enqueue(Job* job)
+{
+	JobQueue& q = job_queues[own_queue()];
+	{
+		std::lock_guard<std::mutex> lock(q.mutex);
+		q.jobs.push_back(job);
+	}
+	job_queued++;
+	wake(job_sleepers);
+}
+
+// The newest job of the own queue, else the oldest of another
+static Job* pop(int self, bool& stolen)
+{
+	if (job_queued.load() == 0)
+		return NULL;
+	for (int k = 0; k < job_queue_count; k++)
+	{
+		JobQueue& q = job_queues[(self + k) % job_queue_count];
+		std::lock_guard<std::mutex> lock(q.mutex);
+		if (q.jobs.empty())
+			continue;
+		Job* job;
+		if (k == 0)
+		{
+			job = q.jobs.back();
+			q.jobs.pop_back();
+		}
+		else
+		{
+			job = q.jobs.front();
+			q.jobs.pop_front();
+		}
+		job_queued--;
+		stolen = k > 0;
+		return job;
+	}
+	return NULL;
+}
+
+static void run(Job* job, bool stolen)
+{
+	job->work();
+	job->work = nullptr;
+	job_run_count++;
+	if (stolen)
+		job_stolen_count++;
+
+	std::vector<Job*> dependents;
+	{
+		std::lock_guard<std::mutex> lock(job->mutex);
+		job->finished = true;
+		dependents.swap(job->dependents);
+	}
+	for (size_t i = 0; i < dependents.size(); i++)
+		if (--dependents[i]->pending == 0)
+			enqueue(dependents[i]);
+	wake(job_waiters);
+	JobSystem::release(job);
+}
+
+// Runs jobs, or sleeps when there are none, until done
+static void help_until(const std::function<bool()>& done)
+{
+	int self = own_queue();
+	while (!done())
+	{
+		bool stolen;
+		Job* job = pop(self, stolen);
+		if (job != NULL)
+		{
+			run(job, stolen);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(job_mutex);
+		job_sleepers++;
+		job_waiters++;
+		job_wake.wait(lock, [&] { return done() || job_queued.load() > 0; });
+		job_sleepers--;
+		job_waiters--;
+	}
+}
+
+static void worker(int self)
+{
+	job_worker = self;
+	Tracer::name_thread("job worker");
+	for (;;)
+	{
+		bool stolen;
+		Job* job = pop(self, stolen);
+		if (job != NULL)
+		{
+			run(job, stolen);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(job_mutex);
+		job_sleepers++;
+		job_wake.wait(lock, [] { return job_quit || job_queued.load() > 0; });
+		job_sleepers--;
+		if (job_quit)
+			return;
+	}
+}
+
+static void pin(std::thread& thread, int core)
+{
+#ifdef _WIN32
+	SetThreadAffinityMask((HANDLE)thread.native_handle(), (DWORD_PTR)1 << (core % (8 * sizeof(DWORD_PTR))));
+#elif defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(core, &set);
+	pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#else
+	(void)thread;
+	(void)core;
+#endif
+}
+
+static void stop_workers()
+{
+	{
+		std::lock_guard<std::mutex> lock(job_mutex);
+		job_quit = true;
+	}
+	job_wake.notify_all();
+	for (size_t i = 0; i < job_workers.size(); i++)
+		job_workers[i].join();
+	job_workers.clear();
+	job_running = false;
+}
+
+static void start_workers(int threads, bool pin_threads)
+{
+	int cores = std::max(1, (int)std::thread::hardware_concurrency());
+	if (threads <= 0)
+		threads = cores;
+#if !defined(_WIN32) && !defined(__linux__)
+	if (pin_threads)
+		fprintf(stderr, "Pinning threads is not supported on this platform\n");
+#endif
+	JobSystem::thread_count = threads;
+	JobSystem::pin_threads = pin_threads;
+	job_queue_count = threads;
+	job_queues.reset(new JobQueue[threads]);
+	job_queued = 0;
+	job_quit = false;
+	for (int i = 0; i < threads - 1; i++)
+	{
+		job_workers.push_back(std::thread(worker, i));
+		// Core 0 is left to the main thread
+		if (pin_threads)
+			pin(job_workers.back(), (i + 1) % cores);
+	}
+
+	static bool registered = false;
+	if (!registered)
+		atexit(JobSystem::shutdown);
+	registered = true;
+	job_running = true;
+}
+
+static void start()
+{
+	if (job_running.load())
+		return;
+	std::lock_guard<std::mutex> lock(job_start_mutex);
+	if (!job_running.load())
+		start_workers(JobSystem::thread_count, JobSystem::pin_threads);
+}
+
+void JobSystem::initialize(int threads, bool pin)
+{
+	std::lock_guard<std::mutex> lock(job_start_mutex);
+	if (job_running.load())
+		stop_workers();
+	start_workers(threads, pin);
+}
+
+void JobSystem::shutdown()
+{
+	std::lock_guard<std::mutex> lock(job_start_mutex);
+	if (job_running.load())
+		stop_workers();
+}
+
+int JobSystem::threads()
+{
+	start();
+	return job_queue_count;
+}
+
+Job* JobSystem::create(std::function<void()> work)
+{
+	start();
+	Job* job = new Job();
+	job->work = std::move(work);
+	job->pending = 1;
+	job->references = 2;
+	job->finished = false;
+	return job;
+}
+
+void JobSystem::depend(Job* job, Job* before)
+{
+	std::lock_guard<std::mutex> lock(before->mutex);
+	if (before->finished)
+		return;
+	job->pending++;
+	before->dependents.push_back(job);
+}
+
+Job* JobSystem::then(Job* before, std::function<void()> work)
+{
+	Job* job = create(std::move(work));
+	depend(job, before);
+	submit(job);
+	return job;
+}
+
+void JobSystem::submit(Job* job)
+{
+	if (--job->pending == 0)
+		enqueue(job);
+}
+
+void JobSystem::wait(Job* job)
+{
+	help_until([job] { return job->finished.load(); });
+	release(job);
+}
+
+void JobSystem::release(Job* job)
+{
+	if (--job->references == 0)
+		delete job;
+}
+
+// Hands the upper half to whoever steals it and keeps halving the rest, so the biggest pieces are
+// the ones other threads find at the front of the queue
+static void run_range(JobRange* range, size_t begin, size_t end)
+{
+	while (end - begin > range->grain)
+	{
+		// At a multiple of grain, so only the last range is short
+		size_t chunks = (end - begin + range->grain - 1) / range->grain;
+		size_t middle = begin + chunks / 2 * range->grain;
+		size_t last = end;
+		Job* job = JobSystem::create([range, middle, last] { run_range(range, middle, last); });
+		JobSystem::submit(job);
+		JobSystem::release(job);
+		end = middle;
+	}
+	(*range->body)(begin, end);
+	if ((range->remaining -= end - begin) == 0)
+		wake(job_waiters);
+}
+
+void JobSystem::parallel_for(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& body)
+{
+	if (grain == 0)
+		grain = 1;
+	if (end <= begin)
+		return;
+	if (end - begin <= grain || threads() == 1)
+	{
+		for (size_t first = begin; first < end; first += grain)
+			body(first, std::min(end, first + grain));
+		return;
+	}
+	JobRange range;
+	range.body = &body;
+	range.grain = grain;
+	range.remaining = end - begin;
+	run_range(&range, begin, end);
+	help_until([&range] { return range.remaining.load() == 0; });
+}
+
+JobStats JobSystem::stats()
+{
+	JobStats stats;
+	stats.jobs = job_run_count.load();
+	stats.stolen = job_stolen_count.load();
+	return stats;
+}
+
+void JobSystem::print_summary()
+{
+	JobStats stats = JobSystem::stats();
+	if (stats.jobs == 0)
+		return;
+	printf("Jobs: %llu run on %d threads%s, %llu stolen (%.0f%%)\n", stats.jobs, job_queue_count,
+		pin_threads ? " pinned to cores" : "", stats.stolen, 100.0 * stats.stolen / stats.jobs);
+}
@@ -0,0 +1,57 @@
+#ifndef _JOBSYSTEM_H_
+#define _JOBSYSTEM_H_
+
+#include <functional>
+#include <stddef.h>
+
+// Opaque, created by JobSystem::create and freed by the scheduler
+struct Job;
+
+struct JobStats {
+	unsigned long long jobs;	// Jobs run, parallel_for ranges included
+	unsigned long long stolen;	// Of those, taken from another thread's queue
+};
+
+// Work-stealing scheduler shared by everything that runs in parallel: parsing, decoding, per-frame
+// updates. Every worker has its own deque; it pushes and pops jobs at the back, so related work stays
+// on one core while it is hot in the cache, and idle workers steal from the front of the others,
+// where the oldest and largest pieces are. Threads that are not workers (the main thread, the render
+// thread) share one more queue and run jobs themselves while they wait, so waiting never blocks a
+// core and a job may wait for other jobs. No GL dependency, so the tools link it like OBJParser.
+class JobSystem
+{
+public:
+	// Used when the first job starts the workers. 0 threads means one per core, the caller included.
+	// pin_threads pins every worker to its own core, the calling threads are left alone.
+	static int thread_count;
+	static bool pin_threads;
+
+	// Starts or restarts the workers with other settings, only while no jobs are running
+	static void initialize(int threads, bool pin);
+	static void shutdown();
+	// Workers plus the calling thread
+	static int threads();
+
+	// A job runs once it is submitted and every job it depends on has finished. The handle stays
+	// valid until it is passed to wait or release.
+	static Job* create(std::function<void()> work);
+	// job runs after before, call it before submitting job
+	static void depend(Job* job, Job* before);
+	// Continuation: creates and submits a job that runs after before
+	static Job* then(Job* before, std::function<void()> work);
+	static void submit(Job* job);
+	// Runs other jobs until job has finished, then releases the handle
+	static void wait(Job* job);
+	// For jobs nobody waits for
+	static void release(Job* job);
+
+	// Calls body(first, last) on ranges of at most grain items that together cover [begin, end),
+	// on all threads, and returns when every range is done. Small enough ranges run inline.
+	static void parallel_for(size_t begin, size_t end, size_t grain,
+		const std::function<void(size_t, size_t)>& body);
+
+	static JobStats stats();
+	static void print_summary();
+};
+
+#endif
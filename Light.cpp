@@ -1,5 +1,6 @@
 #define _CRT_SECURE_NO_DEPRECATE
 #include "Light.h"
+#include "Tracer.h"
 
 Light::Light()
 {
@@ -11,6 +12,7 @@ Light::~Light()
 
 void Light::update(GLuint shaderProgram)
 {
+	TRACE_SCOPE("Light::update");
 	// Light color
 	uLight_on = glGetUniformLocation(shaderProgram, "on");
 
@@ -19,9 +21,9 @@ void Light::update(GLuint shaderProgram)
 
 	// Directional light
 	glUniform3f(glGetUniformLocation(shaderProgram, "dirLight.direction"), d_direction.x, d_direction.y, d_direction.z);
-	glUniform3f(glGetUniformLocation(shaderProgram, "dirLight.ambient"), 0.3f, 0.24f, 0.14f);
-	glUniform3f(glGetUniformLocation(shaderProgram, "dirLight.diffuse"), 0.7f, 0.42f, 0.26f);
-	glUniform3f(glGetUniformLocation(shaderProgram, "dirLight.specular"), 0.5f, 0.5f, 0.5f);
+	glUniform3f(glGetUniformLocation(shaderProgram, "dirLight.ambient"), d_ambient.x, d_ambient.y, d_ambient.z);
+	glUniform3f(glGetUniformLocation(shaderProgram, "dirLight.diffuse"), d_diffuse.x, d_diffuse.y, d_diffuse.z);
+	glUniform3f(glGetUniformLocation(shaderProgram, "dirLight.specular"), d_specular.x, d_specular.y, d_specular.z);
 
 	// Point light
 	glUniform3f(glGetUniformLocation(shaderProgram, "pointLight.position"), p_position.x, p_position.y, p_position.z);
@@ -31,11 +33,11 @@ void Light::update(GLuint shaderProgram)
 	glUniform1f(glGetUniformLocation(shaderProgram, "pointLight.quadratic"), attenuation);
 
 	// Spot light
-	glUniform3f(glGetUniformLocation(shaderProgram, "spotLight.direction"), 0.0f, 0.0f, -1.0f);
+	glUniform3f(glGetUniformLocation(shaderProgram, "spotLight.direction"), s_direction.x, s_direction.y, s_direction.z);
 	glUniform3f(glGetUniformLocation(shaderProgram, "spotLight.position"), s_position.x, s_position.y, s_position.z);
-	glUniform3f(glGetUniformLocation(shaderProgram, "spotLight.ambient"), 0.0f, 0.0f, 0.0f);
-	glUniform3f(glGetUniformLocation(shaderProgram, "spotLight.diffuse"), 0.8f, 0.8f, 0.0f);
-	glUniform3f(glGetUniformLocation(shaderProgram, "spotLight.specular"), 0.8f, 0.8f, 0.8f);
+	glUniform3f(glGetUniformLocation(shaderProgram, "spotLight.ambient"), s_ambient.x, s_ambient.y, s_ambient.z);
+	glUniform3f(glGetUniformLocation(shaderProgram, "spotLight.diffuse"), s_diffuse.x, s_diffuse.y, s_diffuse.z);
+	glUniform3f(glGetUniformLocation(shaderProgram, "spotLight.specular"), s_specular.x, s_specular.y, s_specular.z);
 	glUniform1f(glGetUniformLocation(shaderProgram, "spotLight.quadratic"), attenuation);
 	glUniform1f(glGetUniformLocation(shaderProgram, "spotLight.cutOff"), cos_cutOff);
 	glUniform1f(glGetUniformLocation(shaderProgram, "spotLight.outerCutOff"), cos_outerCutOff);
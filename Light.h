@@ -1,3 +1,6 @@
+#ifndef _LIGHT_H_
+#define _LIGHT_H_
+
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <glm/mat4x4.hpp>
@@ -18,9 +21,16 @@ public:
 
 	// Settings
 	glm::vec3 d_direction = { -0.2f, -1.0f, -0.3f }; 
+	glm::vec3 d_ambient = { 0.3f, 0.24f, 0.14f }; // Directional light colors
+	glm::vec3 d_diffuse = { 0.7f, 0.42f, 0.26f };
+	glm::vec3 d_specular = { 0.5f, 0.5f, 0.5f };
 	glm::vec3 p_position = { 0.0f, 0.0f, 5.2f }; // Point light position
 	glm::vec3 light_color = { 0.7f, 0.7f, 0.7f }; // Point light color
 	glm::vec3 s_position = { -0.911678, 0.026234, 3.89464 }; // Spot light
+	glm::vec3 s_direction = { 0.0f, 0.0f, -1.0f };
+	glm::vec3 s_ambient = { 0.0f, 0.0f, 0.0f }; // Spot light colors
+	glm::vec3 s_diffuse = { 0.8f, 0.8f, 0.0f };
+	glm::vec3 s_specular = { 0.8f, 0.8f, 0.8f };
 	int cos_exp = 1;
 	float attenuation = 0.032f;
 	int lights_on = 1;
@@ -30,4 +40,6 @@ public:
 	float cos_outerCutOff = pow(glm::cos(glm::radians(outerCutOff)), cos_exp);
 	// Sent to GPU
 	GLuint uLight_on;
-};
\ No newline at end of file
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,217 @@
+#define _CRT_SECURE_NO_DEPRECATE
+#include "Mesh.h"
+#include "OBJParser.h"
+#include "MeshCodec.h"
+#include "GLState.h"
+#include "Tracer.h"
+#include <glm/common.hpp>
+#include <stdlib.h>
+#include <algorithm>
+
+Mesh::~Mesh()
+{
+	release_gpu();
+}
+
+void Mesh::release_gpu()
+{
+	// Delete previously generated buffers. Note that forgetting to do this can waste GPU memory in a 
+	// large project! This could crash the graphics driver due to memory leaks, or slow down application performance!
+	if (VAO == 0)
+		return;
+	GLState::delete_vertex_arrays(1, &VAO);
+	GLState::delete_buffers(1, &VBO);
+	GLState::delete_buffers(1, &NBO);
+	GLState::delete_buffers(1, &EBO);
+	VAO = VBO = NBO = EBO = 0;
+}
+
+void Mesh::release_cpu()
+{
+	// swap frees the memory, clear alone keeps the capacity
+	std::vector<glm::vec3>().swap(vertices);
+	std::vector<glm::vec3>().swap(normals);
+	std::vector<GLuint>().swap(indices);
+}
+
+size_t Mesh::cpu_bytes() const
+{
+	return (vertices.capacity() + normals.capacity()) * sizeof(glm::vec3) + indices.capacity() * sizeof(GLuint);
+}
+
+void Mesh::upload()
+{
+	TRACE_SCOPE("Mesh::upload");
+	create_buffers(vertices.size(), normals.size(), indices.size(), vertices.data(), normals.data(), indices.data());
+}
+
+void Mesh::create_buffers(size_t vertex_count, size_t normal_count, size_t count, const void* vertex_data,
+	const void* normal_data, const void* index_data)
+{
+	index_first = 0;
+	index_count = (GLsizei)count;
+	this->vertex_count = std::min(vertex_count, normal_count);
+	static uint64_t uploads = 0;
+	upload_id = ++uploads;
+	uploaded_bytes = (vertex_count + normal_count) * sizeof(glm::vec3) + count * sizeof(GLuint);
+
+	// Create array object and buffers. Remember to delete your buffers when the object is destroyed!
+	glGenVertexArrays(1, &VAO);
+	glGenBuffers(1, &VBO); // Stores large number of vertices
+	glGenBuffers(1, &NBO);
+	glGenBuffers(1, &EBO);
+
+	// Bind the Vertex Array Object (VAO) first, then bind the associated buffers to it.
+	// Consider the VAO as a container for all your buffers.
+	GLState::bind_vertex_array(VAO);
+
+	// Now bind a VBO to it as a GL_ARRAY_BUFFER. The GL_ARRAY_BUFFER is an array containing relevant data to what
+	// you want to draw, such as vertices, normals, colors, etc.
+	GLState::bind_buffer(GL_ARRAY_BUFFER, VBO);
+
+	// glBufferData populates the most recently bound buffer with data starting at the 3rd argument and ending after
+	// the 2nd argument number of indices. How does OpenGL know how long an index spans? Go to glVertexAttribPointer.
+	glBufferData(GL_ARRAY_BUFFER, vertex_count * sizeof(glm::vec3), vertex_data, GL_STATIC_DRAW);
+
+	// Enable the usage of layout location 0 (check the vertex shader to see what this is)
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0,// This first parameter x should be the same as the number passed into the line "layout (location = x)" in the vertex shader. In this case, it's 0. Valid values are 0 to GL_MAX_UNIFORM_LOCATIONS.
+		3, // This second line tells us how any components there are per vertex. In this case, it's 3 (we have an x, y, and z component)
+		GL_FLOAT, // What type these components are
+		GL_FALSE, // GL_TRUE means the values should be normalized. GL_FALSE means they shouldn't
+		3 * sizeof(GLfloat), // Offset between consecutive indices. Since each of our vertices have 3 floats, they should have the size of 3 floats in between
+		(GLvoid*)0); // Offset of the first vertex's component. In our case it's 0 since we don't pad the vertices array with anything.
+
+					 // We've sent the vertex data over to OpenGL, but there's still something missing.
+					 // In what order should it draw those vertices? That's why we'll need a GL_ELEMENT_ARRAY_BUFFER for this.
+
+	/* NBO */
+	
+	GLState::bind_buffer(GL_ARRAY_BUFFER, NBO);
+	glBufferData(GL_ARRAY_BUFFER, normal_count * sizeof(glm::vec3), normal_data, GL_STATIC_DRAW);
+	
+	// Enable the usage of layout location 1 (check the vertex shader to see what this is)
+	glEnableVertexAttribArray(1);
+
+	glVertexAttribPointer(1,// This first parameter x should be the same as the number passed into the line "layout (location = x)" in the vertex shader.
+		3, // This second line tells us how any components there are per vertex. In this case, it's 3 (we have an x, y, and z component)
+		GL_FLOAT, // What type these components are
+		GL_FALSE, // GL_TRUE means the values should be normalized. GL_FALSE means they shouldn't
+		3 * sizeof(GLfloat), // Offset between consecutive indices. Since each of our vertices have 3 floats, they should have the size of 3 floats in between
+		(GLvoid*)0); // Offset of the first vertex's component. In our case it's 0 since we don't pad the vertices array with anything.
+
+					 // We've sent the vertex data over to OpenGL, but there's still something missing.
+					 // In what order should it draw those vertices? That's why we'll need a GL_ELEMENT_ARRAY_BUFFER for this.
+	
+	/*END*/
+
+
+	GLState::bind_buffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, count * sizeof(GLuint), index_data, GL_STATIC_DRAW);
+
+	// Unbind the currently bound buffer so that we don't accidentally make unwanted changes to it.
+	GLState::bind_buffer(GL_ARRAY_BUFFER, 0);
+
+	// Unbind the VAO now so we don't accidentally tamper with it.
+	// NOTE: You must NEVER unbind the element array buffer associated with a VAO!
+	GLState::bind_vertex_array(0);
+}
+
+bool Mesh::upload_from_file()
+{
+	TRACE_SCOPE("Mesh::upload_from_file");
+	std::vector<unsigned char> file;
+	MeshFileInfo info;
+	if (!MeshCodec::is_mesh_file(path.c_str()) || !MeshCodec::load(path.c_str(), file, info)
+		|| info.vertex_count == 0 || info.index_count == 0)
+		return false;
+
+	// Allocate the buffers empty, then decode into them while they are mapped
+	size_t normal_count = info.has_normals ? info.vertex_count : 0;
+	create_buffers(info.vertex_count, normal_count, info.index_count, NULL, NULL, NULL);
+	GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT;
+	GLState::bind_vertex_array(VAO);
+	GLState::bind_buffer(GL_ARRAY_BUFFER, VBO);
+	float* positions = (float*)glMapBufferRange(GL_ARRAY_BUFFER, 0, info.vertex_count * sizeof(glm::vec3), access);
+	float* mapped_normals = NULL;
+	if (normal_count > 0)
+	{
+		GLState::bind_buffer(GL_ARRAY_BUFFER, NBO);
+		mapped_normals = (float*)glMapBufferRange(GL_ARRAY_BUFFER, 0, normal_count * sizeof(glm::vec3), access);
+	}
+	unsigned int* mapped_indices = (unsigned int*)glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, 0,
+		info.index_count * sizeof(GLuint), access);
+
+	bool decoded = positions != NULL && (normal_count == 0 || mapped_normals != NULL) && mapped_indices != NULL
+		&& MeshCodec::decode(file, positions, mapped_normals, mapped_indices);
+
+	// Unmapping fails if the driver lost the contents, which then have to be uploaded the usual way
+	if (mapped_indices != NULL && !glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER))
+		decoded = false;
+	if (mapped_normals != NULL && !glUnmapBuffer(GL_ARRAY_BUFFER))
+		decoded = false;
+	GLState::bind_buffer(GL_ARRAY_BUFFER, VBO);
+	if (positions != NULL && !glUnmapBuffer(GL_ARRAY_BUFFER))
+		decoded = false;
+	GLState::bind_buffer(GL_ARRAY_BUFFER, 0);
+	GLState::bind_vertex_array(0);
+	if (!decoded)
+	{
+		release_gpu();
+		return false;
+	}
+	bounds_min = info.bounds_min;
+	bounds_max = info.bounds_max;
+	hash = info.hash;
+	return true;
+}
+
+bool Mesh::parse(const char* filepath)
+{
+	TRACE_SCOPE("Mesh::parse");
+	path = filepath;
+	// Stored already placed like below, and the bounds are in the header
+	if (MeshCodec::is_mesh_file(filepath))
+	{
+		MeshFileInfo info;
+		if (!MeshCodec::read(filepath, vertices, normals, indices, info)) {
+			release_cpu();
+			return false;
+		}
+		bounds_min = info.bounds_min;
+		bounds_max = info.bounds_max;
+		hash = info.hash;
+		return true;
+	}
+
+	glm::vec3 min, max;
+	if (!OBJParser::parse(filepath, vertices, normals, indices, min, max)) {
+		release_cpu();
+		return false;
+	}
+	OBJParser::normalize(vertices, min, max);
+
+	if (!vertices.empty())
+		bounds_min = bounds_max = vertices[0];
+	for (size_t i = 1; i < vertices.size(); i++) {
+		bounds_min = glm::min(bounds_min, vertices[i]);
+		bounds_max = glm::max(bounds_max, vertices[i]);
+	}
+	return true;
+}
+
+void Mesh::draw()
+{
+	draw(VAO);
+}
+
+void Mesh::draw(GLuint vao)
+{
+	// Now draw the object. We simply need to bind the VAO associated with it.
+	GLState::bind_vertex_array(vao);
+
+	// Tell OpenGL to draw with triangles, using indices, the type of the indices, and the offset to start from
+	glDrawElements(GL_TRIANGLES, index_count, GL_UNSIGNED_INT, (GLvoid*)(index_first * sizeof(GLuint)));
+
+	// The VAO stays bound, the next draw binds its own and code that changes one binds it first
+}
@@ -0,0 +1,76 @@
+#ifndef _MESH_H_
+#define _MESH_H_
+
+#define GLFW_INCLUDE_GLEXT
+#ifdef __APPLE__
+#define GLFW_INCLUDE_GLCOREARB
+#else
+#include <GL/glew.h>
+#endif
+#include <GLFW/glfw3.h>
+// Use of degrees is deprecated. Use radians instead.
+#ifndef GLM_FORCE_RADIANS
+#define GLM_FORCE_RADIANS
+#endif
+#include <glm/vec3.hpp>
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+// Geometry of a model on the CPU and in GL buffers. Meshes loaded from files come from AssetManager
+// and are shared by every OBJObject that uses them; ResidencyManager decides which copies exist.
+class Mesh
+{
+public:
+	Mesh() {}
+	~Mesh();
+	// Owns GL buffers, share it through a std::shared_ptr instead
+	Mesh(const Mesh&) = delete;
+	Mesh& operator=(const Mesh&) = delete;
+
+	// Containers
+	std::vector<GLuint> indices;
+	std::vector<glm::vec3> vertices;
+	std::vector<glm::vec3> normals;
+	// Bounding box in object space, for culling
+	glm::vec3 bounds_min = glm::vec3(0.0f);
+	glm::vec3 bounds_max = glm::vec3(0.0f);
+	// File parse read the mesh from, for reloading after eviction. Empty for the cube.
+	std::string path;
+	// Of the parsed geometry, for finding files with the same content
+	uint64_t hash = 0;
+	// Triangle indices drawn from the GL buffers, still valid once the CPU copy is dropped. A streamed
+	// mesh moves them to each finer level as it arrives.
+	size_t index_first = 0;
+	GLsizei index_count = 0;
+	// Vertices in the GL buffers that have a normal as well
+	size_t vertex_count = 0;
+	// New for every create_buffers, unlike the GL names, which come back after an eviction
+	uint64_t upload_id = 0;
+	size_t uploaded_bytes = 0;
+
+	// .obj or .mesh, by extension. False with the error printed and no geometry if it cannot be read.
+	bool parse(const char* filepath);
+	void upload();
+	// For a .mesh path, decodes the file straight into the GL buffers without a CPU copy. False if
+	// that is not possible, parse and upload then.
+	bool upload_from_file();
+	void release_cpu();
+	void release_gpu();
+	bool has_cpu() const { return !indices.empty(); }
+	bool has_gpu() const { return VAO != 0; }
+	size_t cpu_bytes() const;
+	size_t gpu_bytes() const { return VAO != 0 ? uploaded_bytes : 0; }
+	// Binds the buffers and draws the triangles, the caller sets up the program
+	void draw();
+	// The same triangles with another VAO over these buffers, for extra per-vertex attributes
+	void draw(GLuint vao);
+
+	// Data pointers may be NULL to leave the buffers uninitialized, for filling them later
+	void create_buffers(size_t vertex_count, size_t normal_count, size_t count, const void* vertex_data,
+		const void* normal_data, const void* index_data);
+
+	GLuint VBO = 0, VAO = 0, EBO = 0, NBO = 0;
+};
+
+#endif
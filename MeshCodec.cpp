@@ -0,0 +1,902 @@
+#define _CRT_SECURE_NO_DEPRECATE
+#include "MeshCodec.h"
+#include "JobSystem.h"
+#include "Tracer.h"
+#include <glm/common.hpp>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <array>
+#include <unordered_map>
+#include <atomic>
+
+// Header layout, all little endian:
+//   0  "MSH1"            4  version
+//   8  vertex count      12 index count        16 flags
+//   20 bounds min, max (6 floats)              44 hash (64 bit)
+//   52 vertex blocks     56 index blocks       60 offset of the vertex records (64 bit)
+//   68 per index block: offset (64 bit), size, next new vertex at its start
+// The vertex records follow: 3x16 bit position, then 2x16 bit octahedral normal with FLAG_NORMALS.
+// With FLAG_PROGRESSIVE, 52 is the number of levels instead, 56 is 0 and 60 is the offset of the level
+// table. A level table entry is its vertex count (all levels so far), index count, offset (64 bit) and
+// size of its data, then 4 reserved bytes. Its data holds the records of the vertices it adds, then
+// its triangles as zigzag varint deltas from the previous index. The last level is the full mesh.
+static const char MAGIC[4] = { 'M', 'S', 'H', '1' };
+static const uint32_t VERSION = 1;
+static const uint32_t FLAG_NORMALS = 1;
+static const uint32_t FLAG_PROGRESSIVE = 2;
+static const size_t HEADER_SIZE = 68;
+static const size_t BLOCK_ENTRY_SIZE = 16;
+static const size_t LEVEL_ENTRY_SIZE = 24;
+
+// Clustering grid of the coarsest level, doubled for each finer one
+static const uint32_t BASE_GRID = 16;
+static const int MAX_LEVELS = 8;
+
+// Forsyth's vertex cache optimization, with the usual constants
+static const int CACHE_SIZE = 32;
+static const float CACHE_DECAY = 1.5f;
+static const float LAST_TRIANGLE_SCORE = 0.75f;
+static const float VALENCE_SCALE = 2.0f;
+static const float VALENCE_POWER = 0.5f;
+
+static void put_u32(std::vector<unsigned char>& out, uint32_t value)
+{
+	for (int i = 0; i < 4; i++)
+		out.push_back((unsigned char)(value >> (8 * i)));
+}
+
+static void put_u64(std::vector<unsigned char>& out, uint64_t value)
+{
+	put_u32(out, (uint32_t)value);
+	put_u32(out, (uint32_t)(value >> 32));
+}
+
+static void put_f32(std::vector<unsigned char>& out, float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, 4);
+	put_u32(out, bits);
+}
+
+static uint32_t get_u32(const unsigned char* in)
+{
+	return in[0] | (in[1] << 8) | (in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+static uint64_t get_u64(const unsigned char* in)
+{
+	return get_u32(in) | ((uint64_t)get_u32(in + 4) << 32);
+}
+
+static float get_f32(const unsigned char* in)
+{
+	uint32_t bits = get_u32(in);
+	float value;
+	memcpy(&value, &bits, 4);
+	return value;
+}
+
+static void set_u32(std::vector<unsigned char>& out, size_t at, uint32_t value)
+{
+	for (int i = 0; i < 4; i++)
+		out[at + i] = (unsigned char)(value >> (8 * i));
+}
+
+static void set_u64(std::vector<unsigned char>& out, size_t at, uint64_t value)
+{
+	set_u32(out, at, (uint32_t)value);
+	set_u32(out, at + 4, (uint32_t)(value >> 32));
+}
+
+static float vertex_score(int cache_position, uint32_t remaining)
+{
+	if (remaining == 0)
+		return -1.0f;
+	float score = 0.0f;
+	if (cache_position >= 0)
+	{
+		// The triangle just drawn used the first three, they get a fixed score
+		if (cache_position < 3)
+			score = LAST_TRIANGLE_SCORE;
+		else
+			score = powf(1.0f - (cache_position - 3) / (float)(CACHE_SIZE - 3), CACHE_DECAY);
+	}
+	// Vertices with few triangles left are finished first, so they don't linger
+	return score + VALENCE_SCALE * powf((float)remaining, -VALENCE_POWER);
+}
+
+// Reorders the triangles so that vertices are reused while they are still in a post-transform cache
+static std::vector<unsigned int> optimize_vertex_cache(const std::vector<unsigned int>& indices, size_t vertex_count)
+{
+	size_t triangle_count = indices.size() / 3;
+	std::vector<uint32_t> offsets(vertex_count + 1, 0), remaining(vertex_count, 0);
+	for (size_t i = 0; i < triangle_count * 3; i++)
+		remaining[indices[i]]++;
+	for (size_t v = 0; v < vertex_count; v++)
+		offsets[v + 1] = offsets[v] + remaining[v];
+	// Triangles of every vertex, the first remaining[v] of them not drawn yet
+	std::vector<uint32_t> adjacency(triangle_count * 3);
+	std::vector<uint32_t> fill(offsets);
+	for (size_t t = 0; t < triangle_count; t++)
+		for (int k = 0; k < 3; k++)
+			adjacency[fill[indices[3 * t + k]]++] = (uint32_t)t;
+
+	std::vector<int> cache_position(vertex_count, -1);
+	std::vector<float> score(vertex_count), triangle_score(triangle_count, 0.0f);
+	std::vector<bool> drawn(triangle_count, false);
+	for (size_t v = 0; v < vertex_count; v++)
+		score[v] = vertex_score(-1, remaining[v]);
+	for (size_t t = 0; t < triangle_count; t++)
+		triangle_score[t] = score[indices[3 * t]] + score[indices[3 * t + 1]] + score[indices[3 * t + 2]];
+
+	std::vector<unsigned int> out;
+	out.reserve(triangle_count * 3);
+	uint32_t cache[CACHE_SIZE + 3];
+	int cache_count = 0;
+	size_t scan = 0;			// Triangles before this are drawn, for when the cache has nothing left
+	long long best = -1;
+	for (size_t emitted = 0; emitted < triangle_count; emitted++)
+	{
+		if (best < 0)
+		{
+			while (drawn[scan])
+				scan++;
+			best = (long long)scan;
+		}
+
+		uint32_t triangle = (uint32_t)best;
+		drawn[triangle] = true;
+		uint32_t corners[3] = { indices[3 * triangle], indices[3 * triangle + 1], indices[3 * triangle + 2] };
+		for (int k = 0; k < 3; k++)
+		{
+			uint32_t v = corners[k];
+			out.push_back(v);
+			// Swap the triangle out of the vertex's remaining range
+			uint32_t* list = &adjacency[offsets[v]];
+			for (uint32_t i = 0; i < remaining[v]; i++)
+			{
+				if (list[i] == triangle)
+				{
+					std::swap(list[i], list[remaining[v] - 1]);
+					remaining[v]--;
+					break;
+				}
+			}
+		}
+
+		// The triangle's vertices move to the front of the cache, the rest shifts back
+		uint32_t next_cache[CACHE_SIZE + 3];
+		int next_count = 0;
+		for (int k = 0; k < 3; k++)
+			if (std::find(next_cache, next_cache + next_count, corners[k]) == next_cache + next_count)
+				next_cache[next_count++] = corners[k];
+		for (int i = 0; i < cache_count; i++)
+			if (std::find(next_cache, next_cache + next_count, cache[i]) == next_cache + next_count)
+				next_cache[next_count++] = cache[i];
+
+		for (int i = 0; i < next_count; i++)
+		{
+			uint32_t v = next_cache[i];
+			cache_position[v] = i < CACHE_SIZE ? i : -1;
+			float updated = vertex_score(cache_position[v], remaining[v]);
+			float delta = updated - score[v];
+			score[v] = updated;
+			for (uint32_t j = 0; j < remaining[v]; j++)
+				triangle_score[adjacency[offsets[v] + j]] += delta;
+		}
+
+		// Only triangles of cached vertices changed, the next one is among them if anywhere
+		best = -1;
+		float best_score = -1.0f;
+		cache_count = std::min(next_count, CACHE_SIZE);
+		for (int i = 0; i < cache_count; i++)
+		{
+			uint32_t v = next_cache[i];
+			cache[i] = v;
+			for (uint32_t j = 0; j < remaining[v]; j++)
+			{
+				uint32_t t = adjacency[offsets[v] + j];
+				if (triangle_score[t] > best_score)
+				{
+					best_score = triangle_score[t];
+					best = t;
+				}
+			}
+		}
+	}
+	return out;
+}
+
+static uint16_t quantize(float value, float min, float extent)
+{
+	if (extent <= 0.0f)
+		return 0;
+	float unit = std::min(std::max((value - min) / extent, 0.0f), 1.0f);
+	return (uint16_t)(unit * 65535.0f + 0.5f);
+}
+
+static void encode_octahedral(glm::vec3 n, uint16_t& u, uint16_t& v)
+{
+	float sum = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+	float x = sum > 0.0f ? n.x / sum : 0.0f;
+	float y = sum > 0.0f ? n.y / sum : 0.0f;
+	// The lower hemisphere folds over the diagonals
+	if (n.z < 0.0f)
+	{
+		float fx = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float fy = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = fx;
+		y = fy;
+	}
+	u = quantize(x, -1.0f, 2.0f);
+	v = quantize(y, -1.0f, 2.0f);
+}
+
+static inline void decode_octahedral(uint16_t u, uint16_t v, float* out)
+{
+	float x = u * (2.0f / 65535.0f) - 1.0f;
+	float y = v * (2.0f / 65535.0f) - 1.0f;
+	float z = 1.0f - fabsf(x) - fabsf(y);
+	float t = std::max(-z, 0.0f);
+	x += x >= 0.0f ? -t : t;
+	y += y >= 0.0f ? -t : t;
+	float scale = 1.0f / sqrtf(x * x + y * y + z * z);
+	out[0] = x * scale;
+	out[1] = y * scale;
+	out[2] = z * scale;
+}
+
+static void put_varint(std::vector<unsigned char>& out, uint32_t value)
+{
+	while (value >= 0x80)
+	{
+		out.push_back((unsigned char)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((unsigned char)value);
+}
+
+bool MeshCodec::is_mesh_file(const char* path)
+{
+	size_t length = strlen(path);
+	return length >= 5 && strcmp(path + length - 5, ".mesh") == 0;
+}
+
+static bool parse_header(const unsigned char* data, size_t size, MeshFileInfo& info)
+{
+	if (size < HEADER_SIZE || memcmp(data, MAGIC, 4) != 0 || get_u32(data + 4) != VERSION)
+		return false;
+	info.vertex_count = get_u32(data + 8);
+	info.index_count = get_u32(data + 12);
+	info.has_normals = (get_u32(data + 16) & FLAG_NORMALS) != 0;
+	for (int k = 0; k < 3; k++)
+	{
+		info.bounds_min[k] = get_f32(data + 20 + 4 * k);
+		info.bounds_max[k] = get_f32(data + 32 + 4 * k);
+	}
+	info.hash = get_u64(data + 44);
+	info.levels = (get_u32(data + 16) & FLAG_PROGRESSIVE) != 0 ? get_u32(data + 52) : 1;
+	return info.levels > 0;
+}
+
+static void put_zigzag(std::vector<unsigned char>& out, uint32_t index, uint32_t previous)
+{
+	int32_t delta = (int32_t)(index - previous);
+	put_varint(out, ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));
+}
+
+static void put_header(std::vector<unsigned char>& out, size_t vertex_count, size_t index_count, uint32_t flags,
+	const glm::vec3& min, const glm::vec3& max)
+{
+	out.insert(out.end(), MAGIC, MAGIC + 4);
+	put_u32(out, VERSION);
+	put_u32(out, (uint32_t)vertex_count);
+	put_u32(out, (uint32_t)index_count);
+	put_u32(out, flags);
+	for (int k = 0; k < 3; k++)
+		put_f32(out, min[k]);
+	for (int k = 0; k < 3; k++)
+		put_f32(out, max[k]);
+	put_u64(out, 0);		// Hash, once the decoded geometry is known
+}
+
+static void put_vertex(std::vector<unsigned char>& out, const glm::vec3& p, const glm::vec3* n, const glm::vec3& min,
+	const glm::vec3& extent)
+{
+	for (int k = 0; k < 3; k++)
+	{
+		uint16_t q = quantize(p[k], min[k], extent[k]);
+		out.push_back((unsigned char)q);
+		out.push_back((unsigned char)(q >> 8));
+	}
+	if (n != NULL)
+	{
+		uint16_t u, v;
+		encode_octahedral(*n, u, v);
+		out.push_back((unsigned char)u);
+		out.push_back((unsigned char)(u >> 8));
+		out.push_back((unsigned char)v);
+		out.push_back((unsigned char)(v >> 8));
+	}
+}
+
+// Whole triangles with valid indices, or false with a message
+static bool check_mesh(const char* path, size_t vertex_count, const std::vector<unsigned int>& indices,
+	std::vector<unsigned int>& triangles)
+{
+	if (vertex_count >= UINT32_MAX || indices.size() >= UINT32_MAX)
+	{
+		fprintf(stderr, "%s: too large for 32 bit counts\n", path);
+		return false;
+	}
+	triangles.assign(indices.begin(), indices.begin() + indices.size() / 3 * 3);
+	for (size_t i = 0; i < triangles.size(); i++)
+	{
+		if (triangles[i] >= vertex_count)
+		{
+			fprintf(stderr, "%s: index %u is past the %u vertices\n", path, triangles[i], (unsigned int)vertex_count);
+			return false;
+		}
+	}
+	return true;
+}
+
+static void compute_bounds(const std::vector<glm::vec3>& vertices, glm::vec3& min, glm::vec3& max)
+{
+	min = max = glm::vec3(0.0f);
+	if (!vertices.empty())
+		min = max = vertices[0];
+	for (size_t v = 1; v < vertices.size(); v++)
+	{
+		min = glm::min(min, vertices[v]);
+		max = glm::max(max, vertices[v]);
+	}
+}
+
+// Sets the hash from the decoded geometry and writes the file
+static bool finish_file(const char* path, std::vector<unsigned char>& out, MeshFileInfo* info)
+{
+	MeshFileInfo written_info;
+	if (!parse_header(out.data(), out.size(), written_info))
+		return false;
+	size_t vertex_count = written_info.vertex_count;
+	std::vector<glm::vec3> decoded_vertices(vertex_count), decoded_normals(written_info.has_normals ? vertex_count : 0);
+	std::vector<unsigned int> decoded_indices(written_info.index_count);
+	if (!MeshCodec::decode(out, vertex_count ? &decoded_vertices[0][0] : NULL,
+		decoded_normals.empty() ? NULL : &decoded_normals[0][0], decoded_indices.data()))
+	{
+		fprintf(stderr, "%s: encoded mesh does not decode\n", path);
+		return false;
+	}
+	// The hash is of what readers will get, after quantization
+	set_u64(out, 44, MeshCodec::hash(decoded_vertices, decoded_normals, decoded_indices));
+
+	FILE* fp = fopen(path, "wb");
+	if (fp == NULL)
+	{
+		fprintf(stderr, "Cannot write %s\n", path);
+		return false;
+	}
+	bool written = fwrite(out.data(), 1, out.size(), fp) == out.size();
+	written = fclose(fp) == 0 && written;
+	if (!written)
+	{
+		fprintf(stderr, "Error writing %s\n", path);
+		return false;
+	}
+	if (info != NULL)
+		MeshCodec::read_header(path, *info);
+	return true;
+}
+
+// Coarse levels merge the vertices in each cell of a grid into the cell's first vertex. The first vertex of
+// a cell is also the first of the finer cell it is in, so each level's vertices include the coarser ones
+// and are numbered after them: every level draws from a prefix of the vertex records.
+static bool write_progressive(const char* path, const std::vector<glm::vec3>& vertices,
+	const std::vector<glm::vec3>& normals, const std::vector<unsigned int>& triangles, MeshFileInfo* info)
+{
+	size_t vertex_count = vertices.size();
+	bool has_normals = normals.size() == vertex_count && vertex_count > 0;
+	glm::vec3 min, max;
+	compute_bounds(vertices, min, max);
+	glm::vec3 extent = max - min;
+	float size = std::max(extent.x, std::max(extent.y, extent.z));
+
+	std::vector<std::vector<uint32_t> > representative;
+	for (uint32_t grid = BASE_GRID; representative.size() + 1 < MAX_LEVELS && size > 0.0f; grid *= 2)
+	{
+		std::unordered_map<uint64_t, uint32_t> first;
+		first.reserve(std::min(vertex_count, (size_t)grid * grid * 4));
+		std::vector<uint32_t> level(vertex_count);
+		for (size_t v = 0; v < vertex_count; v++)
+		{
+			uint64_t key = 0;
+			for (int k = 0; k < 3; k++)
+			{
+				uint32_t cell = (uint32_t)((vertices[v][k] - min[k]) / size * grid);
+				key = (key << 21) | std::min(cell, grid - 1);
+			}
+			level[v] = first.insert(std::make_pair(key, (uint32_t)v)).first->second;
+		}
+		// Once merging no longer halves the vertices, the full mesh comes next
+		if (first.size() * 2 > vertex_count)
+			break;
+		representative.push_back(std::move(level));
+	}
+	uint32_t levels = (uint32_t)representative.size() + 1;
+
+	// Coarsest level each vertex is in
+	std::vector<uint32_t> level_of(vertex_count, levels - 1);
+	for (uint32_t l = levels - 1; l-- > 0;)
+		for (size_t v = 0; v < vertex_count; v++)
+			if (representative[l][v] == v)
+				level_of[v] = l;
+
+	// Each level's new vertices are numbered in order of first use by its triangles
+	std::vector<std::vector<unsigned int> > level_triangles(levels);
+	std::vector<uint32_t> level_vertices(levels), remap(vertex_count, UINT32_MAX), order(vertex_count);
+	uint32_t numbered = 0;
+	for (uint32_t l = 0; l < levels; l++)
+	{
+		std::vector<unsigned int>& level = level_triangles[l];
+		if (l + 1 == levels)
+			level = triangles;
+		else
+		{
+			// Triangles whose corners merged vanish, and merged copies of a triangle are drawn once
+			std::vector<std::array<uint32_t, 3> > merged;
+			for (size_t i = 0; i < triangles.size(); i += 3)
+			{
+				std::array<uint32_t, 3> t = { { representative[l][triangles[i]], representative[l][triangles[i + 1]],
+					representative[l][triangles[i + 2]] } };
+				if (t[0] == t[1] || t[1] == t[2] || t[0] == t[2])
+					continue;
+				while (t[0] > t[1] || t[0] > t[2])
+					std::rotate(t.begin(), t.begin() + 1, t.end());
+				merged.push_back(t);
+			}
+			std::sort(merged.begin(), merged.end());
+			merged.erase(std::unique(merged.begin(), merged.end()), merged.end());
+			for (size_t i = 0; i < merged.size(); i++)
+				level.insert(level.end(), merged[i].begin(), merged[i].end());
+		}
+		level = optimize_vertex_cache(level, vertex_count);
+
+		for (size_t i = 0; i < level.size(); i++)
+		{
+			if (remap[level[i]] == UINT32_MAX)
+			{
+				order[numbered] = level[i];
+				remap[level[i]] = numbered++;
+			}
+		}
+		for (size_t v = 0; v < vertex_count; v++)
+		{
+			if (level_of[v] == l && remap[v] == UINT32_MAX)
+			{
+				order[numbered] = (uint32_t)v;
+				remap[v] = numbered++;
+			}
+		}
+		level_vertices[l] = numbered;
+	}
+
+	std::vector<unsigned char> out;
+	put_header(out, vertex_count, triangles.size(), FLAG_PROGRESSIVE | (has_normals ? FLAG_NORMALS : 0), min, max);
+	put_u32(out, levels);
+	put_u32(out, 0);
+	put_u64(out, HEADER_SIZE);
+	out.resize(HEADER_SIZE + levels * LEVEL_ENTRY_SIZE, 0);
+	for (uint32_t l = 0; l < levels; l++)
+	{
+		size_t begin = out.size();
+		for (uint32_t i = l > 0 ? level_vertices[l - 1] : 0; i < level_vertices[l]; i++)
+			put_vertex(out, vertices[order[i]], has_normals ? &normals[order[i]] : NULL, min, extent);
+		uint32_t previous = 0;
+		for (size_t i = 0; i < level_triangles[l].size(); i++)
+		{
+			uint32_t index = remap[level_triangles[l][i]];
+			put_zigzag(out, index, previous);
+			previous = index;
+		}
+		size_t entry = HEADER_SIZE + l * LEVEL_ENTRY_SIZE;
+		set_u32(out, entry, level_vertices[l]);
+		set_u32(out, entry + 4, (uint32_t)level_triangles[l].size());
+		set_u64(out, entry + 8, begin);
+		set_u32(out, entry + 16, (uint32_t)(out.size() - begin));
+	}
+	return finish_file(path, out, info);
+}
+
+bool MeshCodec::write(const char* path, const std::vector<glm::vec3>& vertices, const std::vector<glm::vec3>& normals,
+	const std::vector<unsigned int>& indices, MeshFileInfo* info, bool progressive)
+{
+	size_t vertex_count = vertices.size();
+	std::vector<unsigned int> triangles;
+	if (!check_mesh(path, vertex_count, indices, triangles))
+		return false;
+	if (progressive)
+		return write_progressive(path, vertices, normals, triangles, info);
+	// Normals pair up with positions, since faces are indexed by position; any other count is not usable
+	bool has_normals = normals.size() == vertex_count && vertex_count > 0;
+
+	// Vertices in order of first use, unused ones at the end
+	triangles = optimize_vertex_cache(triangles, vertex_count);
+	std::vector<uint32_t> remap(vertex_count, UINT32_MAX), order;
+	order.reserve(vertex_count);
+	for (size_t i = 0; i < triangles.size(); i++)
+	{
+		if (remap[triangles[i]] == UINT32_MAX)
+		{
+			remap[triangles[i]] = (uint32_t)order.size();
+			order.push_back(triangles[i]);
+		}
+		triangles[i] = remap[triangles[i]];
+	}
+	for (size_t v = 0; v < vertex_count; v++)
+		if (remap[v] == UINT32_MAX)
+			order.push_back((uint32_t)v);
+
+	glm::vec3 min, max;
+	compute_bounds(vertices, min, max);
+	glm::vec3 extent = max - min;
+
+	uint32_t vertex_blocks = (uint32_t)((vertex_count + VERTEX_BLOCK - 1) / VERTEX_BLOCK);
+	size_t triangle_count = triangles.size() / 3;
+	uint32_t index_blocks = (uint32_t)((triangle_count + TRIANGLE_BLOCK - 1) / TRIANGLE_BLOCK);
+
+	std::vector<unsigned char> out;
+	put_header(out, vertex_count, triangles.size(), has_normals ? FLAG_NORMALS : 0, min, max);
+	put_u32(out, vertex_blocks);
+	put_u32(out, index_blocks);
+	put_u64(out, 0);		// Vertex records offset
+	out.resize(HEADER_SIZE + index_blocks * BLOCK_ENTRY_SIZE, 0);
+
+	set_u64(out, 60, out.size());
+	for (size_t i = 0; i < vertex_count; i++)
+		put_vertex(out, vertices[order[i]], has_normals ? &normals[order[i]] : NULL, min, extent);
+
+	// Each index is its distance below the next new vertex, 0 meaning the new vertex itself
+	uint32_t next = 0;
+	for (uint32_t b = 0; b < index_blocks; b++)
+	{
+		size_t entry = HEADER_SIZE + b * BLOCK_ENTRY_SIZE;
+		size_t begin = out.size();
+		set_u64(out, entry, begin);
+		set_u32(out, entry + 12, next);
+		size_t end = std::min(triangle_count, (size_t)(b + 1) * TRIANGLE_BLOCK) * 3;
+		for (size_t i = (size_t)b * TRIANGLE_BLOCK * 3; i < end; i++)
+		{
+			uint32_t index = triangles[i];
+			put_varint(out, next - index);
+			if (index == next)
+				next++;
+		}
+		set_u32(out, entry + 8, (uint32_t)(out.size() - begin));
+	}
+
+	return finish_file(path, out, info);
+}
+
+bool MeshCodec::read_header(const char* path, MeshFileInfo& info)
+{
+	FILE* fp = fopen(path, "rb");
+	if (fp == NULL)
+	{
+		fprintf(stderr, "Cannot open %s\n", path);
+		return false;
+	}
+	unsigned char header[HEADER_SIZE];
+	size_t size = fread(header, 1, HEADER_SIZE, fp);
+	fclose(fp);
+	if (!parse_header(header, size, info))
+	{
+		fprintf(stderr, "%s is not a mesh file\n", path);
+		return false;
+	}
+	return true;
+}
+
+bool MeshCodec::load(const char* path, std::vector<unsigned char>& file, MeshFileInfo& info)
+{
+	FILE* fp = fopen(path, "rb");
+	if (fp == NULL)
+	{
+		fprintf(stderr, "Cannot open %s\n", path);
+		return false;
+	}
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	file.resize(size > 0 ? (size_t)size : 0);
+	bool read = fread(file.data(), 1, file.size(), fp) == file.size();
+	fclose(fp);
+	if (!read || !parse_header(file.data(), file.size(), info))
+	{
+		fprintf(stderr, "%s is not a mesh file\n", path);
+		return false;
+	}
+	return true;
+}
+
+// One block of vertex records
+static void decode_vertices(const unsigned char* records, size_t stride, uint32_t begin, uint32_t end,
+	const MeshFileInfo& info, float* positions, float* normals)
+{
+	glm::vec3 step = (info.bounds_max - info.bounds_min) / 65535.0f;
+	for (uint32_t i = begin; i < end; i++)
+	{
+		const unsigned char* r = records + i * stride;
+		float* p = positions + 3 * (size_t)i;
+		p[0] = info.bounds_min.x + (r[0] | (r[1] << 8)) * step.x;
+		p[1] = info.bounds_min.y + (r[2] | (r[3] << 8)) * step.y;
+		p[2] = info.bounds_min.z + (r[4] | (r[5] << 8)) * step.z;
+		if (normals != NULL)
+			decode_octahedral((uint16_t)(r[6] | (r[7] << 8)), (uint16_t)(r[8] | (r[9] << 8)), normals + 3 * (size_t)i);
+	}
+}
+
+// One block of varint indices. false if it is corrupt.
+static bool decode_indices(const unsigned char* in, const unsigned char* in_end, uint32_t next, uint32_t vertex_count,
+	unsigned int* out, unsigned int* out_end)
+{
+	while (out != out_end)
+	{
+		if (in == in_end)
+			return false;
+		uint32_t code = *in++;
+		if (code >= 0x80)
+		{
+			code &= 0x7f;
+			for (int shift = 7;; shift += 7)
+			{
+				if (in == in_end || shift > 28)
+					return false;
+				uint32_t byte = *in++;
+				code |= (byte & 0x7f) << shift;
+				if (byte < 0x80)
+					break;
+			}
+		}
+		if (code > next || (code == 0 && next >= vertex_count))
+			return false;
+		*out++ = next - code;
+		next += code == 0;
+	}
+	return true;
+}
+
+static bool get_varint(const unsigned char*& in, const unsigned char* in_end, uint32_t& value)
+{
+	value = 0;
+	for (int shift = 0; shift <= 28; shift += 7)
+	{
+		if (in == in_end)
+			return false;
+		uint32_t byte = *in++;
+		value |= (byte & 0x7f) << shift;
+		if (byte < 0x80)
+			return true;
+	}
+	return false;
+}
+
+// The triangles of one level. false if they are corrupt.
+static bool decode_level_indices(const unsigned char* in, const unsigned char* in_end, uint32_t vertex_count,
+	unsigned int* out, unsigned int* out_end)
+{
+	uint32_t previous = 0;
+	while (out != out_end)
+	{
+		uint32_t code;
+		if (!get_varint(in, in_end, code))
+			return false;
+		uint32_t index = previous + ((code >> 1) ^ (0u - (code & 1)));
+		if (index >= vertex_count)
+			return false;
+		*out++ = previous = index;
+	}
+	return true;
+}
+
+// Checks a level table against the header and the file size
+static bool parse_levels(const unsigned char* table, const MeshFileInfo& info, uint64_t file_size,
+	std::vector<MeshLevel>& levels)
+{
+	size_t stride = info.has_normals ? 10 : 6;
+	levels.resize(info.levels);
+	uint32_t previous = 0;
+	for (uint32_t l = 0; l < info.levels; l++)
+	{
+		const unsigned char* entry = table + l * LEVEL_ENTRY_SIZE;
+		MeshLevel& level = levels[l];
+		level.vertex_count = get_u32(entry);
+		level.index_count = get_u32(entry + 4);
+		level.offset = get_u64(entry + 8);
+		level.size = get_u32(entry + 16);
+		if (level.vertex_count < previous || level.vertex_count > info.vertex_count || level.index_count % 3 != 0
+			|| level.offset + level.size > file_size || level.size < (uint64_t)(level.vertex_count - previous) * stride)
+			return false;
+		previous = level.vertex_count;
+	}
+	return previous == info.vertex_count && levels.back().index_count == info.index_count;
+}
+
+bool MeshCodec::read_levels(const char* path, MeshFileInfo& info, std::vector<MeshLevel>& levels)
+{
+	FILE* fp = fopen(path, "rb");
+	if (fp == NULL)
+	{
+		fprintf(stderr, "Cannot open %s\n", path);
+		return false;
+	}
+	std::vector<unsigned char> header(HEADER_SIZE);
+	bool read = fread(header.data(), 1, HEADER_SIZE, fp) == HEADER_SIZE && parse_header(header.data(), HEADER_SIZE, info);
+	bool progressive = read && (get_u32(&header[16]) & FLAG_PROGRESSIVE) != 0;
+	if (progressive)
+	{
+		// The table follows the header
+		header.resize(HEADER_SIZE + info.levels * LEVEL_ENTRY_SIZE);
+		fseek(fp, 0, SEEK_END);
+		long size = ftell(fp);
+		fseek(fp, HEADER_SIZE, SEEK_SET);
+		read = get_u64(&header[60]) == HEADER_SIZE
+			&& fread(&header[HEADER_SIZE], 1, header.size() - HEADER_SIZE, fp) == header.size() - HEADER_SIZE
+			&& parse_levels(&header[HEADER_SIZE], info, size > 0 ? (uint64_t)size : 0, levels);
+	}
+	fclose(fp);
+	if (!read)
+		fprintf(stderr, "%s is not a mesh file\n", path);
+	return read && progressive;
+}
+
+bool MeshCodec::decode_level(const std::vector<unsigned char>& data, const MeshFileInfo& info, uint32_t first_vertex,
+	const MeshLevel& level, float* positions, float* normals, unsigned int* indices)
+{
+	size_t stride = info.has_normals ? 10 : 6;
+	uint32_t added = level.vertex_count - first_vertex;
+	if (level.vertex_count < first_vertex || data.size() < (size_t)added * stride)
+		return false;
+	decode_vertices(data.data(), stride, 0, added, info, positions, info.has_normals ? normals : NULL);
+	return decode_level_indices(data.data() + (size_t)added * stride, data.data() + data.size(), level.vertex_count,
+		indices, indices + level.index_count);
+}
+
+// All vertices and the triangles of the last level
+static bool decode_progressive(const std::vector<unsigned char>& file, const MeshFileInfo& info, float* positions,
+	float* normals, unsigned int* indices)
+{
+	const unsigned char* data = file.data();
+	uint64_t table = get_u64(data + 60);
+	std::vector<MeshLevel> levels;
+	if (table + (uint64_t)info.levels * LEVEL_ENTRY_SIZE > file.size()
+		|| !parse_levels(data + table, info, file.size(), levels))
+		return false;
+	size_t stride = info.has_normals ? 10 : 6;
+	if (!info.has_normals)
+		normals = NULL;
+
+	// Each level's vertices and the last level's triangles are independent jobs
+	uint32_t jobs = info.levels + 1;
+	std::atomic<bool> failed(false);
+	auto work = [&](size_t first, size_t last)
+	{
+		for (uint32_t job = (uint32_t)first; job < last && !failed; job++)
+		{
+			if (job < info.levels)
+			{
+				uint32_t begin = job > 0 ? levels[job - 1].vertex_count : 0;
+				const unsigned char* records = data + levels[job].offset - (size_t)begin * stride;
+				decode_vertices(records, stride, begin, levels[job].vertex_count, info, positions, normals);
+				continue;
+			}
+			const MeshLevel& last = levels.back();
+			uint32_t added = last.vertex_count - (info.levels > 1 ? levels[info.levels - 2].vertex_count : 0);
+			const unsigned char* in = data + last.offset + (size_t)added * stride;
+			if (!decode_level_indices(in, data + last.offset + last.size, last.vertex_count, indices,
+				indices + last.index_count))
+				failed = true;
+		}
+	};
+
+	JobSystem::parallel_for(0, jobs, 1, work);
+	return !failed;
+}
+
+bool MeshCodec::decode(const std::vector<unsigned char>& file, float* positions, float* normals, unsigned int* indices)
+{
+	TRACE_SCOPE("MeshCodec::decode");
+	MeshFileInfo info;
+	const unsigned char* data = file.data();
+	size_t size = file.size();
+	if (!parse_header(data, size, info))
+		return false;
+	if ((get_u32(data + 16) & FLAG_PROGRESSIVE) != 0)
+		return decode_progressive(file, info, positions, normals, indices);
+	uint32_t vertex_blocks = get_u32(data + 52);
+	uint32_t index_blocks = get_u32(data + 56);
+	uint64_t records_offset = get_u64(data + 60);
+	size_t stride = info.has_normals ? 10 : 6;
+	if (HEADER_SIZE + (uint64_t)index_blocks * BLOCK_ENTRY_SIZE > size
+		|| records_offset + (uint64_t)info.vertex_count * stride > size
+		|| vertex_blocks != (info.vertex_count + VERTEX_BLOCK - 1) / VERTEX_BLOCK
+		|| index_blocks != (info.index_count / 3 + TRIANGLE_BLOCK - 1) / TRIANGLE_BLOCK
+		|| info.index_count % 3 != 0)
+		return false;
+	for (uint32_t b = 0; b < index_blocks; b++)
+	{
+		const unsigned char* entry = data + HEADER_SIZE + b * BLOCK_ENTRY_SIZE;
+		if (get_u64(entry) + get_u32(entry + 8) > size)
+			return false;
+	}
+	if (!info.has_normals)
+		normals = NULL;
+
+	// Vertex blocks and index blocks are all independent jobs
+	uint32_t jobs = vertex_blocks + index_blocks;
+	std::atomic<bool> failed(false);
+	auto work = [&](size_t first, size_t last)
+	{
+		for (uint32_t job = (uint32_t)first; job < last && !failed; job++)
+		{
+			if (job < vertex_blocks)
+			{
+				uint32_t begin = job * VERTEX_BLOCK;
+				uint32_t end = std::min(info.vertex_count, begin + VERTEX_BLOCK);
+				decode_vertices(data + records_offset, stride, begin, end, info, positions, normals);
+				continue;
+			}
+			uint32_t b = job - vertex_blocks;
+			const unsigned char* entry = data + HEADER_SIZE + b * BLOCK_ENTRY_SIZE;
+			const unsigned char* in = data + get_u64(entry);
+			size_t first = (size_t)b * TRIANGLE_BLOCK * 3;
+			size_t last = std::min((size_t)info.index_count, first + TRIANGLE_BLOCK * 3);
+			if (!decode_indices(in, in + get_u32(entry + 8), get_u32(entry + 12), info.vertex_count, indices + first,
+				indices + last))
+				failed = true;
+		}
+	};
+
+	JobSystem::parallel_for(0, jobs, 1, work);
+	return !failed;
+}
+
+bool MeshCodec::read(const char* path, std::vector<glm::vec3>& vertices, std::vector<glm::vec3>& normals,
+	std::vector<unsigned int>& indices, MeshFileInfo& info)
+{
+	std::vector<unsigned char> file;
+	if (!load(path, file, info))
+		return false;
+	vertices.resize(info.vertex_count);
+	normals.resize(info.has_normals ? info.vertex_count : 0);
+	indices.resize(info.index_count);
+	if (!decode(file, info.vertex_count ? &vertices[0][0] : NULL, normals.empty() ? NULL : &normals[0][0],
+		indices.data()))
+	{
+		fprintf(stderr, "%s is corrupt\n", path);
+		return false;
+	}
+	return true;
+}
+
+// FNV-1a, 64 bit
+static uint64_t hash_bytes(uint64_t hash, const void* data, size_t size)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; i++)
+		hash = (hash ^ bytes[i]) * 1099511628211ull;
+	return hash;
+}
+
+uint64_t MeshCodec::hash(const std::vector<glm::vec3>& vertices, const std::vector<glm::vec3>& normals,
+	const std::vector<unsigned int>& indices)
+{
+	uint64_t hash = 14695981039346656037ull;
+	uint64_t counts[3] = { vertices.size(), normals.size(), indices.size() };
+	hash = hash_bytes(hash, counts, sizeof(counts));
+	hash = hash_bytes(hash, vertices.data(), vertices.size() * sizeof(glm::vec3));
+	hash = hash_bytes(hash, normals.data(), normals.size() * sizeof(glm::vec3));
+	return hash_bytes(hash, indices.data(), indices.size() * sizeof(unsigned int));
+}
@@ -0,0 +1,76 @@
+#ifndef _MESHCODEC_H_
+#define _MESHCODEC_H_
+
+// Use of degrees is deprecated. Use radians instead.
+#ifndef GLM_FORCE_RADIANS
+#define GLM_FORCE_RADIANS
+#endif
+#include <glm/vec3.hpp>
+#include <vector>
+#include <stdint.h>
+
+// What the header of a .mesh file says about the mesh
+struct MeshFileInfo {
+	uint32_t vertex_count, index_count;
+	bool has_normals;
+	glm::vec3 bounds_min, bounds_max;
+	uint64_t hash;		// MeshCodec::hash of the decoded geometry
+	uint32_t levels;	// 1 unless the file is progressive
+};
+
+// One detail level of a progressive file. It draws from the first vertex_count vertices, the ones of
+// the coarser levels and its own, which are stored at offset followed by its triangles.
+struct MeshLevel {
+	uint32_t vertex_count, index_count;
+	uint64_t offset;
+	uint32_t size;
+};
+
+// Compact mesh files (.mesh), written by the obj2mesh tool. Triangles are reordered for the vertex
+// cache and vertices by first use, so most indices are either the next new vertex or one used a few
+// triangles ago: each is stored as a varint of its distance below the next new vertex. Positions are
+// quantized to 16 bits per axis within the bounds, normals to 2x16 bits octahedral. Vertices and
+// triangles are split into blocks that decode independently, in parallel on the JobSystem.
+// Progressive files instead hold a series of levels of detail, from a small base mesh up to the full
+// one, each a prefix of the vertices plus its own triangles, so a viewer can show the base at once and
+// refine it while the rest loads. Reading a whole file gives the full mesh either way.
+// Like OBJParser this has no GL dependency, so tools can link it on its own.
+class MeshCodec
+{
+public:
+	static const uint32_t VERTEX_BLOCK = 16384;		// Vertices per block
+	static const uint32_t TRIANGLE_BLOCK = 16384;	// Triangles per block
+
+	// By extension
+	static bool is_mesh_file(const char* path);
+
+	// Reorders, quantizes and writes the mesh. vertices are stored as given, so normalize them first
+	// for the viewer. normals are kept if there is one for every vertex. info receives the header.
+	// progressive adds coarser levels of detail, made by merging vertices on ever finer grids.
+	static bool write(const char* path, const std::vector<glm::vec3>& vertices, const std::vector<glm::vec3>& normals,
+		const std::vector<unsigned int>& indices, MeshFileInfo* info, bool progressive = false);
+
+	// Reads only the header
+	static bool read_header(const char* path, MeshFileInfo& info);
+	// Reads the whole file into file and its header into info, for decode
+	static bool load(const char* path, std::vector<unsigned char>& file, MeshFileInfo& info);
+	// Decodes a loaded file into caller memory, e.g. mapped GL buffers: 3 floats per vertex in positions
+	// and normals (NULL to skip them) and info.index_count indices
+	static bool decode(const std::vector<unsigned char>& file, float* positions, float* normals, unsigned int* indices);
+	// load and decode into vectors, normals stays empty without them
+	static bool read(const char* path, std::vector<glm::vec3>& vertices, std::vector<glm::vec3>& normals,
+		std::vector<unsigned int>& indices, MeshFileInfo& info);
+
+	// Reads the header and the level table of a progressive file, false for other files
+	static bool read_levels(const char* path, MeshFileInfo& info, std::vector<MeshLevel>& levels);
+	// Decodes the size bytes of level read from its offset, given the vertex count of the level before.
+	// Its new vertices go to positions and normals, which point at the first of them, its triangles to indices.
+	static bool decode_level(const std::vector<unsigned char>& data, const MeshFileInfo& info, uint32_t first_vertex,
+		const MeshLevel& level, float* positions, float* normals, unsigned int* indices);
+
+	// FNV-1a over the counts and the geometry, for finding identical meshes
+	static uint64_t hash(const std::vector<glm::vec3>& vertices, const std::vector<glm::vec3>& normals,
+		const std::vector<unsigned int>& indices);
+};
+
+#endif
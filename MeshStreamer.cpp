@@ -0,0 +1,295 @@
+#define _CRT_SECURE_NO_DEPRECATE
+#include "MeshStreamer.h"
+#include "MeshCodec.h"
+#include "GLState.h"
+#include "Tracer.h"
+#include <stdio.h>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+
+size_t MeshStreamer::bytes_per_frame = 4 * 1024 * 1024;
+bool MeshStreamer::enabled = true;
+
+// A level decoded by the reader thread, waiting to be uploaded
+struct DecodedLevel {
+	uint32_t level;
+	std::vector<float> positions, normals;
+	std::vector<unsigned int> indices;
+};
+
+struct MeshStream {
+	Mesh* mesh;
+	std::string path;
+	MeshFileInfo info;
+	std::vector<MeshLevel> levels;
+	std::vector<size_t> first_index;		// Where each level's triangles go in the index buffer
+	std::thread reader;
+	std::atomic<bool> stop;
+	std::atomic<bool> failed;
+	std::mutex lock;
+	std::deque<DecodedLevel*> decoded;
+	size_t vertices_done, indices_done;		// Of the level being uploaded
+	uint32_t shown;
+	std::chrono::steady_clock::time_point start;
+	int frames;
+};
+
+struct StreamStats {
+	int opened, finished;
+	double base_ms, full_ms;				// Slowest of all meshes
+};
+
+std::vector<MeshStream*> stream_meshes;
+StreamStats stream_stats = StreamStats();
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool read_level(FILE* fp, const MeshStream& stream, uint32_t level, DecodedLevel& out)
+{
+	const MeshLevel& entry = stream.levels[level];
+	std::vector<unsigned char> data(entry.size);
+	if (fseek(fp, (long)entry.offset, SEEK_SET) != 0 || fread(data.data(), 1, data.size(), fp) != data.size())
+		return false;
+	uint32_t first = level > 0 ? stream.levels[level - 1].vertex_count : 0;
+	out.level = level;
+	out.positions.resize(3 * (size_t)(entry.vertex_count - first));
+	out.normals.resize(stream.info.has_normals ? out.positions.size() : 0);
+	out.indices.resize(entry.index_count);
+	return MeshCodec::decode_level(data, stream.info, first, entry, out.positions.data(), out.normals.data(),
+		out.indices.data());
+}
+
+static void read_levels(MeshStream* stream)
+{
+	Tracer::name_thread("mesh streamer");
+	FILE* fp = fopen(stream->path.c_str(), "rb");
+	for (uint32_t l = 1; l < stream->levels.size() && !stream->stop; l++)
+	{
+		DecodedLevel* level = new DecodedLevel();
+		if (fp == NULL || !read_level(fp, *stream, l, *level))
+		{
+			delete level;
+			stream->failed = true;
+			break;
+		}
+		std::lock_guard<std::mutex> guard(stream->lock);
+		stream->decoded.push_back(level);
+	}
+	if (fp != NULL)
+		fclose(fp);
+}
+
+// Copies as much of level as budget allows, vertices first. true once all of it is in.
+static bool upload_level(MeshStream& stream, const DecodedLevel& level, size_t& budget)
+{
+	Mesh* mesh = stream.mesh;
+	size_t first = level.level > 0 ? stream.levels[level.level - 1].vertex_count : 0;
+	size_t added = level.positions.size() / 3;
+	size_t vertex_bytes = (level.normals.empty() ? 1 : 2) * sizeof(glm::vec3);
+	if (stream.vertices_done < added && budget > 0)
+	{
+		size_t count = std::min(added - stream.vertices_done, std::max<size_t>(1, budget / vertex_bytes));
+		GLintptr offset = (GLintptr)((first + stream.vertices_done) * sizeof(glm::vec3));
+		GLState::bind_buffer(GL_ARRAY_BUFFER, mesh->VBO);
+		glBufferSubData(GL_ARRAY_BUFFER, offset, count * sizeof(glm::vec3), &level.positions[3 * stream.vertices_done]);
+		if (!level.normals.empty())
+		{
+			GLState::bind_buffer(GL_ARRAY_BUFFER, mesh->NBO);
+			glBufferSubData(GL_ARRAY_BUFFER, offset, count * sizeof(glm::vec3), &level.normals[3 * stream.vertices_done]);
+		}
+		stream.vertices_done += count;
+		budget -= std::min(budget, count * vertex_bytes);
+	}
+	if (stream.vertices_done == added && stream.indices_done < level.indices.size() && budget > 0)
+	{
+		size_t count = std::min(level.indices.size() - stream.indices_done, std::max<size_t>(1, budget / sizeof(GLuint)));
+		// The element array binding belongs to the VAO
+		GLState::bind_vertex_array(mesh->VAO);
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, (GLintptr)((stream.first_index[level.level] + stream.indices_done) * sizeof(GLuint)),
+			count * sizeof(GLuint), &level.indices[stream.indices_done]);
+		stream.indices_done += count;
+		budget -= std::min(budget, count * sizeof(GLuint));
+	}
+	return stream.vertices_done == added && stream.indices_done == level.indices.size();
+}
+
+static void show_level(MeshStream& stream, uint32_t level)
+{
+	stream.shown = level;
+	stream.mesh->index_first = stream.first_index[level];
+	stream.mesh->index_count = (GLsizei)stream.levels[level].index_count;
+}
+
+static void close_stream(size_t i)
+{
+	MeshStream* stream = stream_meshes[i];
+	stream->stop = true;
+	if (stream->reader.joinable())
+		stream->reader.join();
+	for (size_t j = 0; j < stream->decoded.size(); j++)
+		delete stream->decoded[j];
+	delete stream;
+	stream_meshes.erase(stream_meshes.begin() + i);
+}
+
+bool MeshStreamer::open(Mesh* mesh)
+{
+	if (!enabled)
+		return false;
+	MeshStream* stream = new MeshStream();
+	stream->start = std::chrono::steady_clock::now();
+	if (!MeshCodec::is_mesh_file(mesh->path.c_str())
+		|| !MeshCodec::read_levels(mesh->path.c_str(), stream->info, stream->levels) || stream->info.index_count == 0)
+	{
+		delete stream;
+		return false;
+	}
+	cancel(mesh);
+	stream->mesh = mesh;
+	stream->path = mesh->path;
+	stream->stop = false;
+	stream->failed = false;
+	stream->vertices_done = stream->indices_done = 0;
+	stream->frames = 0;
+
+	// The base level is read right away, the rest in the background
+	DecodedLevel base;
+	FILE* fp = fopen(stream->path.c_str(), "rb");
+	bool read = fp != NULL && read_level(fp, *stream, 0, base);
+	if (fp != NULL)
+		fclose(fp);
+	if (!read)
+	{
+		fprintf(stderr, "%s is corrupt\n", stream->path.c_str());
+		delete stream;
+		return false;
+	}
+
+	// Every level's triangles get their own range, so none is overwritten while it may be drawn
+	size_t total_indices = 0;
+	for (size_t l = 0; l < stream->levels.size(); l++)
+	{
+		stream->first_index.push_back(total_indices);
+		total_indices += stream->levels[l].index_count;
+	}
+	size_t vertex_count = stream->info.vertex_count;
+	mesh->create_buffers(vertex_count, stream->info.has_normals ? vertex_count : 0, total_indices, NULL, NULL, NULL);
+	size_t unlimited = (size_t)-1;
+	upload_level(*stream, base, unlimited);
+	show_level(*stream, 0);
+	mesh->bounds_min = stream->info.bounds_min;
+	mesh->bounds_max = stream->info.bounds_max;
+	mesh->hash = stream->info.hash;
+	stream->vertices_done = stream->indices_done = 0;
+
+	double ms = elapsed_ms(stream->start);
+	stream_stats.opened++;
+	stream_stats.base_ms = std::max(stream_stats.base_ms, ms);
+	printf("Streaming %s: base of %u triangles ready in %.1f ms, %d finer levels to go\n", stream->path.c_str(),
+		stream->levels[0].index_count / 3, ms, (int)stream->levels.size() - 1);
+	if (stream->levels.size() == 1)
+	{
+		delete stream;
+		return true;
+	}
+	stream->reader = std::thread(read_levels, stream);
+	stream_meshes.push_back(stream);
+	return true;
+}
+
+void MeshStreamer::update()
+{
+	TRACE_SCOPE("MeshStreamer::update");
+	for (size_t i = 0; i < stream_meshes.size();)
+	{
+		MeshStream& stream = *stream_meshes[i];
+		stream.frames++;
+		size_t budget = bytes_per_frame;
+		bool finished = false;
+		while (budget > 0 && !finished)
+		{
+			DecodedLevel* level = NULL;
+			{
+				std::lock_guard<std::mutex> guard(stream.lock);
+				if (!stream.decoded.empty())
+					level = stream.decoded.front();
+			}
+			if (level == NULL || !upload_level(stream, *level, budget))
+				break;
+
+			show_level(stream, level->level);
+			finished = level->level + 1 == stream.levels.size();
+			stream.vertices_done = stream.indices_done = 0;
+			{
+				std::lock_guard<std::mutex> guard(stream.lock);
+				stream.decoded.pop_front();
+			}
+			delete level;
+		}
+
+		bool stalled = false;
+		if (!finished && stream.failed)
+		{
+			std::lock_guard<std::mutex> guard(stream.lock);
+			stalled = stream.decoded.empty();
+		}
+		if (finished)
+		{
+			double ms = elapsed_ms(stream.start);
+			stream_stats.finished++;
+			stream_stats.full_ms = std::max(stream_stats.full_ms, ms);
+			printf("Streamed %s: full detail after %.0f ms and %d frames\n", stream.path.c_str(), ms, stream.frames);
+		}
+		else if (stalled)
+			fprintf(stderr, "%s is corrupt, stopped streaming at level %u of %d\n", stream.path.c_str(), stream.shown,
+				(int)stream.levels.size() - 1);
+		if (finished || stalled)
+			close_stream(i);
+		else
+			i++;
+	}
+}
+
+void MeshStreamer::cancel(Mesh* mesh)
+{
+	for (size_t i = 0; i < stream_meshes.size(); i++)
+	{
+		if (stream_meshes[i]->mesh == mesh)
+		{
+			close_stream(i);
+			return;
+		}
+	}
+}
+
+std::string MeshStreamer::overlay_text()
+{
+	if (stream_meshes.empty())
+		return std::string();
+	const MeshStream& stream = *stream_meshes[0];
+	char text[128];
+	snprintf(text, sizeof(text), "streaming level %u/%d", stream.shown, (int)stream.levels.size() - 1);
+	return text;
+}
+
+void MeshStreamer::print_summary()
+{
+	if (stream_stats.opened == 0)
+		return;
+	printf("Mesh streaming: %d meshes, base shown within %.1f ms, %d at full detail within %.0f ms\n", stream_stats.opened,
+		stream_stats.base_ms, stream_stats.finished, stream_stats.full_ms);
+}
+
+void MeshStreamer::clean_up()
+{
+	while (!stream_meshes.empty())
+		close_stream(stream_meshes.size() - 1);
+}
@@ -0,0 +1,31 @@
+#ifndef _MESHSTREAMER_H_
+#define _MESHSTREAMER_H_
+
+#include "Mesh.h"
+#include <string>
+
+// Shows progressive .mesh files (obj2mesh --progressive) long before they are fully loaded. Opening
+// one uploads only its small base level, so it is drawn from the next frame on whatever the size of
+// the full mesh. A background thread reads and decodes the finer levels, and every frame copies at
+// most bytes_per_frame of them into the buffers, which are allocated for all levels up front. A level
+// replaces the one drawn once all of it is in, so frames never wait for a load.
+class MeshStreamer
+{
+public:
+	static size_t bytes_per_frame;
+	// false loads progressive files whole, for stills that must not show a coarse level
+	static bool enabled;
+
+	// Starts streaming mesh->path into new GL buffers of mesh. False if it is not a progressive file.
+	static bool open(Mesh* mesh);
+	// Uploads what the background threads have decoded, needs the GL context. Call before drawing.
+	static void update();
+	// Stops streaming mesh, before its buffers or the mesh are freed
+	static void cancel(Mesh* mesh);
+
+	static std::string overlay_text();
+	static void print_summary();
+	static void clean_up();
+};
+
+#endif
@@ -14,24 +14,46 @@
 #endif
 #include <glm/mat4x4.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-#include <vector>
+#include <memory>
+#include "Mesh.h"
+
+// Uniform block binding point of the per-draw data. Every block is bound to 0 at link time,
+// so the shaders need no glUniformBlockBinding.
+const GLuint DRAW_DATA_BINDING = 0;
+
+// The DrawData block of shader.vert and shader.frag in std140 layout, written to the uniform ring
+// once per draw. The depth pre-pass and fallback shaders declare only the matrices.
+struct DrawUniforms {
+	glm::mat4 projection;
+	glm::mat4 modelview;
+	glm::mat4 model;
+	glm::mat4 view;
+	// Material, a vec3 takes 16 bytes unless a float follows it
+	glm::vec3 ambient;
+	float pad0;
+	glm::vec3 diffuse;
+	float pad1;
+	glm::vec3 specular;
+	float shininess;
+};
 
 class OBJObject
 {
 public:
 	// Constructors
 	OBJObject();
-	OBJObject(const char* filepath);
+	// upload = false only parses, for renderers that don't use the GL buffers. mesh stays null if
+	// the file cannot be read.
+	OBJObject(const char* filepath, bool upload = true);
 	OBJObject(bool cube);
 	~OBJObject();
 
 	// toWorld vector
-	glm::mat4 toWorld;
+	glm::mat4 toWorld = glm::mat4(1.0f);
 
-	// Containers
-	std::vector<GLuint> indices;
-	std::vector<glm::vec3> vertices;
-	std::vector<glm::vec3> normals;
+	// Geometry, shared with every other object loaded from the same file or with the same
+	// content. The material and transform below belong to this object alone.
+	std::shared_ptr<Mesh> mesh;
 
 	// Colors
 	glm::vec3 object_color = { 0.11f, 0.1f, 0.91f };
@@ -42,9 +64,12 @@ public:
 	int shininess = 32;
 
 	void initialize();
-	void parse(const char* filepath);
 
 	void draw(GLuint);
+	// Draws with explicit matrices instead of toWorld and the Window camera, e.g. from a scene snapshot
+	void draw(GLuint shaderProgram, const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection);
+	// Binds the DrawData block of one draw, for drawing the mesh some other way. false if it did not fit.
+	bool bind_uniforms(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection);
 	void update();
 	void spin(float);
 	void translate(float x, float y, float z);
@@ -58,10 +83,5 @@ public:
 	void setDiffuse(float r, float g, float b);
 	void setSpecular(float r, float g, float b);
 	void setShininess(int number);
-
-
-	// These variables are needed for the shader program
-	GLuint VBO, VAO, EBO, NBO;
-	GLuint uProjection, uModelview, uModel, uView, uLight, uColor, uDiffuse, uSpecular, uShininess;
 };
 #endif
\ No newline at end of file
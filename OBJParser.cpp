@@ -0,0 +1,226 @@
+#define _CRT_SECURE_NO_DEPRECATE
+#include "OBJParser.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <cfloat>
+#include <string.h>
+#include <algorithm>
+
+// Position index of a face corner such as "7", "7/3", "7//5" or "7/3/5"
+static unsigned int face_index(const char* corner)
+{
+	return (unsigned int)strtoul(corner, NULL, 10) - 1;
+}
+
+bool OBJParser::parse(const char* filepath, std::vector<glm::vec3>& vertices, std::vector<glm::vec3>& normals,
+	std::vector<unsigned int>& indices, glm::vec3& min, glm::vec3& max)
+{
+	FILE* fp;     // file pointer
+	float x = 0.0f, y = 0.0f, z = 0.0f;  // vertex coordinates
+	char corner1[64], corner2[64], corner3[64]; // face corners
+	char line[1024];
+	int malformed = 0;  // lines that looked like data but did not parse
+
+	min = glm::vec3(FLT_MAX);
+	max = glm::vec3(-FLT_MAX);
+
+	fp = fopen(filepath, "rb");
+	if (fp == NULL) {
+		fprintf(stderr, "error loading file %s\n", filepath);
+		return false;
+	}  // just in case the file can't be found or is corrupt
+
+	// One line at a time, so comments and unknown statements are skipped whole
+	// and nothing inside them is mistaken for data
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		size_t length = strlen(line);
+		if (length == sizeof(line) - 1 && line[length - 1] != '\n') {
+			// Drop the rest of a line too long for the buffer; only its start is used
+			int c;
+			while ((c = fgetc(fp)) != '\n' && c != EOF) {}
+		}
+		if (line[0] == '#')
+			continue;
+
+		// Check if line is a vertex
+		if (line[0] == 'v' && (line[1] == ' ' || line[1] == '\t'))
+		{
+			if (sscanf(line + 2, "%f %f %f", &x, &y, &z) != 3) {
+				malformed++;
+				continue;
+			}
+			vertices.push_back(glm::vec3(x, y, z));
+
+			if (x > max.x) max.x = x;
+			if (x < min.x) min.x = x;
+			if (y > max.y) max.y = y;
+			if (y < min.y) min.y = y;
+			if (z > max.z) max.z = z;
+			if (z < min.z) min.z = z;
+		}
+
+		// read normal data accordingly
+		else if (line[0] == 'v' && line[1] == 'n' && (line[2] == ' ' || line[2] == '\t'))
+		{
+			if (sscanf(line + 3, "%f %f %f", &x, &y, &z) != 3) {
+				malformed++;
+				continue;
+			}
+			normals.push_back(glm::vec3(x, y, z));
+		}
+
+		else if (line[0] == 'f' && (line[1] == ' ' || line[1] == '\t')) {
+			if (sscanf(line + 2, "%63s %63s %63s", corner1, corner2, corner3) != 3) {
+				malformed++;
+				continue;
+			}
+			indices.push_back(face_index(corner1));
+			indices.push_back(face_index(corner2));
+			indices.push_back(face_index(corner3));
+		}
+	}
+	if (malformed > 0)
+		fprintf(stderr, "%s: skipped %d malformed lines\n", filepath, malformed);
+	fclose(fp);   // make sure you don't forget to close the file when done
+	return true;
+}
+
+void OBJParser::normalize(std::vector<glm::vec3>& vertices, const glm::vec3& min, const glm::vec3& max)
+{
+	float avg_x = (max.x - min.x) / 2;
+	float avg_y = (max.y - min.y) / 2;
+	float avg_z = (max.z - min.z) / 2;
+	float size;
+
+	if (max.x - min.x > max.y - min.y)
+		size = max.x - min.x;
+	else {
+		size = max.y - min.y;
+	}
+	if (max.z - min.z > size) {
+		size = max.z - min.z;
+	}
+
+	for (size_t i = 0; i < vertices.size(); i++) {
+		vertices[i][0] = (vertices[i][0] - avg_x) / size;
+		vertices[i][1] = (vertices[i][1] - avg_y) / size;
+		vertices[i][2] = (vertices[i][2] - avg_z) / size;
+	}
+}
+
+// Large enough that the longest line fits many times over
+static const size_t POINT_BUFFER_SIZE = 1 << 20;
+
+// Points sampled at the start of a file to tell 0 to 255 colors from 0 to 1 ones, a batch of PointOctree
+static const size_t COLOR_SAMPLE_POINTS = 1 << 20;
+
+bool OBJPointReader::open(const char* filepath)
+{
+	close();
+	fp = fopen(filepath, "rb");
+	if (fp == NULL) {
+		fprintf(stderr, "error loading file %s\n", filepath);
+		return false;
+	}
+	buffer.resize(POINT_BUFFER_SIZE + 1);
+	used = filled = 0;
+
+	// One scale for the whole file, since a dark point of a 0 to 255 scan like "0 1 1" reads as well
+	// as a bright 0 to 1 one
+	float values[6];
+	float brightest = 0.0f;
+	for (size_t i = 0; i < COLOR_SAMPLE_POINTS; i++)
+	{
+		int found = next_point(values);
+		if (found == 0)
+			break;
+		if (found == 6)
+			brightest = std::max(brightest, std::max(values[3], std::max(values[4], values[5])));
+	}
+	color_scale = brightest > 1.0f ? 1.0f / 255.0f : 1.0f;
+	rewind(fp);
+	used = filled = 0;
+	return true;
+}
+
+void OBJPointReader::close()
+{
+	if (fp != NULL)
+		fclose(fp);
+	fp = NULL;
+}
+
+uint32_t OBJPointReader::pack_color(float r, float g, float b, float scale)
+{
+	float channels[3] = { r, g, b };
+	uint32_t packed = 0xff000000u;
+	for (int i = 0; i < 3; i++)
+	{
+		float value = channels[i] * scale;
+		packed |= (uint32_t)(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f) << (8 * i);
+	}
+	return packed;
+}
+
+int OBJPointReader::next_point(float values[6])
+{
+	for (;;)
+	{
+		char* line = &buffer[used];
+		char* end = (char*)memchr(line, '\n', filled - used);
+		if (end == NULL)
+		{
+			// Keep the partial line and fill the rest of the buffer behind it
+			size_t partial = filled - used;
+			if (partial == POINT_BUFFER_SIZE)
+				partial = 0;		// A line this long is no point, drop it
+			memmove(&buffer[0], line, partial);
+			used = 0;
+			filled = partial + fread(&buffer[partial], 1, POINT_BUFFER_SIZE - partial, fp);
+			if (filled == partial)
+			{
+				// The last line may have no newline
+				if (partial == 0)
+					return 0;
+				buffer[filled++] = '\n';
+			}
+			continue;
+		}
+		*end = '\0';
+		used = end + 1 - &buffer[0];
+		if (line[0] != 'v' || (line[1] != ' ' && line[1] != '\t'))
+			continue;
+
+		int found = 0;
+		char* next = line + 2;
+		for (; found < 6; found++)
+		{
+			char* after;
+			values[found] = strtof(next, &after);
+			if (after == next)
+				break;
+			next = after;
+		}
+		if (found >= 3)
+			return found;
+	}
+}
+
+size_t OBJPointReader::read(std::vector<glm::vec3>& positions, std::vector<uint32_t>& colors, size_t max)
+{
+	size_t count = 0;
+	float values[6];
+	while (fp != NULL && count < max)
+	{
+		int found = next_point(values);
+		if (found == 0)
+		{
+			close();
+			break;
+		}
+		positions.push_back(glm::vec3(values[0], values[1], values[2]));
+		colors.push_back(found == 6 ? pack_color(values[3], values[4], values[5], color_scale) : 0xffffffffu);
+		count++;
+	}
+	return count;
+}
@@ -0,0 +1,54 @@
+#ifndef _OBJPARSER_H_
+#define _OBJPARSER_H_
+
+// Use of degrees is deprecated. Use radians instead.
+#ifndef GLM_FORCE_RADIANS
+#define GLM_FORCE_RADIANS
+#endif
+#include <glm/vec3.hpp>
+#include <vector>
+#include <stdio.h>
+#include <stdint.h>
+
+// The file reading half of OBJObject. Needs no GL context, so benchmarks and tools can link it on its own.
+class OBJParser
+{
+public:
+	// Appends positions, normals and zero based position indices of the triangles in filepath.
+	// Faces may be written as v, v/vt, v//vn or v/vt/vn. min and max receive the bounds of the positions.
+	static bool parse(const char* filepath, std::vector<glm::vec3>& vertices, std::vector<glm::vec3>& normals,
+		std::vector<unsigned int>& indices, glm::vec3& min, glm::vec3& max);
+
+	// Centers and scales the positions by their largest extent, the way the viewer places every model
+	static void normalize(std::vector<glm::vec3>& vertices, const glm::vec3& min, const glm::vec3& max);
+};
+
+// Reads the "v" lines of an OBJ file a batch at a time, for point clouds too large to hold in memory.
+// Scanners often write "v x y z r g b"; the colors are kept, packed as RGBA8, and points without one
+// are white. The colors of a file are taken to be 0 to 255 if any channel of its first million
+// points is above 1, and 0 to 1 otherwise.
+class OBJPointReader
+{
+public:
+	OBJPointReader() : fp(NULL), used(0), filled(0), color_scale(1.0f) {}
+	~OBJPointReader() { close(); }
+
+	bool open(const char* filepath);
+	// Appends up to max points and returns how many, 0 at the end of the file
+	size_t read(std::vector<glm::vec3>& positions, std::vector<uint32_t>& colors, size_t max);
+	void close();
+
+	// RGBA8 of channels multiplied by scale
+	static uint32_t pack_color(float r, float g, float b, float scale);
+
+private:
+	FILE* fp;
+	std::vector<char> buffer;
+	size_t used, filled;		// Parsed and valid bytes of buffer
+	float color_scale;			// 1 / 255 for 0 to 255 colors
+
+	// Values of the next point, 3 or with a color 6, and 0 at the end of the file
+	int next_point(float values[6]);
+};
+
+#endif
@@ -0,0 +1,478 @@
+#define _CRT_SECURE_NO_DEPRECATE
+#include "OcclusionCuller.h"
+#include "shader.h"
+#include "GLState.h"
+#include "QueryRing.h"
+#include "ScreenSize.h"
+#include <stdio.h>
+#include <vector>
+#include <algorithm>
+
+bool OcclusionCuller::enabled = false;
+int OcclusionCuller::debug_level = -1;
+
+struct CullFrame {
+	bool pending;
+	QueryPool pool;				// One query per object tested
+};
+
+QueryRing<CullFrame, OcclusionCuller::FRAME_LATENCY> cull_ring;
+
+// Full resolution single sample copy of the depth buffer, in the format of the depth buffer
+// because glBlitFramebuffer cannot convert depth
+GLuint cull_source_fbo = 0, cull_source = 0;
+GLenum cull_source_format = 0;
+int cull_source_width = 0, cull_source_height = 0;
+
+// R32F mip chain at half resolution and below, one framebuffer per level
+GLuint cull_pyramid = 0;
+std::vector<GLuint> cull_level_fbos;
+int cull_levels = 0;			// 0 until a pyramid has been built, so nothing is culled against garbage
+int cull_pyramid_width = 0, cull_pyramid_height = 0;
+
+GLuint cull_reduce_program = 0, cull_test_program = 0, cull_debug_program = 0, cull_vao = 0;
+GLint cull_uReduceSource, cull_uReduceLevel;
+GLint cull_uTestMvp, cull_uTestMin, cull_uTestMax, cull_uTestPyramid, cull_uTestLevels;
+GLint cull_uDebugPyramid, cull_uDebugLevel;
+GLuint cull_program_before = 0;
+
+// Set by rewind: the next objects reuse the queries of the frame from cull_replay_next on
+bool cull_replay = false;
+size_t cull_replay_next = 0;
+bool cull_conditional = false;
+
+// This frame so far, and the latest frame read back
+int cull_frustum_culled = 0;
+int cull_last_tested = 0, cull_last_occluded = 0, cull_last_frustum = 0;
+long long cull_total_tested = 0, cull_total_occluded = 0, cull_total_frustum = 0;
+int cull_frames_counted = 0;
+
+static const char* FullscreenVertexShader =
+	"#version 330 core\n"
+	"void main()\n"
+	"{\n"
+	"    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);\n"
+	"    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);\n"
+	"}\n";
+
+// Farthest depth of the 2x2 source texels under each texel. At odd source sizes the last
+// texel in a row or column also takes the third one, so nothing is left out.
+static const char* ReduceFragmentShader =
+	"#version 330 core\n"
+	"uniform sampler2D source;\n"
+	"uniform int level;\n"
+	"out float depth;\n"
+	"void main()\n"
+	"{\n"
+	"    ivec2 size = textureSize(source, level);\n"
+	"    ivec2 base = ivec2(gl_FragCoord.xy) * 2;\n"
+	"    ivec2 extra = ivec2(equal(base + 3, size));\n"
+	"    float farthest = 0.0;\n"
+	"    for (int y = 0; y <= 1 + extra.y; y++)\n"
+	"        for (int x = 0; x <= 1 + extra.x; x++)\n"
+	"            farthest = max(farthest, texelFetch(source, min(base + ivec2(x, y), size - 1), level).r);\n"
+	"    depth = farthest;\n"
+	"}\n";
+
+// One point per object, placed inside the viewport when the box may be visible and outside
+// otherwise, so the occlusion query counts a sample only for visible objects
+static const char* TestVertexShader =
+	"#version 330 core\n"
+	"uniform mat4 mvp;\n"
+	"uniform vec3 box_min;\n"
+	"uniform vec3 box_max;\n"
+	"uniform sampler2D pyramid;\n"
+	"uniform int levels;\n"
+	"void main()\n"
+	"{\n"
+	"    vec3 lo = vec3(1.0);\n"
+	"    vec3 hi = vec3(-1.0);\n"
+	"    bool crosses_near = false;\n"
+	"    for (int i = 0; i < 8; i++)\n"
+	"    {\n"
+	"        vec3 corner = mix(box_min, box_max, vec3(i & 1, (i >> 1) & 1, (i >> 2) & 1));\n"
+	"        vec4 clip = mvp * vec4(corner, 1.0);\n"
+	"        if (clip.w <= 0.0)\n"
+	"            crosses_near = true;\n"
+	"        vec3 ndc = clip.xyz / clip.w;\n"
+	"        lo = i == 0 ? ndc : min(lo, ndc);\n"
+	"        hi = i == 0 ? ndc : max(hi, ndc);\n"
+	"    }\n"
+	"    bool visible = true;\n"
+	"    if (!crosses_near && levels > 0)\n"
+	"    {\n"
+	"        vec2 uv_lo = clamp(lo.xy * 0.5 + 0.5, 0.0, 1.0);\n"
+	"        vec2 uv_hi = clamp(hi.xy * 0.5 + 0.5, 0.0, 1.0);\n"
+	"        vec2 extent = (uv_hi - uv_lo) * vec2(textureSize(pyramid, 0));\n"
+	"        // At this level the box spans at most one texel, so it touches at most 2x2\n"
+	"        int level = clamp(int(ceil(log2(max(max(extent.x, extent.y), 1.0)))), 0, levels - 1);\n"
+	"        ivec2 size = textureSize(pyramid, level);\n"
+	"        ivec2 a = clamp(ivec2(uv_lo * vec2(size)), ivec2(0), size - 1);\n"
+	"        ivec2 b = clamp(ivec2(uv_hi * vec2(size)), ivec2(0), size - 1);\n"
+	"        float farthest = max(max(texelFetch(pyramid, a, level).r, texelFetch(pyramid, ivec2(b.x, a.y), level).r),\n"
+	"            max(texelFetch(pyramid, ivec2(a.x, b.y), level).r, texelFetch(pyramid, b, level).r));\n"
+	"        visible = lo.z * 0.5 + 0.5 <= farthest;\n"
+	"    }\n"
+	"    gl_Position = visible ? vec4(0.0, 0.0, 0.0, 1.0) : vec4(2.0, 2.0, 2.0, 1.0);\n"
+	"}\n";
+
+static const char* TestFragmentShader =
+	"#version 330 core\n"
+	"out vec4 color;\n"
+	"void main()\n"
+	"{\n"
+	"    color = vec4(1.0);\n"
+	"}\n";
+
+// Depth is mostly close to 1 with a perspective projection, stretch it to be readable
+static const char* DebugFragmentShader =
+	"#version 330 core\n"
+	"uniform sampler2D pyramid;\n"
+	"uniform int level;\n"
+	"out vec4 color;\n"
+	"void main()\n"
+	"{\n"
+	"    ivec2 size = textureSize(pyramid, level);\n"
+	"    vec2 uv = gl_FragCoord.xy / vec2(textureSize(pyramid, 0) * 2);\n"
+	"    float depth = texelFetch(pyramid, min(ivec2(uv * vec2(size)), size - 1), level).r;\n"
+	"    color = vec4(vec3(pow(depth, 64.0)), 1.0);\n"
+	"}\n";
+
+static void create_programs()
+{
+	cull_reduce_program = LoadShaderSource(FullscreenVertexShader, ReduceFragmentShader, "hi-z reduce");
+	cull_uReduceSource = glGetUniformLocation(cull_reduce_program, "source");
+	cull_uReduceLevel = glGetUniformLocation(cull_reduce_program, "level");
+	cull_test_program = LoadShaderSource(TestVertexShader, TestFragmentShader, "hi-z test");
+	cull_uTestMvp = glGetUniformLocation(cull_test_program, "mvp");
+	cull_uTestMin = glGetUniformLocation(cull_test_program, "box_min");
+	cull_uTestMax = glGetUniformLocation(cull_test_program, "box_max");
+	cull_uTestPyramid = glGetUniformLocation(cull_test_program, "pyramid");
+	cull_uTestLevels = glGetUniformLocation(cull_test_program, "levels");
+	cull_debug_program = LoadShaderSource(FullscreenVertexShader, DebugFragmentShader, "hi-z debug");
+	cull_uDebugPyramid = glGetUniformLocation(cull_debug_program, "pyramid");
+	cull_uDebugLevel = glGetUniformLocation(cull_debug_program, "level");
+	// Core profiles need a vertex array object bound even without attributes
+	glGenVertexArrays(1, &cull_vao);
+}
+
+static void delete_targets()
+{
+	if (cull_source_fbo != 0)
+	{
+		GLState::delete_framebuffers(1, &cull_source_fbo);
+		GLState::delete_textures(1, &cull_source);
+		cull_source_fbo = cull_source = 0;
+	}
+	if (cull_pyramid != 0)
+	{
+		GLState::delete_framebuffers((GLsizei)cull_level_fbos.size(), cull_level_fbos.data());
+		GLState::delete_textures(1, &cull_pyramid);
+		cull_level_fbos.clear();
+		cull_pyramid = 0;
+	}
+	cull_levels = 0;
+	cull_source_width = cull_source_height = 0;
+}
+
+// Depth formats of the read framebuffer, which the copy has to match
+static GLenum depth_format()
+{
+	GLuint read = GLState::get_framebuffer(GL_READ_FRAMEBUFFER);
+	GLenum attachment = read == 0 ? GL_DEPTH : GL_DEPTH_ATTACHMENT;
+	GLint depth_bits = 24, stencil_bits = 0, type = GL_UNSIGNED_NORMALIZED;
+	glGetFramebufferAttachmentParameteriv(GL_READ_FRAMEBUFFER, attachment, GL_FRAMEBUFFER_ATTACHMENT_DEPTH_SIZE, &depth_bits);
+	glGetFramebufferAttachmentParameteriv(GL_READ_FRAMEBUFFER, attachment, GL_FRAMEBUFFER_ATTACHMENT_COMPONENT_TYPE, &type);
+	if (read == 0)
+		glGetFramebufferAttachmentParameteriv(GL_READ_FRAMEBUFFER, GL_STENCIL, GL_FRAMEBUFFER_ATTACHMENT_STENCIL_SIZE, &stencil_bits);
+	else
+	{
+		GLint object_type = GL_NONE;
+		glGetFramebufferAttachmentParameteriv(GL_READ_FRAMEBUFFER, GL_STENCIL_ATTACHMENT, GL_FRAMEBUFFER_ATTACHMENT_OBJECT_TYPE, &object_type);
+		if (object_type != GL_NONE)
+			glGetFramebufferAttachmentParameteriv(GL_READ_FRAMEBUFFER, GL_STENCIL_ATTACHMENT, GL_FRAMEBUFFER_ATTACHMENT_STENCIL_SIZE, &stencil_bits);
+	}
+
+	if (type == GL_FLOAT)
+		return stencil_bits > 0 ? GL_DEPTH32F_STENCIL8 : GL_DEPTH_COMPONENT32F;
+	if (stencil_bits > 0)
+		return GL_DEPTH24_STENCIL8;
+	return depth_bits <= 16 ? GL_DEPTH_COMPONENT16 : GL_DEPTH_COMPONENT24;
+}
+
+static void create_targets(int width, int height, GLenum format)
+{
+	delete_targets();
+	cull_source_width = width;
+	cull_source_height = height;
+	cull_source_format = format;
+
+	glGenTextures(1, &cull_source);
+	GLState::bind_texture(GL_TEXTURE_2D, cull_source);
+	bool stencil = format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+	GLenum type = format == GL_DEPTH24_STENCIL8 ? GL_UNSIGNED_INT_24_8 : format == GL_DEPTH32F_STENCIL8 ?
+		GL_FLOAT_32_UNSIGNED_INT_24_8_REV : format == GL_DEPTH_COMPONENT32F ? GL_FLOAT : GL_UNSIGNED_INT;
+	glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, stencil ? GL_DEPTH_STENCIL : GL_DEPTH_COMPONENT, type, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	glGenFramebuffers(1, &cull_source_fbo);
+	GLState::bind_framebuffer(GL_FRAMEBUFFER, cull_source_fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, stencil ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, cull_source, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+
+	cull_pyramid_width = std::max(1, width / 2);
+	cull_pyramid_height = std::max(1, height / 2);
+	int levels = 1;
+	while ((cull_pyramid_width >> levels) > 0 || (cull_pyramid_height >> levels) > 0)
+		levels++;
+	glGenTextures(1, &cull_pyramid);
+	GLState::bind_texture(GL_TEXTURE_2D, cull_pyramid);
+	for (int level = 0; level < levels; level++)
+		glTexImage2D(GL_TEXTURE_2D, level, GL_R32F, std::max(1, cull_pyramid_width >> level),
+			std::max(1, cull_pyramid_height >> level), 0, GL_RED, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+	cull_level_fbos.resize(levels);
+	glGenFramebuffers(levels, cull_level_fbos.data());
+	for (int level = 0; level < levels; level++)
+	{
+		GLState::bind_framebuffer(GL_FRAMEBUFFER, cull_level_fbos[level]);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, cull_pyramid, level);
+	}
+	GLState::bind_texture(GL_TEXTURE_2D, 0);
+}
+
+static bool frame_ready(const CullFrame& frame)
+{
+	return query_ready(frame.pool.last());
+}
+
+static void read_frame(const CullFrame& frame)
+{
+	int occluded = 0;
+	for (size_t q = 0; q < frame.pool.used; q++)
+	{
+		GLuint passed = 0;
+		glGetQueryObjectuiv(frame.pool.queries[q], GL_QUERY_RESULT, &passed);
+		if (passed == 0)
+			occluded++;
+	}
+	cull_last_tested = (int)frame.pool.used;
+	cull_last_occluded = occluded;
+	cull_total_tested += frame.pool.used;
+	cull_total_occluded += occluded;
+	cull_frames_counted++;
+}
+
+void OcclusionCuller::begin_frame()
+{
+	if (!enabled)
+		return;
+	if (cull_test_program == 0)
+		create_programs();
+
+	CullFrame& frame = cull_ring.advance(frame_ready, read_frame);
+	frame.pool.used = 0;
+	cull_replay = false;
+	cull_last_frustum = cull_frustum_culled;
+	cull_total_frustum += cull_frustum_culled;
+	cull_frustum_culled = 0;
+}
+
+bool OcclusionCuller::begin_object(const glm::vec3& min, const glm::vec3& max, const glm::mat4& model_view_projection)
+{
+	if (!enabled)
+		return true;
+	if (outside_frustum(min, max, model_view_projection))
+	{
+		if (!cull_replay)
+			cull_frustum_culled++;
+		return false;
+	}
+
+	QueryPool& pool = cull_ring.now().pool;
+	if (cull_replay)
+	{
+		cull_conditional = cull_replay_next < pool.used;
+		if (cull_conditional)
+			glBeginConditionalRender(pool.queries[cull_replay_next++], GL_QUERY_WAIT);
+		return true;
+	}
+	GLuint query = pool.next();
+
+	cull_program_before = GLState::get_program();
+	GLState::use_program(cull_test_program);
+	glUniformMatrix4fv(cull_uTestMvp, 1, GL_FALSE, &model_view_projection[0][0]);
+	glUniform3f(cull_uTestMin, min.x, min.y, min.z);
+	glUniform3f(cull_uTestMax, max.x, max.y, max.z);
+	glUniform1i(cull_uTestLevels, cull_levels);
+	glUniform1i(cull_uTestPyramid, 0);
+	GLState::active_texture(GL_TEXTURE0);
+	GLState::bind_texture(GL_TEXTURE_2D, cull_pyramid);
+
+	// The test point must not touch the image or be hidden by it. A depth pre-pass may have
+	// masked color or depth already.
+	GLboolean color_mask[4], depth_mask;
+	GLState::get_color_mask(color_mask);
+	depth_mask = GLState::get_depth_mask();
+	GLState::color_mask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	GLState::depth_mask(GL_FALSE);
+	GLState::disable(GL_DEPTH_TEST);
+	glBeginQuery(GL_ANY_SAMPLES_PASSED, query);
+	GLState::bind_vertex_array(cull_vao);
+	glDrawArrays(GL_POINTS, 0, 1);
+	glEndQuery(GL_ANY_SAMPLES_PASSED);
+	GLState::enable(GL_DEPTH_TEST);
+	GLState::depth_mask(depth_mask);
+	GLState::color_mask(color_mask[0], color_mask[1], color_mask[2], color_mask[3]);
+	GLState::bind_texture(GL_TEXTURE_2D, 0);
+	GLState::use_program(cull_program_before);
+
+	// The GPU waits for the query, the CPU moves on
+	glBeginConditionalRender(query, GL_QUERY_WAIT);
+	cull_conditional = true;
+	return true;
+}
+
+void OcclusionCuller::end_object()
+{
+	if (enabled && cull_conditional)
+		glEndConditionalRender();
+	cull_conditional = false;
+}
+
+void OcclusionCuller::rewind()
+{
+	cull_replay = true;
+	cull_replay_next = 0;
+}
+
+static void draw_fullscreen()
+{
+	GLState::bind_vertex_array(cull_vao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+void OcclusionCuller::end_frame()
+{
+	if (!enabled)
+		return;
+
+	GLint viewport[4];
+	GLState::get_viewport(viewport);
+	GLuint draw_before = GLState::get_framebuffer(GL_DRAW_FRAMEBUFFER);
+	GLuint read_before = GLState::get_framebuffer(GL_READ_FRAMEBUFFER);
+	GLuint program_before = GLState::get_program();
+	int width = viewport[2], height = viewport[3];
+	if (width <= 0 || height <= 0)
+		return;
+
+	// Dynamic resolution changes the viewport, which reallocates the pyramid
+	GLenum format = depth_format();
+	if (width != cull_source_width || height != cull_source_height || format != cull_source_format || cull_pyramid == 0)
+	{
+		create_targets(width, height, format);
+		GLState::bind_framebuffer(GL_DRAW_FRAMEBUFFER, draw_before);
+		GLState::bind_framebuffer(GL_READ_FRAMEBUFFER, read_before);
+	}
+
+	// Resolves multisampling too
+	GLState::bind_framebuffer(GL_DRAW_FRAMEBUFFER, cull_source_fbo);
+	glBlitFramebuffer(viewport[0], viewport[1], viewport[0] + width, viewport[1] + height, 0, 0, width, height,
+		GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+	GLState::disable(GL_DEPTH_TEST);
+	GLState::use_program(cull_reduce_program);
+	glUniform1i(cull_uReduceSource, 0);
+	GLState::active_texture(GL_TEXTURE0);
+	int levels = (int)cull_level_fbos.size();
+	for (int level = 0; level < levels; level++)
+	{
+		GLState::bind_framebuffer(GL_DRAW_FRAMEBUFFER, cull_level_fbos[level]);
+		GLState::viewport(0, 0, std::max(1, cull_pyramid_width >> level), std::max(1, cull_pyramid_height >> level));
+		if (level == 0)
+		{
+			GLState::bind_texture(GL_TEXTURE_2D, cull_source);
+			glUniform1i(cull_uReduceLevel, 0);
+		}
+		else
+		{
+			// Only the level being read is visible to the shader, which avoids a feedback loop
+			GLState::bind_texture(GL_TEXTURE_2D, cull_pyramid);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+			glUniform1i(cull_uReduceLevel, level - 1);
+		}
+		draw_fullscreen();
+	}
+	GLState::bind_texture(GL_TEXTURE_2D, cull_pyramid);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+	cull_levels = levels;
+
+	GLState::bind_framebuffer(GL_DRAW_FRAMEBUFFER, draw_before);
+	GLState::bind_framebuffer(GL_READ_FRAMEBUFFER, read_before);
+	GLState::viewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+	if (debug_level >= 0)
+	{
+		GLState::use_program(cull_debug_program);
+		glUniform1i(cull_uDebugPyramid, 0);
+		glUniform1i(cull_uDebugLevel, std::min(debug_level, levels - 1));
+		draw_fullscreen();
+	}
+
+	GLState::bind_texture(GL_TEXTURE_2D, 0);
+	GLState::enable(GL_DEPTH_TEST);
+	GLState::use_program(program_before);
+}
+
+void OcclusionCuller::cycle_debug_view()
+{
+	int levels = std::max(cull_levels, 1);
+	debug_level = debug_level + 1 >= levels ? -1 : debug_level + 1;
+	if (debug_level < 0)
+		printf("Hi-Z debug view off\n");
+	else
+		printf("Hi-Z debug view: level %d of %d\n", debug_level, levels);
+}
+
+std::string OcclusionCuller::overlay_text()
+{
+	if (!enabled)
+		return std::string();
+	char text[96];
+	snprintf(text, sizeof(text), "drawn %d, occluded %d, outside %d", cull_last_tested - cull_last_occluded,
+		cull_last_occluded, cull_last_frustum);
+	return text;
+}
+
+void OcclusionCuller::print_summary()
+{
+	if (cull_frames_counted == 0)
+		return;
+	printf("Occlusion culling over %d frames: %.1f objects drawn, %.1f occluded, %.1f outside the frustum per frame\n",
+		cull_frames_counted, (cull_total_tested - cull_total_occluded) / (double)cull_frames_counted,
+		cull_total_occluded / (double)cull_frames_counted, cull_total_frustum / (double)cull_frames_counted);
+}
+
+void OcclusionCuller::clean_up()
+{
+	delete_targets();
+	for (int i = 0; i < FRAME_LATENCY; i++)
+	{
+		cull_ring.frames[i].pool.clean_up();
+		cull_ring.frames[i].pending = false;
+	}
+	if (cull_test_program != 0)
+	{
+		glDeleteProgram(cull_reduce_program);
+		glDeleteProgram(cull_test_program);
+		glDeleteProgram(cull_debug_program);
+		GLState::delete_vertex_arrays(1, &cull_vao);
+		cull_reduce_program = cull_test_program = cull_debug_program = cull_vao = 0;
+	}
+}
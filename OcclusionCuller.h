@@ -0,0 +1,53 @@
+#ifndef _OCCLUSIONCULLER_H_
+#define _OCCLUSIONCULLER_H_
+
+#define GLFW_INCLUDE_GLEXT
+#ifdef __APPLE__
+#define GLFW_INCLUDE_GLCOREARB
+#else
+#include <GL/glew.h>
+#endif
+#include <GLFW/glfw3.h>
+// Use of degrees is deprecated. Use radians instead.
+#ifndef GLM_FORCE_RADIANS
+#define GLM_FORCE_RADIANS
+#endif
+#include <glm/mat4x4.hpp>
+#include <string>
+
+// Skips objects hidden behind others. After every frame the depth buffer is reduced into a
+// hierarchical depth (Hi-Z) pyramid, where each texel holds the farthest depth of the pixels under it.
+// Objects of the next frame are first tested against the view frustum on the CPU, then a single
+// vertex on the GPU compares the nearest depth of their bounding box with the pyramid level at which
+// the box covers at most 2x2 texels. The test feeds an occlusion query, and the object's draw calls
+// are made conditional on it, so the CPU never waits for the result. The counts are read back
+// FRAME_LATENCY frames later. Objects uncovered by the camera or other objects moving can be missing
+// for one frame, since the pyramid is one frame old.
+class OcclusionCuller
+{
+public:
+	static const int FRAME_LATENCY = 4;
+
+	static bool enabled;
+	static int debug_level;		// Pyramid level drawn over the scene, -1 for none
+
+	static void begin_frame();
+	// false if the box is outside the frustum and the object should be skipped. Otherwise the draw
+	// calls until end_object only happen if the box is not hidden in the pyramid.
+	static bool begin_object(const glm::vec3& min, const glm::vec3& max, const glm::mat4& model_view_projection);
+	static void end_object();
+	// The begin_object calls that follow repeat the ones since begin_frame, in the same order, with
+	// their earlier results instead of new tests, e.g. for the lighting pass after a depth pre-pass
+	static void rewind();
+	// Builds the pyramid for the next frame from the depth of the bound framebuffer and viewport,
+	// and draws the debug view
+	static void end_frame();
+	// Steps the debug view through the pyramid levels and back to off
+	static void cycle_debug_view();
+
+	static std::string overlay_text();
+	static void print_summary();
+	static void clean_up();
+};
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef _PHONG_H_
+#define _PHONG_H_
+
+#include "SimdMath.h"
+#include "OBJObject.h"
+#include "Light.h"
+
+// shader.frag on the CPU, for four fragments at a time. Shared by the CPU renderers so they
+// light scenes exactly like the GL path.
+
+// Everything shader.frag reads from uniforms, expanded to four lanes
+struct PhongParams
+{
+	bool lights_on;
+	int shininess;
+	Float4x3 material_ambient, material_diffuse, material_specular;
+	Float4x3 view_pos;
+	Float4x3 d_dir, d_ambient, d_diffuse, d_specular;	// d_dir points towards the light
+	Float4x3 p_position, p_ambient, p_diffuse, p_specular;
+	Float4x3 s_position, s_dir, s_ambient, s_diffuse, s_specular;
+	Float4 quadratic, cut_off, outer_cut_off;
+};
+
+inline Float4x3 phong_splat(const glm::vec3& v)
+{
+	return Float4x3(v.x, v.y, v.z);
+}
+
+// Same values Light::update and OBJObject::draw send to the shader
+inline PhongParams phong_params(const OBJObject& object, const Light& light)
+{
+	PhongParams params;
+	params.lights_on = light.lights_on == 1;
+	params.shininess = object.shininess;
+	params.material_ambient = phong_splat(object.object_color);
+	params.material_diffuse = phong_splat(object.diffuse);
+	params.material_specular = phong_splat(object.specular);
+	params.view_pos = Float4x3(0.0f, 0.0f, 20.0f);
+	params.d_dir = phong_splat(glm::normalize(-light.d_direction));
+	params.d_ambient = phong_splat(light.d_ambient);
+	params.d_diffuse = phong_splat(light.d_diffuse);
+	params.d_specular = phong_splat(light.d_specular);
+	params.p_position = phong_splat(light.p_position);
+	params.p_ambient = phong_splat(light.light_color * 0.1f);
+	params.p_diffuse = phong_splat(light.light_color);
+	params.p_specular = phong_splat(light.light_color);
+	params.s_position = phong_splat(light.s_position);
+	params.s_dir = phong_splat(glm::normalize(-light.s_direction));
+	params.s_ambient = phong_splat(light.s_ambient);
+	params.s_diffuse = phong_splat(light.s_diffuse);
+	params.s_specular = phong_splat(light.s_specular);
+	params.quadratic = Float4(light.attenuation);
+	params.cut_off = Float4(light.cos_cutOff);
+	params.outer_cut_off = Float4(light.cos_outerCutOff);
+	return params;
+}
+
+// Diffuse and specular of one light, scaled by visible (1 lit, 0 in shadow)
+inline Float4x3 phong_direct(const PhongParams& s, const Float4x3& norm, const Float4x3& view_dir,
+	const Float4x3& light_dir, const Float4x3& diffuse, const Float4x3& specular, Float4 visible)
+{
+	Float4 n_dot_l = dot(norm, light_dir);
+	Float4 diff = max(n_dot_l, Float4(0.0f));
+	Float4x3 reflect_dir = norm * (Float4(2.0f) * n_dot_l) - light_dir;
+	Float4 spec = pow(max(dot(view_dir, reflect_dir), Float4(0.0f)), s.shininess);
+	return (diffuse * s.material_diffuse * diff + specular * s.material_specular * spec) * visible;
+}
+
+// The visibility factors are 1 without shadows. Ambient terms are never shadowed.
+inline Float4x3 phong_shade(const PhongParams& s, const Float4x3& normal, const Float4x3& frag_pos,
+	Float4 visible_d, Float4 visible_p, Float4 visible_s)
+{
+	Float4x3 norm = normalize(normal);
+	if (!s.lights_on)
+		return norm;
+
+	Float4 one(1.0f);
+	Float4x3 view_dir = normalize(s.view_pos - frag_pos);
+
+	// Directional light, modulated by the material's ambient color like in shader.frag
+	Float4x3 result = (s.d_ambient * s.material_diffuse
+		+ phong_direct(s, norm, view_dir, s.d_dir, s.d_diffuse, s.d_specular, visible_d)) * s.material_ambient;
+
+	// Point light
+	Float4x3 to_light = s.p_position - frag_pos;
+	Float4 distance = length(to_light);
+	Float4x3 light_dir = to_light * (one / distance);
+	Float4 attenuation = one / (s.quadratic * (distance * distance));
+	result = result + (s.p_ambient * s.material_diffuse
+		+ phong_direct(s, norm, view_dir, light_dir, s.p_diffuse, s.p_specular, visible_p)) * attenuation;
+
+	// Spot light
+	to_light = s.s_position - frag_pos;
+	distance = length(to_light);
+	light_dir = to_light * (one / distance);
+	attenuation = one / (s.quadratic * (distance * distance));
+	Float4 theta = dot(light_dir, s.s_dir);
+	Float4 intensity = clamp((theta - s.outer_cut_off) / (s.cut_off - s.outer_cut_off), Float4(0.0f), one);
+	result = result + (s.s_ambient * s.material_diffuse
+		+ phong_direct(s, norm, view_dir, light_dir, s.s_diffuse, s.s_specular, visible_s)) * (attenuation * intensity);
+
+	return result;
+}
+
+#endif
@@ -0,0 +1,338 @@
+#define _CRT_SECURE_NO_DEPRECATE
+#include "PointCloud.h"
+#include "PointOctree.h"
+#include "shader.h"
+#include "GLState.h"
+#include "Tracer.h"
+#include "ScreenSize.h"
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <stdio.h>
+#include <vector>
+#include <deque>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <cstddef>
+
+const char* PointCloud::source = NULL;
+size_t PointCloud::point_budget = 3000000;
+
+// Points this far apart on screen need no finer nodes
+static const float MIN_SPACING_PIXELS = 1.0f;
+static const float MAX_POINT_SIZE = 16.0f;
+static const size_t UPLOAD_BYTES_PER_FRAME = 8 * 1024 * 1024;
+
+// Only the main thread changes the state. A node stays NODE_REQUESTED from the request until its
+// upload, including while it waits in pc_read, and goes back to NODE_ON_DISK if reading failed.
+enum NodeState { NODE_ON_DISK, NODE_REQUESTED, NODE_IN_GL };
+
+struct NodeBuffers {
+	NodeState state;
+	GLuint VAO, VBO;
+	unsigned long long last_drawn;
+};
+
+// A node read from disk, waiting for upload
+struct ReadNode {
+	int node;
+	std::vector<OctreePoint> points;
+};
+
+PointOctree pc_tree;
+std::vector<NodeBuffers> pc_nodes;
+GLuint pc_program = 0;
+unsigned long long pc_frame = 0;
+size_t pc_points_in_gl = 0;
+
+// Reader thread, fed the most important missing nodes of the latest frame
+std::thread pc_reader;
+std::mutex pc_lock;
+std::condition_variable pc_wake;
+std::deque<int> pc_requests;
+std::deque<ReadNode*> pc_read;
+bool pc_stop = false;
+
+// Latest frame and totals
+int pc_last_nodes = 0, pc_last_missing = 0;
+size_t pc_last_points = 0;
+double pc_total_points = 0.0;
+int pc_frames = 0;
+
+static const char* PointVertexShader =
+	"#version 330 core\n"
+	"layout (location = 0) in vec3 position;\n"
+	"layout (location = 1) in vec4 color;\n"
+	"uniform mat4 model_view_projection;\n"
+	"uniform float spacing_pixels;\n"
+	"uniform float max_size;\n"
+	"out vec4 point_color;\n"
+	"void main()\n"
+	"{\n"
+	"    gl_Position = model_view_projection * vec4(position.x, position.y, position.z, 1.0);\n"
+	"    gl_PointSize = clamp(spacing_pixels / gl_Position.w, 1.0, max_size);\n"
+	"    point_color = color;\n"
+	"}\n";
+
+// Round splats
+static const char* PointFragmentShader =
+	"#version 330 core\n"
+	"in vec4 point_color;\n"
+	"out vec4 color;\n"
+	"void main()\n"
+	"{\n"
+	"    vec2 offset = gl_PointCoord * 2.0 - 1.0;\n"
+	"    if (dot(offset, offset) > 1.0)\n"
+	"        discard;\n"
+	"    color = vec4(point_color.rgb, 1.0);\n"
+	"}\n";
+
+static void read_nodes()
+{
+	Tracer::name_thread("point reader");
+	FILE* fp = fopen(pc_tree.file.c_str(), "rb");
+	for (;;)
+	{
+		int node;
+		{
+			std::unique_lock<std::mutex> guard(pc_lock);
+			pc_wake.wait(guard, [] { return pc_stop || !pc_requests.empty(); });
+			if (pc_stop)
+				break;
+			node = pc_requests.front();
+			pc_requests.pop_front();
+		}
+		ReadNode* read = new ReadNode();
+		read->node = node;
+		if (fp == NULL || !pc_tree.read(fp, node, read->points))
+			read->points.clear();
+		std::lock_guard<std::mutex> guard(pc_lock);
+		pc_read.push_back(read);
+	}
+	if (fp != NULL)
+		fclose(fp);
+}
+
+bool PointCloud::load()
+{
+	if (source == NULL || !pc_tree.open(source))
+		return false;
+	pc_nodes.assign(pc_tree.nodes.size(), NodeBuffers());
+	pc_program = LoadShaderSource(PointVertexShader, PointFragmentShader, "point cloud");
+	pc_stop = false;
+	pc_reader = std::thread(read_nodes);
+	printf("Point cloud %s: %.1f million points in %d nodes\n", source, pc_tree.point_count / 1e6,
+		(int)pc_tree.nodes.size());
+	return true;
+}
+
+bool PointCloud::loaded()
+{
+	return !pc_nodes.empty();
+}
+
+static void release(int node)
+{
+	NodeBuffers& buffers = pc_nodes[node];
+	GLState::delete_vertex_arrays(1, &buffers.VAO);
+	GLState::delete_buffers(1, &buffers.VBO);
+	buffers.VAO = buffers.VBO = 0;
+	buffers.state = NODE_ON_DISK;
+	pc_points_in_gl -= pc_tree.nodes[node].count;
+}
+
+// Uploads nodes the reader has finished, within the per-frame limit
+static void upload_read_nodes()
+{
+	size_t budget = UPLOAD_BYTES_PER_FRAME;
+	while (budget > 0)
+	{
+		ReadNode* read = NULL;
+		{
+			std::lock_guard<std::mutex> guard(pc_lock);
+			if (pc_read.empty())
+				break;
+			read = pc_read.front();
+			pc_read.pop_front();
+		}
+		NodeBuffers& buffers = pc_nodes[read->node];
+		if (read->points.size() == pc_tree.nodes[read->node].count)
+		{
+			glGenVertexArrays(1, &buffers.VAO);
+			glGenBuffers(1, &buffers.VBO);
+			GLState::bind_vertex_array(buffers.VAO);
+			GLState::bind_buffer(GL_ARRAY_BUFFER, buffers.VBO);
+			glBufferData(GL_ARRAY_BUFFER, read->points.size() * sizeof(OctreePoint), read->points.data(), GL_STATIC_DRAW);
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(OctreePoint), (GLvoid*)0);
+			// RGBA8, normalized to 0..1 in the shader
+			glEnableVertexAttribArray(1);
+			glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(OctreePoint), (GLvoid*)offsetof(OctreePoint, color));
+			GLState::bind_buffer(GL_ARRAY_BUFFER, 0);
+			GLState::bind_vertex_array(0);
+			buffers.state = NODE_IN_GL;
+			pc_points_in_gl += read->points.size();
+			budget -= std::min(budget, read->points.size() * sizeof(OctreePoint));
+		}
+		else
+			buffers.state = NODE_ON_DISK;
+		delete read;
+	}
+}
+
+struct VisitNode {
+	float priority;			// Size on screen
+	int node;
+	bool operator<(const VisitNode& other) const { return priority < other.priority; }
+};
+
+void PointCloud::draw(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection)
+{
+	TRACE_SCOPE("PointCloud::draw");
+	if (!loaded())
+		return;
+	pc_frame++;
+	upload_read_nodes();
+
+	GLint viewport[4];
+	GLState::get_viewport(viewport);
+	glm::mat4 model_view = view * model;
+	glm::mat4 model_view_projection = projection * model_view;
+	// World units at distance 1 to pixels, and the scale of the model matrix
+	float pixels = pixels_at_unit_distance(projection, viewport[3]);
+	float scale = max_scale(model);
+
+	// Largest on screen first, until the budget is used up
+	std::vector<int> visible, missing;
+	size_t points = 0;
+	std::priority_queue<VisitNode> queue;
+	VisitNode root = { 1e30f, 0 };
+	queue.push(root);
+	while (!queue.empty())
+	{
+		int index = queue.top().node;
+		queue.pop();
+		const OctreeNode& node = pc_tree.nodes[index];
+		if (points + node.count > point_budget)
+			break;
+		if (outside_frustum(node.min, node.min + glm::vec3(node.size), model_view_projection))
+			continue;
+		points += node.count;
+		if (pc_nodes[index].state == NODE_IN_GL)
+			visible.push_back(index);
+		else
+			missing.push_back(index);
+
+		for (int c = 0; c < 8; c++)
+		{
+			int child = node.children[c];
+			if (child < 0)
+				continue;
+			const OctreeNode& n = pc_tree.nodes[child];
+			glm::vec3 center = glm::vec3(model_view * glm::vec4(n.min + glm::vec3(n.size * 0.5f), 1.0f));
+			float radius = n.size * 0.866f * scale;
+			// No point in children whose points land less than a pixel apart
+			if (n.spacing * scale * pixels / sphere_distance(center, radius) < MIN_SPACING_PIXELS)
+				continue;
+			VisitNode visit = { screen_radius(center, radius, pixels), child };
+			queue.push(visit);
+		}
+	}
+
+	// The reader works through the missing nodes, most important first, and forgets older requests
+	{
+		std::lock_guard<std::mutex> guard(pc_lock);
+		for (size_t i = 0; i < pc_requests.size(); i++)
+			if (pc_nodes[pc_requests[i]].state == NODE_REQUESTED)
+				pc_nodes[pc_requests[i]].state = NODE_ON_DISK;
+		pc_requests.clear();
+		for (size_t i = 0; i < missing.size(); i++)
+		{
+			if (pc_nodes[missing[i]].state != NODE_ON_DISK)
+				continue;
+			pc_nodes[missing[i]].state = NODE_REQUESTED;
+			pc_requests.push_back(missing[i]);
+		}
+	}
+	pc_wake.notify_one();
+
+	GLState::use_program(pc_program);
+	glUniformMatrix4fv(glGetUniformLocation(pc_program, "model_view_projection"), 1, GL_FALSE, &model_view_projection[0][0]);
+	glUniform1f(glGetUniformLocation(pc_program, "max_size"), MAX_POINT_SIZE);
+	GLint spacing_pixels = glGetUniformLocation(pc_program, "spacing_pixels");
+	GLState::enable(GL_PROGRAM_POINT_SIZE);
+	size_t drawn = 0;
+	for (size_t i = 0; i < visible.size(); i++)
+	{
+		const OctreeNode& node = pc_tree.nodes[visible[i]];
+		NodeBuffers& buffers = pc_nodes[visible[i]];
+		buffers.last_drawn = pc_frame;
+		glUniform1f(spacing_pixels, node.spacing * scale * pixels);
+		GLState::bind_vertex_array(buffers.VAO);
+		glDrawArrays(GL_POINTS, 0, node.count);
+		drawn += node.count;
+	}
+	GLState::disable(GL_PROGRAM_POINT_SIZE);
+
+	// Keep up to twice the budget around for when the view turns back
+	if (pc_points_in_gl > 2 * point_budget)
+	{
+		std::vector<std::pair<unsigned long long, int> > resident;
+		for (size_t i = 0; i < pc_nodes.size(); i++)
+			if (pc_nodes[i].state == NODE_IN_GL && pc_nodes[i].last_drawn != pc_frame)
+				resident.push_back(std::make_pair(pc_nodes[i].last_drawn, (int)i));
+		std::sort(resident.begin(), resident.end());
+		for (size_t i = 0; i < resident.size() && pc_points_in_gl > 2 * point_budget; i++)
+			release(resident[i].second);
+	}
+
+	pc_last_nodes = (int)visible.size();
+	pc_last_missing = (int)missing.size();
+	pc_last_points = drawn;
+	pc_total_points += drawn;
+	pc_frames++;
+}
+
+std::string PointCloud::overlay_text()
+{
+	if (!loaded())
+		return std::string();
+	char text[128];
+	snprintf(text, sizeof(text), "points %.2fM of %.1fM, %d nodes, %d loading", pc_last_points / 1e6,
+		pc_tree.point_count / 1e6, pc_last_nodes, pc_last_missing);
+	return text;
+}
+
+void PointCloud::print_summary()
+{
+	if (pc_frames == 0)
+		return;
+	printf("Point cloud: %.2f million points per frame on average, budget %.2f million, %.1f MB in GL buffers at exit\n",
+		pc_total_points / pc_frames / 1e6, point_budget / 1e6, pc_points_in_gl * sizeof(OctreePoint) / (1024.0 * 1024.0));
+}
+
+void PointCloud::clean_up()
+{
+	if (!loaded())
+		return;
+	{
+		std::lock_guard<std::mutex> guard(pc_lock);
+		pc_stop = true;
+	}
+	pc_wake.notify_one();
+	if (pc_reader.joinable())
+		pc_reader.join();
+	for (size_t i = 0; i < pc_read.size(); i++)
+		delete pc_read[i];
+	pc_read.clear();
+	pc_requests.clear();
+	for (size_t i = 0; i < pc_nodes.size(); i++)
+		if (pc_nodes[i].state == NODE_IN_GL)
+			release((int)i);
+	pc_nodes.clear();
+	if (pc_program != 0)
+		glDeleteProgram(pc_program);
+	pc_program = 0;
+}
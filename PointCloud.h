@@ -0,0 +1,42 @@
+#ifndef _POINTCLOUD_H_
+#define _POINTCLOUD_H_
+
+#define GLFW_INCLUDE_GLEXT
+#ifdef __APPLE__
+#define GLFW_INCLUDE_GLCOREARB
+#else
+#include <GL/glew.h>
+#endif
+#include <GLFW/glfw3.h>
+// Use of degrees is deprecated. Use radians instead.
+#ifndef GLM_FORCE_RADIANS
+#define GLM_FORCE_RADIANS
+#endif
+#include <glm/mat4x4.hpp>
+#include <string>
+
+// Draws a colored point cloud from an OBJ of "v x y z r g b" lines instead of the models (--points).
+// The cloud is sorted into a PointOctree on first use. Every frame the nodes are visited in order of
+// their size on screen and taken until point_budget is reached, and nodes whose points are already
+// less than a pixel apart are not refined further, so the cost of a frame depends on the budget, not
+// on the size of the cloud. Nodes are read from disk by a background thread, uploaded within a
+// per-frame limit and dropped again when more than twice the budget is in GL buffers. Until a node
+// arrives its parent, which covers the same space more sparsely, fills in.
+class PointCloud
+{
+public:
+	static const char* source;			// --points
+	static size_t point_budget;			// Points per frame, --point-budget takes millions
+
+	// Opens or builds the octree of source, needs the GL context
+	static bool load();
+	static bool loaded();
+	// Draws with the current framebuffer and viewport
+	static void draw(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection);
+
+	static std::string overlay_text();
+	static void print_summary();
+	static void clean_up();
+};
+
+#endif
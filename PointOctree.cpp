@@ -0,0 +1,419 @@
+#define _CRT_SECURE_NO_DEPRECATE
+#include "PointOctree.h"
+#include "OBJParser.h"
+#include <glm/common.hpp>
+#include <cfloat>
+#include <string.h>
+#include <sys/stat.h>
+#include <cmath>
+#include <map>
+#include <chrono>
+#include <algorithm>
+
+// File layout, native byte order:
+//   "OCT1", version, size of the OBJ file it was built from (64 bit), point count (64 bit),
+//   node count, offset of the node table (64 bit), modification time and hash of the OBJ file
+//   (64 bit each), then the points of every node and the table
+static const char MAGIC[4] = { 'O', 'C', 'T', '1' };
+static const uint32_t VERSION = 3;
+static const size_t HEADER_SIZE = 52;
+static const size_t STAMP_BLOCK = 64 * 1024;		// Hashed at each end of the OBJ file
+
+static const size_t BATCH_POINTS = 1 << 20;
+static const size_t SPILL_POINTS = 4096;			// Per chunk, before it is written out
+static const int MAX_DEPTH = 20;
+static const int MAX_CHUNK_DEPTH = 4;
+
+// Octree files of large scans pass 2 GB, beyond what fseek takes on Windows
+static bool seek(FILE* fp, uint64_t offset)
+{
+#ifdef _WIN32
+	return _fseeki64(fp, (long long)offset, SEEK_SET) == 0;
+#else
+	return fseeko(fp, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+// Identifies the OBJ file an octree was built from. The size alone misses a scan re-exported with
+// fixed-width numbers; its colors or positions change the hash of the first and last blocks.
+struct SourceStamp {
+	uint64_t size, mtime, hash;
+
+	bool operator==(const SourceStamp& other) const
+	{
+		return size == other.size && mtime == other.mtime && hash == other.hash;
+	}
+};
+
+// FNV-1a, 64 bit
+static uint64_t hash_bytes(uint64_t hash, const unsigned char* data, size_t size)
+{
+	for (size_t i = 0; i < size; i++)
+		hash = (hash ^ data[i]) * 1099511628211ull;
+	return hash;
+}
+
+static bool source_stamp(const char* path, SourceStamp& stamp)
+{
+#ifdef _WIN32
+	struct _stat64 info;
+	if (_stat64(path, &info) != 0)
+		return false;
+#else
+	struct stat info;
+	if (stat(path, &info) != 0)
+		return false;
+#endif
+	stamp.size = (uint64_t)info.st_size;
+	stamp.mtime = (uint64_t)info.st_mtime;
+	stamp.hash = 14695981039346656037ull;
+
+	FILE* fp = fopen(path, "rb");
+	if (fp == NULL)
+		return false;
+	std::vector<unsigned char> block(STAMP_BLOCK);
+	size_t read = fread(block.data(), 1, STAMP_BLOCK, fp);
+	stamp.hash = hash_bytes(stamp.hash, block.data(), read);
+	// The last block, or whatever follows the first one in a small file
+	bool found = stamp.size <= 2 * STAMP_BLOCK || seek(fp, stamp.size - STAMP_BLOCK);
+	read = fread(block.data(), 1, STAMP_BLOCK, fp);
+	stamp.hash = hash_bytes(stamp.hash, block.data(), read);
+	fclose(fp);
+	return found;
+}
+
+static bool read_header(FILE* fp, SourceStamp& source, uint64_t& points, uint32_t& node_count, uint64_t& table)
+{
+	unsigned char header[HEADER_SIZE];
+	uint32_t version;
+	if (fread(header, 1, HEADER_SIZE, fp) != HEADER_SIZE || memcmp(header, MAGIC, 4) != 0)
+		return false;
+	memcpy(&version, header + 4, 4);
+	memcpy(&source.size, header + 8, 8);
+	memcpy(&points, header + 16, 8);
+	memcpy(&node_count, header + 24, 4);
+	memcpy(&table, header + 28, 8);
+	memcpy(&source.mtime, header + 36, 8);
+	memcpy(&source.hash, header + 44, 8);
+	return version == VERSION && node_count > 0;
+}
+
+bool PointOctree::open(const char* path)
+{
+	file = std::string(path) + ".octree";
+	SourceStamp source;
+	if (!source_stamp(path, source))
+	{
+		fprintf(stderr, "Cannot open %s\n", path);
+		return false;
+	}
+
+	for (int attempt = 0; attempt < 2; attempt++)
+	{
+		FILE* fp = fopen(file.c_str(), "rb");
+		SourceStamp built_from = SourceStamp();
+		uint64_t table = 0;
+		uint32_t node_count = 0;
+		bool current = fp != NULL && read_header(fp, built_from, point_count, node_count, table)
+			&& built_from == source;
+		if (current)
+		{
+			nodes.resize(node_count);
+			current = seek(fp, table)
+				&& fread(nodes.data(), sizeof(OctreeNode), node_count, fp) == node_count;
+		}
+		if (fp != NULL)
+			fclose(fp);
+		if (current)
+			return true;
+		if (attempt == 0 && !build(path, file.c_str()))
+			return false;
+	}
+	fprintf(stderr, "%s is corrupt\n", file.c_str());
+	return false;
+}
+
+bool PointOctree::read(FILE* fp, int node, std::vector<OctreePoint>& points) const
+{
+	const OctreeNode& n = nodes[node];
+	points.resize(n.count);
+	return seek(fp, n.offset) && fread(points.data(), sizeof(OctreePoint), n.count, fp) == n.count;
+}
+
+// Nodes by depth and cell, created with all their ancestors
+struct OctreeBuilder {
+	std::vector<OctreeNode> nodes;
+	std::map<uint64_t, int> cells;
+	FILE* out;
+	uint64_t written;
+
+	static uint64_t key(int depth, uint32_t x, uint32_t y, uint32_t z)
+	{
+		return ((uint64_t)depth << 60) | ((uint64_t)x << 40) | ((uint64_t)y << 20) | z;
+	}
+
+	int node(int depth, uint32_t x, uint32_t y, uint32_t z)
+	{
+		std::map<uint64_t, int>::iterator found = cells.find(key(depth, x, y, z));
+		if (found != cells.end())
+			return found->second;
+		int parent = depth > 0 ? node(depth - 1, x >> 1, y >> 1, z >> 1) : -1;
+		OctreeNode n;
+		n.size = 1.0f / (1 << depth);
+		n.min = glm::vec3(-0.5f) + glm::vec3((float)x, (float)y, (float)z) * n.size;
+		n.spacing = n.size / PointOctree::GRID;
+		n.count = 0;
+		n.offset = 0;
+		for (int i = 0; i < 8; i++)
+			n.children[i] = -1;
+		int index = (int)nodes.size();
+		nodes.push_back(n);
+		if (parent >= 0)
+			nodes[parent].children[(x & 1) | ((y & 1) << 1) | ((z & 1) << 2)] = index;
+		cells[key(depth, x, y, z)] = index;
+		return index;
+	}
+
+	bool write(int index, const std::vector<OctreePoint>& points)
+	{
+		nodes[index].offset = written;
+		nodes[index].count = (uint32_t)points.size();
+		written += points.size() * sizeof(OctreePoint);
+		return fwrite(points.data(), sizeof(OctreePoint), points.size(), out) == points.size();
+	}
+
+	// Keeps the first point in every grid cell of the node and passes the rest to its children
+	bool subdivide(int index, int depth, uint32_t x, uint32_t y, uint32_t z, std::vector<OctreePoint>& points)
+	{
+		if (points.size() <= PointOctree::LEAF_POINTS || depth >= MAX_DEPTH)
+			return write(index, points);
+		const int grid = PointOctree::GRID;
+		glm::vec3 min = nodes[index].min;
+		float size = nodes[index].size;
+		std::vector<uint64_t> occupied(grid * grid * grid / 64, 0);
+		std::vector<OctreePoint> kept, children[8];
+		for (size_t i = 0; i < points.size(); i++)
+		{
+			glm::vec3 unit = (points[i].position - min) / size;
+			int cx = std::min(std::max((int)(unit.x * grid), 0), grid - 1);
+			int cy = std::min(std::max((int)(unit.y * grid), 0), grid - 1);
+			int cz = std::min(std::max((int)(unit.z * grid), 0), grid - 1);
+			size_t cell = (size_t)cx + grid * ((size_t)cy + grid * (size_t)cz);
+			if ((occupied[cell / 64] & (1ull << (cell % 64))) == 0)
+			{
+				occupied[cell / 64] |= 1ull << (cell % 64);
+				kept.push_back(points[i]);
+			}
+			else
+				children[(cx >= grid / 2) | ((cy >= grid / 2) << 1) | ((cz >= grid / 2) << 2)].push_back(points[i]);
+		}
+		std::vector<OctreePoint>().swap(points);
+		if (!write(index, kept))
+			return false;
+		for (uint32_t c = 0; c < 8; c++)
+		{
+			if (children[c].empty())
+				continue;
+			uint32_t cx = 2 * x + (c & 1), cy = 2 * y + ((c >> 1) & 1), cz = 2 * z + ((c >> 2) & 1);
+			if (!subdivide(node(depth + 1, cx, cy, cz), depth + 1, cx, cy, cz, children[c]))
+				return false;
+		}
+		return true;
+	}
+};
+
+static bool build_failed(const char* message, const char* path, FILE* a, FILE* b, FILE* c)
+{
+	fprintf(stderr, message, path);
+	FILE* files[3] = { a, b, c };
+	for (int i = 0; i < 3; i++)
+		if (files[i] != NULL)
+			fclose(files[i]);
+	return false;
+}
+
+// 1. The OBJ is parsed once into a binary spill file, measuring the bounds.
+// 2. The nodes above the chunk depth take the first point of every cell of their grid, tracked with
+//    one bitmap per depth, and the other points are sorted into spill blocks per chunk.
+// 3. Each chunk, a cube of the chunk depth, is loaded on its own and subdivided in memory.
+bool PointOctree::build(const char* obj_path, const char* octree_path)
+{
+	auto start = std::chrono::steady_clock::now();
+	printf("Building %s\n", octree_path);
+	std::string raw_path = std::string(octree_path) + ".points", spill_path = std::string(octree_path) + ".chunks";
+
+	// Taken before reading, so a file that changes during the build is seen as changed next time
+	SourceStamp source;
+	if (!source_stamp(obj_path, source))
+		return build_failed("Cannot open %s\n", obj_path, NULL, NULL, NULL);
+	OBJPointReader reader;
+	if (!reader.open(obj_path))
+		return false;
+	FILE* raw = fopen(raw_path.c_str(), "w+b");
+	if (raw == NULL)
+		return build_failed("Cannot write %s\n", raw_path.c_str(), NULL, NULL, NULL);
+	std::vector<glm::vec3> positions;
+	std::vector<uint32_t> colors;
+	std::vector<OctreePoint> batch;
+	glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+	uint64_t count = 0;
+	for (;;)
+	{
+		positions.clear();
+		colors.clear();
+		size_t read = reader.read(positions, colors, BATCH_POINTS);
+		if (read == 0)
+			break;
+		batch.clear();
+		for (size_t i = 0; i < read; i++)
+		{
+			// A scanner's "nan" would land in no cell
+			const glm::vec3& p = positions[i];
+			if (!std::isfinite(p.x) || !std::isfinite(p.y) || !std::isfinite(p.z))
+				continue;
+			OctreePoint point = { p, colors[i] };
+			batch.push_back(point);
+			min = glm::min(min, p);
+			max = glm::max(max, p);
+		}
+		if (fwrite(batch.data(), sizeof(OctreePoint), batch.size(), raw) != batch.size())
+			return build_failed("Error writing %s\n", raw_path.c_str(), raw, NULL, NULL);
+		count += batch.size();
+	}
+	reader.close();
+	if (count == 0)
+		return build_failed("%s has no points\n", obj_path, raw, NULL, NULL);
+	printf("  %llu points read\n", (unsigned long long)count);
+
+	// Into the unit cube around the origin
+	glm::vec3 center = (min + max) * 0.5f;
+	float size = std::max(max.x - min.x, std::max(max.y - min.y, max.z - min.z));
+	float scale = size > 0.0f ? 1.0f / size : 1.0f;
+
+	// Scans are surfaces, so a chunk depth of d divides them into about 4^d chunks
+	int chunk_depth = 0;
+	while (chunk_depth < MAX_CHUNK_DEPTH && count / ((uint64_t)1 << (2 * chunk_depth)) > CHUNK_POINTS)
+		chunk_depth++;
+	uint32_t chunk_cells = 1u << chunk_depth;
+
+	FILE* spill = fopen(spill_path.c_str(), "w+b");
+	FILE* out = fopen(octree_path, "wb");
+	if (spill == NULL || out == NULL)
+		return build_failed("Cannot write %s\n", octree_path, raw, spill, out);
+	OctreeBuilder builder;
+	builder.out = out;
+	builder.written = HEADER_SIZE;
+	std::vector<unsigned char> header(HEADER_SIZE, 0);
+	fwrite(header.data(), 1, HEADER_SIZE, out);
+	builder.node(0, 0, 0, 0);
+
+	std::vector<std::vector<uint64_t> > occupied(chunk_depth);
+	for (int d = 0; d < chunk_depth; d++)
+		occupied[d].assign(((size_t)GRID << d) * ((size_t)GRID << d) * ((size_t)GRID << d) / 64, 0);
+	std::map<int, std::vector<OctreePoint> > upper;
+	size_t chunk_count = (size_t)chunk_cells * chunk_cells * chunk_cells;
+	std::vector<std::vector<OctreePoint> > pending(chunk_count);
+	std::vector<std::vector<std::pair<uint64_t, uint32_t> > > blocks(chunk_count);
+	uint64_t spilled = 0;
+
+	rewind(raw);
+	for (uint64_t done = 0; done < count;)
+	{
+		size_t n = (size_t)std::min<uint64_t>(BATCH_POINTS, count - done);
+		batch.resize(n);
+		if (fread(batch.data(), sizeof(OctreePoint), n, raw) != n)
+			return build_failed("Error reading %s\n", raw_path.c_str(), raw, spill, out);
+		done += n;
+		for (size_t i = 0; i < n; i++)
+		{
+			OctreePoint point = batch[i];
+			point.position = (point.position - center) * scale;
+			glm::vec3 unit = glm::clamp(point.position + glm::vec3(0.5f), 0.0f, 0.999999f);
+			bool taken = false;
+			for (int d = 0; d < chunk_depth && !taken; d++)
+			{
+				uint32_t cells = (uint32_t)GRID << d;
+				uint32_t cx = (uint32_t)(unit.x * cells), cy = (uint32_t)(unit.y * cells), cz = (uint32_t)(unit.z * cells);
+				size_t cell = cx + cells * ((size_t)cy + cells * (size_t)cz);
+				if ((occupied[d][cell / 64] & (1ull << (cell % 64))) != 0)
+					continue;
+				occupied[d][cell / 64] |= 1ull << (cell % 64);
+				upper[builder.node(d, cx / GRID, cy / GRID, cz / GRID)].push_back(point);
+				taken = true;
+			}
+			if (taken)
+				continue;
+			uint32_t cx = (uint32_t)(unit.x * chunk_cells), cy = (uint32_t)(unit.y * chunk_cells);
+			uint32_t cz = (uint32_t)(unit.z * chunk_cells);
+			size_t chunk = cx + chunk_cells * ((size_t)cy + chunk_cells * cz);
+			std::vector<OctreePoint>& list = pending[chunk];
+			list.push_back(point);
+			if (list.size() < SPILL_POINTS)
+				continue;
+			if (fwrite(list.data(), sizeof(OctreePoint), list.size(), spill) != list.size())
+				return build_failed("Error writing %s\n", spill_path.c_str(), raw, spill, out);
+			blocks[chunk].push_back(std::make_pair(spilled, (uint32_t)list.size()));
+			spilled += list.size() * sizeof(OctreePoint);
+			list.clear();
+		}
+	}
+	fclose(raw);
+	remove(raw_path.c_str());
+	for (std::map<int, std::vector<OctreePoint> >::iterator it = upper.begin(); it != upper.end(); ++it)
+		if (!builder.write(it->first, it->second))
+			return build_failed("Error writing %s\n", octree_path, NULL, spill, out);
+	std::map<int, std::vector<OctreePoint> >().swap(upper);
+	std::vector<std::vector<uint64_t> >().swap(occupied);
+
+	std::vector<OctreePoint> points;
+	for (size_t chunk = 0; chunk < chunk_count; chunk++)
+	{
+		points.swap(pending[chunk]);
+		std::vector<OctreePoint>().swap(pending[chunk]);
+		size_t spilled_points = 0;
+		for (size_t b = 0; b < blocks[chunk].size(); b++)
+			spilled_points += blocks[chunk][b].second;
+		size_t in_memory = points.size();
+		points.resize(in_memory + spilled_points);
+		OctreePoint* next = points.data() + in_memory;
+		for (size_t b = 0; b < blocks[chunk].size(); b++)
+		{
+			uint32_t n = blocks[chunk][b].second;
+			if (!seek(spill, blocks[chunk][b].first) || fread(next, sizeof(OctreePoint), n, spill) != n)
+				return build_failed("Error reading %s\n", spill_path.c_str(), NULL, spill, out);
+			next += n;
+		}
+		if (points.empty())
+			continue;
+		uint32_t cx = (uint32_t)(chunk % chunk_cells), cy = (uint32_t)(chunk / chunk_cells % chunk_cells);
+		uint32_t cz = (uint32_t)(chunk / chunk_cells / chunk_cells);
+		if (!builder.subdivide(builder.node(chunk_depth, cx, cy, cz), chunk_depth, cx, cy, cz, points))
+			return build_failed("Error writing %s\n", octree_path, NULL, spill, out);
+		points.clear();
+	}
+	fclose(spill);
+	remove(spill_path.c_str());
+
+	uint64_t table = builder.written;
+	uint32_t node_count = (uint32_t)builder.nodes.size();
+	memcpy(&header[0], MAGIC, 4);
+	memcpy(&header[4], &VERSION, 4);
+	memcpy(&header[8], &source.size, 8);
+	memcpy(&header[16], &count, 8);
+	memcpy(&header[24], &node_count, 4);
+	memcpy(&header[28], &table, 8);
+	memcpy(&header[36], &source.mtime, 8);
+	memcpy(&header[44], &source.hash, 8);
+	bool written = fwrite(builder.nodes.data(), sizeof(OctreeNode), node_count, out) == node_count
+		&& seek(out, 0) && fwrite(header.data(), 1, HEADER_SIZE, out) == HEADER_SIZE;
+	written = fclose(out) == 0 && written;
+	if (!written)
+	{
+		fprintf(stderr, "Error writing %s\n", octree_path);
+		remove(octree_path);
+		return false;
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("  %u nodes, %d chunks deep, built in %.1f s\n", node_count, chunk_depth, seconds);
+	return true;
+}
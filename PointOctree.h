@@ -0,0 +1,53 @@
+#ifndef _POINTOCTREE_H_
+#define _POINTOCTREE_H_
+
+// Use of degrees is deprecated. Use radians instead.
+#ifndef GLM_FORCE_RADIANS
+#define GLM_FORCE_RADIANS
+#endif
+#include <glm/vec3.hpp>
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <stdint.h>
+
+// A point as stored and uploaded, 16 bytes
+struct OctreePoint {
+	glm::vec3 position;
+	uint32_t color;			// RGBA8
+};
+
+struct OctreeNode {
+	glm::vec3 min;			// Cube, within the unit cube around the origin the cloud is scaled to
+	float size;
+	float spacing;			// Distance between the node's points, at least
+	uint32_t count;
+	uint64_t offset;		// Of its points in the file
+	int32_t children[8];	// -1 for none
+};
+
+// Octree of a point cloud too large for memory, built out of core from an OBJ file and kept next to
+// it as a .octree file that later runs reuse. Each node keeps a subsample of its points, one per cell
+// of a GRID^3 grid over its cube, and passes the rest on to its children, so drawing the nodes down to
+// some depth gives a uniformly thinned out cloud. Every point is stored once.
+// Like OBJParser this has no GL dependency.
+class PointOctree
+{
+public:
+	static const int GRID = 64;
+	static const uint32_t LEAF_POINTS = 32768;		// Nodes with fewer points keep them all
+	static const size_t CHUNK_POINTS = 4000000;		// Most points held in memory while building
+
+	std::vector<OctreeNode> nodes;					// nodes[0] is the root
+	uint64_t point_count = 0;
+	std::string file;
+
+	// Opens the octree of the OBJ file at path, building it first if it is missing or out of date
+	bool open(const char* path);
+	// Reads the points of a node through fp, a handle to file of the caller's own
+	bool read(FILE* fp, int node, std::vector<OctreePoint>& points) const;
+
+	static bool build(const char* obj_path, const char* octree_path);
+};
+
+#endif
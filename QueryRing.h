@@ -0,0 +1,104 @@
+#ifndef _QUERYRING_H_
+#define _QUERYRING_H_
+
+#define GLFW_INCLUDE_GLEXT
+#ifdef __APPLE__
+#define GLFW_INCLUDE_GLCOREARB
+#else
+#include <GL/glew.h>
+#endif
+#include <GLFW/glfw3.h>
+#include <vector>
+
+// Query objects of one kind, created as a frame needs them and reused by later frames
+struct QueryPool
+{
+	std::vector<GLuint> queries;
+	size_t used;				// The first used queries belong to the current frame
+
+	QueryPool() : used(0) {}
+
+	GLuint next()
+	{
+		if (used == queries.size())
+		{
+			GLuint query;
+			glGenQueries(1, &query);
+			queries.push_back(query);
+		}
+		return queries[used++];
+	}
+
+	// The query issued last this frame, 0 if there is none
+	GLuint last() const
+	{
+		return used > 0 ? queries[used - 1] : 0;
+	}
+
+	void clean_up()
+	{
+		if (!queries.empty())
+			glDeleteQueries((GLsizei)queries.size(), queries.data());
+		queries.clear();
+		used = 0;
+	}
+};
+
+// Whether the result of query can be read without waiting, true for 0
+inline bool query_ready(GLuint query)
+{
+	if (query == 0)
+		return true;
+	GLint ready = GL_FALSE;
+	glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &ready);
+	return ready == GL_TRUE;
+}
+
+// The last LATENCY frames of queries, read back without ever waiting on the GPU. Frame needs a
+// bool pending, set while its results are unread. Each new frame first reads every finished one
+// but the newest, oldest first, and then takes the slot of the oldest. If that frame is still
+// pending the GPU is more than LATENCY frames behind, and its results are dropped.
+template <typename Frame, int LATENCY>
+class QueryRing
+{
+public:
+	Frame frames[LATENCY];
+	int current;
+
+	QueryRing() : current(0)
+	{
+		for (int i = 0; i < LATENCY; i++)
+			frames[i].pending = false;
+	}
+
+	Frame& now()
+	{
+		return frames[current];
+	}
+
+	// ready(frame) tells whether all of a frame's queries are done, read(frame) takes the results.
+	// dropped receives whether the returned frame still had unread results.
+	template <typename Ready, typename Read>
+	Frame& advance(Ready ready, Read read, bool* dropped = NULL)
+	{
+		for (int i = 1; i < LATENCY; i++)
+		{
+			Frame& frame = frames[(current + i) % LATENCY];
+			if (!frame.pending)
+				continue;
+			// The GPU finishes frames in order, so later ones are not done either
+			if (!ready(frame))
+				break;
+			read(frame);
+			frame.pending = false;
+		}
+		current = (current + 1) % LATENCY;
+		Frame& frame = frames[current];
+		if (dropped != NULL)
+			*dropped = frame.pending;
+		frame.pending = true;
+		return frame;
+	}
+};
+
+#endif
@@ -0,0 +1,786 @@
+#define _CRT_SECURE_NO_DEPRECATE
+#include "RayTracer.h"
+#include "SoftwareRasterizer.h"
+#include "Phong.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <float.h>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+int RayTracer::max_samples = 1024;
+
+// Interior nodes have count 0 and their children at first and first + 1,
+// leaves hold triangles first .. first + count - 1
+struct BvhNode
+{
+	glm::vec3 min;
+	int first;
+	glm::vec3 max;
+	int count;
+};
+
+// Precomputed for the intersection test, in BVH order
+struct BvhTriangle
+{
+	glm::vec3 v0, e1, e2;
+	unsigned int index;		// Triangle in OBJObject::indices
+};
+
+struct Bvh
+{
+	std::vector<BvhNode> nodes;
+	std::vector<BvhTriangle> triangles;
+};
+
+// Four rays, one per lane
+struct RayPacket
+{
+	Float4x3 origin, dir, inv_dir;
+	Float4 active;		// Lanes without a ray, e.g. past the edge of the image
+	Float4 t;			// Closest hit so far, or the end of the ray
+	Float4 u, v;		// Barycentrics of the hit
+	int triangle[4];	// Index into Bvh::triangles, -1 for a miss
+};
+
+const int LEAF_SIZE = 4;
+const int SAH_BINS = 12;
+// Keeps the traversal stacks bounded however bad the mesh is
+const int MAX_DEPTH = 48;
+const float SHADOW_EPSILON = 1e-3f;
+
+// Work-stealing pool. Every pass deals the tiles out in contiguous runs, one per thread.
+// Threads take tiles from the back of their own queue and steal from the front of the others'.
+struct TileQueue
+{
+	std::mutex mutex;
+	std::deque<int> tiles;
+};
+
+struct TracerPool
+{
+	std::vector<std::thread> workers;
+	std::unique_ptr<TileQueue[]> queues;	// Queue 0 belongs to the calling thread
+	int threads = 1;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	std::function<void(int)> task;
+	int busy = 0;
+	unsigned generation = 0;
+	bool quit = false;
+};
+
+TracerPool tracer_pool;
+bool tracer_present = false;
+int tracer_width = 0, tracer_height = 0;
+std::vector<float> tracer_accum;		// Sum of all samples, RGB per pixel
+std::vector<uint32_t> tracer_color;		// RGBA8, bottom row first like GL
+int tracer_samples = 0;
+std::map<const Mesh*, Bvh> tracer_bvhs;
+
+// What the accumulated samples were rendered with
+const OBJObject* tracer_object = NULL;
+glm::mat4 tracer_model, tracer_view, tracer_projection;
+Light tracer_light;
+
+std::atomic<unsigned long long> tracer_pass_rays(0);
+unsigned long long tracer_total_rays = 0;
+double tracer_total_seconds = 0.0;
+double tracer_last_rays_per_second = 0.0;
+
+static bool pop_tile(int queue, bool steal, int& tile)
+{
+	TileQueue& q = tracer_pool.queues[queue];
+	std::lock_guard<std::mutex> lock(q.mutex);
+	if (q.tiles.empty())
+		return false;
+	if (steal)
+	{
+		tile = q.tiles.front();
+		q.tiles.pop_front();
+	}
+	else
+	{
+		tile = q.tiles.back();
+		q.tiles.pop_back();
+	}
+	return true;
+}
+
+static void run_tiles(int self)
+{
+	int tile;
+	for (;;)
+	{
+		if (pop_tile(self, false, tile))
+		{
+			tracer_pool.task(tile);
+			continue;
+		}
+		bool stolen = false;
+		for (int k = 1; k < tracer_pool.threads && !stolen; k++)
+			stolen = pop_tile((self + k) % tracer_pool.threads, true, tile);
+		if (!stolen)
+			return;
+		tracer_pool.task(tile);
+	}
+}
+
+static void tracer_worker(int self)
+{
+	unsigned seen = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(tracer_pool.mutex);
+			tracer_pool.wake.wait(lock, [&] { return tracer_pool.quit || tracer_pool.generation != seen; });
+			if (tracer_pool.quit)
+				return;
+			seen = tracer_pool.generation;
+		}
+		run_tiles(self);
+		{
+			std::lock_guard<std::mutex> lock(tracer_pool.mutex);
+			if (--tracer_pool.busy == 0)
+				tracer_pool.done.notify_all();
+		}
+	}
+}
+
+static void for_each_tile(int count, const std::function<void(int)>& task)
+{
+	int threads = tracer_pool.threads;
+	for (int i = 0; i < threads; i++)
+	{
+		TileQueue& q = tracer_pool.queues[i];
+		std::lock_guard<std::mutex> lock(q.mutex);
+		q.tiles.clear();
+		// Neighboring tiles stay on one thread until they are stolen
+		for (int tile = count * i / threads; tile < count * (i + 1) / threads; tile++)
+			q.tiles.push_back(tile);
+	}
+	{
+		std::lock_guard<std::mutex> lock(tracer_pool.mutex);
+		tracer_pool.task = task;
+		tracer_pool.busy = threads - 1;
+		tracer_pool.generation++;
+	}
+	tracer_pool.wake.notify_all();
+	run_tiles(0);
+	std::unique_lock<std::mutex> lock(tracer_pool.mutex);
+	tracer_pool.done.wait(lock, [] { return tracer_pool.busy == 0; });
+}
+
+static glm::vec3 triangle_vertex(const OBJObject& object, size_t triangle, int corner)
+{
+	return object.mesh->vertices[object.mesh->indices[3 * triangle + corner]];
+}
+
+static void grow(glm::vec3& min, glm::vec3& max, const glm::vec3& p)
+{
+	min = glm::min(min, p);
+	max = glm::max(max, p);
+}
+
+static float half_area(const glm::vec3& min, const glm::vec3& max)
+{
+	glm::vec3 d = max - min;
+	return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+struct BuildTriangle
+{
+	glm::vec3 min, max, centroid;
+	unsigned int index;
+};
+
+// Binned surface area heuristic
+static void build_node(Bvh& bvh, std::vector<BuildTriangle>& tris, int node, int begin, int end, int depth)
+{
+	glm::vec3 min(FLT_MAX), max(-FLT_MAX), cmin(FLT_MAX), cmax(-FLT_MAX);
+	for (int i = begin; i < end; i++)
+	{
+		grow(min, max, tris[i].min);
+		grow(min, max, tris[i].max);
+		grow(cmin, cmax, tris[i].centroid);
+	}
+	bvh.nodes[node].min = min;
+	bvh.nodes[node].max = max;
+	bvh.nodes[node].first = begin;
+	bvh.nodes[node].count = end - begin;
+	int count = end - begin;
+	if (count <= LEAF_SIZE || depth >= MAX_DEPTH)
+		return;
+
+	int best_axis = -1, best_bin = 0;
+	float best_cost = half_area(min, max) * count;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float extent = cmax[axis] - cmin[axis];
+		if (extent <= 0.0f)
+			continue;
+		int bin_count[SAH_BINS] = { 0 };
+		glm::vec3 bin_min[SAH_BINS], bin_max[SAH_BINS];
+		for (int b = 0; b < SAH_BINS; b++)
+		{
+			bin_min[b] = glm::vec3(FLT_MAX);
+			bin_max[b] = glm::vec3(-FLT_MAX);
+		}
+		for (int i = begin; i < end; i++)
+		{
+			int b = std::min(SAH_BINS - 1, (int)((tris[i].centroid[axis] - cmin[axis]) / extent * SAH_BINS));
+			bin_count[b]++;
+			grow(bin_min[b], bin_max[b], tris[i].min);
+			grow(bin_min[b], bin_max[b], tris[i].max);
+		}
+		// Sweep from the right, then from the left, splitting after bin b
+		float right_cost[SAH_BINS];
+		glm::vec3 rmin(FLT_MAX), rmax(-FLT_MAX);
+		int right = 0;
+		for (int b = SAH_BINS - 1; b > 0; b--)
+		{
+			right += bin_count[b];
+			if (bin_count[b] > 0)
+			{
+				grow(rmin, rmax, bin_min[b]);
+				grow(rmin, rmax, bin_max[b]);
+			}
+			right_cost[b - 1] = right > 0 ? half_area(rmin, rmax) * right : 0.0f;
+		}
+		glm::vec3 lmin(FLT_MAX), lmax(-FLT_MAX);
+		int left = 0;
+		for (int b = 0; b < SAH_BINS - 1; b++)
+		{
+			left += bin_count[b];
+			if (bin_count[b] > 0)
+			{
+				grow(lmin, lmax, bin_min[b]);
+				grow(lmin, lmax, bin_max[b]);
+			}
+			if (left == 0 || left == count)
+				continue;
+			float cost = half_area(lmin, lmax) * left + right_cost[b];
+			if (cost < best_cost)
+			{
+				best_cost = cost;
+				best_axis = axis;
+				best_bin = b;
+			}
+		}
+	}
+
+	int middle;
+	if (best_axis >= 0)
+	{
+		float extent = cmax[best_axis] - cmin[best_axis];
+		BuildTriangle* split = std::partition(&tris[begin], &tris[0] + end, [&](const BuildTriangle& t) {
+			return std::min(SAH_BINS - 1, (int)((t.centroid[best_axis] - cmin[best_axis]) / extent * SAH_BINS)) <= best_bin;
+		});
+		middle = (int)(split - &tris[0]);
+	}
+	else if (count > 4 * LEAF_SIZE)
+	{
+		// Splitting doesn't pay off by the heuristic, but huge leaves are slow either way
+		middle = begin + count / 2;
+	}
+	else
+		return;
+
+	int left_child = (int)bvh.nodes.size();
+	bvh.nodes.resize(bvh.nodes.size() + 2);
+	bvh.nodes[node].first = left_child;
+	bvh.nodes[node].count = 0;
+	build_node(bvh, tris, left_child, begin, middle, depth + 1);
+	build_node(bvh, tris, left_child + 1, middle, end, depth + 1);
+}
+
+static const Bvh& get_bvh(const OBJObject& object)
+{
+	std::map<const Mesh*, Bvh>::iterator found = tracer_bvhs.find(object.mesh.get());
+	if (found != tracer_bvhs.end())
+		return found->second;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	Bvh& bvh = tracer_bvhs[object.mesh.get()];
+	size_t count = object.mesh->indices.size() / 3;
+	std::vector<BuildTriangle> tris;
+	tris.reserve(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		if (object.mesh->indices[3 * i] >= object.mesh->vertices.size() || object.mesh->indices[3 * i + 1] >= object.mesh->vertices.size() ||
+			object.mesh->indices[3 * i + 2] >= object.mesh->vertices.size())
+			continue;
+		BuildTriangle t;
+		t.min = glm::vec3(FLT_MAX);
+		t.max = glm::vec3(-FLT_MAX);
+		for (int corner = 0; corner < 3; corner++)
+			grow(t.min, t.max, triangle_vertex(object, i, corner));
+		t.centroid = (t.min + t.max) * 0.5f;
+		t.index = (unsigned int)i;
+		tris.push_back(t);
+	}
+	if (tris.empty())
+		return bvh;
+
+	bvh.nodes.reserve(2 * tris.size() / LEAF_SIZE + 1);
+	bvh.nodes.resize(1);
+	build_node(bvh, tris, 0, 0, (int)tris.size(), 0);
+
+	bvh.triangles.resize(tris.size());
+	for (size_t i = 0; i < tris.size(); i++)
+	{
+		glm::vec3 v0 = triangle_vertex(object, tris[i].index, 0);
+		bvh.triangles[i].v0 = v0;
+		bvh.triangles[i].e1 = triangle_vertex(object, tris[i].index, 1) - v0;
+		bvh.triangles[i].e2 = triangle_vertex(object, tris[i].index, 2) - v0;
+		bvh.triangles[i].index = tris[i].index;
+	}
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	printf("Built BVH over %d triangles with %d nodes in %.1f ms\n", (int)tris.size(), (int)bvh.nodes.size(), ms);
+	return bvh;
+}
+
+// Slab test of four rays against a box. Returns the lanes that enter it before limit and sets t_near.
+static Float4 hit_box(const BvhNode& node, const Float4x3& origin, const Float4x3& inv_dir, Float4 limit, Float4& t_near)
+{
+	Float4 t0x = (Float4(node.min.x) - origin.x) * inv_dir.x, t1x = (Float4(node.max.x) - origin.x) * inv_dir.x;
+	Float4 t0y = (Float4(node.min.y) - origin.y) * inv_dir.y, t1y = (Float4(node.max.y) - origin.y) * inv_dir.y;
+	Float4 t0z = (Float4(node.min.z) - origin.z) * inv_dir.z, t1z = (Float4(node.max.z) - origin.z) * inv_dir.z;
+	t_near = max(max(min(t0x, t1x), min(t0y, t1y)), max(min(t0z, t1z), Float4(0.0f)));
+	Float4 t_far = min(min(max(t0x, t1x), max(t0y, t1y)), min(max(t0z, t1z), limit));
+	return t_near <= t_far;
+}
+
+// Moller-Trumbore for four rays against one triangle
+static Float4 hit_triangle(const BvhTriangle& tri, const Float4x3& origin, const Float4x3& dir, Float4 t_min, Float4 t_max,
+	Float4& t, Float4& u, Float4& v)
+{
+	Float4x3 e1 = phong_splat(tri.e1), e2 = phong_splat(tri.e2);
+	Float4x3 p = cross(dir, e2);
+	Float4 det = dot(e1, p);
+	Float4 inv_det = Float4(1.0f) / det;
+	Float4x3 s = origin - phong_splat(tri.v0);
+	u = dot(s, p) * inv_det;
+	Float4x3 q = cross(s, e1);
+	v = dot(dir, q) * inv_det;
+	t = dot(e2, q) * inv_det;
+	Float4 zero(0.0f);
+	return (abs(det) > Float4(1e-12f)) & (u >= zero) & (v >= zero) & (u + v <= Float4(1.0f)) & (t > t_min) & (t < t_max);
+}
+
+static void trace_closest(const Bvh& bvh, RayPacket& ray)
+{
+	for (int k = 0; k < 4; k++)
+		ray.triangle[k] = -1;
+	if (bvh.nodes.empty())
+		return;
+
+	int stack[MAX_DEPTH + 2];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		const BvhNode& node = bvh.nodes[stack[--top]];
+		Float4 t_near;
+		if (!any(hit_box(node, ray.origin, ray.inv_dir, ray.t, t_near) & ray.active))
+			continue;
+
+		if (node.count > 0)
+		{
+			for (int i = node.first; i < node.first + node.count; i++)
+			{
+				Float4 t, u, v;
+				Float4 mask = hit_triangle(bvh.triangles[i], ray.origin, ray.dir, Float4(0.0f), ray.t, t, u, v) & ray.active;
+				int lanes = bits(mask);
+				if (lanes == 0)
+					continue;
+				ray.t = select(mask, t, ray.t);
+				ray.u = select(mask, u, ray.u);
+				ray.v = select(mask, v, ray.v);
+				for (int k = 0; k < 4; k++)
+					if (lanes & (1 << k))
+						ray.triangle[k] = i;
+			}
+			continue;
+		}
+
+		// Visit the child the packet reaches first first, so the far one is culled by closer hits
+		Float4 near_left, near_right;
+		Float4 left = hit_box(bvh.nodes[node.first], ray.origin, ray.inv_dir, ray.t, near_left) & ray.active;
+		Float4 right = hit_box(bvh.nodes[node.first + 1], ray.origin, ray.inv_dir, ray.t, near_right) & ray.active;
+		bool hit_left = any(left), hit_right = any(right);
+		if (hit_left && hit_right)
+		{
+			bool left_first = bits((near_left <= near_right) & left) != 0;
+			stack[top++] = left_first ? node.first + 1 : node.first;
+			stack[top++] = left_first ? node.first : node.first + 1;
+		}
+		else if (hit_left)
+			stack[top++] = node.first;
+		else if (hit_right)
+			stack[top++] = node.first + 1;
+	}
+}
+
+// Lanes of active whose segment from origin to origin + t_max * dir hits anything
+static Float4 trace_shadow(const Bvh& bvh, const Float4x3& origin, const Float4x3& dir, Float4 t_max, Float4 active)
+{
+	Float4 blocked(0.0f);
+	if (bvh.nodes.empty() || !any(active))
+		return blocked;
+	Float4x3 inv_dir(Float4(1.0f) / dir.x, Float4(1.0f) / dir.y, Float4(1.0f) / dir.z);
+	int want = bits(active);
+
+	int stack[MAX_DEPTH + 2];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		const BvhNode& node = bvh.nodes[stack[--top]];
+		Float4 t_near;
+		Float4 open = select(blocked, Float4(0.0f), active);
+		if (!any(hit_box(node, origin, inv_dir, t_max, t_near) & open))
+			continue;
+		if (node.count == 0)
+		{
+			stack[top++] = node.first + 1;
+			stack[top++] = node.first;
+			continue;
+		}
+		for (int i = node.first; i < node.first + node.count; i++)
+		{
+			Float4 t, u, v;
+			blocked = blocked | (hit_triangle(bvh.triangles[i], origin, dir, Float4(SHADOW_EPSILON), t_max, t, u, v) & open);
+			// Any hit will do
+			if ((bits(blocked) & want) == want)
+				return blocked;
+		}
+	}
+	return blocked;
+}
+
+static int lane_count(int lanes)
+{
+	return (lanes & 1) + ((lanes >> 1) & 1) + ((lanes >> 2) & 1) + ((lanes >> 3) & 1);
+}
+
+static float halton(int index, int base)
+{
+	float result = 0.0f, f = 1.0f;
+	while (index > 0)
+	{
+		f /= base;
+		result += f * (index % base);
+		index /= base;
+	}
+	return result;
+}
+
+static Float4x3 transform_point(const glm::mat4& m, const Float4x3& p)
+{
+	return Float4x3(Float4(m[0][0]) * p.x + Float4(m[1][0]) * p.y + Float4(m[2][0]) * p.z + Float4(m[3][0]),
+		Float4(m[0][1]) * p.x + Float4(m[1][1]) * p.y + Float4(m[2][1]) * p.z + Float4(m[3][1]),
+		Float4(m[0][2]) * p.x + Float4(m[1][2]) * p.y + Float4(m[2][2]) * p.z + Float4(m[3][2]));
+}
+
+static Float4x3 transform_vector(const glm::mat3& m, const Float4x3& d)
+{
+	return Float4x3(Float4(m[0][0]) * d.x + Float4(m[1][0]) * d.y + Float4(m[2][0]) * d.z,
+		Float4(m[0][1]) * d.x + Float4(m[1][1]) * d.y + Float4(m[2][1]) * d.z,
+		Float4(m[0][2]) * d.x + Float4(m[1][2]) * d.y + Float4(m[2][2]) * d.z);
+}
+
+// Unprojects NDC points on the near and far planes, with the perspective divide
+static Float4x3 unproject(const glm::mat4& m, Float4 x, Float4 y, float z)
+{
+	Float4 w = Float4(m[0][3]) * x + Float4(m[1][3]) * y + Float4(m[2][3] * z + m[3][3]);
+	Float4 inv_w = Float4(1.0f) / w;
+	return Float4x3((Float4(m[0][0]) * x + Float4(m[1][0]) * y + Float4(m[2][0] * z + m[3][0])) * inv_w,
+		(Float4(m[0][1]) * x + Float4(m[1][1]) * y + Float4(m[2][1] * z + m[3][1])) * inv_w,
+		(Float4(m[0][2]) * x + Float4(m[1][2]) * y + Float4(m[2][2] * z + m[3][2])) * inv_w);
+}
+
+struct FrameSetup
+{
+	const OBJObject* object;
+	const Bvh* bvh;
+	glm::mat4 inverse_view_projection;
+	glm::mat4 model, inverse_model;
+	glm::mat3 normal_matrix, inverse_model3;
+	PhongParams phong;
+	float jitter_x, jitter_y;
+};
+
+// Shadow rays toward one light for the lanes in active. Points and directions are in world space.
+static Float4 light_visible(const FrameSetup& f, const Float4x3& position, const Float4x3& to_light, Float4 t_max,
+	Float4 active, unsigned long long& rays)
+{
+	if (!any(active))
+		return Float4(1.0f);
+	rays += lane_count(bits(active));
+	Float4x3 origin = transform_point(f.inverse_model, position);
+	Float4x3 dir = transform_vector(f.inverse_model3, to_light);
+	Float4 blocked = trace_shadow(*f.bvh, origin, dir, t_max, active);
+	return select(blocked, Float4(0.0f), Float4(1.0f));
+}
+
+static void trace_tile(const FrameSetup& f, int tile)
+{
+	int tiles_x = (tracer_width + RayTracer::TILE_SIZE - 1) / RayTracer::TILE_SIZE;
+	int x0 = (tile % tiles_x) * RayTracer::TILE_SIZE, y0 = (tile / tiles_x) * RayTracer::TILE_SIZE;
+	int x1 = std::min(x0 + RayTracer::TILE_SIZE, tracer_width), y1 = std::min(y0 + RayTracer::TILE_SIZE, tracer_height);
+	unsigned long long rays = 0;
+	const PhongParams& s = f.phong;
+	Float4 zero(0.0f), one(1.0f);
+
+	// 2x2 pixel packets, lanes in the order (x, y), (x + 1, y), (x, y + 1), (x + 1, y + 1)
+	for (int y = y0; y < y1; y += 2)
+	{
+		for (int x = x0; x < x1; x += 2)
+		{
+			int px[4] = { x, x + 1, x, x + 1 };
+			int py[4] = { y, y, y + 1, y + 1 };
+			float lane_active[4];
+			for (int k = 0; k < 4; k++)
+				lane_active[k] = (px[k] < x1 && py[k] < y1) ? 1.0f : 0.0f;
+			Float4 active = Float4::load(lane_active) > zero;
+
+			Float4 ndc_x = (Float4((float)x + f.jitter_x) + Float4(0.0f, 1.0f, 0.0f, 1.0f)) * Float4(2.0f / tracer_width) - one;
+			Float4 ndc_y = (Float4((float)y + f.jitter_y) + Float4(0.0f, 0.0f, 1.0f, 1.0f)) * Float4(2.0f / tracer_height) - one;
+			Float4x3 near_point = unproject(f.inverse_view_projection, ndc_x, ndc_y, -1.0f);
+			Float4x3 far_point = unproject(f.inverse_view_projection, ndc_x, ndc_y, 1.0f);
+			Float4x3 world_dir = far_point - near_point;
+
+			Float4x3 color(0.0f, 0.0f, 0.0f);
+			if (f.object)
+			{
+				// The BVH is in object space. Transforming the ray keeps t the same in both spaces.
+				RayPacket ray;
+				ray.origin = transform_point(f.inverse_model, near_point);
+				ray.dir = transform_vector(f.inverse_model3, world_dir);
+				ray.inv_dir = Float4x3(one / ray.dir.x, one / ray.dir.y, one / ray.dir.z);
+				ray.active = active;
+				ray.t = Float4(1.0f);
+				ray.u = ray.v = zero;
+				rays += lane_count(bits(active));
+				trace_closest(*f.bvh, ray);
+
+				float hit_lane[4], n[3][4];
+				float u[4], v[4];
+				ray.u.store(u);
+				ray.v.store(v);
+				for (int k = 0; k < 4; k++)
+				{
+					hit_lane[k] = ray.triangle[k] >= 0 ? 1.0f : 0.0f;
+					glm::vec3 normal(0.0f, 0.0f, 1.0f);
+					if (ray.triangle[k] >= 0)
+					{
+						unsigned int triangle = f.bvh->triangles[ray.triangle[k]].index;
+						const std::vector<glm::vec3>& normals = f.object->mesh->normals;
+						GLuint i0 = f.object->mesh->indices[3 * triangle], i1 = f.object->mesh->indices[3 * triangle + 1], i2 = f.object->mesh->indices[3 * triangle + 2];
+						if (i0 < normals.size() && i1 < normals.size() && i2 < normals.size())
+							normal = normals[i0] * (1.0f - u[k] - v[k]) + normals[i1] * u[k] + normals[i2] * v[k];
+					}
+					n[0][k] = normal.x;
+					n[1][k] = normal.y;
+					n[2][k] = normal.z;
+				}
+				Float4 hit = Float4::load(hit_lane) > zero;
+
+				if (any(hit))
+				{
+					Float4x3 position = near_point + world_dir * ray.t;
+					Float4x3 normal = transform_vector(f.normal_matrix, Float4x3(Float4::load(n[0]), Float4::load(n[1]), Float4::load(n[2])));
+					Float4 visible_d = one, visible_p = one, visible_s = one;
+					if (s.lights_on)
+					{
+						visible_d = light_visible(f, position, s.d_dir, Float4(FLT_MAX), hit, rays);
+						visible_p = light_visible(f, position, s.p_position - position, one, hit, rays);
+						// Only where the spot cone reaches
+						Float4x3 to_spot = s.s_position - position;
+						Float4 in_cone = dot(normalize(to_spot), s.s_dir) > s.outer_cut_off;
+						visible_s = light_visible(f, position, to_spot, one, hit & in_cone, rays);
+					}
+					color = select(hit, phong_shade(s, normal, position, visible_d, visible_p, visible_s), color);
+				}
+			}
+
+			float r[4], g[4], b[4];
+			color.x.store(r);
+			color.y.store(g);
+			color.z.store(b);
+			for (int k = 0; k < 4; k++)
+			{
+				if (lane_active[k] == 0.0f)
+					continue;
+				size_t pixel = (size_t)py[k] * tracer_width + px[k];
+				float* sum = &tracer_accum[3 * pixel];
+				// Clamp before accumulating, like the framebuffer does per sample
+				sum[0] += std::min(std::max(r[k], 0.0f), 1.0f);
+				sum[1] += std::min(std::max(g[k], 0.0f), 1.0f);
+				sum[2] += std::min(std::max(b[k], 0.0f), 1.0f);
+				float scale = 255.0f / (tracer_samples + 1);
+				tracer_color[pixel] = (uint32_t)(sum[0] * scale + 0.5f) | ((uint32_t)(sum[1] * scale + 0.5f) << 8) |
+					((uint32_t)(sum[2] * scale + 0.5f) << 16) | 0xFF000000u;
+			}
+		}
+	}
+	tracer_pass_rays += rays;
+}
+
+static bool same_matrix(const glm::mat4& a, const glm::mat4& b)
+{
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < 4; j++)
+			if (a[i][j] != b[i][j])
+				return false;
+	return true;
+}
+
+static bool same_light(const Light& a, const Light& b)
+{
+	return a.d_direction == b.d_direction && a.d_ambient == b.d_ambient && a.d_diffuse == b.d_diffuse &&
+		a.d_specular == b.d_specular && a.p_position == b.p_position && a.light_color == b.light_color &&
+		a.s_position == b.s_position && a.s_direction == b.s_direction && a.s_ambient == b.s_ambient &&
+		a.s_diffuse == b.s_diffuse && a.s_specular == b.s_specular && a.attenuation == b.attenuation &&
+		a.lights_on == b.lights_on && a.cos_cutOff == b.cos_cutOff && a.cos_outerCutOff == b.cos_outerCutOff;
+}
+
+void RayTracer::initialize(int threads, bool present)
+{
+	if (threads <= 0)
+		threads = std::max(1, (int)std::thread::hardware_concurrency());
+	tracer_present = present;
+
+	tracer_pool.quit = false;
+	tracer_pool.generation = 0;
+	tracer_pool.threads = threads;
+	tracer_pool.queues.reset(new TileQueue[threads]);
+	for (int i = 1; i < threads; i++)
+		tracer_pool.workers.push_back(std::thread(tracer_worker, i));
+	printf("Ray tracer running on %d threads\n", threads);
+}
+
+void RayTracer::resize(int width, int height)
+{
+	tracer_width = std::max(width, 1);
+	tracer_height = std::max(height, 1);
+	tracer_accum.assign((size_t)tracer_width * tracer_height * 3, 0.0f);
+	tracer_color.assign((size_t)tracer_width * tracer_height, 0xFF000000u);
+	tracer_samples = 0;
+}
+
+void RayTracer::render(const OBJObject* object, const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection,
+	const Light& light)
+{
+	if (tracer_width == 0 || !tracer_pool.queues)
+		return;
+
+	if (object != tracer_object || !same_matrix(model, tracer_model) || !same_matrix(view, tracer_view) ||
+		!same_matrix(projection, tracer_projection) || !same_light(light, tracer_light))
+	{
+		tracer_object = object;
+		tracer_model = model;
+		tracer_view = view;
+		tracer_projection = projection;
+		tracer_light = light;
+		std::fill(tracer_accum.begin(), tracer_accum.end(), 0.0f);
+		tracer_samples = 0;
+	}
+	if (tracer_samples >= max_samples)
+		return;
+
+	FrameSetup f;
+	f.object = object;
+	f.bvh = object ? &get_bvh(*object) : NULL;
+	if (f.bvh && f.bvh->nodes.empty())
+		f.object = NULL;
+	f.inverse_view_projection = glm::inverse(projection * view);
+	f.model = model;
+	f.inverse_model = glm::inverse(model);
+	f.inverse_model3 = glm::mat3(f.inverse_model);
+	f.normal_matrix = glm::mat3(glm::transpose(f.inverse_model));
+	if (object)
+		f.phong = phong_params(*object, light);
+	// The first sample goes through pixel centers, later ones spread over the pixel
+	f.jitter_x = tracer_samples == 0 ? 0.5f : halton(tracer_samples, 2);
+	f.jitter_y = tracer_samples == 0 ? 0.5f : halton(tracer_samples, 3);
+
+	int tiles = ((tracer_width + TILE_SIZE - 1) / TILE_SIZE) * ((tracer_height + TILE_SIZE - 1) / TILE_SIZE);
+	tracer_pass_rays = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for_each_tile(tiles, [&](int tile) { trace_tile(f, tile); });
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	tracer_samples++;
+
+	unsigned long long rays = tracer_pass_rays;
+	tracer_total_rays += rays;
+	tracer_total_seconds += seconds;
+	tracer_last_rays_per_second = seconds > 0.0 ? rays / seconds : 0.0;
+}
+
+void RayTracer::present()
+{
+	if (tracer_present)
+		SoftwareRasterizer::present(tracer_color.data(), tracer_width, tracer_height, tracer_width);
+}
+
+bool RayTracer::save_ppm(const char* path)
+{
+	return SoftwareRasterizer::save_ppm(path, tracer_color.data(), tracer_width, tracer_height, tracer_width);
+}
+
+int RayTracer::samples()
+{
+	return tracer_samples;
+}
+
+double RayTracer::rays_per_second()
+{
+	return tracer_total_seconds > 0.0 ? tracer_total_rays / tracer_total_seconds : 0.0;
+}
+
+std::string RayTracer::overlay_text()
+{
+	if (!tracer_pool.queues)
+		return std::string();
+	char text[64];
+	snprintf(text, sizeof(text), "%.1f Mrays/s, %d spp", tracer_last_rays_per_second / 1e6, tracer_samples);
+	return text;
+}
+
+void RayTracer::print_summary()
+{
+	if (tracer_total_rays == 0)
+		return;
+	printf("Ray tracer: %.1f million rays in %.3f s, %.2f Mrays/s on %d threads\n", tracer_total_rays / 1e6,
+		tracer_total_seconds, rays_per_second() / 1e6, tracer_pool.threads);
+}
+
+void RayTracer::clean_up()
+{
+	if (!tracer_pool.workers.empty())
+	{
+		{
+			std::lock_guard<std::mutex> lock(tracer_pool.mutex);
+			tracer_pool.quit = true;
+		}
+		tracer_pool.wake.notify_all();
+		for (size_t i = 0; i < tracer_pool.workers.size(); i++)
+			tracer_pool.workers[i].join();
+		tracer_pool.workers.clear();
+	}
+	tracer_pool.queues.reset();
+	tracer_bvhs.clear();
+	tracer_object = NULL;
+}
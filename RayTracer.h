@@ -0,0 +1,38 @@
+#ifndef _RAYTRACER_H_
+#define _RAYTRACER_H_
+
+#include "OBJObject.h"
+#include "Light.h"
+#include <string>
+
+// Reference renderer for checking the lighting and for stills. Traces the scene on the CPU with the
+// lighting of shader.frag plus hard shadows from all three lights. Each mesh gets a flat BVH in
+// object space the first time it is drawn, shared by the objects that share the mesh. Rays are
+// traced in 2x2 packets with SIMD, tiles are shared out to all cores with work stealing, and every
+// render() adds one jittered sample per pixel, so the image refines as long as the scene stays the same.
+class RayTracer
+{
+public:
+	static const int TILE_SIZE = 16;
+	static int max_samples;		// render() stops adding samples once the image has this many
+
+	// threads = 0 uses every core. With present the image can be shown in the window with present().
+	static void initialize(int threads, bool present);
+	static void resize(int width, int height);
+	// Adds a sample per pixel. Starts over when the object, its transform, the camera or the light changed.
+	// object may be NULL for an empty scene.
+	static void render(const OBJObject* object, const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection,
+		const Light& light);
+	// Draws the image into the bound framebuffer through a texture, needs a GL context
+	static void present();
+	static bool save_ppm(const char* path);
+
+	static int samples();
+	// Primary and shadow rays per second of tracing, over all samples so far
+	static double rays_per_second();
+	static std::string overlay_text();
+	static void print_summary();
+	static void clean_up();
+};
+
+#endif
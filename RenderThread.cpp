@@ -0,0 +1,114 @@
+#define _CRT_SECURE_NO_DEPRECATE
+#include "RenderThread.h"
+#include "SPSCQueue.h"
+#include "TripleBuffer.h"
+#include "Window.h"
+#include "Tracer.h"
+#include <thread>
+#include <mutex>
+
+SPSCQueue<RenderCommand, 64> render_commands;
+TripleBuffer<SceneSnapshot> render_snapshots;
+std::thread render_thread;
+GLFWwindow* render_window = NULL;
+bool render_running = false;
+
+// The title bar can only be set from the main thread, the text comes from here
+std::mutex overlay_mutex;
+std::string overlay;
+
+static void render_loop()
+{
+	Tracer::name_thread("render");
+	glfwMakeContextCurrent(render_window);
+
+	double last_overlay = 0.0;
+	for (;;)
+	{
+		RenderCommand command;
+		bool quit = false;
+		while (!quit && render_commands.pop(command))
+		{
+			if (command.type == RenderCommand::QUIT)
+				quit = true;
+			else
+				Window::execute(command);
+		}
+		if (quit)
+			break;
+
+		// Latest state from the main thread, or the previous one again if nothing changed.
+		// In low latency mode this is taken as late as the frame cost allows.
+		FramePacer::wait();
+		bool fresh = render_snapshots.update();
+		SceneSnapshot& scene = render_snapshots.read_buffer();
+		Window::render(scene);
+
+		if (glfwGetTime() - last_overlay > 0.5)
+		{
+			last_overlay = glfwGetTime();
+			std::string text = Window::overlay_text();
+			std::lock_guard<std::mutex> lock(overlay_mutex);
+			overlay.swap(text);
+		}
+
+		FramePacer::finish_frame();
+		// Blocks this thread on vsync, the main thread keeps running
+		glfwSwapBuffers(render_window);
+		// A snapshot drawn again has no new input to measure
+		FramePacer::presented(fresh ? scene.input_time : 0.0);
+	}
+
+	glfwMakeContextCurrent(NULL);
+}
+
+void RenderThread::start(GLFWwindow* window)
+{
+	if (render_running)
+		return;
+
+	render_window = window;
+	publish(Window::snapshot());
+
+	// A context can only be current on one thread at a time
+	glfwMakeContextCurrent(NULL);
+	render_running = true;
+	render_thread = std::thread(render_loop);
+}
+
+void RenderThread::stop()
+{
+	if (!render_running)
+		return;
+
+	RenderCommand command = RenderCommand();
+	command.type = RenderCommand::QUIT;
+	submit(command);
+	render_thread.join();
+	render_running = false;
+
+	glfwMakeContextCurrent(render_window);
+}
+
+bool RenderThread::running()
+{
+	return render_running;
+}
+
+void RenderThread::submit(const RenderCommand& command)
+{
+	while (!render_commands.push(command))
+		std::this_thread::yield();
+}
+
+void RenderThread::publish(const SceneSnapshot& scene)
+{
+	render_snapshots.write_buffer() = scene;
+	render_snapshots.publish();
+}
+
+std::string RenderThread::overlay_text()
+{
+	std::lock_guard<std::mutex> lock(overlay_mutex);
+	return overlay;
+}
@@ -0,0 +1,45 @@
+#ifndef _RENDERTHREAD_H_
+#define _RENDERTHREAD_H_
+
+#define GLFW_INCLUDE_GLEXT
+#ifdef __APPLE__
+#define GLFW_INCLUDE_GLCOREARB
+#else
+#include <GL/glew.h>
+#endif
+#include <GLFW/glfw3.h>
+#include <string>
+
+struct SceneSnapshot;
+
+// Work that needs the GL context but is triggered by input on the main thread
+struct RenderCommand
+{
+	enum Type { RESIZE, START_CAPTURE, STOP_CAPTURE, TOGGLE_CAPTURE, ENABLE_PROFILER, TOGGLE_LOW_LATENCY,
+		TOGGLE_OCCLUSION, CYCLE_HIZ_VIEW, CYCLE_PREPASS, QUIT };
+
+	Type type;
+	int width, height;		// RESIZE
+	const char* path;		// START_CAPTURE and TOGGLE_CAPTURE, must outlive the command
+};
+
+// Renders on its own thread, which owns the window's GL context while it runs.
+// The main thread keeps handling events and updates, sends commands through a lock-free queue
+// and publishes scene snapshots, so slow frames don't delay input and input doesn't delay frames.
+class RenderThread
+{
+public:
+	static void start(GLFWwindow* window);
+	// Finishes the current frame and makes the context current on the calling thread again
+	static void stop();
+	static bool running();
+
+	// Main thread only. Only waits if the render thread fell a whole queue behind.
+	static void submit(const RenderCommand& command);
+	static void publish(const SceneSnapshot& scene);
+
+	// GPU profiler overlay, refreshed by the render thread
+	static std::string overlay_text();
+};
+
+#endif
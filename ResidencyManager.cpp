@@ -0,0 +1,219 @@
+#define _CRT_SECURE_NO_DEPRECATE
+#include "ResidencyManager.h"
+#include "MeshStreamer.h"
+#include <stdio.h>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+size_t ResidencyManager::cpu_budget = 0;
+size_t ResidencyManager::gpu_budget = 0;
+
+struct ResidentMesh {
+	Mesh* mesh;
+	unsigned long long last_used;
+	unsigned long long last_frame;		// res_frame of the last use, 0 for none
+	bool failed;						// Could not be read again, no longer drawn
+};
+
+std::vector<ResidentMesh> res_meshes;
+unsigned long long res_clock = 0;		// Counts uses, so the smallest last_used is the least recent
+unsigned long long res_frame = 1;
+ResidencyStats res_stats = ResidencyStats();
+bool res_warned = false;
+
+static const double MB = 1024.0 * 1024.0;
+
+static ResidentMesh* find(Mesh* mesh)
+{
+	for (size_t i = 0; i < res_meshes.size(); i++)
+		if (res_meshes[i].mesh == mesh)
+			return &res_meshes[i];
+	return NULL;
+}
+
+static size_t total_bytes(bool gpu)
+{
+	size_t total = 0;
+	for (size_t i = 0; i < res_meshes.size(); i++)
+		total += gpu ? res_meshes[i].mesh->gpu_bytes() : res_meshes[i].mesh->cpu_bytes();
+	return total;
+}
+
+static void update_peaks()
+{
+	res_stats.cpu_peak = std::max(res_stats.cpu_peak, total_bytes(false));
+	res_stats.gpu_peak = std::max(res_stats.gpu_peak, total_bytes(true));
+}
+
+// Drops the least recently used copies until the budget holds. keep and the meshes drawn this
+// frame are never dropped, even if they alone are over the budget.
+static void enforce(bool gpu, Mesh* keep)
+{
+	size_t budget = gpu ? ResidencyManager::gpu_budget : ResidencyManager::cpu_budget;
+	if (budget == 0)
+		return;
+	while (total_bytes(gpu) > budget)
+	{
+		ResidentMesh* oldest = NULL;
+		for (size_t i = 0; i < res_meshes.size(); i++)
+		{
+			Mesh* mesh = res_meshes[i].mesh;
+			bool resident = gpu ? mesh->has_gpu() : mesh->has_cpu();
+			if (mesh != keep && res_meshes[i].last_frame != res_frame && resident && !mesh->path.empty()
+				&& (oldest == NULL || res_meshes[i].last_used < oldest->last_used))
+				oldest = &res_meshes[i];
+		}
+		if (oldest == NULL)
+		{
+			if (!res_warned)
+				fprintf(stderr, "%s memory budget of %.1f MB is too small for the meshes of one frame, now using %.1f MB\n",
+					gpu ? "GPU" : "CPU", budget / MB, total_bytes(gpu) / MB);
+			res_warned = true;
+			return;
+		}
+		if (gpu)
+		{
+			MeshStreamer::cancel(oldest->mesh);
+			oldest->mesh->release_gpu();
+		}
+		else
+			oldest->mesh->release_cpu();
+		res_stats.evictions++;
+	}
+}
+
+static bool reload(Mesh* mesh)
+{
+	auto start = std::chrono::steady_clock::now();
+	if (!mesh->parse(mesh->path.c_str()))
+		return false;
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	printf("Reloaded %s (%.1f MB) in %.0f ms\n", mesh->path.c_str(), mesh->cpu_bytes() / MB, ms);
+	res_stats.reloads++;
+	return true;
+}
+
+static bool reload_to_gpu(Mesh* mesh)
+{
+	if (MeshStreamer::open(mesh))
+		return true;
+	auto start = std::chrono::steady_clock::now();
+	if (!mesh->upload_from_file())
+		return false;
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	printf("Reloaded %s (%.1f MB) straight into GL buffers in %.0f ms\n", mesh->path.c_str(), mesh->gpu_bytes() / MB, ms);
+	res_stats.reloads++;
+	return true;
+}
+
+void ResidencyManager::add(Mesh* mesh)
+{
+	if (find(mesh) != NULL)
+		return;
+	ResidentMesh entry = { mesh, ++res_clock, 0, false };
+	res_meshes.push_back(entry);
+	// Only the buffers are drawn from once they exist
+	if (mesh->has_gpu())
+		mesh->release_cpu();
+	update_peaks();
+	enforce(true, mesh);
+	enforce(false, mesh);
+}
+
+void ResidencyManager::begin_frame()
+{
+	res_frame++;
+}
+
+bool ResidencyManager::use(Mesh* mesh, bool gpu)
+{
+	ResidentMesh* entry = find(mesh);
+	if (entry == NULL)
+	{
+		add(mesh);
+		entry = find(mesh);
+	}
+	entry->last_used = ++res_clock;
+	entry->last_frame = res_frame;
+	if (entry->failed)
+		return false;
+
+	bool changed = false;
+	if (!mesh->has_cpu() && !(gpu && mesh->has_gpu()) && !mesh->path.empty())
+	{
+		// A .mesh file decodes straight into new buffers, without the CPU copy, or streams in if progressive
+		if (gpu && reload_to_gpu(mesh))
+			res_stats.uploads++;
+		else if (!reload(mesh))
+		{
+			fprintf(stderr, "Cannot read %s again, it is no longer drawn\n", mesh->path.c_str());
+			entry->failed = true;
+			return false;
+		}
+		changed = true;
+	}
+	if (gpu && !mesh->has_gpu())
+	{
+		mesh->upload();
+		mesh->release_cpu();
+		res_stats.uploads++;
+		changed = true;
+	}
+	if (!changed)
+		return true;
+	update_peaks();
+	enforce(gpu, mesh);
+	return true;
+}
+
+void ResidencyManager::remove(Mesh* mesh)
+{
+	for (size_t i = 0; i < res_meshes.size(); i++)
+	{
+		if (res_meshes[i].mesh == mesh)
+		{
+			res_meshes.erase(res_meshes.begin() + i);
+			return;
+		}
+	}
+}
+
+ResidencyStats ResidencyManager::stats()
+{
+	ResidencyStats stats = res_stats;
+	stats.cpu_bytes = total_bytes(false);
+	stats.gpu_bytes = total_bytes(true);
+	stats.cpu_budget = cpu_budget;
+	stats.gpu_budget = gpu_budget;
+	stats.meshes = (int)res_meshes.size();
+	stats.cpu_resident = stats.gpu_resident = 0;
+	for (size_t i = 0; i < res_meshes.size(); i++)
+	{
+		stats.cpu_resident += res_meshes[i].mesh->has_cpu();
+		stats.gpu_resident += res_meshes[i].mesh->has_gpu();
+	}
+	return stats;
+}
+
+std::string ResidencyManager::overlay_text()
+{
+	if (res_meshes.empty())
+		return std::string();
+	ResidencyStats s = stats();
+	char text[128];
+	snprintf(text, sizeof(text), "meshes %.1f MB GPU, %.1f MB CPU, %d evicted", s.gpu_bytes / MB, s.cpu_bytes / MB,
+		s.evictions);
+	return text;
+}
+
+void ResidencyManager::print_summary()
+{
+	if (res_meshes.empty())
+		return;
+	ResidencyStats s = stats();
+	printf("Mesh memory: peak %.1f MB GPU, %.1f MB CPU", s.gpu_peak / MB, s.cpu_peak / MB);
+	if (gpu_budget > 0 || cpu_budget > 0)
+		printf(" (budgets %.1f MB GPU, %.1f MB CPU, 0 for none)", gpu_budget / MB, cpu_budget / MB);
+	printf(", %d evictions, %d reloads, %d uploads\n", s.evictions, s.reloads, s.uploads);
+}
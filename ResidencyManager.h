@@ -0,0 +1,43 @@
+#ifndef _RESIDENCYMANAGER_H_
+#define _RESIDENCYMANAGER_H_
+
+#include "Mesh.h"
+#include <string>
+
+struct ResidencyStats {
+	size_t cpu_bytes, gpu_bytes;
+	size_t cpu_peak, gpu_peak;
+	size_t cpu_budget, gpu_budget;	// 0 for none
+	int meshes, cpu_resident, gpu_resident;
+	int uploads, reloads, evictions;
+};
+
+// Keeps the meshes within a CPU and a GPU memory budget. The GL renderer only needs the buffers,
+// so the CPU copy of a mesh is dropped as soon as it is uploaded; the CPU renderers only need the
+// CPU copy. When a budget is exceeded the least recently drawn meshes lose their copy, and a mesh
+// that is drawn again is read back from its file and uploaded again on the spot. Meshes drawn in the
+// current frame are never evicted, so a budget below what one frame draws is exceeded rather than
+// reloading meshes within every frame.
+class ResidencyManager
+{
+public:
+	static size_t cpu_budget;		// Bytes, 0 for no limit. --cpu-budget and --gpu-budget take MB.
+	static size_t gpu_budget;
+
+	// Before the first use of a frame
+	static void begin_frame();
+	// Starts tracking mesh, which must have been parsed from a file. AssetManager adds every mesh it loads.
+	static void add(Mesh* mesh);
+	// Makes mesh ready to draw, through GL or on the CPU, and marks it as just used. Needs the
+	// GL context for gpu. May evict other meshes. False if the mesh had to be read again and could
+	// not be; it is not tried again and must not be drawn.
+	static bool use(Mesh* mesh, bool gpu);
+	// Stops tracking mesh, before it is freed
+	static void remove(Mesh* mesh);
+
+	static ResidencyStats stats();
+	static std::string overlay_text();
+	static void print_summary();
+};
+
+#endif
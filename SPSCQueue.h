@@ -0,0 +1,44 @@
+#ifndef _SPSCQUEUE_H_
+#define _SPSCQUEUE_H_
+
+#include <atomic>
+#include <stddef.h>
+
+// Bounded single producer, single consumer queue. Neither side ever takes a lock or waits for
+// the other: push fails when the queue is full, pop when it is empty.
+template <typename T, size_t Capacity>
+class SPSCQueue
+{
+public:
+	SPSCQueue() : head(0), tail(0) {}
+
+	// Producer thread only
+	bool push(const T& item)
+	{
+		size_t t = tail.load(std::memory_order_relaxed);
+		if (t - head.load(std::memory_order_acquire) == Capacity)
+			return false;
+		items[t % Capacity] = item;
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer thread only
+	bool pop(T& item)
+	{
+		size_t h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire))
+			return false;
+		item = items[h % Capacity];
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+private:
+	// Separate cache lines, so the two threads don't keep stealing them from each other
+	alignas(64) std::atomic<size_t> head;
+	alignas(64) std::atomic<size_t> tail;
+	T items[Capacity];
+};
+
+#endif
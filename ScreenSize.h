@@ -0,0 +1,62 @@
+#ifndef _SCREENSIZE_H_
+#define _SCREENSIZE_H_
+
+// Use of degrees is deprecated. Use radians instead.
+#ifndef GLM_FORCE_RADIANS
+#define GLM_FORCE_RADIANS
+#endif
+#include <glm/mat4x4.hpp>
+#include <glm/geometric.hpp>
+#include <algorithm>
+
+// How large something is on screen, the measure every level of detail is chosen by: point cloud
+// nodes by PointCloud, lighting by ShadingLod. Sizes are in pixels of the current viewport.
+// Also whether it is on screen at all, for the culling of PointCloud and OcclusionCuller.
+
+// Pixels covered by one world unit at distance 1 in front of a perspective camera
+inline float pixels_at_unit_distance(const glm::mat4& projection, int viewport_height)
+{
+	return projection[1][1] * viewport_height * 0.5f;
+}
+
+// Distance from the eye to the nearest point of a sphere with its center in view space, never zero
+inline float sphere_distance(const glm::vec3& view_center, float radius)
+{
+	return std::max(glm::length(view_center) - radius, 1e-3f);
+}
+
+// Radius in pixels of a sphere, an upper bound that holds wherever it is in the view
+inline float screen_radius(const glm::vec3& view_center, float radius, float pixels)
+{
+	return radius * pixels / sphere_distance(view_center, radius);
+}
+
+// Largest scale of the axes of a model matrix, for radii measured in object space
+inline float max_scale(const glm::mat4& model)
+{
+	return std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])),
+		glm::length(glm::vec3(model[2]))));
+}
+
+// True if the box is certainly outside the view of mvp, its model view projection matrix
+inline bool outside_frustum(const glm::vec3& min, const glm::vec3& max, const glm::mat4& mvp)
+{
+	// Only if all corners are beyond the same clip plane
+	int outside[6] = { 0 };
+	for (int i = 0; i < 8; i++)
+	{
+		glm::vec4 clip = mvp * glm::vec4(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z, 1.0f);
+		outside[0] += clip.x < -clip.w;
+		outside[1] += clip.x > clip.w;
+		outside[2] += clip.y < -clip.w;
+		outside[3] += clip.y > clip.w;
+		outside[4] += clip.z < -clip.w;
+		outside[5] += clip.z > clip.w;
+	}
+	for (int plane = 0; plane < 6; plane++)
+		if (outside[plane] == 8)
+			return true;
+	return false;
+}
+
+#endif
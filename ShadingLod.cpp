@@ -0,0 +1,315 @@
+#define _CRT_SECURE_NO_DEPRECATE
+#include "ShadingLod.h"
+#include "ScreenSize.h"
+#include "GLState.h"
+#include "Tracer.h"
+#include "shader.h"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+float ShadingLod::pixel_threshold = 48.0f;
+size_t ShadingLod::cache_budget = 64 * 1024 * 1024;
+
+const int LOD_LIGHT_VALUES = 38;
+const int LOD_MATERIAL_VALUES = 10;
+
+// One draw of a frame and the colors cached for it
+struct LodSlot {
+	ShadingLod::Level level;	// Last picked, for the hysteresis
+	int last_cached;			// Frame it was last drawn from the cache
+	GLuint colors, vao;
+	size_t bytes;
+	// What the colors were captured for
+	OBJObject* object;
+	uint64_t upload_id;
+	size_t index_first;
+	GLsizei index_count;
+	glm::mat4 model;
+	float material[LOD_MATERIAL_VALUES];
+	int light_version;
+};
+
+bool lod_enabled = false;
+ShaderHandle lod_vertex_handle, lod_cached_handle;
+std::string lod_vertex_path;
+GLuint lod_capture = 0;
+bool lod_capture_failed = false;
+std::vector<LodSlot> lod_slots;
+size_t lod_next = 0;			// Slot of the next prepare this frame
+size_t lod_cache_bytes = 0;
+int lod_frame = 0;
+
+// The lights of this frame, and a version that changes with any of their values
+Light lod_light;
+float lod_light_values[LOD_LIGHT_VALUES];
+int lod_light_version = 0;
+int lod_vertex_lights = -1, lod_capture_lights = -1;	// Version each program's uniforms were set for
+
+// Draws per level, this frame for the overlay and in total
+int lod_frame_draws[ShadingLod::LEVELS], lod_last_draws[ShadingLod::LEVELS];
+unsigned long long lod_draws[ShadingLod::LEVELS];
+unsigned long long lod_captures = 0;
+size_t lod_peak_bytes = 0;
+
+static void light_values(const Light& light, float values[LOD_LIGHT_VALUES])
+{
+	const glm::vec3* vectors[] = { &light.d_direction, &light.d_ambient, &light.d_diffuse, &light.d_specular,
+		&light.p_position, &light.light_color, &light.s_position, &light.s_direction, &light.s_ambient,
+		&light.s_diffuse, &light.s_specular };
+	int n = 0;
+	for (int i = 0; i < 11; i++)
+	{
+		values[n++] = vectors[i]->x;
+		values[n++] = vectors[i]->y;
+		values[n++] = vectors[i]->z;
+	}
+	values[n++] = (float)light.cos_exp;
+	values[n++] = light.attenuation;
+	values[n++] = (float)light.lights_on;
+	values[n++] = light.cos_cutOff;
+	values[n++] = light.cos_outerCutOff;
+}
+
+static void material_values(const OBJObject* object, float values[LOD_MATERIAL_VALUES])
+{
+	const glm::vec3* vectors[] = { &object->object_color, &object->diffuse, &object->specular };
+	for (int i = 0; i < 3; i++)
+	{
+		values[3 * i] = vectors[i]->x;
+		values[3 * i + 1] = vectors[i]->y;
+		values[3 * i + 2] = vectors[i]->z;
+	}
+	values[9] = (float)object->shininess;
+}
+
+// Light uniforms are kept by each program, so they are only set again after a change
+static void use_lit_program(GLuint program, int& version)
+{
+	GLState::use_program(program);
+	if (version == lod_light_version)
+		return;
+	lod_light.update(program);
+	version = lod_light_version;
+}
+
+static void free_cache(LodSlot& slot)
+{
+	if (slot.vao != 0)
+		GLState::delete_vertex_arrays(1, &slot.vao);
+	if (slot.colors != 0)
+		GLState::delete_buffers(1, &slot.colors);
+	lod_cache_bytes -= slot.bytes;
+	slot.vao = slot.colors = 0;
+	slot.bytes = 0;
+	slot.upload_id = 0;
+}
+
+// Buffer for one color per vertex of the mesh, drawn with its positions and indices. false if the
+// budget has no room for it.
+static bool create_cache(LodSlot& slot, Mesh* mesh)
+{
+	size_t bytes = mesh->vertex_count * sizeof(glm::vec3);
+	if (slot.upload_id == mesh->upload_id && slot.bytes == bytes)
+		return true;
+	free_cache(slot);
+	if (lod_cache_bytes + bytes > ShadingLod::cache_budget)
+		return false;
+
+	glGenBuffers(1, &slot.colors);
+	GLState::bind_buffer(GL_ARRAY_BUFFER, slot.colors);
+	// Written by the GPU and only read by it
+	glBufferData(GL_ARRAY_BUFFER, bytes, NULL, GL_DYNAMIC_COPY);
+
+	glGenVertexArrays(1, &slot.vao);
+	GLState::bind_vertex_array(slot.vao);
+	GLState::bind_buffer(GL_ARRAY_BUFFER, mesh->VBO);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
+	// Location 2 is cached_color in shader.vert
+	GLState::bind_buffer(GL_ARRAY_BUFFER, slot.colors);
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
+	GLState::bind_buffer(GL_ELEMENT_ARRAY_BUFFER, mesh->EBO);
+	GLState::bind_buffer(GL_ARRAY_BUFFER, 0);
+	GLState::bind_vertex_array(0);
+
+	slot.bytes = bytes;
+	slot.upload_id = mesh->upload_id;
+	lod_cache_bytes += bytes;
+	lod_peak_bytes = std::max(lod_peak_bytes, lod_cache_bytes);
+	return true;
+}
+
+// Runs the per-vertex lighting over every vertex of the mesh into the slot's colors
+static void capture(LodSlot& slot, OBJObject* object, const glm::mat4& model, const glm::mat4& view,
+	const glm::mat4& projection)
+{
+	TRACE_SCOPE("ShadingLod::capture");
+	use_lit_program(lod_capture, lod_capture_lights);
+	if (!object->bind_uniforms(model, view, projection))
+		return;
+	GLState::enable(GL_RASTERIZER_DISCARD);
+	GLState::bind_buffer_base(GL_TRANSFORM_FEEDBACK_BUFFER, 0, slot.colors);
+	GLState::bind_vertex_array(object->mesh->VAO);
+	glBeginTransformFeedback(GL_POINTS);
+	glDrawArrays(GL_POINTS, 0, (GLsizei)object->mesh->vertex_count);
+	glEndTransformFeedback();
+	GLState::disable(GL_RASTERIZER_DISCARD);
+
+	const Mesh* mesh = object->mesh.get();
+	slot.object = object;
+	slot.index_first = mesh->index_first;
+	slot.index_count = mesh->index_count;
+	slot.model = model;
+	material_values(object, slot.material);
+	slot.light_version = lod_light_version;
+	lod_captures++;
+}
+
+static bool cache_valid(const LodSlot& slot, const OBJObject* object, const glm::mat4& model)
+{
+	const Mesh* mesh = object->mesh.get();
+	float material[LOD_MATERIAL_VALUES];
+	material_values(object, material);
+	return slot.object == object && slot.upload_id == mesh->upload_id && slot.index_first == mesh->index_first
+		&& slot.index_count == mesh->index_count && slot.model == model && slot.light_version == lod_light_version
+		&& memcmp(slot.material, material, sizeof(material)) == 0;
+}
+
+void ShadingLod::initialize(const char* vertex_path, const char* fragment_path)
+{
+	lod_enabled = pixel_threshold > 0.0f;
+	if (!lod_enabled)
+		return;
+	lod_vertex_handle = SubmitShaders(vertex_path, fragment_path, "#define VERTEX_LIGHTING\n");
+	lod_cached_handle = SubmitShaders(vertex_path, fragment_path, "#define CACHED_LIGHTING\n");
+	// The capture program compiles synchronously, so only once the first small object shows up
+	lod_vertex_path = vertex_path;
+}
+
+void ShadingLod::begin_frame(const Light& light)
+{
+	if (!lod_enabled)
+		return;
+	lod_frame++;
+	lod_next = 0;
+	memcpy(lod_last_draws, lod_frame_draws, sizeof(lod_frame_draws));
+	memset(lod_frame_draws, 0, sizeof(lod_frame_draws));
+
+	lod_light = light;
+	float values[LOD_LIGHT_VALUES];
+	light_values(light, values);
+	if (memcmp(values, lod_light_values, sizeof(values)) != 0)
+	{
+		memcpy(lod_light_values, values, sizeof(values));
+		lod_light_version++;
+	}
+
+	for (size_t i = 0; i < lod_slots.size(); i++)
+		if (lod_slots[i].bytes > 0 && lod_frame - lod_slots[i].last_cached > STALE_FRAMES)
+			free_cache(lod_slots[i]);
+}
+
+ShadingLod::Level ShadingLod::prepare(OBJObject* object, const glm::mat4& model, const glm::mat4& view,
+	const glm::mat4& projection)
+{
+	if (!lod_enabled)
+		return PER_PIXEL;
+	if (lod_next == lod_slots.size())
+	{
+		LodSlot slot = {};
+		slot.level = PER_PIXEL;
+		lod_slots.push_back(slot);
+	}
+	LodSlot& slot = lod_slots[lod_next++];
+
+	const Mesh* mesh = object->mesh.get();
+	if (!mesh->has_gpu() || mesh->vertex_count == 0 || !ShaderProgramReady(lod_vertex_handle)
+		|| !ShaderProgramReady(lod_cached_handle))
+		return slot.level = PER_PIXEL;
+
+	// The bounding sphere of the mesh, sized like the point cloud's nodes
+	GLint viewport[4];
+	GLState::get_viewport(viewport);
+	glm::vec3 center = (mesh->bounds_min + mesh->bounds_max) * 0.5f;
+	float radius = glm::length(mesh->bounds_max - mesh->bounds_min) * 0.5f * max_scale(model);
+	glm::vec3 view_center = glm::vec3(view * model * glm::vec4(center, 1.0f));
+	float pixels = screen_radius(view_center, radius, pixels_at_unit_distance(projection, viewport[3]));
+	// Up to a quarter above the threshold an object keeps a cheaper level it already has, so one
+	// right at the threshold does not flicker between the two
+	float threshold = slot.level == PER_PIXEL ? pixel_threshold : pixel_threshold * 1.25f;
+	if (pixels >= threshold)
+		return slot.level = PER_PIXEL;
+
+	if (lod_capture == 0 && !lod_capture_failed)
+	{
+		const char* varyings[] = { "LitColor" };
+		lod_capture = LoadFeedbackShader(lod_vertex_path.c_str(), "#define VERTEX_LIGHTING\n", varyings, 1);
+		lod_capture_failed = lod_capture == 0;
+	}
+	if (lod_capture == 0 || !create_cache(slot, object->mesh.get()))
+		return slot.level = PER_VERTEX;
+	if (!cache_valid(slot, object, model))
+		capture(slot, object, model, view, projection);
+	slot.last_cached = lod_frame;
+	return slot.level = CACHED;
+}
+
+void ShadingLod::draw(OBJObject* object, Level level, GLuint program, const glm::mat4& model, const glm::mat4& view,
+	const glm::mat4& projection)
+{
+	lod_frame_draws[level]++;
+	lod_draws[level]++;
+	if (level == PER_PIXEL)
+	{
+		GLState::use_program(program);
+		object->draw(program, model, view, projection);
+	}
+	else if (level == PER_VERTEX)
+	{
+		GLuint vertex_program = GetShaderProgram(lod_vertex_handle, program);
+		use_lit_program(vertex_program, lod_vertex_lights);
+		object->draw(vertex_program, model, view, projection);
+	}
+	else
+	{
+		// The colors need nothing but the matrices, no lights
+		GLState::use_program(GetShaderProgram(lod_cached_handle, program));
+		if (object->bind_uniforms(model, view, projection))
+			object->mesh->draw(lod_slots[lod_next - 1].vao);
+	}
+}
+
+std::string ShadingLod::overlay_text()
+{
+	if (!lod_enabled || lod_frame == 0)
+		return "";
+	char text[96];
+	snprintf(text, sizeof(text), "lighting %d per pixel, %d cached, %d per vertex", lod_last_draws[PER_PIXEL],
+		lod_last_draws[CACHED], lod_last_draws[PER_VERTEX]);
+	return text;
+}
+
+void ShadingLod::print_summary()
+{
+	unsigned long long total = lod_draws[PER_PIXEL] + lod_draws[CACHED] + lod_draws[PER_VERTEX];
+	if (!lod_enabled || total == 0)
+		return;
+	printf("Lighting LOD: below %.0f pixels, %.0f%% of draws lit per pixel, %.0f%% cached, %.0f%% per vertex, "
+		"%llu captures, up to %.1f MB cached\n", pixel_threshold, 100.0 * lod_draws[PER_PIXEL] / total,
+		100.0 * lod_draws[CACHED] / total, 100.0 * lod_draws[PER_VERTEX] / total, lod_captures,
+		lod_peak_bytes / (1024.0 * 1024.0));
+	if (lod_capture_failed)
+		printf("Lighting LOD: the capture shader did not link, small objects were lit per vertex\n");
+}
+
+void ShadingLod::clean_up()
+{
+	for (size_t i = 0; i < lod_slots.size(); i++)
+		free_cache(lod_slots[i]);
+	lod_slots.clear();
+	if (lod_capture != 0)
+		glDeleteProgram(lod_capture);
+	lod_capture = 0;
+}
@@ -0,0 +1,54 @@
+#ifndef _SHADINGLOD_H_
+#define _SHADINGLOD_H_
+
+#define GLFW_INCLUDE_GLEXT
+#ifdef __APPLE__
+#define GLFW_INCLUDE_GLCOREARB
+#else
+#include <GL/glew.h>
+#endif
+#include <GLFW/glfw3.h>
+// Use of degrees is deprecated. Use radians instead.
+#ifndef GLM_FORCE_RADIANS
+#define GLM_FORCE_RADIANS
+#endif
+#include <glm/mat4x4.hpp>
+#include <string>
+#include "Light.h"
+#include "OBJObject.h"
+
+// Level of detail for lighting. Per-pixel lighting is only worth its cost on objects that are large
+// on screen; one whose bounding sphere is less than pixel_threshold pixels in radius, measured the
+// way PointCloud sizes its nodes, is lit per vertex instead. The vertex colors are captured with
+// transform feedback into a buffer of the draw and reused until the lights, the material, the
+// transform or the mesh change, so a small object costs a pass-through shader on both stages.
+// The lighting is in world space, so moving the camera keeps the cache. Once cache_budget is used
+// up, the remaining small objects are lit per vertex every frame.
+class ShadingLod
+{
+public:
+	enum Level { PER_PIXEL, CACHED, PER_VERTEX, LEVELS };
+	// Frames a cache stays without being drawn from before it is freed
+	static const int STALE_FRAMES = 120;
+
+	static float pixel_threshold;	// --shading-lod, 0 lights everything per pixel
+	static size_t cache_budget;		// Bytes of cached vertex colors
+
+	// Submits the per-vertex variants of the lighting shaders
+	static void initialize(const char* vertex_path, const char* fragment_path);
+	// Before the first prepare of a frame, with the lights it is drawn with
+	static void begin_frame(const Light& light);
+	// Picks the level of one draw and captures its colors if the cache is out of date. Draws have to
+	// come in the same order every frame, and this has to be called outside conditional rendering
+	// and queries, since those would skip or count the capture.
+	static Level prepare(OBJObject* object, const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection);
+	// Draws what was just prepared, PER_PIXEL with program and its lights already set
+	static void draw(OBJObject* object, Level level, GLuint program, const glm::mat4& model, const glm::mat4& view,
+		const glm::mat4& projection);
+
+	static std::string overlay_text();
+	static void print_summary();
+	static void clean_up();
+};
+
+#endif
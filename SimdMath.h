@@ -0,0 +1,149 @@
+#ifndef _SIMDMATH_H_
+#define _SIMDMATH_H_
+
+#include <math.h>
+#include <string.h>
+#include <stdint.h>
+
+// Four floats processed together. Uses SSE where the compiler targets it and plain loops otherwise,
+// so the CPU renderers build everywhere and vectorize where they can.
+// Comparisons return masks with all bits of a lane set, for use with select, any and bits.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_SSE 1
+#include <emmintrin.h>
+#endif
+
+#ifdef SIMD_SSE
+
+struct Float4
+{
+	__m128 v;
+
+	Float4() {}
+	Float4(__m128 v) : v(v) {}
+	explicit Float4(float s) : v(_mm_set1_ps(s)) {}
+	Float4(float a, float b, float c, float d) : v(_mm_setr_ps(a, b, c, d)) {}
+
+	static Float4 load(const float* p) { return _mm_loadu_ps(p); }
+	void store(float* p) const { _mm_storeu_ps(p, v); }
+};
+
+inline Float4 operator+(Float4 a, Float4 b) { return _mm_add_ps(a.v, b.v); }
+inline Float4 operator-(Float4 a, Float4 b) { return _mm_sub_ps(a.v, b.v); }
+inline Float4 operator*(Float4 a, Float4 b) { return _mm_mul_ps(a.v, b.v); }
+inline Float4 operator/(Float4 a, Float4 b) { return _mm_div_ps(a.v, b.v); }
+inline Float4 operator-(Float4 a) { return _mm_sub_ps(_mm_setzero_ps(), a.v); }
+inline Float4 min(Float4 a, Float4 b) { return _mm_min_ps(a.v, b.v); }
+inline Float4 max(Float4 a, Float4 b) { return _mm_max_ps(a.v, b.v); }
+inline Float4 sqrt(Float4 a) { return _mm_sqrt_ps(a.v); }
+
+inline Float4 operator<(Float4 a, Float4 b) { return _mm_cmplt_ps(a.v, b.v); }
+inline Float4 operator<=(Float4 a, Float4 b) { return _mm_cmple_ps(a.v, b.v); }
+inline Float4 operator>(Float4 a, Float4 b) { return _mm_cmpgt_ps(a.v, b.v); }
+inline Float4 operator>=(Float4 a, Float4 b) { return _mm_cmpge_ps(a.v, b.v); }
+inline Float4 operator==(Float4 a, Float4 b) { return _mm_cmpeq_ps(a.v, b.v); }
+inline Float4 operator&(Float4 a, Float4 b) { return _mm_and_ps(a.v, b.v); }
+inline Float4 operator|(Float4 a, Float4 b) { return _mm_or_ps(a.v, b.v); }
+
+// mask ? a : b, per lane
+inline Float4 select(Float4 mask, Float4 a, Float4 b) { return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)); }
+// One bit per lane, lane 0 in bit 0
+inline int bits(Float4 mask) { return _mm_movemask_ps(mask.v); }
+
+#else
+
+struct Float4
+{
+	float v[4];
+
+	Float4() {}
+	explicit Float4(float s) { v[0] = v[1] = v[2] = v[3] = s; }
+	Float4(float a, float b, float c, float d) { v[0] = a; v[1] = b; v[2] = c; v[3] = d; }
+
+	static Float4 load(const float* p) { return Float4(p[0], p[1], p[2], p[3]); }
+	void store(float* p) const { p[0] = v[0]; p[1] = v[1]; p[2] = v[2]; p[3] = v[3]; }
+};
+
+#define SIMD_LANES(expr) Float4 r; for (int i = 0; i < 4; i++) r.v[i] = (expr); return r
+
+inline float simd_mask(bool set) { uint32_t u = set ? 0xFFFFFFFFu : 0u; float f; memcpy(&f, &u, 4); return f; }
+inline uint32_t simd_bits(float f) { uint32_t u; memcpy(&u, &f, 4); return u; }
+inline float simd_float(uint32_t u) { float f; memcpy(&f, &u, 4); return f; }
+
+inline Float4 operator+(Float4 a, Float4 b) { SIMD_LANES(a.v[i] + b.v[i]); }
+inline Float4 operator-(Float4 a, Float4 b) { SIMD_LANES(a.v[i] - b.v[i]); }
+inline Float4 operator*(Float4 a, Float4 b) { SIMD_LANES(a.v[i] * b.v[i]); }
+inline Float4 operator/(Float4 a, Float4 b) { SIMD_LANES(a.v[i] / b.v[i]); }
+inline Float4 operator-(Float4 a) { SIMD_LANES(-a.v[i]); }
+inline Float4 min(Float4 a, Float4 b) { SIMD_LANES(b.v[i] < a.v[i] ? b.v[i] : a.v[i]); }
+inline Float4 max(Float4 a, Float4 b) { SIMD_LANES(b.v[i] > a.v[i] ? b.v[i] : a.v[i]); }
+inline Float4 sqrt(Float4 a) { SIMD_LANES(sqrtf(a.v[i])); }
+
+inline Float4 operator<(Float4 a, Float4 b) { SIMD_LANES(simd_mask(a.v[i] < b.v[i])); }
+inline Float4 operator<=(Float4 a, Float4 b) { SIMD_LANES(simd_mask(a.v[i] <= b.v[i])); }
+inline Float4 operator>(Float4 a, Float4 b) { SIMD_LANES(simd_mask(a.v[i] > b.v[i])); }
+inline Float4 operator>=(Float4 a, Float4 b) { SIMD_LANES(simd_mask(a.v[i] >= b.v[i])); }
+inline Float4 operator==(Float4 a, Float4 b) { SIMD_LANES(simd_mask(a.v[i] == b.v[i])); }
+inline Float4 operator&(Float4 a, Float4 b) { SIMD_LANES(simd_float(simd_bits(a.v[i]) & simd_bits(b.v[i]))); }
+inline Float4 operator|(Float4 a, Float4 b) { SIMD_LANES(simd_float(simd_bits(a.v[i]) | simd_bits(b.v[i]))); }
+
+inline Float4 select(Float4 mask, Float4 a, Float4 b) { SIMD_LANES(simd_bits(mask.v[i]) ? a.v[i] : b.v[i]); }
+inline int bits(Float4 mask)
+{
+	int result = 0;
+	for (int i = 0; i < 4; i++)
+		if (simd_bits(mask.v[i]) & 0x80000000u)
+			result |= 1 << i;
+	return result;
+}
+
+#undef SIMD_LANES
+
+#endif
+
+inline Float4 clamp(Float4 a, Float4 lo, Float4 hi) { return min(max(a, lo), hi); }
+inline Float4 abs(Float4 a) { return max(a, -a); }
+inline bool any(Float4 mask) { return bits(mask) != 0; }
+
+// Integer power by squaring, exact for the integer shininess of the materials
+inline Float4 pow(Float4 x, int n)
+{
+	Float4 result(1.0f);
+	while (n > 0)
+	{
+		if (n & 1)
+			result = result * x;
+		x = x * x;
+		n >>= 1;
+	}
+	return result;
+}
+
+// Four 3D vectors in structure-of-arrays form
+struct Float4x3
+{
+	Float4 x, y, z;
+
+	Float4x3() {}
+	Float4x3(Float4 x, Float4 y, Float4 z) : x(x), y(y), z(z) {}
+	// The same vector in every lane
+	Float4x3(float sx, float sy, float sz) : x(sx), y(sy), z(sz) {}
+};
+
+inline Float4x3 operator+(const Float4x3& a, const Float4x3& b) { return Float4x3(a.x + b.x, a.y + b.y, a.z + b.z); }
+inline Float4x3 operator-(const Float4x3& a, const Float4x3& b) { return Float4x3(a.x - b.x, a.y - b.y, a.z - b.z); }
+inline Float4x3 operator*(const Float4x3& a, const Float4x3& b) { return Float4x3(a.x * b.x, a.y * b.y, a.z * b.z); }
+inline Float4x3 operator*(const Float4x3& a, Float4 s) { return Float4x3(a.x * s, a.y * s, a.z * s); }
+inline Float4 dot(const Float4x3& a, const Float4x3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline Float4x3 cross(const Float4x3& a, const Float4x3& b)
+{
+	return Float4x3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+inline Float4 length(const Float4x3& a) { return sqrt(dot(a, a)); }
+inline Float4x3 normalize(const Float4x3& a) { return a * (Float4(1.0f) / length(a)); }
+inline Float4x3 select(Float4 mask, const Float4x3& a, const Float4x3& b)
+{
+	return Float4x3(select(mask, a.x, b.x), select(mask, a.y, b.y), select(mask, a.z, b.z));
+}
+
+#endif
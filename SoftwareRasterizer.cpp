@@ -0,0 +1,520 @@
+#define _CRT_SECURE_NO_DEPRECATE
+#include "SoftwareRasterizer.h"
+#include "Phong.h"
+#include "shader.h"
+#include "GLState.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <algorithm>
+
+// Transformed vertices, structure of arrays so four of them fit one Float4.
+// Arrays are padded to a multiple of four.
+struct RasterVertices {
+	std::vector<float> sx, sy, sz;	// Window coordinates, z in [0, 1]
+	std::vector<float> iw;			// 1 / clip w, 0 if the vertex is behind the camera
+	std::vector<float> px, py, pz;	// World position (FragPos in shader.vert)
+	std::vector<float> nx, ny, nz;	// World normal
+};
+
+// Parallel loop over a fixed set of workers. The calling thread works along.
+struct RasterPool {
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	std::function<void(int)> task;
+	int count = 0;
+	std::atomic<int> next;
+	int busy = 0;
+	unsigned generation = 0;
+	bool quit = false;
+};
+
+RasterPool raster_pool;
+bool raster_present = false;
+int raster_width = 0, raster_height = 0;
+int raster_pitch = 0;				// Row length in pixels, a multiple of four
+int raster_tiles_x = 0, raster_tiles_y = 0;
+std::vector<uint32_t> raster_color;	// RGBA8, bottom row first like GL
+std::vector<float> raster_depth;
+RasterVertices raster_vertices;
+// Triangle indices per binning chunk and tile. Chunks are binned in parallel but cover
+// consecutive triangles, so walking them in order keeps the submission order.
+std::vector<std::vector<unsigned int> > raster_bins;
+int raster_chunks = 0;
+
+GLuint raster_texture = 0;
+GLuint raster_program = 0;
+GLuint raster_vao = 0;
+int raster_texture_width = 0, raster_texture_height = 0;
+
+static void run_items()
+{
+	for (int i = raster_pool.next++; i < raster_pool.count; i = raster_pool.next++)
+		raster_pool.task(i);
+}
+
+static void worker_loop()
+{
+	unsigned seen = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(raster_pool.mutex);
+			raster_pool.wake.wait(lock, [&] { return raster_pool.quit || raster_pool.generation != seen; });
+			if (raster_pool.quit)
+				return;
+			seen = raster_pool.generation;
+		}
+		run_items();
+		{
+			std::lock_guard<std::mutex> lock(raster_pool.mutex);
+			if (--raster_pool.busy == 0)
+				raster_pool.done.notify_all();
+		}
+	}
+}
+
+static void parallel_for(int count, const std::function<void(int)>& task)
+{
+	if (raster_pool.workers.empty())
+	{
+		for (int i = 0; i < count; i++)
+			task(i);
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(raster_pool.mutex);
+		raster_pool.task = task;
+		raster_pool.count = count;
+		raster_pool.next = 0;
+		raster_pool.busy = (int)raster_pool.workers.size();
+		raster_pool.generation++;
+	}
+	raster_pool.wake.notify_all();
+	run_items();
+	std::unique_lock<std::mutex> lock(raster_pool.mutex);
+	raster_pool.done.wait(lock, [] { return raster_pool.busy == 0; });
+}
+
+static void resize_vertices(size_t count)
+{
+	size_t padded = (count + 3) & ~(size_t)3;
+	std::vector<float>* arrays[] = { &raster_vertices.sx, &raster_vertices.sy, &raster_vertices.sz, &raster_vertices.iw,
+		&raster_vertices.px, &raster_vertices.py, &raster_vertices.pz, &raster_vertices.nx, &raster_vertices.ny, &raster_vertices.nz };
+	for (int i = 0; i < 10; i++)
+		arrays[i]->resize(padded);
+}
+
+// shader.vert for four vertices at a time, plus the perspective divide and viewport transform
+static void transform_vertices(const OBJObject& object, const glm::mat4& model, const glm::mat4& view_projection,
+	const glm::mat3& normal_matrix, size_t begin, size_t end)
+{
+	const std::vector<glm::vec3>& positions = object.mesh->vertices;
+	const std::vector<glm::vec3>& normals = object.mesh->normals;
+	size_t last = positions.size() - 1;
+	RasterVertices& out = raster_vertices;
+	Float4 half_width(raster_width * 0.5f), half_height(raster_height * 0.5f), half(0.5f);
+
+	for (size_t i = begin; i < end; i += 4)
+	{
+		float x[4], y[4], z[4], n[3][4];
+		for (int k = 0; k < 4; k++)
+		{
+			size_t v = std::min(i + k, last);
+			x[k] = positions[v].x;
+			y[k] = positions[v].y;
+			z[k] = positions[v].z;
+			// Models without normals still get lit, facing the camera
+			glm::vec3 normal = v < normals.size() ? normals[v] : glm::vec3(0.0f, 0.0f, 1.0f);
+			n[0][k] = normal.x;
+			n[1][k] = normal.y;
+			n[2][k] = normal.z;
+		}
+		Float4 vx = Float4::load(x), vy = Float4::load(y), vz = Float4::load(z);
+
+		// glm matrices are column major, m[column][row]
+		Float4 wx = Float4(model[0][0]) * vx + Float4(model[1][0]) * vy + Float4(model[2][0]) * vz + Float4(model[3][0]);
+		Float4 wy = Float4(model[0][1]) * vx + Float4(model[1][1]) * vy + Float4(model[2][1]) * vz + Float4(model[3][1]);
+		Float4 wz = Float4(model[0][2]) * vx + Float4(model[1][2]) * vy + Float4(model[2][2]) * vz + Float4(model[3][2]);
+
+		const glm::mat4& m = view_projection;
+		Float4 cx = Float4(m[0][0]) * wx + Float4(m[1][0]) * wy + Float4(m[2][0]) * wz + Float4(m[3][0]);
+		Float4 cy = Float4(m[0][1]) * wx + Float4(m[1][1]) * wy + Float4(m[2][1]) * wz + Float4(m[3][1]);
+		Float4 cz = Float4(m[0][2]) * wx + Float4(m[1][2]) * wy + Float4(m[2][2]) * wz + Float4(m[3][2]);
+		Float4 cw = Float4(m[0][3]) * wx + Float4(m[1][3]) * wy + Float4(m[2][3]) * wz + Float4(m[3][3]);
+
+		Float4 in_front = cw > Float4(1e-5f);
+		Float4 iw = select(in_front, Float4(1.0f) / cw, Float4(0.0f));
+		((Float4(1.0f) + cx * iw) * half_width).store(&out.sx[i]);
+		((Float4(1.0f) + cy * iw) * half_height).store(&out.sy[i]);
+		(cz * iw * half + half).store(&out.sz[i]);
+		iw.store(&out.iw[i]);
+		wx.store(&out.px[i]);
+		wy.store(&out.py[i]);
+		wz.store(&out.pz[i]);
+
+		Float4 nx = Float4::load(n[0]), ny = Float4::load(n[1]), nz = Float4::load(n[2]);
+		const glm::mat3& nm = normal_matrix;
+		(Float4(nm[0][0]) * nx + Float4(nm[1][0]) * ny + Float4(nm[2][0]) * nz).store(&out.nx[i]);
+		(Float4(nm[0][1]) * nx + Float4(nm[1][1]) * ny + Float4(nm[2][1]) * nz).store(&out.ny[i]);
+		(Float4(nm[0][2]) * nx + Float4(nm[1][2]) * ny + Float4(nm[2][2]) * nz).store(&out.nz[i]);
+	}
+}
+
+static void bin_triangles(const std::vector<GLuint>& indices, size_t vertex_count, size_t begin, size_t end, int chunk)
+{
+	const RasterVertices& v = raster_vertices;
+	std::vector<unsigned int>* bins = &raster_bins[(size_t)chunk * raster_tiles_x * raster_tiles_y];
+
+	for (size_t t = begin; t < end; t++)
+	{
+		GLuint a = indices[3 * t], b = indices[3 * t + 1], c = indices[3 * t + 2];
+		if (a >= vertex_count || b >= vertex_count || c >= vertex_count)
+			continue;
+		if (v.iw[a] == 0.0f || v.iw[b] == 0.0f || v.iw[c] == 0.0f)
+			continue;
+
+		float area = (v.sx[b] - v.sx[a]) * (v.sy[c] - v.sy[a]) - (v.sx[c] - v.sx[a]) * (v.sy[b] - v.sy[a]);
+		if (area == 0.0f)
+			continue;
+
+		float min_x = std::min(v.sx[a], std::min(v.sx[b], v.sx[c]));
+		float max_x = std::max(v.sx[a], std::max(v.sx[b], v.sx[c]));
+		float min_y = std::min(v.sy[a], std::min(v.sy[b], v.sy[c]));
+		float max_y = std::max(v.sy[a], std::max(v.sy[b], v.sy[c]));
+		if (max_x < 0.0f || max_y < 0.0f || min_x >= raster_width || min_y >= raster_height)
+			continue;
+
+		int tx0 = std::max(0, (int)min_x) / SoftwareRasterizer::TILE_SIZE;
+		int ty0 = std::max(0, (int)min_y) / SoftwareRasterizer::TILE_SIZE;
+		int tx1 = std::min(raster_width - 1, (int)max_x) / SoftwareRasterizer::TILE_SIZE;
+		int ty1 = std::min(raster_height - 1, (int)max_y) / SoftwareRasterizer::TILE_SIZE;
+		for (int ty = ty0; ty <= ty1; ty++)
+			for (int tx = tx0; tx <= tx1; tx++)
+				bins[ty * raster_tiles_x + tx].push_back((unsigned int)t);
+	}
+}
+
+static uint32_t pack_color(float r, float g, float b)
+{
+	r = std::min(std::max(r, 0.0f), 1.0f);
+	g = std::min(std::max(g, 0.0f), 1.0f);
+	b = std::min(std::max(b, 0.0f), 1.0f);
+	return (uint32_t)(r * 255.0f + 0.5f) | ((uint32_t)(g * 255.0f + 0.5f) << 8) | ((uint32_t)(b * 255.0f + 0.5f) << 16) | 0xFF000000u;
+}
+
+struct Edge {
+	float a, b, c;		// a * x + b * y + c, positive inside
+	Float4 owned;		// Pixels exactly on the edge belong to one of the two triangles sharing it
+};
+
+static Edge make_edge(float x0, float y0, float x1, float y1)
+{
+	Edge edge;
+	edge.a = y0 - y1;
+	edge.b = x1 - x0;
+	edge.c = -(edge.a * x0 + edge.b * y0);
+	bool owned = edge.a > 0.0f || (edge.a == 0.0f && edge.b > 0.0f);
+	edge.owned = owned ? (Float4(0.0f) == Float4(0.0f)) : (Float4(0.0f) == Float4(1.0f));
+	return edge;
+}
+
+static Float4 inside(const Edge& edge, Float4 value)
+{
+	return (value > Float4(0.0f)) | ((value == Float4(0.0f)) & edge.owned);
+}
+
+static void raster_triangle(unsigned int triangle, const std::vector<GLuint>& indices, const PhongParams& params,
+	int tile_x0, int tile_y0, int tile_x1, int tile_y1)
+{
+	const RasterVertices& v = raster_vertices;
+	GLuint i0 = indices[3 * triangle], i1 = indices[3 * triangle + 1], i2 = indices[3 * triangle + 2];
+
+	float area = (v.sx[i1] - v.sx[i0]) * (v.sy[i2] - v.sy[i0]) - (v.sx[i2] - v.sx[i0]) * (v.sy[i1] - v.sy[i0]);
+	// No culling, both windings are drawn like with GL_CULL_FACE disabled
+	if (area < 0.0f)
+	{
+		std::swap(i1, i2);
+		area = -area;
+	}
+
+	float min_x = std::min(v.sx[i0], std::min(v.sx[i1], v.sx[i2]));
+	float max_x = std::max(v.sx[i0], std::max(v.sx[i1], v.sx[i2]));
+	float min_y = std::min(v.sy[i0], std::min(v.sy[i1], v.sy[i2]));
+	float max_y = std::max(v.sy[i0], std::max(v.sy[i1], v.sy[i2]));
+	// Blocks of four pixels start at multiples of four
+	int x0 = std::max(tile_x0, (int)min_x) & ~3;
+	int x1 = std::min(tile_x1 - 1, (int)max_x);
+	int y0 = std::max(tile_y0, (int)min_y);
+	int y1 = std::min(tile_y1 - 1, (int)max_y);
+	if (x0 > x1 || y0 > y1)
+		return;
+
+	// Edge i lies opposite vertex i, so its value is that vertex's barycentric weight times the area
+	Edge e0 = make_edge(v.sx[i1], v.sy[i1], v.sx[i2], v.sy[i2]);
+	Edge e1 = make_edge(v.sx[i2], v.sy[i2], v.sx[i0], v.sy[i0]);
+	Edge e2 = make_edge(v.sx[i0], v.sy[i0], v.sx[i1], v.sy[i1]);
+	Float4 inv_area(1.0f / area);
+
+	Float4 z0(v.sz[i0]), z1(v.sz[i1]), z2(v.sz[i2]);
+	Float4 w0(v.iw[i0]), w1(v.iw[i1]), w2(v.iw[i2]);
+	Float4x3 p0(v.px[i0], v.py[i0], v.pz[i0]), p1(v.px[i1], v.py[i1], v.pz[i1]), p2(v.px[i2], v.py[i2], v.pz[i2]);
+	Float4x3 n0(v.nx[i0], v.ny[i0], v.nz[i0]), n1(v.nx[i1], v.ny[i1], v.nz[i1]), n2(v.nx[i2], v.ny[i2], v.nz[i2]);
+	Float4 lane_offsets(0.5f, 1.5f, 2.5f, 3.5f);
+
+	for (int y = y0; y <= y1; y++)
+	{
+		Float4 py((float)y + 0.5f);
+		float* depth_row = &raster_depth[(size_t)y * raster_pitch];
+		uint32_t* color_row = &raster_color[(size_t)y * raster_pitch];
+
+		for (int x = x0; x <= x1; x += 4)
+		{
+			Float4 px = Float4((float)x) + lane_offsets;
+			Float4 b0 = Float4(e0.a) * px + Float4(e0.b) * py + Float4(e0.c);
+			Float4 b1 = Float4(e1.a) * px + Float4(e1.b) * py + Float4(e1.c);
+			Float4 b2 = Float4(e2.a) * px + Float4(e2.b) * py + Float4(e2.c);
+			Float4 mask = inside(e0, b0) & inside(e1, b1) & inside(e2, b2);
+			if (!any(mask))
+				continue;
+
+			b0 = b0 * inv_area;
+			b1 = b1 * inv_area;
+			b2 = b2 * inv_area;
+			Float4 z = b0 * z0 + b1 * z1 + b2 * z2;
+			Float4 depth = Float4::load(depth_row + x);
+			// Depth range clipping and GL_LEQUAL
+			mask = mask & (z >= Float4(0.0f)) & (z <= Float4(1.0f)) & (z <= depth);
+			int lanes = bits(mask);
+			if (lanes == 0)
+				continue;
+			select(mask, z, depth).store(depth_row + x);
+
+			// Perspective correct attributes
+			Float4 w = b0 * w0 + b1 * w1 + b2 * w2;
+			Float4 inv_w = Float4(1.0f) / w;
+			Float4 c0 = b0 * w0 * inv_w, c1 = b1 * w1 * inv_w, c2 = b2 * w2 * inv_w;
+			Float4x3 frag_pos = p0 * c0 + p1 * c1 + p2 * c2;
+			Float4x3 normal = n0 * c0 + n1 * c1 + n2 * c2;
+			Float4x3 color = phong_shade(params, normal, frag_pos, Float4(1.0f), Float4(1.0f), Float4(1.0f));
+
+			float r[4], g[4], b[4];
+			color.x.store(r);
+			color.y.store(g);
+			color.z.store(b);
+			for (int k = 0; k < 4; k++)
+				if (lanes & (1 << k))
+					color_row[x + k] = pack_color(r[k], g[k], b[k]);
+		}
+	}
+}
+
+void SoftwareRasterizer::initialize(int threads, bool present)
+{
+	clean_up();
+	if (threads <= 0)
+		threads = std::max(1, (int)std::thread::hardware_concurrency());
+	raster_present = present;
+
+	raster_pool.quit = false;
+	raster_pool.generation = 0;
+	for (int i = 1; i < threads; i++)
+		raster_pool.workers.push_back(std::thread(worker_loop));
+	printf("Software rasterizer running on %d threads\n", threads);
+}
+
+void SoftwareRasterizer::resize(int width, int height)
+{
+	raster_width = std::max(width, 1);
+	raster_height = std::max(height, 1);
+	raster_pitch = (raster_width + 3) & ~3;
+	raster_tiles_x = (raster_width + TILE_SIZE - 1) / TILE_SIZE;
+	raster_tiles_y = (raster_height + TILE_SIZE - 1) / TILE_SIZE;
+	raster_color.assign((size_t)raster_pitch * raster_height, 0xFF000000u);
+	raster_depth.assign((size_t)raster_pitch * raster_height, 1.0f);
+	raster_chunks = 0;
+	raster_bins.clear();
+}
+
+void SoftwareRasterizer::clear()
+{
+	// Black like glClearColor, depth 1 like the default glClearDepth
+	parallel_for(raster_height, [](int y) {
+		std::fill(raster_color.begin() + (size_t)y * raster_pitch, raster_color.begin() + (size_t)(y + 1) * raster_pitch, 0xFF000000u);
+		std::fill(raster_depth.begin() + (size_t)y * raster_pitch, raster_depth.begin() + (size_t)(y + 1) * raster_pitch, 1.0f);
+	});
+}
+
+void SoftwareRasterizer::draw(const OBJObject& object, const glm::mat4& model, const glm::mat4& view,
+	const glm::mat4& projection, const Light& light)
+{
+	if (object.mesh->vertices.empty() || object.mesh->indices.empty() || raster_width == 0)
+		return;
+
+	// Vertex stage
+	glm::mat4 view_projection = projection * view;
+	glm::mat3 normal_matrix = glm::mat3(glm::transpose(glm::inverse(model)));
+	size_t vertex_count = object.mesh->vertices.size();
+	resize_vertices(vertex_count);
+	const size_t VERTEX_BATCH = 4096;
+	int vertex_batches = (int)((vertex_count + VERTEX_BATCH - 1) / VERTEX_BATCH);
+	parallel_for(vertex_batches, [&](int batch) {
+		size_t begin = batch * VERTEX_BATCH;
+		transform_vertices(object, model, view_projection, normal_matrix, begin, std::min(begin + VERTEX_BATCH, vertex_count));
+	});
+
+	// Binning, a few chunks per thread so uneven chunks still balance
+	int tiles = raster_tiles_x * raster_tiles_y;
+	int chunks = (int)(raster_pool.workers.size() + 1) * 4;
+	if (chunks != raster_chunks)
+	{
+		raster_chunks = chunks;
+		raster_bins.assign((size_t)chunks * tiles, std::vector<unsigned int>());
+	}
+	for (size_t i = 0; i < raster_bins.size(); i++)
+		raster_bins[i].clear();
+	size_t triangle_count = object.mesh->indices.size() / 3;
+	parallel_for(chunks, [&](int chunk) {
+		bin_triangles(object.mesh->indices, vertex_count, triangle_count * chunk / chunks, triangle_count * (chunk + 1) / chunks, chunk);
+	});
+
+	PhongParams params = phong_params(object, light);
+
+	// Tiles own disjoint pixels, so they need no synchronization
+	parallel_for(tiles, [&](int tile) {
+		int tx = tile % raster_tiles_x, ty = tile / raster_tiles_x;
+		int x0 = tx * TILE_SIZE, y0 = ty * TILE_SIZE;
+		int x1 = std::min(x0 + TILE_SIZE, raster_width), y1 = std::min(y0 + TILE_SIZE, raster_height);
+		for (int chunk = 0; chunk < chunks; chunk++)
+		{
+			const std::vector<unsigned int>& bin = raster_bins[(size_t)chunk * tiles + tile];
+			for (size_t i = 0; i < bin.size(); i++)
+				raster_triangle(bin[i], object.mesh->indices, params, x0, y0, x1, y1);
+		}
+	});
+}
+
+static const char* PresentVertexShader =
+	"#version 330 core\n"
+	"void main()\n"
+	"{\n"
+	"    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);\n"
+	"    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);\n"
+	"}\n";
+
+// The window framebuffer is multisampled, which rules out glBlitFramebuffer into it
+static const char* PresentFragmentShader =
+	"#version 330 core\n"
+	"uniform sampler2D image;\n"
+	"out vec4 color;\n"
+	"void main()\n"
+	"{\n"
+	"    color = texelFetch(image, ivec2(gl_FragCoord.xy), 0);\n"
+	"}\n";
+
+void SoftwareRasterizer::present()
+{
+	if (raster_present)
+		present(raster_color.data(), raster_width, raster_height, raster_pitch);
+}
+
+void SoftwareRasterizer::present(const uint32_t* pixels, int width, int height, int pitch)
+{
+	if (raster_program == 0)
+	{
+		raster_program = LoadShaderSource(PresentVertexShader, PresentFragmentShader, "software present");
+		glGenVertexArrays(1, &raster_vao);
+		glGenTextures(1, &raster_texture);
+	}
+
+	GLState::active_texture(GL_TEXTURE0);
+	GLState::bind_texture(GL_TEXTURE_2D, raster_texture);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, pitch);
+	if (raster_texture_width != width || raster_texture_height != height)
+	{
+		raster_texture_width = width;
+		raster_texture_height = height;
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	}
+	else
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+	GLState::viewport(0, 0, width, height);
+	GLState::disable(GL_DEPTH_TEST);
+	GLState::use_program(raster_program);
+	glUniform1i(glGetUniformLocation(raster_program, "image"), 0);
+	GLState::bind_vertex_array(raster_vao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	GLState::bind_texture(GL_TEXTURE_2D, 0);
+	GLState::enable(GL_DEPTH_TEST);
+}
+
+bool SoftwareRasterizer::save_ppm(const char* path)
+{
+	return save_ppm(path, raster_color.data(), raster_width, raster_height, raster_pitch);
+}
+
+bool SoftwareRasterizer::save_ppm(const char* path, const uint32_t* image, int width, int height, int pitch)
+{
+	FILE* fp = fopen(path, "wb");
+	if (fp == NULL)
+	{
+		fprintf(stderr, "Could not write %s\n", path);
+		return false;
+	}
+	fprintf(fp, "P6\n%d %d\n255\n", width, height);
+	std::vector<unsigned char> row(width * 3);
+	// Rows are stored bottom up like GL, PPM wants them top down
+	for (int y = height - 1; y >= 0; y--)
+	{
+		const uint32_t* pixels = &image[(size_t)y * pitch];
+		for (int x = 0; x < width; x++)
+		{
+			row[3 * x] = pixels[x] & 0xFF;
+			row[3 * x + 1] = (pixels[x] >> 8) & 0xFF;
+			row[3 * x + 2] = (pixels[x] >> 16) & 0xFF;
+		}
+		fwrite(row.data(), 1, row.size(), fp);
+	}
+	fclose(fp);
+	printf("Saved %dx%d frame to %s\n", width, height, path);
+	return true;
+}
+
+int SoftwareRasterizer::threads()
+{
+	return (int)raster_pool.workers.size() + 1;
+}
+
+void SoftwareRasterizer::clean_up()
+{
+	if (!raster_pool.workers.empty())
+	{
+		{
+			std::lock_guard<std::mutex> lock(raster_pool.mutex);
+			raster_pool.quit = true;
+		}
+		raster_pool.wake.notify_all();
+		for (size_t i = 0; i < raster_pool.workers.size(); i++)
+			raster_pool.workers[i].join();
+		raster_pool.workers.clear();
+	}
+	if (raster_program != 0)
+	{
+		glDeleteProgram(raster_program);
+		GLState::delete_vertex_arrays(1, &raster_vao);
+		GLState::delete_textures(1, &raster_texture);
+		raster_program = raster_vao = raster_texture = 0;
+		raster_texture_width = raster_texture_height = 0;
+	}
+}
@@ -0,0 +1,34 @@
+#ifndef _SOFTWARERASTERIZER_H_
+#define _SOFTWARERASTERIZER_H_
+
+#include "OBJObject.h"
+#include "Light.h"
+#include <stdint.h>
+
+// Renders OBJObjects with the lighting of shader.frag on the CPU, for machines without a usable GPU.
+// Vertices are transformed four at a time with SIMD, triangles are binned into screen tiles, and the
+// tiles are rasterized in parallel with half-space edge functions, a depth buffer and Phong shading
+// evaluated for four pixels at once. Triangles reaching behind the camera are dropped, not clipped.
+class SoftwareRasterizer
+{
+public:
+	static const int TILE_SIZE = 64;
+
+	// threads = 0 uses every core. With present the image can be shown in the window with present().
+	static void initialize(int threads, bool present);
+	static void resize(int width, int height);
+	static void clear();
+	// Same inputs as OBJObject::draw and Light::update
+	static void draw(const OBJObject& object, const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection,
+		const Light& light);
+	// Draws the image into the bound framebuffer through a texture, needs a GL context
+	static void present();
+	static bool save_ppm(const char* path);
+	// The same for any RGBA8 image stored bottom row first, e.g. from RayTracer. pitch is in pixels.
+	static void present(const uint32_t* pixels, int width, int height, int pitch);
+	static bool save_ppm(const char* path, const uint32_t* pixels, int width, int height, int pitch);
+	static int threads();
+	static void clean_up();
+};
+
+#endif
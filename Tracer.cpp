@@ -0,0 +1,172 @@
+#define _CRT_SECURE_NO_DEPRECATE
+#include "Tracer.h"
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct TraceEvent {
+	const char* name;
+	int64_t begin, end;
+};
+
+// Written only by its thread. Events are published by count, so the writer reads up to count
+// without stopping the thread, and chunks never move once allocated.
+struct TraceBuffer {
+	static const size_t CHUNK_EVENTS = 8192;
+	static const size_t MAX_CHUNKS = 512;		// 4M events per thread, later ones are dropped
+	int tid;
+	std::atomic<const char*> thread_name;
+	std::atomic<size_t> count;
+	TraceEvent* chunks[MAX_CHUNKS];
+};
+
+std::atomic<bool> Tracer::enabled(false);
+
+std::string trace_path;
+int trace_frames = 0;
+int trace_frames_started = 0;
+int64_t trace_start = 0;
+bool trace_written = true;
+std::atomic<unsigned long long> trace_dropped(0);
+
+// Buffers of every thread that recorded, kept until exit since their threads may be gone
+std::mutex trace_mutex;
+std::vector<TraceBuffer*> trace_buffers;
+
+thread_local TraceBuffer* trace_buffer = NULL;
+thread_local const char* trace_thread_name = NULL;
+
+static TraceBuffer* own_buffer()
+{
+	if (trace_buffer != NULL)
+		return trace_buffer;
+	TraceBuffer* buffer = new TraceBuffer();
+	buffer->thread_name = trace_thread_name;
+	buffer->count = 0;
+	memset(buffer->chunks, 0, sizeof(buffer->chunks));
+	std::lock_guard<std::mutex> lock(trace_mutex);
+	buffer->tid = (int)trace_buffers.size() + 1;
+	trace_buffers.push_back(buffer);
+	trace_buffer = buffer;
+	return buffer;
+}
+
+int64_t Tracer::now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count() + 1;
+}
+
+void Tracer::record(const char* name, int64_t begin, int64_t end)
+{
+	if (!enabled.load(std::memory_order_relaxed))
+		return;
+	TraceBuffer* buffer = own_buffer();
+	size_t count = buffer->count.load(std::memory_order_relaxed);
+	size_t chunk = count / TraceBuffer::CHUNK_EVENTS;
+	if (chunk >= TraceBuffer::MAX_CHUNKS)
+	{
+		trace_dropped++;
+		return;
+	}
+	if (buffer->chunks[chunk] == NULL)
+		buffer->chunks[chunk] = new TraceEvent[TraceBuffer::CHUNK_EVENTS];
+	TraceEvent& event = buffer->chunks[chunk][count % TraceBuffer::CHUNK_EVENTS];
+	event.name = name;
+	event.begin = begin;
+	event.end = end;
+	buffer->count.store(count + 1, std::memory_order_release);
+}
+
+void Tracer::name_thread(const char* name)
+{
+	trace_thread_name = name;
+	if (trace_buffer != NULL)
+		trace_buffer->thread_name = name;
+}
+
+void Tracer::start(const char* path, int frames)
+{
+	trace_path = path;
+	trace_frames = frames;
+	trace_frames_started = 0;
+	trace_start = now();
+	trace_written = false;
+	enabled = true;
+}
+
+void Tracer::begin_frame()
+{
+	if (trace_written)
+		return;
+	if (++trace_frames_started > trace_frames)
+		finish();
+}
+
+// Names are literals, but quotes and backslashes would break the file
+static void write_name(FILE* fp, const char* name)
+{
+	for (const char* c = name; *c; c++)
+	{
+		if (*c == '"' || *c == '\\')
+			fputc('\\', fp);
+		fputc(*c, fp);
+	}
+}
+
+void Tracer::finish()
+{
+	if (trace_written)
+		return;
+	trace_written = true;
+	enabled = false;
+
+	FILE* fp = fopen(trace_path.c_str(), "wb");
+	if (fp == NULL)
+	{
+		fprintf(stderr, "Cannot write trace %s\n", trace_path.c_str());
+		return;
+	}
+	std::vector<TraceBuffer*> buffers;
+	{
+		std::lock_guard<std::mutex> lock(trace_mutex);
+		buffers = trace_buffers;
+	}
+
+	// Complete events ("X") in microseconds since start, plus one metadata event naming each thread
+	fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf(fp, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"GLFWStarterProject\"}}");
+	size_t events = 0;
+	for (size_t b = 0; b < buffers.size(); b++)
+	{
+		TraceBuffer* buffer = buffers[b];
+		const char* thread_name = buffer->thread_name.load();
+		fprintf(fp, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"", buffer->tid);
+		if (thread_name != NULL)
+			write_name(fp, thread_name);
+		else
+			fprintf(fp, "thread %d", buffer->tid);
+		fprintf(fp, "\"}}");
+
+		size_t count = buffer->count.load(std::memory_order_acquire);
+		for (size_t i = 0; i < count; i++)
+		{
+			const TraceEvent& event = buffer->chunks[i / TraceBuffer::CHUNK_EVENTS][i % TraceBuffer::CHUNK_EVENTS];
+			fprintf(fp, ",\n{\"name\":\"");
+			write_name(fp, event.name);
+			fprintf(fp, "\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", buffer->tid,
+				(event.begin - trace_start) / 1000.0, (event.end - event.begin) / 1000.0);
+		}
+		events += count;
+	}
+	fprintf(fp, "\n]}\n");
+	fclose(fp);
+
+	printf("Wrote trace of %d frames to %s: %zu scopes on %d threads", trace_frames_started > trace_frames ? trace_frames
+		: trace_frames_started, trace_path.c_str(), events, (int)buffers.size());
+	if (trace_dropped > 0)
+		printf(", %llu dropped", trace_dropped.load());
+	printf("\n");
+}
@@ -0,0 +1,47 @@
+#ifndef _TRACER_H_
+#define _TRACER_H_
+
+#include <atomic>
+#include <stdint.h>
+
+// CPU timeline of named scopes on every thread, written as Chrome trace-event JSON that opens in
+// Perfetto (ui.perfetto.dev) or chrome://tracing. Each thread appends to buffers of its own without
+// taking locks. While tracing is off a scope costs one relaxed load, so scopes stay in release builds.
+// No GL dependency, so the loaders and the job system in the OBJParser library can be traced too.
+class Tracer
+{
+public:
+	static std::atomic<bool> enabled;
+
+	// Starts recording. The trace is written to path once frames frames are complete, or by finish.
+	static void start(const char* path, int frames);
+	// Call at the start of every frame, writes the trace when the last one is done
+	static void begin_frame();
+	// Stops recording and writes the trace if it has not been written yet
+	static void finish();
+	// Names the calling thread in the trace, names must outlive the tracer
+	static void name_thread(const char* name);
+
+	// Nanoseconds on a steady clock, never 0
+	static int64_t now();
+	// Scope names must outlive the tracer, string literals are the intended use
+	static void record(const char* name, int64_t begin, int64_t end);
+};
+
+// Records the time spent in the enclosing C++ scope
+class TraceScope
+{
+public:
+	TraceScope(const char* name) : name(name), begin(Tracer::enabled.load(std::memory_order_relaxed) ? Tracer::now() : 0) {}
+	~TraceScope() { if (begin != 0) Tracer::record(name, begin, Tracer::now()); }
+
+private:
+	const char* name;
+	int64_t begin;
+};
+
+#define TRACE_SCOPE_CONCAT2(a, b) a##b
+#define TRACE_SCOPE_CONCAT(a, b) TRACE_SCOPE_CONCAT2(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_SCOPE_CONCAT(trace_scope_, __LINE__)(name)
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef _TRIPLEBUFFER_H_
+#define _TRIPLEBUFFER_H_
+
+#include <atomic>
+
+// Hands the latest value from one writer thread to one reader thread without locks.
+// The writer fills its own slot and swaps it with the shared middle slot, the reader swaps the
+// middle slot with its own when something new was published. Each side always owns one slot,
+// so neither ever waits, and the reader skips values it was too slow to see.
+template <typename T>
+class TripleBuffer
+{
+public:
+	TripleBuffer() : middle(1), back(0), front(2) {}
+
+	// Writer thread: fill this, then publish()
+	T& write_buffer() { return slots[back]; }
+
+	void publish()
+	{
+		back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+	}
+
+	// Reader thread: picks up the latest published value, returns false if there was none since the last call
+	bool update()
+	{
+		if (!(middle.load(std::memory_order_relaxed) & FRESH))
+			return false;
+		front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+		return true;
+	}
+
+	T& read_buffer() { return slots[front]; }
+
+private:
+	enum { INDEX = 3, FRESH = 4 };
+
+	T slots[3];
+	std::atomic<int> middle;	// Index of the shared slot, FRESH if the writer put it there
+	int back;					// Owned by the writer
+	int front;					// Owned by the reader
+};
+
+#endif
@@ -0,0 +1,186 @@
+#define _CRT_SECURE_NO_DEPRECATE
+#include "UniformRing.h"
+#include "GLState.h"
+#include "Tracer.h"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+size_t UniformRing::frame_bytes = 256 * 1024;
+
+GLuint ring_buffer = 0;
+bool ring_persistent = false;
+unsigned char* ring_mapped = NULL;			// The whole buffer, mapped or a copy in memory
+std::vector<unsigned char> ring_shadow;		// The copy when the buffer cannot stay mapped
+size_t ring_frame_bytes = 0;
+GLint ring_alignment = 256;
+GLsync ring_fences[UniformRing::FRAMES] = {};
+int ring_frame = 0;
+size_t ring_used = 0;						// Bytes of the current third handed out
+
+// Per frame, for the overlay
+size_t ring_frame_used = 0, ring_last_used = 0;
+
+// Totals
+unsigned long long ring_allocations = 0, ring_bytes = 0;
+int ring_frames = 0, ring_waits = 0, ring_overflows = 0;
+double ring_wait_ms = 0.0;
+
+static void create()
+{
+	if (ring_buffer != 0)
+		return;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &ring_alignment);
+	ring_alignment = std::max(ring_alignment, 16);
+	ring_frame_bytes = (UniformRing::frame_bytes + ring_alignment - 1) / ring_alignment * ring_alignment;
+	size_t total = ring_frame_bytes * UniformRing::FRAMES;
+
+	glGenBuffers(1, &ring_buffer);
+	GLState::bind_buffer(GL_UNIFORM_BUFFER, ring_buffer);
+#ifndef __APPLE__
+	ring_persistent = GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+#endif
+	if (ring_persistent)
+	{
+		// Coherent, so plain stores reach the GPU without flushing ranges
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_UNIFORM_BUFFER, total, NULL, flags);
+		ring_mapped = (unsigned char*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, total, flags);
+		if (ring_mapped == NULL)
+		{
+			fprintf(stderr, "UniformRing: cannot map the buffer persistently, copying ranges instead\n");
+			GLState::bind_buffer(GL_UNIFORM_BUFFER, 0);
+			GLState::delete_buffers(1, &ring_buffer);
+			glGenBuffers(1, &ring_buffer);
+			GLState::bind_buffer(GL_UNIFORM_BUFFER, ring_buffer);
+			ring_persistent = false;
+		}
+	}
+	if (!ring_persistent)
+	{
+		glBufferData(GL_UNIFORM_BUFFER, total, NULL, GL_DYNAMIC_DRAW);
+		ring_shadow.resize(total);
+		ring_mapped = ring_shadow.data();
+	}
+	GLState::bind_buffer(GL_UNIFORM_BUFFER, 0);
+}
+
+// Blocks until the GPU has passed the fence
+static void wait_for(GLsync fence)
+{
+	GLenum result = glClientWaitSync(fence, 0, 0);
+	if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+		return;
+	TRACE_SCOPE("UniformRing::wait");
+	int64_t start = Tracer::now();
+	while (result == GL_TIMEOUT_EXPIRED)
+		result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+	ring_waits++;
+	ring_wait_ms += (Tracer::now() - start) / 1e6;
+}
+
+void UniformRing::begin_frame()
+{
+	create();
+	ring_frame = (ring_frame + 1) % FRAMES;
+	if (ring_fences[ring_frame] != 0)
+	{
+		// Written three frames ago, normally long done
+		wait_for(ring_fences[ring_frame]);
+		glDeleteSync(ring_fences[ring_frame]);
+		ring_fences[ring_frame] = 0;
+	}
+	ring_used = 0;
+	ring_frame_used = 0;
+}
+
+void UniformRing::end_frame()
+{
+	if (ring_buffer == 0)
+		return;
+	if (ring_fences[ring_frame] != 0)
+		glDeleteSync(ring_fences[ring_frame]);
+	ring_fences[ring_frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	ring_last_used = ring_frame_used;
+	ring_frames++;
+}
+
+void* UniformRing::allocate(size_t size, GLintptr& offset)
+{
+	create();
+	size_t aligned = (size + ring_alignment - 1) / ring_alignment * ring_alignment;
+	if (aligned > ring_frame_bytes)
+	{
+		fprintf(stderr, "UniformRing: %zu bytes do not fit in a frame of %zu\n", size, ring_frame_bytes);
+		return NULL;
+	}
+	if (ring_used + aligned > ring_frame_bytes)
+	{
+		// More draws than the third holds, start it over once the GPU has read everything queued so far
+		GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		wait_for(fence);
+		glDeleteSync(fence);
+		ring_used = 0;
+		ring_overflows++;
+	}
+	offset = (GLintptr)(ring_frame * ring_frame_bytes + ring_used);
+	ring_used += aligned;
+	ring_frame_used += aligned;
+	ring_allocations++;
+	ring_bytes += size;
+	return ring_mapped + offset;
+}
+
+void UniformRing::bind(GLuint index, GLintptr offset, GLsizeiptr size)
+{
+	if (!ring_persistent)
+	{
+		GLState::bind_buffer(GL_UNIFORM_BUFFER, ring_buffer);
+		glBufferSubData(GL_UNIFORM_BUFFER, offset, size, ring_mapped + offset);
+	}
+	GLState::bind_buffer_range(GL_UNIFORM_BUFFER, index, ring_buffer, offset, size);
+}
+
+std::string UniformRing::overlay_text()
+{
+	if (ring_frames == 0)
+		return "";
+	char text[64];
+	snprintf(text, sizeof(text), "uniform ring %zu KB", (ring_last_used + 1023) / 1024);
+	return text;
+}
+
+void UniformRing::print_summary()
+{
+	if (ring_frames == 0)
+		return;
+	printf("Uniform ring: %s, %d x %zu KB, %llu draws, %.0f bytes per frame, %d waits for the GPU (%.2f ms)",
+		ring_persistent ? "persistently mapped" : "copied with glBufferSubData", FRAMES, ring_frame_bytes / 1024,
+		ring_allocations, (double)ring_bytes / ring_frames, ring_waits, ring_wait_ms);
+	if (ring_overflows > 0)
+		printf(", %d overflows, raise UniformRing::frame_bytes", ring_overflows);
+	printf("\n");
+}
+
+void UniformRing::clean_up()
+{
+	for (int i = 0; i < FRAMES; i++)
+	{
+		if (ring_fences[i] != 0)
+			glDeleteSync(ring_fences[i]);
+		ring_fences[i] = 0;
+	}
+	if (ring_buffer != 0)
+	{
+		if (ring_persistent)
+		{
+			GLState::bind_buffer(GL_UNIFORM_BUFFER, ring_buffer);
+			glUnmapBuffer(GL_UNIFORM_BUFFER);
+		}
+		GLState::delete_buffers(1, &ring_buffer);
+	}
+	ring_buffer = 0;
+	ring_mapped = NULL;
+	ring_shadow.clear();
+}
@@ -0,0 +1,41 @@
+#ifndef _UNIFORMRING_H_
+#define _UNIFORMRING_H_
+
+#define GLFW_INCLUDE_GLEXT
+#ifdef __APPLE__
+#define GLFW_INCLUDE_GLCOREARB
+#else
+#include <GL/glew.h>
+#endif
+#include <GLFW/glfw3.h>
+#include <string>
+
+// Per-draw uniform data in one uniform buffer that stays mapped for the whole run. Each frame writes
+// to its own third of the buffer with plain stores and binds ranges of it, so a draw costs a memcpy
+// and one glBindBufferRange instead of a glUniform call per value, and the driver never allocates.
+// A fence per third keeps the CPU from overwriting data the GPU has not read yet.
+// Without GL 4.4 or ARB_buffer_storage the buffer cannot stay mapped, and each range is copied
+// with glBufferSubData when it is bound.
+class UniformRing
+{
+public:
+	static const int FRAMES = 3;
+	// Bytes per frame, taken when the buffer is created
+	static size_t frame_bytes;
+
+	// Waits until the GPU is done with the third this frame writes to, usually it already is
+	static void begin_frame();
+	// Fences the third written this frame
+	static void end_frame();
+
+	// Space for size bytes, aligned for glBindBufferRange. Returns where to write, valid until bind.
+	static void* allocate(size_t size, GLintptr& offset);
+	// Binds an allocated range to a uniform block binding point
+	static void bind(GLuint index, GLintptr offset, GLsizeiptr size);
+
+	static std::string overlay_text();
+	static void print_summary();
+	static void clean_up();
+};
+
+#endif
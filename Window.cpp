@@ -1,10 +1,14 @@
-#include "window.h"
+#include "Window.h"
 
 
 const char* window_title = "GLFW Starter Project";
 Cube * cube;
 GLint shaderProgram;
 
+// The lighting shader compiles in the background, the fallback is drawn until it is ready
+ShaderHandle shaderHandle;
+GLuint fallbackProgram;
+
 
 // Initialize objects
 OBJObject * bunny;
@@ -35,16 +39,28 @@ bool button_down = false;
 // Lights
 Light light;
 
+// Frame capture (C key or --capture)
+FrameCapture capture;
+const char* DEFAULT_CAPTURE_PATH = "capture.y4m";
+
+// Time of the first input since the last snapshot, for latency measurements
+double pending_input_time = 0.0;
+
+// Size of the default framebuffer as the GL context last saw it
+int framebuffer_width = 0;
+int framebuffer_height = 0;
+
+// Crowd layout: rows of bunny, dragon and bear receding from the camera
+const int CROWD_ROWS = 8;
+const float CROWD_SPACING_X = 2.5f;
+const float CROWD_SPACING_Z = 4.0f;
+
 // Light settings
 bool LIGHT_MODE = false;
 bool DIRECTIONAL = true;
 bool POINT = false;
 bool SPOT = false;
 
-// On some systems you need to change this to the absolute path
-#define VERTEX_SHADER_PATH "../shader.vert"
-#define FRAGMENT_SHADER_PATH "../shader.frag"
-
 // Default camera parameters
 glm::vec3 cam_pos(0.0f, 0.0f, 20.0f);		// e  | Position of camera
 glm::vec3 cam_look_at(0.0f, 0.0f, 0.0f);	// d  | This is where the camera looks at
@@ -56,47 +72,134 @@ int Window::height;
 glm::mat4 Window::P;
 glm::mat4 Window::V;
 
+bool Window::show_overlay = false;
+bool Window::software = false;
+bool Window::raytrace = false;
+bool Window::crowd = false;
+
+static void input_arrived()
+{
+	if (pending_input_time == 0.0)
+		pending_input_time = glfwGetTime();
+}
+
+// GL work goes to the render thread while it runs, otherwise it is done right away
+static void submit(const RenderCommand& command)
+{
+	if (RenderThread::running())
+		RenderThread::submit(command);
+	else
+		Window::execute(command);
+}
+
+// Models converted with obj2mesh load faster, so a .mesh next to the .obj is used instead
+static std::string model_path(const char* name)
+{
+	std::string mesh = std::string(name) + ".mesh";
+	FILE* fp = fopen(mesh.c_str(), "rb");
+	if (fp == NULL)
+		return std::string(name) + ".obj";
+	fclose(fp);
+	return mesh;
+}
+
 void Window::initialize_objects()
 {
+	TRACE_SCOPE("Window::initialize_objects");
+	// Submit the shaders first so the driver compiles them while the models are being parsed.
+	// Make sure you have the correct filepath up top
+	bool gl = !software && !raytrace;
+	if (gl)
+	{
+		fallbackProgram = LoadFallbackShader();
+		shaderHandle = SubmitShaders(VERTEX_SHADER_PATH, FRAGMENT_SHADER_PATH);
+		ShadingLod::initialize(VERTEX_SHADER_PATH, FRAGMENT_SHADER_PATH);
+	}
+
+	// The models parse in parallel, each is uploaded as soon as its parse is done
+	std::string paths[3] = { model_path("bunny"), model_path("dragon"), model_path("bear") };
+	const char* prefetch[3] = { paths[0].c_str(), paths[1].c_str(), paths[2].c_str() };
+	AssetManager::prefetch(prefetch, 3);
+
 	// Bunny
-	bunny = new OBJObject("bunny.obj");
+	bunny = new OBJObject(paths[0].c_str(), gl);
 	bunny->setAmbient(0.92f, 0.2f, 0.2f);
 	bunny->setDiffuse(0.3f, 0.2f, 0.2f);
 	bunny->setSpecular(0.9f, 0.9f, 0.9f);
 	bunny->setShininess(127);
 
 	// Dragon
-	dragon = new OBJObject("dragon.obj");
+	dragon = new OBJObject(paths[1].c_str(), gl);
 	dragon->setAmbient(0.1f, 0.9f, 0.1f);
 	dragon->setDiffuse(0.6f, 0.6f, 0.3f);
 	dragon->setSpecular(0.7f, 0.8f, 0.6f);
 	dragon->setShininess(50);
 
 	// Warren Bear
-	bear = new OBJObject("bear.obj");
+	bear = new OBJObject(paths[2].c_str(), gl);
 	bear->setAmbient(0.3f, 0.1f, 1.0f);
 	bear->setDiffuse(0.6f, 0.6f, 0.6f);
 	bear->setSpecular(0.2f, 0.2f, 0.2f);
 	bear->setShininess(1);
 
-	light = Light();
+	if (!bunny->mesh || !dragon->mesh || !bear->mesh)
+		exit(-1);
 
-	// Load the shader program. Make sure you have the correct filepath up top
-	shaderProgram = LoadShaders(VERTEX_SHADER_PATH, FRAGMENT_SHADER_PATH);
+	// Shown instead of the models
+	if (PointCloud::source != NULL)
+	{
+		if (!gl)
+			fprintf(stderr, "--points needs the GL renderer\n");
+		else if (!PointCloud::load())
+			fprintf(stderr, "Cannot show %s, showing the models\n", PointCloud::source);
+	}
+
+	light = Light();
 }
 
 // Treat this as a destructor function. Delete dynamically allocated memory here.
 void Window::clean_up()
 {
+	Tracer::finish();
+	AssetManager::print_summary();
+	ResidencyManager::print_summary();
+	MeshStreamer::print_summary();
+	MeshStreamer::clean_up();
+	PointCloud::print_summary();
+	PointCloud::clean_up();
+	// The meshes are freed with the last object using them
 	delete(cube);
 	delete(bunny);
 	delete(dragon);
 	delete(bear);
-	glDeleteProgram(shaderProgram);
+	capture.stop();
+	if (GpuProfiler::enabled)
+		GpuProfiler::print_summary();
+	GpuProfiler::clean_up();
+	FramePacer::print_summary();
+	DynamicResolution::clean_up();
+	OcclusionCuller::print_summary();
+	OcclusionCuller::clean_up();
+	DepthPrepass::print_summary();
+	DepthPrepass::clean_up();
+	RayTracer::print_summary();
+	RayTracer::clean_up();
+	SoftwareRasterizer::clean_up();
+	ShadingLod::print_summary();
+	ShadingLod::clean_up();
+	UniformRing::print_summary();
+	UniformRing::clean_up();
+	GLState::print_summary();
+	JobSystem::print_summary();
+	JobSystem::shutdown();
+	ShutdownShaderCompiler();
+	if (fallbackProgram != 0)
+		glDeleteProgram(fallbackProgram);
 }
 
 GLFWwindow* Window::create_window(int width, int height)
 {
+	TRACE_SCOPE("Window::create_window");
 	// Initialize GLFW
 	if (!glfwInit())
 	{
@@ -144,10 +247,15 @@ GLFWwindow* Window::create_window(int width, int height)
 
 void Window::resize_callback(GLFWwindow* window, int width, int height)
 {
+	TRACE_SCOPE("Window::resize_callback");
 	Window::width = width;
 	Window::height = height;
-	// Set the viewport size. This is the only matrix that OpenGL maintains for us in modern OpenGL!
-	glViewport(0, 0, width, height);
+
+	RenderCommand command = RenderCommand();
+	command.type = RenderCommand::RESIZE;
+	command.width = width;
+	command.height = height;
+	submit(command);
 
 	if (height > 0)
 	{
@@ -158,42 +266,355 @@ void Window::resize_callback(GLFWwindow* window, int width, int height)
 
 void Window::idle_callback()
 {
-	// Call the update function
-	if (showBunny) {
-		bunny->update();
+	TRACE_SCOPE("Window::idle_callback");
+	// Call the update function of every model on screen, as jobs
+	OBJObject* shown[3];
+	int count = 0;
+	if (crowd) {
+		shown[count++] = bunny;
+		shown[count++] = dragon;
+		shown[count++] = bear;
+	}
+	else if (showBunny) {
+		shown[count++] = bunny;
 	}
-	
 	else if (showDragon) {
-		dragon->update();
+		shown[count++] = dragon;
 	}
-
 	else if (showBear) {
-		bear->update();
+		shown[count++] = bear;
 	}
+	JobSystem::parallel_for(0, count, 1, [&](size_t first, size_t last) {
+		for (size_t i = first; i < last; i++)
+			shown[i]->update();
+	});
 }
 
 void Window::display_callback(GLFWwindow* window)
 {
+	TRACE_SCOPE("Window::display_callback");
+	// Low latency mode sleeps until the frame has to start and takes the freshest input
+	if (FramePacer::enabled)
+	{
+		FramePacer::wait();
+		glfwPollEvents();
+	}
+
+	SceneSnapshot scene = snapshot();
+	render(scene);
+	update_title(window);
+
+	// Gets events, including input such as keyboard and mouse or window resizing
+	if (!FramePacer::enabled)
+		glfwPollEvents();
+	FramePacer::finish_frame();
+	// Swap buffers
+	glfwSwapBuffers(window);
+	FramePacer::presented(scene.input_time);
+	// Events recorded from now on belong to the next frame
+	InputRecorder::next_frame();
+}
+
+void Window::update_title(GLFWwindow* window)
+{
+	// GPU timings in the title bar, refreshed twice a second
+	static double last_overlay = 0.0;
+	if (show_overlay && glfwGetTime() - last_overlay > 0.5)
+	{
+		last_overlay = glfwGetTime();
+		std::string text = RenderThread::running() ? RenderThread::overlay_text() : overlay_text();
+		if (!text.empty())
+			glfwSetWindowTitle(window, text.c_str());
+	}
+}
+
+std::string Window::overlay_text()
+{
+	std::string parts[12] = { GpuProfiler::overlay_text(), DynamicResolution::overlay_text(), DepthPrepass::overlay_text(),
+		OcclusionCuller::overlay_text(), RayTracer::overlay_text(), ResidencyManager::overlay_text(),
+		MeshStreamer::overlay_text(), PointCloud::overlay_text(), ShadingLod::overlay_text(), GLState::overlay_text(),
+		UniformRing::overlay_text(), FramePacer::overlay_text() };
+	std::string text;
+	for (int i = 0; i < 12; i++)
+	{
+		if (!text.empty() && !parts[i].empty())
+			text += " | ";
+		text += parts[i];
+	}
+	return text;
+}
+
+SceneSnapshot Window::snapshot()
+{
+	SceneSnapshot scene;
+	scene.model = showBunny ? 1 : showBear ? 3 : showDragon ? 2 : 0;
+	scene.toWorld = showBunny ? bunny->toWorld : showBear ? bear->toWorld : showDragon ? dragon->toWorld : glm::mat4(1.0f);
+	scene.P = P;
+	scene.V = V;
+	scene.light = light;
+	scene.input_time = pending_input_time;
+	pending_input_time = 0.0;
+	scene.crowd = crowd;
+	scene.toWorlds[0] = bunny->toWorld;
+	scene.toWorlds[1] = dragon->toWorld;
+	scene.toWorlds[2] = bear->toWorld;
+	return scene;
+}
+
+void Window::render()
+{
+	SceneSnapshot scene = snapshot();
+	render(scene);
+}
+
+// Skips the draw if the occlusion culler finds the object outside the frustum or hidden. lit draws
+// pick their lighting level of detail and are timed as a GPU scope named after the model, the others
+// just use program.
+static void draw_culled(OBJObject* object, const char* name, const glm::mat4& model, const SceneSnapshot& scene,
+	GLuint program, bool lit)
+{
+	// Before the culler, whose conditional rendering would skip capturing the lighting cache
+	ShadingLod::Level level = lit ? ShadingLod::prepare(object, model, scene.V, scene.P) : ShadingLod::PER_PIXEL;
+	if (!OcclusionCuller::begin_object(object->mesh->bounds_min, object->mesh->bounds_max, scene.P * scene.V * model))
+		return;
+	// Reloads the mesh if it was evicted since it was last drawn
+	if (!ResidencyManager::use(object->mesh.get(), true))
+	{
+		OcclusionCuller::end_object();
+		return;
+	}
+	DepthPrepass::begin_draw();
+	if (lit)
+	{
+		GPU_SCOPE(name);
+		ShadingLod::draw(object, level, program, model, scene.V, scene.P);
+	}
+	else
+		object->draw(program, model, scene.V, scene.P);
+	DepthPrepass::end_draw();
+	OcclusionCuller::end_object();
+}
+
+// Once for the depth pre-pass and once for lighting, in the same order both times
+static void draw_scene(const SceneSnapshot& scene, GLuint program, bool lit)
+{
+	if (scene.crowd)
+	{
+		// Front to back, so the nearest rows fill the depth buffer first
+		OBJObject* models[3] = { bunny, dragon, bear };
+		const char* names[3] = { "bunny", "dragon", "bear" };
+		for (int row = 0; row < CROWD_ROWS; row++)
+		{
+			for (int column = 0; column < 3; column++)
+			{
+				int model = (row + column) % 3;
+				glm::mat4 offset = glm::translate(glm::mat4(1.0f),
+					glm::vec3((column - 1) * CROWD_SPACING_X, 0.0f, -row * CROWD_SPACING_Z));
+				draw_culled(models[model], names[model], offset * scene.toWorlds[model], scene, program, lit);
+			}
+		}
+	}
+	else if (scene.model == 1)
+		draw_culled(bunny, "bunny", scene.toWorld, scene, program, lit);
+	else if (scene.model == 3)
+		draw_culled(bear, "bear", scene.toWorld, scene, program, lit);
+	else if (scene.model == 2)
+		draw_culled(dragon, "dragon", scene.toWorld, scene, program, lit);
+}
+
+void Window::render(SceneSnapshot& scene)
+{
+	// A trace is written once its last frame is complete
+	Tracer::begin_frame();
+	TRACE_SCOPE("Window::render");
+	GLState::begin_frame();
+	ResidencyManager::begin_frame();
+	if (software || raytrace)
+	{
+		render_software(scene);
+		return;
+	}
+
+	GpuProfiler::begin_frame();
+	OcclusionCuller::begin_frame();
+	// Per-draw uniforms of this frame go to a part of the ring the GPU is done with
+	UniformRing::begin_frame();
+	// Finer levels of streamed meshes, within a fixed number of bytes per frame
+	{
+		GPU_SCOPE("mesh streaming");
+		MeshStreamer::update();
+	}
+	// With a target frame time the scene goes into a scaled offscreen target first
+	DynamicResolution::begin_scene(framebuffer_width, framebuffer_height);
+
 	// Clear the color and depth buffers
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	{
+		GPU_SCOPE("clear");
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	}
 
-	// Use the shader of programID
-	glUseProgram(shaderProgram);
+	if (PointCloud::loaded())
+	{
+		// Unlit, with the transform of the selected model
+		GPU_SCOPE("PointCloud::draw");
+		PointCloud::draw(scene.toWorld, scene.V, scene.P);
+	}
+	else
+	{
+		// Depth only first when it saves enough shading, then light just the visible fragments
+		if (DepthPrepass::begin_frame())
+		{
+			GPU_SCOPE("depth pre-pass");
+			GLState::use_program(DepthPrepass::program());
+			draw_scene(scene, DepthPrepass::program(), false);
+			OcclusionCuller::rewind();
+		}
+		DepthPrepass::begin_color();
 
+		// Use the lighting shader once it has finished compiling
+		PollShaders();
+		shaderProgram = GetShaderProgram(shaderHandle, fallbackProgram);
+		GLState::use_program(shaderProgram);
+
+		{
+			GPU_SCOPE("Light::update");
+			scene.light.update(shaderProgram);
+		}
+		// Small objects are lit per vertex, from a cache while these lights stay the same
+		ShadingLod::begin_frame(scene.light);
+
+		{
+			GPU_SCOPE("lighting");
+			draw_scene(scene, shaderProgram, true);
+		}
+		DepthPrepass::end_frame();
+	}
 
-	light.update(shaderProgram);
+	// Hi-Z pyramid of this frame's depth, for culling the next one
+	{
+		GPU_SCOPE("hi-z");
+		OcclusionCuller::end_frame();
+	}
 
-	if (showBunny)
-		bunny->draw(shaderProgram);
-	else if (showBear)
-		bear->draw(shaderProgram);
-	else if (showDragon)
-		dragon->draw(shaderProgram);
+	{
+		GPU_SCOPE("upscale");
+		DynamicResolution::end_scene();
+	}
 
-	// Gets events, including input such as keyboard and mouse or window resizing
-	glfwPollEvents();
-	// Swap buffers
-	glfwSwapBuffers(window);
+	// Queue the readback of this frame, never waits for the GPU
+	{
+		GPU_SCOPE("capture");
+		capture.capture();
+	}
+
+	UniformRing::end_frame();
+	GpuProfiler::end_frame();
+}
+
+void Window::render_software(SceneSnapshot& scene)
+{
+	OBJObject* object = scene.model == 1 ? bunny : scene.model == 3 ? bear : scene.model == 2 ? dragon : NULL;
+	if (object && !ResidencyManager::use(object->mesh.get(), false))
+		object = NULL;
+	if (raytrace)
+	{
+		RayTracer::render(object, scene.toWorld, scene.V, scene.P, scene.light);
+		RayTracer::present();
+		capture.capture();
+		return;
+	}
+
+	SoftwareRasterizer::clear();
+	if (object)
+		SoftwareRasterizer::draw(*object, scene.toWorld, scene.V, scene.P, scene.light);
+
+	// Shows the image in the window, does nothing without one
+	SoftwareRasterizer::present();
+	capture.capture();
+}
+
+void Window::start_capture(const char* path)
+{
+	RenderCommand command = RenderCommand();
+	command.type = RenderCommand::START_CAPTURE;
+	command.path = path;
+	submit(command);
+}
+
+void Window::stop_capture()
+{
+	RenderCommand command = RenderCommand();
+	command.type = RenderCommand::STOP_CAPTURE;
+	submit(command);
+}
+
+void Window::execute(const RenderCommand& command)
+{
+	switch (command.type)
+	{
+	case RenderCommand::RESIZE:
+		// Captured videos have a fixed frame size
+		if (capture.active() && (command.width != framebuffer_width || command.height != framebuffer_height))
+			capture.stop();
+		framebuffer_width = command.width;
+		framebuffer_height = command.height;
+		if (software || raytrace)
+		{
+			if (raytrace)
+				RayTracer::resize(command.width, command.height);
+			else
+				SoftwareRasterizer::resize(command.width, command.height);
+			break;
+		}
+		// Set the viewport size. This is the only matrix that OpenGL maintains for us in modern OpenGL!
+		GLState::viewport(0, 0, command.width, command.height);
+		break;
+	case RenderCommand::START_CAPTURE:
+		capture.start(command.path, framebuffer_width, framebuffer_height);
+		break;
+	case RenderCommand::STOP_CAPTURE:
+		capture.stop();
+		break;
+	case RenderCommand::TOGGLE_CAPTURE:
+		if (capture.active())
+			capture.stop();
+		else
+			capture.start(command.path, framebuffer_width, framebuffer_height);
+		break;
+	case RenderCommand::ENABLE_PROFILER:
+		GpuProfiler::enabled = true;
+		break;
+	case RenderCommand::TOGGLE_LOW_LATENCY:
+		FramePacer::enabled = !FramePacer::enabled;
+		printf("Low latency frame pacing %s\n", FramePacer::enabled ? "on" : "off");
+		break;
+	case RenderCommand::TOGGLE_OCCLUSION:
+		OcclusionCuller::enabled = !OcclusionCuller::enabled;
+		printf("Occlusion culling %s\n", OcclusionCuller::enabled ? "on" : "off");
+		break;
+	case RenderCommand::CYCLE_PREPASS:
+		DepthPrepass::mode = DepthPrepass::mode == DepthPrepass::AUTO ? DepthPrepass::ON
+			: DepthPrepass::mode == DepthPrepass::ON ? DepthPrepass::OFF : DepthPrepass::AUTO;
+		printf("Depth pre-pass %s\n", DepthPrepass::mode_name());
+		break;
+	case RenderCommand::CYCLE_HIZ_VIEW:
+		if (OcclusionCuller::enabled)
+			OcclusionCuller::cycle_debug_view();
+		else
+			printf("The Hi-Z debug view needs occlusion culling (F5)\n");
+		break;
+	default:
+		break;
+	}
+}
+
+void Window::select_model(int model)
+{
+	OBJObject * selected = (model == 1) ? bunny : (model == 2) ? dragon : bear;
+	selected->reset();
+	showBunny = (model == 1);
+	showDragon = (model == 2);
+	showBear = (model == 3);
 }
 
 glm::vec3 Window::trackball(float x, float y)    // Use separate x and y values for the mouse location
@@ -227,6 +648,10 @@ glm::vec3 Window::trackball_translate(float x, float y)    // Use separate x and
 
 void Window::cursor_callback(GLFWwindow* window, double xpos, double ypos)
 {
+	TRACE_SCOPE("Window::cursor_callback");
+	InputRecorder::cursor(xpos, ypos);
+	input_arrived();
+
 	cursor_x = xpos;
 	cursor_y = ypos;
 
@@ -340,6 +765,10 @@ void Window::cursor_callback(GLFWwindow* window, double xpos, double ypos)
 
 void Window::mouse_callback(GLFWwindow* window, int button, int action, int mods)
 {
+	TRACE_SCOPE("Window::mouse_callback");
+	InputRecorder::mouse(button, action, mods);
+	input_arrived();
+
 	if (action == GLFW_PRESS) {
 		button_down = true;
 		old_location = trackball(cursor_x, cursor_y);
@@ -363,6 +792,10 @@ void Window::mouse_callback(GLFWwindow* window, int button, int action, int mods
 
 void Window::scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
+	TRACE_SCOPE("Window::scroll_callback");
+	InputRecorder::scroll(xoffset, yoffset);
+	input_arrived();
+
 	if (yoffset != 0 && !LIGHT_MODE) {
 		if (showBunny) {
 			bunny->translate(0.0, 0.0, (float)-yoffset);
@@ -393,6 +826,10 @@ void Window::scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 
 void Window::key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
+	TRACE_SCOPE("Window::key_callback");
+	InputRecorder::key(key, scancode, action, mods);
+	input_arrived();
+
 	// Check for a key press
 	if (action == GLFW_PRESS)
 	{
@@ -400,46 +837,49 @@ void Window::key_callback(GLFWwindow* window, int key, int scancode, int action,
 		if (key == GLFW_KEY_ESCAPE)
 		{
 			// Close the window. This causes the program to also terminate.
-			glfwSetWindowShouldClose(window, GL_TRUE);
+			// Replayed input has no window when running headless.
+			if (window)
+				glfwSetWindowShouldClose(window, GL_TRUE);
 		}
 
 		// F1 BUNNY
 		else if (key == GLFW_KEY_F1)
 		{
-			bunny->reset();
-			// Show the bunny
-			if (!showBunny)
-			{
-				showBunny = true;
-				showBear = false;
-				showDragon = false;
-			}
+			select_model(1);
 		}
 
 		// F2 DRAGON
 		else if (key == GLFW_KEY_F2)
 		{
-			dragon->reset();
-			// Show the dragon
-			if (!showDragon)
-			{
-				showBunny = false;
-				showBear = false;
-				showDragon = true;
-			}
+			select_model(2);
 		}
 
 		// F3 BEAR
 		else if (key == GLFW_KEY_F3)
 		{
-			bear->reset();
-			// Show the bear
-			if (!showBear)
-			{
-				showBunny = false;
-				showBear = true;
-				showDragon = false;
-			}
+			select_model(3);
+		}
+
+		// F4 CROWD OF ALL MODELS
+		else if (key == GLFW_KEY_F4)
+		{
+			crowd = !crowd;
+		}
+
+		// F5 OCCLUSION CULLING
+		else if (key == GLFW_KEY_F5)
+		{
+			RenderCommand command = RenderCommand();
+			command.type = RenderCommand::TOGGLE_OCCLUSION;
+			submit(command);
+		}
+
+		// F6 HI-Z DEBUG VIEW
+		else if (key == GLFW_KEY_F6)
+		{
+			RenderCommand command = RenderCommand();
+			command.type = RenderCommand::CYCLE_HIZ_VIEW;
+			submit(command);
 		}
 		
 		// X MOVE X
@@ -665,6 +1105,44 @@ void Window::key_callback(GLFWwindow* window, int key, int scancode, int action,
 				}
 			}
 		}
+		// P GPU PROFILER OVERLAY
+		else if (key == GLFW_KEY_P)
+		{
+			show_overlay = !show_overlay;
+			if (show_overlay)
+			{
+				RenderCommand command = RenderCommand();
+				command.type = RenderCommand::ENABLE_PROFILER;
+				submit(command);
+			}
+			else if (window)
+				glfwSetWindowTitle(window, window_title);
+		}
+
+		// L LOW LATENCY FRAME PACING
+		else if (key == GLFW_KEY_L)
+		{
+			RenderCommand command = RenderCommand();
+			command.type = RenderCommand::TOGGLE_LOW_LATENCY;
+			submit(command);
+		}
+
+		// D DEPTH PRE-PASS: AUTO, ON, OFF
+		else if (key == GLFW_KEY_D)
+		{
+			RenderCommand command = RenderCommand();
+			command.type = RenderCommand::CYCLE_PREPASS;
+			submit(command);
+		}
+
+		// C CAPTURE
+		else if (key == GLFW_KEY_C)
+		{
+			RenderCommand command = RenderCommand();
+			command.type = RenderCommand::TOGGLE_CAPTURE;
+			command.path = DEFAULT_CAPTURE_PATH;
+			submit(command);
+		}
 		else if (key == GLFW_KEY_0) {
 			LIGHT_MODE = false;
 		}
@@ -14,6 +14,43 @@
 #include "shader.h"
 #include "OBJObject.h"
 #include "Light.h"
+#include "FrameCapture.h"
+#include "GpuProfiler.h"
+#include "InputRecorder.h"
+#include "RenderThread.h"
+#include "FramePacer.h"
+#include "DynamicResolution.h"
+#include "SoftwareRasterizer.h"
+#include "RayTracer.h"
+#include "OcclusionCuller.h"
+#include "DepthPrepass.h"
+#include "ResidencyManager.h"
+#include "AssetManager.h"
+#include "MeshStreamer.h"
+#include "PointCloud.h"
+#include "JobSystem.h"
+#include "Tracer.h"
+#include "GLState.h"
+#include "UniformRing.h"
+#include "ShadingLod.h"
+
+// On some systems you need to change this to the absolute path
+#define VERTEX_SHADER_PATH "../shader.vert"
+#define FRAGMENT_SHADER_PATH "../shader.frag"
+
+// Everything render() reads from the scene. The main thread copies it after every update,
+// so the render thread never reads state that input handling is changing.
+struct SceneSnapshot
+{
+	int model;			// 0 = nothing, 1 = bunny, 2 = dragon, 3 = bear
+	glm::mat4 toWorld;
+	glm::mat4 P;
+	glm::mat4 V;
+	Light light;
+	double input_time;	// glfwGetTime of the oldest input not in an earlier snapshot, 0 for none
+	bool crowd;			// Draw rows of all three models instead of the selected one
+	glm::mat4 toWorlds[3];	// Bunny, dragon and bear, for the crowd
+};
 
 class Window
 {
@@ -22,12 +59,33 @@ public:
 	static int height;
 	static glm::mat4 P; // P for projection
 	static glm::mat4 V; // V for view
+	static bool show_overlay; // GPU timings in the title bar
+	static bool software; // Render with SoftwareRasterizer instead of OpenGL, set before initialize_objects
+	static bool raytrace; // Render with RayTracer instead of OpenGL, set before initialize_objects
+	static bool crowd; // Rows of models behind each other (F4), to exercise occlusion culling
 	static void initialize_objects();
 	static void clean_up();
 	static GLFWwindow* create_window(int width, int height);
 	static void resize_callback(GLFWwindow* window, int width, int height);
 	static void idle_callback();
 	static void display_callback(GLFWwindow*);
+	// Draws the scene into the currently bound framebuffer, without touching the window
+	static void render();
+	static void render(SceneSnapshot& scene);
+	// SoftwareRasterizer or RayTracer
+	static void render_software(SceneSnapshot& scene);
+	static SceneSnapshot snapshot();
+	// Runs a command on the thread that owns the GL context, see RenderThread
+	static void execute(const RenderCommand& command);
+	// Shows the GPU timings in the title bar while the overlay is on
+	static void update_title(GLFWwindow* window);
+	// GPU timings and input latency, on the thread that renders
+	static std::string overlay_text();
+	// 1 = bunny, 2 = dragon, 3 = bear
+	static void select_model(int model);
+	// Records every rendered frame, see FrameCapture
+	static void start_capture(const char* path);
+	static void stop_capture();
 	static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
 	static void mouse_callback(GLFWwindow* window, int button, int action, int mods);
 	static void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
@@ -0,0 +1,144 @@
+#define _CRT_SECURE_NO_DEPRECATE
+#include "OBJGenerator.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+
+static const char* FORMAT_NAMES[OBJGenerator::FACE_FORMATS] = { "v", "vt", "vn", "vtn" };
+
+static void write_corner(FILE* fp, long long index, OBJGenerator::FaceFormat format)
+{
+	switch (format)
+	{
+	case OBJGenerator::FACE_V:
+		fprintf(fp, " %lld", index);
+		break;
+	case OBJGenerator::FACE_VT:
+		fprintf(fp, " %lld/%lld", index, index);
+		break;
+	case OBJGenerator::FACE_VN:
+		fprintf(fp, " %lld//%lld", index, index);
+		break;
+	default:
+		fprintf(fp, " %lld/%lld/%lld", index, index, index);
+		break;
+	}
+}
+
+bool OBJGenerator::write(const char* path, long long triangles, FaceFormat format, bool colors, long long* vertex_count)
+{
+	if (triangles < 2)
+		triangles = 2;
+
+	// A rings x segments torus has exactly 2 * rings * segments triangles. Pick a square-ish
+	// grid with at least enough cells and stop emitting faces once the count is reached.
+	long long segments = (long long)ceil(sqrt(triangles / 2.0));
+	long long rings = (triangles + 2 * segments - 1) / (2 * segments);
+	if (rings < 3) rings = 3;
+	if (segments < 3) segments = 3;
+
+	FILE* fp = fopen(path, "wb");
+	if (fp == NULL)
+	{
+		fprintf(stderr, "Could not write %s\n", path);
+		return false;
+	}
+	std::vector<char> buffer(1 << 20);
+	setvbuf(fp, buffer.data(), _IOFBF, buffer.size());
+
+	fprintf(fp, "# synthetic torus, %lld triangles\n", triangles);
+
+	const double two_pi = 6.283185307179586;
+	const double major = 1.0, minor = 0.35;
+	bool texcoords = format == FACE_VT || format == FACE_VTN;
+	bool normals = format == FACE_VN || format == FACE_VTN;
+
+	for (long long i = 0; i < rings; i++)
+	{
+		double u = two_pi * i / rings;
+		for (long long j = 0; j < segments; j++)
+		{
+			double v = two_pi * j / segments;
+			double nx = cos(u) * cos(v), ny = sin(u) * cos(v), nz = sin(v);
+			double x = major * cos(u) + minor * nx;
+			double y = major * sin(u) + minor * ny;
+			double z = minor * nz;
+
+			if (colors)
+				fprintf(fp, "v %.6f %.6f %.6f %.3f %.3f %.3f\n", x, y, z, 0.5 + 0.5 * nx, 0.5 + 0.5 * ny, 0.5 + 0.5 * nz);
+			else
+				fprintf(fp, "v %.6f %.6f %.6f\n", x, y, z);
+			if (texcoords)
+				fprintf(fp, "vt %.6f %.6f\n", (double)i / rings, (double)j / segments);
+			if (normals)
+				fprintf(fp, "vn %.6f %.6f %.6f\n", nx, ny, nz);
+		}
+	}
+
+	long long written = 0;
+	for (long long i = 0; i < rings && written < triangles; i++)
+	{
+		for (long long j = 0; j < segments && written < triangles; j++)
+		{
+			// OBJ indices are one based
+			long long a = i * segments + j + 1;
+			long long b = ((i + 1) % rings) * segments + j + 1;
+			long long c = ((i + 1) % rings) * segments + (j + 1) % segments + 1;
+			long long d = i * segments + (j + 1) % segments + 1;
+
+			fputc('f', fp);
+			write_corner(fp, a, format);
+			write_corner(fp, b, format);
+			write_corner(fp, c, format);
+			fputc('\n', fp);
+			if (++written == triangles)
+				break;
+
+			fputc('f', fp);
+			write_corner(fp, a, format);
+			write_corner(fp, c, format);
+			write_corner(fp, d, format);
+			fputc('\n', fp);
+			written++;
+		}
+	}
+
+	bool ok = ferror(fp) == 0;
+	ok = fclose(fp) == 0 && ok;
+	if (!ok)
+		fprintf(stderr, "Writing %s failed\n", path);
+	if (vertex_count)
+		*vertex_count = rings * segments;
+	return ok;
+}
+
+bool OBJGenerator::parse_format(const char* name, FaceFormat& format)
+{
+	for (int i = 0; i < FACE_FORMATS; i++)
+	{
+		if (strcmp(name, FORMAT_NAMES[i]) == 0)
+		{
+			format = (FaceFormat)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+const char* OBJGenerator::format_name(FaceFormat format)
+{
+	return FORMAT_NAMES[format];
+}
+
+long long OBJGenerator::parse_count(const char* text)
+{
+	char* end;
+	double value = strtod(text, &end);
+	if (*end == 'k' || *end == 'K')
+		value *= 1000.0;
+	else if (*end == 'm' || *end == 'M')
+		value *= 1000000.0;
+	return (long long)(value + 0.5);
+}
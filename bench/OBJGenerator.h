@@ -0,0 +1,22 @@
+#ifndef _OBJGENERATOR_H_
+#define _OBJGENERATOR_H_
+
+// Writes synthetic OBJ files of an exact triangle count, for parser benchmarks.
+// The mesh is a closed torus, so every vertex is shared by six triangles like in a scanned model.
+class OBJGenerator
+{
+public:
+	enum FaceFormat { FACE_V, FACE_VT, FACE_VN, FACE_VTN, FACE_FORMATS };
+
+	// Vertex counts are returned so callers can check what a parser read back
+	static bool write(const char* path, long long triangles, FaceFormat format, bool colors,
+		long long* vertex_count = 0);
+
+	// "v", "vt", "vn" or "vtn"
+	static bool parse_format(const char* name, FaceFormat& format);
+	static const char* format_name(FaceFormat format);
+	// Accepts plain numbers and k/M suffixes, e.g. 50M
+	static long long parse_count(const char* text);
+};
+
+#endif
@@ -0,0 +1,170 @@
+#define _CRT_SECURE_NO_DEPRECATE
+#include "JobSystem.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+typedef std::chrono::steady_clock bench_clock;
+
+static void print_usage(const char* program)
+{
+	fprintf(stderr,
+		"usage: %s [options]\n"
+		"  --threads N   most threads to scale up to, 0 for one per core (default 0)\n"
+		"  --items N     parallel_for items (default 4000000)\n"
+		"  --grain N     parallel_for grain (default 4096)\n"
+		"  --jobs N      jobs in the fan-out and chain tests (default 100000)\n"
+		"  --runs N      best of N runs (default 5)\n"
+		"  --pin         pin the workers to cores\n",
+		program);
+}
+
+static double ms_since(bench_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(bench_clock::now() - start).count();
+}
+
+// Enough arithmetic per item that the loop is bound by compute, not memory
+static float kernel(size_t i)
+{
+	float x = (float)(i % 1000) * 0.001f;
+	for (int k = 0; k < 32; k++)
+		x = x * 0.99f + sinf(x + (float)k);
+	return x;
+}
+
+struct ScalingResult {
+	double loop_ms;		// parallel_for over the items
+	double fan_ms;		// Independent jobs joined by one continuation
+	double chain_ms;	// Each job depends on the one before
+	bool correct;
+};
+
+static ScalingResult run(size_t items, size_t grain, int jobs, int runs, const std::vector<float>& expected)
+{
+	ScalingResult result = { 1e30, 1e30, 1e30, true };
+	std::vector<float> out(items);
+	for (int r = 0; r < runs; r++)
+	{
+		std::fill(out.begin(), out.end(), 0.0f);
+		bench_clock::time_point start = bench_clock::now();
+		JobSystem::parallel_for(0, items, grain, [&](size_t first, size_t last)
+		{
+			for (size_t i = first; i < last; i++)
+				out[i] = kernel(i);
+		});
+		result.loop_ms = std::min(result.loop_ms, ms_since(start));
+		result.correct = result.correct && out == expected;
+
+		// The continuation must see every job of the fan-out done
+		std::atomic<int> done(0);
+		int seen = -1;
+		start = bench_clock::now();
+		Job* join = JobSystem::create([&] { seen = done.load(); });
+		for (int j = 0; j < jobs; j++)
+		{
+			Job* job = JobSystem::create([&] { done++; });
+			JobSystem::depend(join, job);
+			JobSystem::submit(job);
+			JobSystem::release(job);
+		}
+		JobSystem::submit(join);
+		JobSystem::wait(join);
+		result.fan_ms = std::min(result.fan_ms, ms_since(start));
+		result.correct = result.correct && seen == jobs;
+
+		// Continuations run in order, one after the other
+		std::vector<int> order;
+		order.reserve(jobs);
+		start = bench_clock::now();
+		Job* first = JobSystem::create([&] { order.push_back(0); });
+		Job* last = first;
+		JobSystem::submit(first);
+		for (int j = 1; j < jobs; j++)
+		{
+			Job* next = JobSystem::then(last, [&order, j] { order.push_back(j); });
+			JobSystem::release(last);
+			last = next;
+		}
+		JobSystem::wait(last);
+		result.chain_ms = std::min(result.chain_ms, ms_since(start));
+		for (int j = 0; j < jobs && result.correct; j++)
+			result.correct = j < (int)order.size() && order[j] == j;
+	}
+	return result;
+}
+
+int main(int argc, char* argv[])
+{
+	int max_threads = 0;
+	size_t items = 4000000;
+	size_t grain = 4096;
+	int jobs = 100000;
+	int runs = 5;
+	bool pin = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			max_threads = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--items") == 0 && i + 1 < argc)
+			items = (size_t)atoll(argv[++i]);
+		else if (strcmp(argv[i], "--grain") == 0 && i + 1 < argc)
+			grain = (size_t)atoll(argv[++i]);
+		else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc)
+			jobs = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc)
+			runs = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--pin") == 0)
+			pin = true;
+		else
+		{
+			print_usage(argv[0]);
+			return 1;
+		}
+	}
+	if (max_threads <= 0)
+		max_threads = std::max(1, (int)std::thread::hardware_concurrency());
+	runs = std::max(1, runs);
+	jobs = std::max(1, jobs);
+
+	std::vector<float> expected(items);
+	for (size_t i = 0; i < items; i++)
+		expected[i] = kernel(i);
+
+	printf("%zu items with grain %zu, %d jobs, best of %d%s\n\n", items, grain, jobs, runs, pin ? ", pinned" : "");
+	printf("%-8s %12s %9s %11s %12s %12s %9s\n", "threads", "loop ms", "speedup", "efficiency", "fan-out us", "chain us",
+		"stolen");
+	double single = 0.0;
+	bool correct = true;
+	// Powers of two up to the most
+	std::vector<int> counts;
+	for (int threads = 1; threads < max_threads; threads *= 2)
+		counts.push_back(threads);
+	counts.push_back(max_threads);
+	for (size_t c = 0; c < counts.size(); c++)
+	{
+		int threads = counts[c];
+		JobSystem::initialize(threads, pin);
+		JobStats before = JobSystem::stats();
+		ScalingResult result = run(items, grain, jobs, runs, expected);
+		JobStats after = JobSystem::stats();
+		if (threads == 1)
+			single = result.loop_ms;
+		double speedup = single / result.loop_ms;
+		unsigned long long ran = after.jobs - before.jobs;
+		printf("%-8d %12.2f %8.2fx %10.0f%% %12.3f %12.3f %8.1f%%%s\n", threads, result.loop_ms, speedup,
+			100.0 * speedup / threads, 1000.0 * result.fan_ms / jobs, 1000.0 * result.chain_ms / jobs,
+			ran > 0 ? 100.0 * (after.stolen - before.stolen) / ran : 0.0, result.correct ? "" : "  WRONG RESULTS");
+		correct = correct && result.correct;
+	}
+	JobSystem::shutdown();
+	printf("\nfan-out and chain are per job: creating, scheduling and running it\n");
+	return correct ? 0 : 1;
+}
@@ -0,0 +1,107 @@
+#define _CRT_SECURE_NO_DEPRECATE
+#include "OBJParser.h"
+#include "MeshCodec.h"
+#include "JobSystem.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <chrono>
+
+static void print_usage(const char* program)
+{
+	fprintf(stderr,
+		"usage: %s in.obj out.mesh [options]\n"
+		"  --raw           keep the positions as they are instead of placing them like the viewer\n"
+		"  --progressive   add coarser levels of detail for the viewer to show while the rest loads\n"
+		"  --runs N        decode the result N times and report the rate (default 10)\n"
+		"  --threads N     job system threads, 0 for one per core (default 0)\n",
+		program);
+}
+
+static long long file_size(const char* path)
+{
+	FILE* fp = fopen(path, "rb");
+	if (fp == NULL)
+		return 0;
+	fseek(fp, 0, SEEK_END);
+	long long size = ftell(fp);
+	fclose(fp);
+	return size;
+}
+
+int main(int argc, char* argv[])
+{
+	const char* in = NULL;
+	const char* out = NULL;
+	bool raw = false;
+	bool progressive = false;
+	int runs = 10;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--raw") == 0)
+			raw = true;
+		else if (strcmp(argv[i], "--progressive") == 0)
+			progressive = true;
+		else if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc)
+			runs = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			JobSystem::thread_count = atoi(argv[++i]);
+		else if (argv[i][0] != '-' && in == NULL)
+			in = argv[i];
+		else if (argv[i][0] != '-' && out == NULL)
+			out = argv[i];
+		else
+		{
+			print_usage(argv[0]);
+			return 1;
+		}
+	}
+	if (in == NULL || out == NULL)
+	{
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	std::vector<glm::vec3> vertices, normals;
+	std::vector<unsigned int> indices;
+	glm::vec3 min, max;
+	if (!OBJParser::parse(in, vertices, normals, indices, min, max))
+		return 1;
+	if (!raw)
+		OBJParser::normalize(vertices, min, max);
+
+	MeshFileInfo info;
+	if (!MeshCodec::write(out, vertices, normals, indices, &info, progressive))
+		return 1;
+	long long obj_bytes = file_size(in), mesh_bytes = file_size(out);
+	printf("Wrote %s: %u vertices, %u triangles%s, %lld bytes, %.1fx smaller than %s\n", out, info.vertex_count,
+		info.index_count / 3, info.has_normals ? "" : " without normals", mesh_bytes,
+		mesh_bytes > 0 ? obj_bytes / (double)mesh_bytes : 0.0, in);
+	std::vector<MeshLevel> levels;
+	if (progressive && MeshCodec::read_levels(out, info, levels))
+		for (size_t l = 0; l < levels.size(); l++)
+			printf("  level %d: %u vertices, %u triangles, %u bytes\n", (int)l, levels[l].vertex_count,
+				levels[l].index_count / 3, levels[l].size);
+
+	// Decode from memory, the way the viewer does after reading the file
+	std::vector<unsigned char> file;
+	if (runs <= 0 || !MeshCodec::load(out, file, info))
+		return 0;
+	std::vector<float> positions(3 * (size_t)info.vertex_count), decoded_normals(3 * (size_t)info.vertex_count);
+	std::vector<unsigned int> decoded_indices(info.index_count);
+	double best = 1e30;
+	for (int run = 0; run < runs; run++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		if (!MeshCodec::decode(file, positions.data(), decoded_normals.data(), decoded_indices.data()))
+		{
+			fprintf(stderr, "%s does not decode\n", out);
+			return 1;
+		}
+		best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	}
+	double decoded = (info.has_normals ? 24.0 : 12.0) * info.vertex_count + 4.0 * info.index_count;
+	printf("Decode: %.2f ms, %.2f GB/s of vertex and index data (best of %d)\n", best * 1000.0, decoded / best / 1e9, runs);
+	return 0;
+}
@@ -0,0 +1,56 @@
+#define _CRT_SECURE_NO_DEPRECATE
+#include "OBJGenerator.h"
+#include <stdio.h>
+#include <string.h>
+
+static void print_usage(const char* program)
+{
+	fprintf(stderr,
+		"usage: %s out.obj [options]\n"
+		"  --triangles N   triangle count, k/M suffixes allowed (default 100k)\n"
+		"  --format F      face format: v, vt, vn or vtn (default vn)\n"
+		"  --colors        write vertex colors after the positions\n",
+		program);
+}
+
+int main(int argc, char* argv[])
+{
+	const char* path = NULL;
+	long long triangles = 100000;
+	OBJGenerator::FaceFormat format = OBJGenerator::FACE_VN;
+	bool colors = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--triangles") == 0 && i + 1 < argc)
+			triangles = OBJGenerator::parse_count(argv[++i]);
+		else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc)
+		{
+			if (!OBJGenerator::parse_format(argv[++i], format))
+			{
+				print_usage(argv[0]);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--colors") == 0)
+			colors = true;
+		else if (argv[i][0] != '-' && path == NULL)
+			path = argv[i];
+		else
+		{
+			print_usage(argv[0]);
+			return 1;
+		}
+	}
+	if (path == NULL)
+	{
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	long long vertices = 0;
+	if (!OBJGenerator::write(path, triangles, format, colors, &vertices))
+		return 1;
+	printf("Wrote %s: %lld vertices, %lld triangles, faces as %s\n", path, vertices, triangles, OBJGenerator::format_name(format));
+	return 0;
+}
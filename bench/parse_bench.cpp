@@ -0,0 +1,264 @@
+#define _CRT_SECURE_NO_DEPRECATE
+#include "OBJGenerator.h"
+#include "OBJParser.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+typedef std::chrono::steady_clock bench_clock;
+
+struct BenchFile {
+	std::string path;
+	std::string format;
+	long long expected_vertices;		// -1 when not generated
+	long long expected_triangles;
+	bool generated;
+};
+
+struct BenchResult {
+	long long bytes;
+	size_t vertices, normals, triangles;
+	double parse_ms;				// Best of the repeats
+	double parse_avg_ms;
+	double normalize_ms;
+	double peak_rss_mb;
+};
+
+static double ms_between(bench_clock::time_point a, bench_clock::time_point b)
+{
+	return std::chrono::duration<double, std::milli>(b - a).count();
+}
+
+// High-water mark of the whole process, so it only grows from one file to the next
+static double peak_rss_mb()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0.0;
+	return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0.0;
+#ifdef __APPLE__
+	return usage.ru_maxrss / (1024.0 * 1024.0);
+#else
+	return usage.ru_maxrss / 1024.0;
+#endif
+#endif
+}
+
+static long long file_size(const char* path)
+{
+	FILE* fp = fopen(path, "rb");
+	if (fp == NULL)
+		return -1;
+	long long size = 0;
+	char buffer[1 << 16];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+		size += n;
+	fclose(fp);
+	return size;
+}
+
+static bool run(const BenchFile& file, int repeat, BenchResult& result)
+{
+	result.bytes = file_size(file.path.c_str());
+	if (result.bytes < 0)
+	{
+		fprintf(stderr, "Could not open %s\n", file.path.c_str());
+		return false;
+	}
+	result.parse_ms = 0.0;
+	result.parse_avg_ms = 0.0;
+	result.normalize_ms = 0.0;
+
+	for (int r = 0; r < repeat; r++)
+	{
+		// Fresh containers every time, the viewer parses into empty vectors too
+		std::vector<glm::vec3> vertices, normals;
+		std::vector<unsigned int> indices;
+		glm::vec3 min, max;
+
+		bench_clock::time_point t0 = bench_clock::now();
+		if (!OBJParser::parse(file.path.c_str(), vertices, normals, indices, min, max))
+			return false;
+		bench_clock::time_point t1 = bench_clock::now();
+		OBJParser::normalize(vertices, min, max);
+		bench_clock::time_point t2 = bench_clock::now();
+
+		double parse_ms = ms_between(t0, t1);
+		double normalize_ms = ms_between(t1, t2);
+		result.parse_ms = r == 0 ? parse_ms : std::min(result.parse_ms, parse_ms);
+		result.normalize_ms = r == 0 ? normalize_ms : std::min(result.normalize_ms, normalize_ms);
+		result.parse_avg_ms += parse_ms / repeat;
+		result.vertices = vertices.size();
+		result.normals = normals.size();
+		result.triangles = indices.size() / 3;
+	}
+	result.peak_rss_mb = peak_rss_mb();
+
+	if (file.expected_vertices >= 0 &&
+		((long long)result.vertices != file.expected_vertices || (long long)result.triangles != file.expected_triangles))
+	{
+		fprintf(stderr, "%s: expected %lld vertices and %lld triangles, parsed %zu and %zu\n", file.path.c_str(),
+			file.expected_vertices, file.expected_triangles, result.vertices, result.triangles);
+		return false;
+	}
+	return true;
+}
+
+static void print_usage(const char* program)
+{
+	fprintf(stderr,
+		"usage: %s [options] [file.obj ...]\n"
+		"Without files, synthetic models are generated, timed and deleted again.\n"
+		"  --triangles N,N,...  synthetic sizes, k/M suffixes allowed (default 1k,100k,1M)\n"
+		"  --format F|all       face format of the synthetic files: v, vt, vn or vtn (default vn)\n"
+		"  --colors             write vertex colors into the synthetic files\n"
+		"  --repeat R           parses per file, the best one is reported (default 3)\n"
+		"  --keep               keep the synthetic files\n"
+		"  --csv results.csv    also write the results as CSV\n",
+		program);
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<long long> sizes;
+	std::vector<OBJGenerator::FaceFormat> formats;
+	std::vector<BenchFile> files;
+	bool colors = false, keep = false;
+	int repeat = 3;
+	const char* csv_path = NULL;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--triangles") == 0 && i + 1 < argc)
+		{
+			for (char* size = strtok(argv[++i], ","); size; size = strtok(NULL, ","))
+				sizes.push_back(OBJGenerator::parse_count(size));
+		}
+		else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc)
+		{
+			OBJGenerator::FaceFormat format;
+			if (strcmp(argv[++i], "all") == 0)
+			{
+				for (int f = 0; f < OBJGenerator::FACE_FORMATS; f++)
+					formats.push_back((OBJGenerator::FaceFormat)f);
+			}
+			else if (OBJGenerator::parse_format(argv[i], format))
+				formats.push_back(format);
+			else
+			{
+				print_usage(argv[0]);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--colors") == 0)
+			colors = true;
+		else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+			repeat = std::max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "--keep") == 0)
+			keep = true;
+		else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc)
+			csv_path = argv[++i];
+		else if (argv[i][0] != '-')
+		{
+			BenchFile file = { argv[i], "file", -1, -1, false };
+			files.push_back(file);
+		}
+		else
+		{
+			print_usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (files.empty())
+	{
+		if (sizes.empty())
+		{
+			sizes.push_back(1000);
+			sizes.push_back(100000);
+			sizes.push_back(1000000);
+		}
+		if (formats.empty())
+			formats.push_back(OBJGenerator::FACE_VN);
+
+		for (size_t s = 0; s < sizes.size(); s++)
+		{
+			for (size_t f = 0; f < formats.size(); f++)
+			{
+				char path[128];
+				snprintf(path, sizeof(path), "synthetic_%lld_%s.obj", sizes[s], OBJGenerator::format_name(formats[f]));
+				long long vertices = 0;
+				bench_clock::time_point start = bench_clock::now();
+				if (!OBJGenerator::write(path, sizes[s], formats[f], colors, &vertices))
+					return 1;
+				printf("Generated %s in %.0f ms\n", path, ms_between(start, bench_clock::now()));
+
+				BenchFile file = { path, OBJGenerator::format_name(formats[f]), vertices, std::max(sizes[s], 2LL), true };
+				files.push_back(file);
+			}
+		}
+	}
+
+	FILE* csv = NULL;
+	if (csv_path)
+	{
+		csv = fopen(csv_path, "w");
+		if (csv == NULL)
+			fprintf(stderr, "Could not open %s, printing the table only\n", csv_path);
+		else
+			fprintf(csv, "file,format,bytes,vertices,normals,triangles,parse_ms,parse_avg_ms,normalize_ms,mb_per_s,mtris_per_s,peak_rss_mb\n");
+	}
+
+	printf("%-32s %6s %12s %10s %10s %10s %10s %10s %10s\n",
+		"file", "faces", "triangles", "MB", "parse ms", "MB/s", "Mtris/s", "norm ms", "peak MB");
+
+	int failures = 0;
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		BenchResult result;
+		if (run(files[i], repeat, result))
+		{
+			double mb = result.bytes / (1024.0 * 1024.0);
+			double seconds = result.parse_ms / 1000.0;
+			double mb_per_s = seconds > 0.0 ? mb / seconds : 0.0;
+			double mtris_per_s = seconds > 0.0 ? result.triangles / seconds / 1000000.0 : 0.0;
+
+			printf("%-32s %6s %12zu %10.1f %10.2f %10.1f %10.2f %10.2f %10.1f\n",
+				files[i].path.c_str(), files[i].format.c_str(), result.triangles, mb, result.parse_ms,
+				mb_per_s, mtris_per_s, result.normalize_ms, result.peak_rss_mb);
+			if (csv)
+				fprintf(csv, "%s,%s,%lld,%zu,%zu,%zu,%.3f,%.3f,%.3f,%.2f,%.3f,%.1f\n",
+					files[i].path.c_str(), files[i].format.c_str(), result.bytes, result.vertices, result.normals,
+					result.triangles, result.parse_ms, result.parse_avg_ms, result.normalize_ms, mb_per_s,
+					mtris_per_s, result.peak_rss_mb);
+		}
+		else
+			failures++;
+
+		if (files[i].generated && !keep)
+			remove(files[i].path.c_str());
+	}
+
+	if (csv)
+	{
+		fclose(csv);
+		printf("Results written to %s\n", csv_path);
+	}
+	return failures == 0 ? 0 : 1;
+}
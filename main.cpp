@@ -42,19 +42,17 @@ void setup_glew()
 
 void setup_opengl_settings()
 {
-#ifndef __APPLE__
-	// Setup GLEW. Don't do this on OSX systems.
-	setup_glew();
-#endif
+	// The state cache knows nothing about a new context
+	GLState::invalidate();
 	// Enable depth buffering
-	glEnable(GL_DEPTH_TEST);
+	GLState::enable(GL_DEPTH_TEST);
 	// Related to shaders and z value comparisons for the depth buffer
-	glDepthFunc(GL_LEQUAL);
+	GLState::depth_func(GL_LEQUAL);
 	// Set polygon drawing mode to fill front and back of each polygon
 	// You can also use the paramter of GL_LINE instead of GL_FILL to see wireframes
 	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 	// Disable backface culling to render both sides of polygons
-	glDisable(GL_CULL_FACE);
+	GLState::disable(GL_CULL_FACE);
 	// Set clear color
 	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 }
@@ -71,28 +69,359 @@ void print_versions()
 #endif
 }
 
-int main(void)
+// Command line settings
+struct Options
+{
+	bool headless = false;
+	int width = 640;
+	int height = 480;
+	int frames = 100;
+	bool frames_set = false;
+	int model = 1;
+	const char* output = NULL;
+	const char* capture = NULL;
+	const char* profile_csv = NULL;
+	const char* record = NULL;
+	const char* replay = NULL;
+	const char* script = NULL;
+	const char* report = NULL;
+	bool single_thread = false;
+	int threads = 0;		// Software rasterizer, ray tracer and job system threads, 0 for one per core
+	const char* trace = NULL;
+	int trace_frames = 300;	// Frames traced after startup
+	const char* batch = NULL;
+	int batch_workers = 0;	// Processes, 0 for one per core
+	int batch_worker = -1;	// Set in the worker processes themselves
+};
+
+// How often the main thread updates the scene when no input arrives
+const double UPDATE_INTERVAL = 1.0 / 120.0;
+
+bool benchmarking(const Options& options)
+{
+	return options.replay != NULL || options.script != NULL;
+}
+
+// Input for benchmark runs, either a recording or a scripted camera/light path
+bool load_benchmark_events(Options& options, std::vector<InputEvent>& events)
+{
+	if (options.replay)
+	{
+		int width = options.width, height = options.height;
+		if (!InputRecorder::load(options.replay, events, width, height))
+			return false;
+		if (width != options.width || height != options.height)
+			printf("Recording was made at %dx%d, replaying at %dx%d\n", width, height, options.width, options.height);
+		// Default to the length of the recording
+		if (!options.frames_set && !events.empty())
+			options.frames = events.back().frame + 1;
+		return true;
+	}
+	if (strcmp(options.script, "orbit") != 0)
+	{
+		fprintf(stderr, "Unknown benchmark script %s\n", options.script);
+		return false;
+	}
+	events = InputRecorder::orbit_script(options.model, options.frames);
+	return true;
+}
+
+// Stills for every line of a job file, see BatchRenderer
+int run_batch(Options& options, const char* executable)
+{
+	if (options.batch_worker < 0 && options.batch_workers != 1)
+	{
+		// Every worker gets an even part of the cores for its own threads
+		int cores = std::max(1, (int)std::thread::hardware_concurrency());
+		int workers = options.batch_workers > 0 ? options.batch_workers : cores;
+		int threads = options.threads > 0 ? options.threads : std::max(1, cores / workers);
+		char arguments[128];
+		snprintf(arguments, sizeof(arguments), " --size %dx%d --threads %d", options.width, options.height, threads);
+		return BatchRenderer::run_workers(executable, options.batch, workers, arguments);
+	}
+
+	if (!Headless::create_context(options.width, options.height))
+		return EXIT_FAILURE;
+	setup_opengl_settings();
+	int result = BatchRenderer::render(options.batch, options.batch_worker, options.batch_workers);
+	Headless::destroy_context();
+	return result;
+}
+
+int run_headless(Options& options)
+{
+	std::vector<InputEvent> events;
+	if (benchmarking(options) && !load_benchmark_events(options, events))
+		return EXIT_FAILURE;
+
+	bool cpu = Window::software || Window::raytrace;
+	if (cpu)
+	{
+		// No GL at all, frames only exist in the CPU renderer's buffers
+		if (options.capture)
+		{
+			fprintf(stderr, "--capture needs OpenGL, use --output with --software or --raytrace\n");
+			return EXIT_FAILURE;
+		}
+		if (Window::raytrace)
+			RayTracer::initialize(options.threads, false);
+		else
+			SoftwareRasterizer::initialize(options.threads, false);
+		Window::resize_callback(NULL, options.width, options.height);
+		Window::initialize_objects();
+	}
+	else
+	{
+		// Offscreen context and framebuffer, no window or display server involved
+		if (!Headless::create_context(options.width, options.height))
+			return EXIT_FAILURE;
+		print_versions();
+		setup_opengl_settings();
+		Window::resize_callback(NULL, options.width, options.height);
+		Window::initialize_objects();
+		// There is nobody watching, so don't render frames with the fallback shader
+		WaitForShaders();
+		if (options.capture)
+			Window::start_capture(options.capture);
+	}
+
+	if (benchmarking(options))
+	{
+		Benchmark::run(NULL, events, options.frames, options.replay ? options.replay : options.script, options.report);
+	}
+	else
+	{
+		Window::select_model(options.model);
+
+		// No vsync and no swap, frames are produced as fast as the backend allows
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int i = 0; i < options.frames; i++)
+		{
+			Window::idle_callback();
+			Window::render();
+		}
+		if (!cpu)
+			glFinish();
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		printf("Rendered %d frames at %dx%d in %.3f s (%.1f fps)\n", options.frames, options.width, options.height, seconds, options.frames / seconds);
+	}
+
+	if (cpu)
+	{
+		if (options.output && Window::raytrace)
+			RayTracer::save_ppm(options.output);
+		else if (options.output)
+			SoftwareRasterizer::save_ppm(options.output);
+		Window::clean_up();
+		return EXIT_SUCCESS;
+	}
+
+	Window::stop_capture();
+	if (options.output)
+		Headless::save_ppm(options.output);
+
+	Window::clean_up();
+	Headless::destroy_context();
+	return EXIT_SUCCESS;
+}
+
+int main(int argc, char* argv[])
 {
+	Options options;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--headless") == 0)
+			options.headless = true;
+		else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc)
+			sscanf(argv[++i], "%dx%d", &options.width, &options.height);
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+		{
+			options.frames = atoi(argv[++i]);
+			options.frames_set = true;
+		}
+		else if (strcmp(argv[i], "--model") == 0 && i + 1 < argc)
+		{
+			i++;
+			options.model = (strcmp(argv[i], "dragon") == 0) ? 2 : (strcmp(argv[i], "bear") == 0) ? 3 : 1;
+		}
+		else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+			options.output = argv[++i];
+		else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+			options.capture = argv[++i];
+		else if (strcmp(argv[i], "--profile") == 0)
+		{
+			GpuProfiler::enabled = true;
+			Window::show_overlay = true;
+		}
+		else if (strcmp(argv[i], "--profile-csv") == 0 && i + 1 < argc)
+			options.profile_csv = argv[++i];
+		else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+			options.record = argv[++i];
+		else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+			options.replay = argv[++i];
+		else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc)
+			options.script = argv[++i];
+		else if (strcmp(argv[i], "--report") == 0 && i + 1 < argc)
+			options.report = argv[++i];
+		else if (strcmp(argv[i], "--single-thread") == 0)
+			options.single_thread = true;
+		else if (strcmp(argv[i], "--low-latency") == 0)
+			FramePacer::enabled = true;
+		else if (strcmp(argv[i], "--target-ms") == 0 && i + 1 < argc)
+		{
+			// The controller is driven by the GPU frame time
+			DynamicResolution::enabled = true;
+			DynamicResolution::target_ms = (float)atof(argv[++i]);
+			GpuProfiler::enabled = true;
+		}
+		else if (strcmp(argv[i], "--scale-range") == 0 && i + 1 < argc)
+			sscanf(argv[++i], "%f:%f", &DynamicResolution::min_scale, &DynamicResolution::max_scale);
+		else if (strcmp(argv[i], "--sharpness") == 0 && i + 1 < argc)
+			DynamicResolution::sharpness = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "--software") == 0)
+			Window::software = true;
+		else if (strcmp(argv[i], "--occlusion") == 0)
+			OcclusionCuller::enabled = true;
+		else if (strcmp(argv[i], "--prepass") == 0 && i + 1 < argc && DepthPrepass::parse_mode(argv[i + 1]))
+			i++;
+		else if (strcmp(argv[i], "--overdraw-threshold") == 0 && i + 1 < argc)
+			DepthPrepass::threshold = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "--gpu-budget") == 0 && i + 1 < argc)
+			ResidencyManager::gpu_budget = (size_t)(atof(argv[++i]) * 1024 * 1024);
+		else if (strcmp(argv[i], "--cpu-budget") == 0 && i + 1 < argc)
+			ResidencyManager::cpu_budget = (size_t)(atof(argv[++i]) * 1024 * 1024);
+		else if (strcmp(argv[i], "--points") == 0 && i + 1 < argc)
+			PointCloud::source = argv[++i];
+		else if (strcmp(argv[i], "--point-budget") == 0 && i + 1 < argc)
+			PointCloud::point_budget = (size_t)(atof(argv[++i]) * 1000000.0);
+		else if (strcmp(argv[i], "--shading-lod") == 0 && i + 1 < argc)
+			ShadingLod::pixel_threshold = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc)
+			options.batch = argv[++i];
+		else if (strcmp(argv[i], "--batch-workers") == 0 && i + 1 < argc)
+			options.batch_workers = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--batch-worker") == 0 && i + 1 < argc)
+			options.batch_worker = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--crowd") == 0)
+			Window::crowd = true;
+		else if (strcmp(argv[i], "--raytrace") == 0)
+			Window::raytrace = true;
+		else if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc)
+			RayTracer::max_samples = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			JobSystem::thread_count = options.threads = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--pin-threads") == 0)
+			JobSystem::pin_threads = true;
+		else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+			options.trace = argv[++i];
+		else if (strcmp(argv[i], "--trace-frames") == 0 && i + 1 < argc)
+			options.trace_frames = atoi(argv[++i]);
+		else
+		{
+			fprintf(stderr, "Usage: %s [--headless] [--size WxH] [--frames N] [--model bunny|dragon|bear] [--output frame.ppm]\n"
+				"          [--capture video.y4m|frames/%%05d.ppm] [--profile] [--profile-csv timings.csv]\n"
+				"          [--record input.txt] [--replay input.txt | --bench orbit] [--report report.json]\n"
+				"          [--single-thread] [--low-latency] [--target-ms ms] [--scale-range min:max] [--sharpness s]\n"
+				"          [--software | --raytrace [--samples N]] [--threads N] [--pin-threads] [--crowd]\n"
+				"          [--occlusion] [--prepass on|off|auto] [--overdraw-threshold x] [--gpu-budget MB] [--cpu-budget MB]\n"
+				"          [--points cloud.obj [--point-budget millions]] [--shading-lod pixels]\n"
+				"          [--trace trace.json [--trace-frames N]] [--batch jobs.txt [--batch-workers N]]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	// Everything from here on is in the trace
+	Tracer::name_thread("main");
+	if (options.trace)
+		Tracer::start(options.trace, options.trace_frames);
+
+	// Writing the CSV turns profiling on; a file that cannot be opened leaves the other flags as set
+	if (options.profile_csv && GpuProfiler::open_csv(options.profile_csv))
+		GpuProfiler::enabled = true;
+
+	DynamicResolution::max_scale = std::min(1.0f, std::max(0.1f, DynamicResolution::max_scale));
+	DynamicResolution::min_scale = std::min(DynamicResolution::max_scale, std::max(0.1f, DynamicResolution::min_scale));
+	DynamicResolution::scale = DynamicResolution::max_scale;
+
+	if (options.batch)
+		return run_batch(options, argv[0]);
+	if (options.headless)
+		return run_headless(options);
+
+	std::vector<InputEvent> events;
+	if (benchmarking(options) && !load_benchmark_events(options, events))
+		return EXIT_FAILURE;
+
 	// Create the GLFW window
-	window = Window::create_window(640, 480);
+	window = Window::create_window(options.width, options.height);
 	// Print OpenGL and GLSL versions
 	print_versions();
+	FramePacer::initialize();
 	// Setup callbacks
 	setup_callbacks();
+	if (benchmarking(options))
+	{
+		// Benchmarks run without vsync and ignore live input, only the recorded events count
+		glfwSwapInterval(0);
+		glfwSetKeyCallback(window, NULL);
+		glfwSetMouseButtonCallback(window, NULL);
+		glfwSetScrollCallback(window, NULL);
+		glfwSetCursorPosCallback(window, NULL);
+	}
+#ifndef __APPLE__
+	// Setup GLEW. Don't do this on OSX systems.
+	setup_glew();
+#endif
 	// Setup OpenGL settings, including lighting, materials, etc.
 	setup_opengl_settings();
+	if (Window::raytrace)
+		RayTracer::initialize(options.threads, true);
+	else if (Window::software)
+		SoftwareRasterizer::initialize(options.threads, true);
 	// Initialize objects/pointers for rendering
 	Window::initialize_objects();
+	if (options.capture)
+		Window::start_capture(options.capture);
+	if (options.record)
+		InputRecorder::start_recording(options.record, Window::width, Window::height);
 
-	// Loop while GLFW window should stay open
-	while (!glfwWindowShouldClose(window))
+	if (benchmarking(options))
+	{
+		// Every run has to do the same work, so don't start with the fallback shader
+		if (!Window::software && !Window::raytrace)
+			WaitForShaders();
+		Benchmark::run(window, events, options.frames, options.replay ? options.replay : options.script, options.report);
+	}
+	else if (!options.single_thread)
+	{
+		// Rendering runs on its own thread, this one only handles events and updates the scene
+		RenderThread::start(window);
+		while (!glfwWindowShouldClose(window))
+		{
+			// Returns as soon as input arrives, so input never waits for a frame
+			glfwWaitEventsTimeout(UPDATE_INTERVAL);
+			Window::idle_callback();
+			RenderThread::publish(Window::snapshot());
+			Window::update_title(window);
+			// Events recorded from now on belong to the next update
+			InputRecorder::next_frame();
+		}
+		RenderThread::stop();
+	}
+	else
 	{
-		// Main render display callback. Rendering of objects is done here.
-		Window::display_callback(window);
-		// Idle callback. Updating objects, etc. can be done here.
-		Window::idle_callback();
+		// Loop while GLFW window should stay open
+		while (!glfwWindowShouldClose(window))
+		{
+			// Main render display callback. Rendering of objects is done here.
+			Window::display_callback(window);
+			// Idle callback. Updating objects, etc. can be done here.
+			Window::idle_callback();
+		}
 	}
 
+	InputRecorder::stop_recording();
 	Window::clean_up();
 	// Destroy the window
 	glfwDestroyWindow(window);
@@ -100,4 +429,4 @@ int main(void)
 	glfwTerminate();
 
 	exit(EXIT_SUCCESS);
-}
\ No newline at end of file
+}
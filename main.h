@@ -10,6 +10,13 @@
 #include <GLFW/glfw3.h>
 #include <stdlib.h>
 #include <stdio.h>
-#include "window.h"
+#include <string.h>
+#include <chrono>
+#include <algorithm>
+#include <thread>
+#include "Window.h"
+#include "Headless.h"
+#include "Benchmark.h"
+#include "BatchRenderer.h"
 
 #endif
\ No newline at end of file
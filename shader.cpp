@@ -1,9 +1,26 @@
 #include <stdio.h>
+#include <stdint.h>
+#include <string.h>
 #include <string>
 #include <vector>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <algorithm>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <atomic>
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#define getpid _getpid
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 using namespace std;
 
 #define GLFW_INCLUDE_GLEXT
@@ -15,97 +32,237 @@ using namespace std;
 #include <GLFW/glfw3.h>
 
 #include "shader.h"
+#include "Tracer.h"
 
-GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path){
+const char * ShaderCacheDir = "shader_cache";
 
-	// Create the shaders
-	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
+// Header written in front of every cached program binary
+struct ProgramBinaryHeader {
+	char Magic[4];
+	GLenum Format;
+	GLint Length;
+};
 
-	// Read the Vertex Shader code from the file
-	std::string VertexShaderCode;
-	std::ifstream VertexShaderStream(vertex_file_path, std::ios::in);
-	if(VertexShaderStream.is_open()){
-		std::string Line = "";
-		while(getline(VertexShaderStream, Line))
-			VertexShaderCode += "\n" + Line;
-		VertexShaderStream.close();
-	}else{
-		printf("Impossible to open %s. Check to make sure the file exists and you passed in the right filepath!\n", vertex_file_path);
-		printf("The current working directory is:");
+static double MillisecondsSince(std::chrono::steady_clock::time_point Start){
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - Start).count();
+}
 
-		// Please for the love of whatever deity/ies you believe in never do something like the next line of code,
-		// Especially on non-Windows systems where you can have the system happily execute "rm -rf ~"
-#ifdef _WIN32
-		system("CD");
-#else
-		system("pwd");
+static bool ReadShaderFile(const char * file_path, std::string & Code){
+	std::ifstream Stream(file_path, std::ios::in | std::ios::binary);
+	if(!Stream.is_open())
+		return false;
+
+	// Read the whole file at once instead of line by line
+	std::stringstream Buffer;
+	Buffer << Stream.rdbuf();
+	Code = Buffer.str();
+	return true;
+}
+
+// GLSL has no #include of its own. Replaces #include "file" lines with the file, which is looked up next
+// to the shader including it, and restores the line numbers after it for error messages.
+static std::string ExpandIncludes(const std::string & Code, const char * file_path){
+	std::string Directory = file_path;
+	size_t Slash = Directory.find_last_of("/\\");
+	Directory = Slash == std::string::npos ? "" : Directory.substr(0, Slash + 1);
+
+	std::string Result;
+	int LineNumber = 1;
+	for(size_t Start = 0; Start < Code.size(); LineNumber++){
+		size_t End = Code.find('\n', Start);
+		End = End == std::string::npos ? Code.size() : End + 1;
+		std::string Line = Code.substr(Start, End - Start);
+		Start = End;
+
+		size_t First = Line.find_first_not_of(" \t");
+		size_t Open = Line.find('"');
+		size_t Close = Open == std::string::npos ? std::string::npos : Line.find('"', Open + 1);
+		if(First == std::string::npos || Line.compare(First, 8, "#include") != 0 || Close == std::string::npos){
+			Result += Line;
+			continue;
+		}
+		std::string Included;
+		std::string IncludePath = Directory + Line.substr(Open + 1, Close - Open - 1);
+		if(!ReadShaderFile(IncludePath.c_str(), Included)){
+			printf("Impossible to open %s, included by %s\n", IncludePath.c_str(), file_path);
+			Result += Line;
+			continue;
+		}
+		Result += Included;
+		if(!Included.empty() && Included[Included.size() - 1] != '\n')
+			Result += "\n";
+		Result += "#line " + std::to_string(LineNumber + 1) + "\n";
+	}
+	return Result;
+}
+
+// #version has to stay the first statement, so the defines go right after it
+static std::string InjectDefines(const std::string & Code, const char * defines){
+	if(defines == NULL || defines[0] == '\0')
+		return Code;
+
+	size_t Version = Code.find("#version");
+	if(Version == std::string::npos)
+		return std::string(defines) + "\n" + Code;
+
+	size_t LineEnd = Code.find('\n', Version);
+	if(LineEnd == std::string::npos)
+		return Code + "\n" + defines + "\n";
+
+	return Code.substr(0, LineEnd + 1) + defines + "\n" + Code.substr(LineEnd + 1);
+}
+
+// 64-bit FNV-1a, good enough to tell shader sources apart
+static uint64_t HashBytes(uint64_t Hash, const char * Data, size_t Length){
+	for(size_t i = 0; i < Length; i++){
+		Hash ^= (unsigned char)Data[i];
+		Hash *= 1099511628211ULL;
+	}
+	// Separator so that "ab" + "c" and "a" + "bc" hash differently
+	Hash ^= 0xff;
+	Hash *= 1099511628211ULL;
+	return Hash;
+}
+
+static bool ProgramBinarySupported(){
+	if(ShaderCacheDir == NULL)
+		return false;
+#ifndef __APPLE__
+	if(!GLEW_ARB_get_program_binary)
+		return false;
 #endif
-		getchar();
+	// Some drivers expose the entry points but no binary formats at all
+	GLint Formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &Formats);
+	return Formats > 0;
+}
+
+static std::string ProgramCachePath(const std::string & VertexShaderCode, const std::string & FragmentShaderCode, const char * defines){
+	// The binary is only valid for the exact driver that produced it, so the renderer and version are part of the key
+	const char * Renderer = (const char *)glGetString(GL_RENDERER);
+	const char * Version = (const char *)glGetString(GL_VERSION);
+	if(Renderer == NULL) Renderer = "";
+	if(Version == NULL) Version = "";
+
+	uint64_t Hash = 14695981039346656037ULL;
+	Hash = HashBytes(Hash, VertexShaderCode.data(), VertexShaderCode.size());
+	Hash = HashBytes(Hash, FragmentShaderCode.data(), FragmentShaderCode.size());
+	Hash = HashBytes(Hash, defines, strlen(defines));
+	Hash = HashBytes(Hash, Renderer, strlen(Renderer));
+	Hash = HashBytes(Hash, Version, strlen(Version));
+
+	char Name[32];
+	snprintf(Name, sizeof(Name), "%016llx.bin", (unsigned long long)Hash);
+	return std::string(ShaderCacheDir) + "/" + Name;
+}
+
+static GLuint LoadProgramBinary(const std::string & CachePath){
+	FILE * File = fopen(CachePath.c_str(), "rb");
+	if(File == NULL)
 		return 0;
-	}
 
-	// Read the Fragment Shader code from the file
-	std::string FragmentShaderCode;
-	std::ifstream FragmentShaderStream(fragment_file_path, std::ios::in);
-	if(FragmentShaderStream.is_open()){
-		std::string Line = "";
-		while(getline(FragmentShaderStream, Line))
-			FragmentShaderCode += "\n" + Line;
-		FragmentShaderStream.close();
+	ProgramBinaryHeader Header;
+	std::vector<char> Binary;
+	bool Valid = fread(&Header, sizeof(Header), 1, File) == 1
+		&& memcmp(Header.Magic, "GLPB", 4) == 0
+		&& Header.Length > 0;
+	if(Valid){
+		Binary.resize(Header.Length);
+		Valid = fread(&Binary[0], 1, Binary.size(), File) == Binary.size();
 	}
+	fclose(File);
+	if(!Valid)
+		return 0;
 
+	GLuint ProgramID = glCreateProgram();
+	glProgramBinary(ProgramID, Header.Format, &Binary[0], Header.Length);
+
+	// The driver is free to reject binaries, e.g. after a driver update
 	GLint Result = GL_FALSE;
-	int InfoLogLength;
+	glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
+	if(Result != GL_TRUE){
+		glDeleteProgram(ProgramID);
+		return 0;
+	}
+	return ProgramID;
+}
 
+static void StoreProgramBinary(const std::string & CachePath, GLuint ProgramID){
+	GLint Length = 0;
+	glGetProgramiv(ProgramID, GL_PROGRAM_BINARY_LENGTH, &Length);
+	if(Length <= 0)
+		return;
 
-	// Compile Vertex Shader
-	printf("Compiling shader : %s\n", vertex_file_path);
-	char const * VertexSourcePointer = VertexShaderCode.c_str();
-	glShaderSource(VertexShaderID, 1, &VertexSourcePointer , NULL);
-	glCompileShader(VertexShaderID);
+	ProgramBinaryHeader Header;
+	memcpy(Header.Magic, "GLPB", 4);
+	std::vector<char> Binary(Length);
+	glGetProgramBinary(ProgramID, Length, &Length, &Header.Format, &Binary[0]);
+	Header.Length = Length;
 
-	// Check Vertex Shader
-	glGetShaderiv(VertexShaderID, GL_COMPILE_STATUS, &Result);
-	glGetShaderiv(VertexShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-	if ( InfoLogLength > 0 ){
-		std::vector<char> VertexShaderErrorMessage(InfoLogLength+1);
-		glGetShaderInfoLog(VertexShaderID, InfoLogLength, NULL, &VertexShaderErrorMessage[0]);
-		printf("%s\n", &VertexShaderErrorMessage[0]);
-	}
-	else {
-		printf("Successfully compiled vertex shader!\n");
+#ifdef _WIN32
+	_mkdir(ShaderCacheDir);
+#else
+	mkdir(ShaderCacheDir, 0755);
+#endif
+
+	// Write to a temporary file first so a crash never leaves a half-written entry behind. Named per
+	// process, batch workers compiling the same program at once must not write into one file.
+	std::string TempPath = CachePath + "." + std::to_string((long long)getpid()) + ".tmp";
+	FILE * File = fopen(TempPath.c_str(), "wb");
+	if(File == NULL){
+		printf("Could not write shader cache entry %s\n", CachePath.c_str());
+		return;
 	}
+	bool Written = fwrite(&Header, sizeof(Header), 1, File) == 1
+		&& fwrite(&Binary[0], 1, Length, File) == (size_t)Length;
+	fclose(File);
 
+	remove(CachePath.c_str());
+	if(!Written || rename(TempPath.c_str(), CachePath.c_str()) != 0)
+		remove(TempPath.c_str());
+}
 
+// Hands the source to the driver without waiting for the result
+static GLuint StartCompile(GLenum Type, const std::string & Code){
+	GLuint ShaderID = glCreateShader(Type);
+	char const * SourcePointer = Code.c_str();
+	glShaderSource(ShaderID, 1, &SourcePointer , NULL);
+	glCompileShader(ShaderID);
+	return ShaderID;
+}
 
-	// Compile Fragment Shader
-	printf("Compiling shader : %s\n", fragment_file_path);
-	char const * FragmentSourcePointer = FragmentShaderCode.c_str();
-	glShaderSource(FragmentShaderID, 1, &FragmentSourcePointer , NULL);
-	glCompileShader(FragmentShaderID);
+// Querying the compile status blocks until the driver is done with the shader
+static void ReportShader(GLuint ShaderID, GLenum Type, const char * file_path){
+	GLint Result = GL_FALSE;
+	int InfoLogLength;
 
-	// Check Fragment Shader
-	glGetShaderiv(FragmentShaderID, GL_COMPILE_STATUS, &Result);
-	glGetShaderiv(FragmentShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+	glGetShaderiv(ShaderID, GL_COMPILE_STATUS, &Result);
+	glGetShaderiv(ShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
 	if ( InfoLogLength > 0 ){
-		std::vector<char> FragmentShaderErrorMessage(InfoLogLength+1);
-		glGetShaderInfoLog(FragmentShaderID, InfoLogLength, NULL, &FragmentShaderErrorMessage[0]);
-		printf("%s\n", &FragmentShaderErrorMessage[0]);
+		std::vector<char> ShaderErrorMessage(InfoLogLength+1);
+		glGetShaderInfoLog(ShaderID, InfoLogLength, NULL, &ShaderErrorMessage[0]);
+		printf("%s: %s\n", file_path, &ShaderErrorMessage[0]);
 	}
-	else {
-		printf("Successfully compiled fragment shader!\n");
+	else if (Result == GL_TRUE) {
+		printf("Successfully compiled %s shader %s!\n", Type == GL_VERTEX_SHADER ? "vertex" : "fragment", file_path);
 	}
+}
 
-
-	// Link the program
-	printf("Linking program\n");
+static GLuint StartLink(GLuint VertexShaderID, GLuint FragmentShaderID, bool Retrievable){
 	GLuint ProgramID = glCreateProgram();
+	// Has to be set before linking, otherwise drivers may not keep the binary around
+	if(Retrievable)
+		glProgramParameteri(ProgramID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 	glAttachShader(ProgramID, VertexShaderID);
 	glAttachShader(ProgramID, FragmentShaderID);
 	glLinkProgram(ProgramID);
+	return ProgramID;
+}
+
+static bool ReportProgram(GLuint ProgramID){
+	GLint Result = GL_FALSE;
+	int InfoLogLength;
 
-	// Check the program
 	glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
 	glGetProgramiv(ProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
 	if ( InfoLogLength > 0 ){
@@ -113,12 +270,421 @@ GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path
 		glGetProgramInfoLog(ProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
 		printf("%s\n", &ProgramErrorMessage[0]);
 	}
-	
+	return Result == GL_TRUE;
+}
+
+static void FinishLink(GLuint ProgramID, GLuint VertexShaderID, GLuint FragmentShaderID){
 	glDetachShader(ProgramID, VertexShaderID);
 	glDetachShader(ProgramID, FragmentShaderID);
-	
 	glDeleteShader(VertexShaderID);
 	glDeleteShader(FragmentShaderID);
+}
+
+static bool ReadShaderSources(const char * vertex_file_path, const char * fragment_file_path, const char * defines, std::string & VertexShaderCode, std::string & FragmentShaderCode){
+	// Read the Vertex Shader code from the file
+	if(!ReadShaderFile(vertex_file_path, VertexShaderCode)){
+		printf("Impossible to open %s. Check to make sure the file exists and you passed in the right filepath!\n", vertex_file_path);
+		printf("The current working directory is:");
+
+		// Please for the love of whatever deity/ies you believe in never do something like the next line of code,
+		// Especially on non-Windows systems where you can have the system happily execute "rm -rf ~"
+#ifdef _WIN32
+		system("CD");
+#else
+		system("pwd");
+#endif
+		getchar();
+		return false;
+	}
+
+	// Read the Fragment Shader code from the file
+	ReadShaderFile(fragment_file_path, FragmentShaderCode);
+
+	VertexShaderCode = InjectDefines(ExpandIncludes(VertexShaderCode, vertex_file_path), defines);
+	FragmentShaderCode = InjectDefines(ExpandIncludes(FragmentShaderCode, fragment_file_path), defines);
+	return true;
+}
+
+GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path,const char * defines){
+
+	TRACE_SCOPE("LoadShaders");
+	std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+	if(defines == NULL)
+		defines = "";
+
+	std::string VertexShaderCode;
+	std::string FragmentShaderCode;
+	if(!ReadShaderSources(vertex_file_path, fragment_file_path, defines, VertexShaderCode, FragmentShaderCode))
+		return 0;
+
+	// Try the program binary cache before handing the sources to the compiler
+	bool UseCache = ProgramBinarySupported();
+	std::string CachePath;
+	if(UseCache){
+		CachePath = ProgramCachePath(VertexShaderCode, FragmentShaderCode, defines);
+		GLuint ProgramID = LoadProgramBinary(CachePath);
+		if(ProgramID != 0){
+			printf("Shader cache hit for %s + %s: loaded in %.2f ms\n", vertex_file_path, fragment_file_path, MillisecondsSince(Start));
+			return ProgramID;
+		}
+	}
+
+	// Compile and link from source
+	printf("Compiling shaders : %s + %s\n", vertex_file_path, fragment_file_path);
+	GLuint VertexShaderID = StartCompile(GL_VERTEX_SHADER, VertexShaderCode);
+	GLuint FragmentShaderID = StartCompile(GL_FRAGMENT_SHADER, FragmentShaderCode);
+	ReportShader(VertexShaderID, GL_VERTEX_SHADER, vertex_file_path);
+	ReportShader(FragmentShaderID, GL_FRAGMENT_SHADER, fragment_file_path);
+
+	printf("Linking program\n");
+	GLuint ProgramID = StartLink(VertexShaderID, FragmentShaderID, UseCache);
+	bool Linked = ReportProgram(ProgramID);
+	FinishLink(ProgramID, VertexShaderID, FragmentShaderID);
+
+	if(UseCache && Linked){
+		StoreProgramBinary(CachePath, ProgramID);
+		printf("Shader cache miss for %s + %s: compiled in %.2f ms, stored %s\n", vertex_file_path, fragment_file_path, MillisecondsSince(Start), CachePath.c_str());
+	}
+	else {
+		printf("Compiled %s + %s in %.2f ms (no program binary cache)\n", vertex_file_path, fragment_file_path, MillisecondsSince(Start));
+	}
+
+	return ProgramID;
+}
+
+GLuint LoadFeedbackShader(const char * vertex_file_path, const char * defines, const char * const * varyings, int count){
+	TRACE_SCOPE("LoadFeedbackShader");
+	std::string VertexShaderCode;
+	if(!ReadShaderFile(vertex_file_path, VertexShaderCode)){
+		printf("Impossible to open %s\n", vertex_file_path);
+		return 0;
+	}
+	VertexShaderCode = InjectDefines(ExpandIncludes(VertexShaderCode, vertex_file_path), defines == NULL ? "" : defines);
+
+	GLuint VertexShaderID = StartCompile(GL_VERTEX_SHADER, VertexShaderCode);
+	ReportShader(VertexShaderID, GL_VERTEX_SHADER, vertex_file_path);
+	GLuint ProgramID = glCreateProgram();
+	glAttachShader(ProgramID, VertexShaderID);
+	// Has to be set before linking
+	glTransformFeedbackVaryings(ProgramID, count, varyings, GL_INTERLEAVED_ATTRIBS);
+	glLinkProgram(ProgramID);
+	bool Linked = ReportProgram(ProgramID);
+	glDetachShader(ProgramID, VertexShaderID);
+	glDeleteShader(VertexShaderID);
+	if(!Linked){
+		glDeleteProgram(ProgramID);
+		return 0;
+	}
+	return ProgramID;
+}
+
+/* Asynchronous compilation */
+
+enum PendingState { PENDING_QUEUED, PENDING_COMPILING, PENDING_LINKED, PENDING_READY, PENDING_FAILED };
+
+struct PendingProgram {
+	std::string VertexPath;
+	std::string FragmentPath;
+	std::string VertexShaderCode;
+	std::string FragmentShaderCode;
+	std::string CachePath;
+	GLuint VertexShaderID;
+	GLuint FragmentShaderID;
+	GLuint ProgramID;
+	GLsync Fence;
+	std::atomic<int> State;
+	std::chrono::steady_clock::time_point Start;
+};
+
+// Indexed by ShaderHandle
+static std::vector<PendingProgram *> Pending;
+static bool CompilerInitialized = false;
+static bool ParallelCompile = false;
+
+// Worker context fallback for drivers without GL_KHR_parallel_shader_compile
+static GLFWwindow * WorkerWindow = NULL;
+static std::thread WorkerThread;
+static std::mutex WorkerMutex;
+static std::condition_variable WorkerWake;
+static std::deque<PendingProgram *> WorkerQueue;
+static bool WorkerQuit = false;
+
+static void WorkerLoop(){
+	Tracer::name_thread("shader compiler");
+	// The hidden window's context shares objects with the main context
+	glfwMakeContextCurrent(WorkerWindow);
+	for(;;){
+		PendingProgram * Program;
+		{
+			std::unique_lock<std::mutex> Lock(WorkerMutex);
+			WorkerWake.wait(Lock, []{ return WorkerQuit || !WorkerQueue.empty(); });
+			if(WorkerQuit)
+				break;
+			Program = WorkerQueue.front();
+			WorkerQueue.pop_front();
+		}
+
+		// Blocking queries are fine here, they only stall this thread
+		TRACE_SCOPE("compile and link");
+		bool UseCache = !Program->CachePath.empty();
+		Program->VertexShaderID = StartCompile(GL_VERTEX_SHADER, Program->VertexShaderCode);
+		Program->FragmentShaderID = StartCompile(GL_FRAGMENT_SHADER, Program->FragmentShaderCode);
+		ReportShader(Program->VertexShaderID, GL_VERTEX_SHADER, Program->VertexPath.c_str());
+		ReportShader(Program->FragmentShaderID, GL_FRAGMENT_SHADER, Program->FragmentPath.c_str());
+		Program->ProgramID = StartLink(Program->VertexShaderID, Program->FragmentShaderID, UseCache);
+		bool Linked = ReportProgram(Program->ProgramID);
+		FinishLink(Program->ProgramID, Program->VertexShaderID, Program->FragmentShaderID);
+		if(UseCache && Linked)
+			StoreProgramBinary(Program->CachePath, Program->ProgramID);
+
+		// The main context may only use the program once this fence has signaled
+		Program->Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		glFlush();
+		Program->State = Linked ? PENDING_LINKED : PENDING_FAILED;
+	}
+	glfwMakeContextCurrent(NULL);
+}
+
+// Works without GLFW, e.g. on a headless context
+static bool HasExtension(const char * Name){
+	GLint Count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &Count);
+	for(GLint i = 0; i < Count; i++){
+		const char * Extension = (const char *)glGetStringi(GL_EXTENSIONS, i);
+		if(Extension != NULL && strcmp(Extension, Name) == 0)
+			return true;
+	}
+	return false;
+}
+
+static void InitializeCompiler(){
+	CompilerInitialized = true;
+
+#ifndef __APPLE__
+	if(HasExtension("GL_KHR_parallel_shader_compile") && glMaxShaderCompilerThreadsKHR != NULL){
+		// Let the driver use as many compiler threads as it likes
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+		ParallelCompile = true;
+	}
+	else if(HasExtension("GL_ARB_parallel_shader_compile") && glMaxShaderCompilerThreadsARB != NULL){
+		glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+		ParallelCompile = true;
+	}
+	if(ParallelCompile){
+		printf("Using GL_KHR_parallel_shader_compile for shader compilation\n");
+		return;
+	}
+#endif
+
+	GLFWwindow * MainWindow = glfwGetCurrentContext();
+	if(MainWindow == NULL){
+		printf("No shared context available, shaders will compile synchronously\n");
+		return;
+	}
+
+	// Invisible window whose only purpose is a context that shares objects with ours
+	glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+	WorkerWindow = glfwCreateWindow(1, 1, "Shader compiler", NULL, MainWindow);
+	glfwWindowHint(GLFW_VISIBLE, GL_TRUE);
+	if(WorkerWindow == NULL){
+		printf("Could not create a shader compiler context, shaders will compile synchronously\n");
+		return;
+	}
+	glfwMakeContextCurrent(MainWindow);
+	WorkerThread = std::thread(WorkerLoop);
+	printf("Using a worker context for shader compilation\n");
+}
+
+ShaderHandle SubmitShaders(const char * vertex_file_path,const char * fragment_file_path,const char * defines){
+	TRACE_SCOPE("SubmitShaders");
+	if(!CompilerInitialized)
+		InitializeCompiler();
+	if(defines == NULL)
+		defines = "";
+
+	PendingProgram * Program = new PendingProgram();
+	Program->VertexPath = vertex_file_path;
+	Program->FragmentPath = fragment_file_path;
+	Program->VertexShaderID = 0;
+	Program->FragmentShaderID = 0;
+	Program->ProgramID = 0;
+	Program->Fence = 0;
+	Program->State = PENDING_QUEUED;
+	Program->Start = std::chrono::steady_clock::now();
+	Pending.push_back(Program);
+	ShaderHandle Handle = (ShaderHandle)Pending.size() - 1;
+
+	if(!ReadShaderSources(vertex_file_path, fragment_file_path, defines, Program->VertexShaderCode, Program->FragmentShaderCode)){
+		Program->State = PENDING_FAILED;
+		return Handle;
+	}
 
+	// A cached binary is cheap enough to load right away
+	if(ProgramBinarySupported()){
+		Program->CachePath = ProgramCachePath(Program->VertexShaderCode, Program->FragmentShaderCode, defines);
+		Program->ProgramID = LoadProgramBinary(Program->CachePath);
+		if(Program->ProgramID != 0){
+			printf("Shader cache hit for %s + %s: loaded in %.2f ms\n", vertex_file_path, fragment_file_path, MillisecondsSince(Program->Start));
+			Program->State = PENDING_READY;
+			return Handle;
+		}
+	}
+
+	printf("Submitted shaders : %s + %s\n", vertex_file_path, fragment_file_path);
+	if(ParallelCompile){
+		// Kick off compile and link; the status is only queried once GL_COMPLETION_STATUS_KHR says it is done
+		Program->VertexShaderID = StartCompile(GL_VERTEX_SHADER, Program->VertexShaderCode);
+		Program->FragmentShaderID = StartCompile(GL_FRAGMENT_SHADER, Program->FragmentShaderCode);
+		Program->ProgramID = StartLink(Program->VertexShaderID, Program->FragmentShaderID, !Program->CachePath.empty());
+		Program->State = PENDING_COMPILING;
+	}
+	else if(WorkerWindow != NULL){
+		std::lock_guard<std::mutex> Lock(WorkerMutex);
+		WorkerQueue.push_back(Program);
+		Program->State = PENDING_COMPILING;
+		WorkerWake.notify_one();
+	}
+	else {
+		Program->ProgramID = LoadShaders(vertex_file_path, fragment_file_path, defines);
+		Program->State = Program->ProgramID != 0 ? PENDING_READY : PENDING_FAILED;
+	}
+	return Handle;
+}
+
+void PollShaders(){
+	for(size_t i = 0; i < Pending.size(); i++){
+		PendingProgram * Program = Pending[i];
+		int State = Program->State;
+
+		if(State == PENDING_COMPILING && ParallelCompile){
+			GLint Done = GL_FALSE;
+			glGetProgramiv(Program->ProgramID, GL_COMPLETION_STATUS_KHR, &Done);
+			if(!Done)
+				continue;
+
+			ReportShader(Program->VertexShaderID, GL_VERTEX_SHADER, Program->VertexPath.c_str());
+			ReportShader(Program->FragmentShaderID, GL_FRAGMENT_SHADER, Program->FragmentPath.c_str());
+			bool Linked = ReportProgram(Program->ProgramID);
+			FinishLink(Program->ProgramID, Program->VertexShaderID, Program->FragmentShaderID);
+			if(Linked && !Program->CachePath.empty())
+				StoreProgramBinary(Program->CachePath, Program->ProgramID);
+			Program->State = Linked ? PENDING_READY : PENDING_FAILED;
+		}
+		else if(State == PENDING_LINKED || (State == PENDING_FAILED && Program->Fence != 0)){
+			GLenum Wait = glClientWaitSync(Program->Fence, 0, 0);
+			if(Wait != GL_ALREADY_SIGNALED && Wait != GL_CONDITION_SATISFIED)
+				continue;
+			glDeleteSync(Program->Fence);
+			Program->Fence = 0;
+			if(State == PENDING_LINKED)
+				Program->State = PENDING_READY;
+		}
+		else {
+			continue;
+		}
+
+		if(Program->State == PENDING_READY)
+			printf("Shaders %s + %s ready after %.2f ms\n", Program->VertexPath.c_str(), Program->FragmentPath.c_str(), MillisecondsSince(Program->Start));
+		else
+			printf("Shaders %s + %s failed to build\n", Program->VertexPath.c_str(), Program->FragmentPath.c_str());
+	}
+}
+
+bool ShaderProgramReady(ShaderHandle handle){
+	return handle >= 0 && handle < (ShaderHandle)Pending.size() && Pending[handle]->State == PENDING_READY;
+}
+
+GLuint GetShaderProgram(ShaderHandle handle, GLuint fallback){
+	if(!ShaderProgramReady(handle))
+		return fallback;
+	return Pending[handle]->ProgramID;
+}
+
+void WaitForShaders(){
+	TRACE_SCOPE("WaitForShaders");
+	bool Busy = true;
+	while(Busy){
+		PollShaders();
+		Busy = false;
+		for(size_t i = 0; i < Pending.size(); i++){
+			int State = Pending[i]->State;
+			if(State != PENDING_READY && (State != PENDING_FAILED || Pending[i]->Fence != 0))
+				Busy = true;
+		}
+		if(Busy)
+			std::this_thread::yield();
+	}
+}
+
+// Shown while the real shaders are still compiling. Deliberately tiny so it compiles in no time.
+static const char * FallbackVertexShader =
+	"#version 330 core\n"
+	"layout (location = 0) in vec3 position;\n"
+	"layout (location = 1) in vec3 normal;\n"
+	// The start of the DrawData block of shader.vert
+	"layout (std140) uniform DrawData {\n"
+	"    mat4 projection;\n"
+	"    mat4 modelview;\n"
+	"    mat4 model;\n"
+	"    mat4 view;\n"
+	"};\n"
+	"out vec3 Normal;\n"
+	"invariant gl_Position;\n"
+	"void main()\n"
+	"{\n"
+	"    gl_Position = projection * view * model * vec4(position.x, position.y, position.z, 1.0);\n"
+	"    Normal = mat3(model) * normal;\n"
+	"}\n";
+
+static const char * FallbackFragmentShader =
+	"#version 330 core\n"
+	"in vec3 Normal;\n"
+	"out vec4 color;\n"
+	"void main()\n"
+	"{\n"
+	"    color = vec4(normalize(Normal) * 0.5 + 0.5, 1.0);\n"
+	"}\n";
+
+GLuint LoadShaderSource(const char * vertex_source, const char * fragment_source, const char * name){
+	GLuint VertexShaderID = StartCompile(GL_VERTEX_SHADER, vertex_source);
+	GLuint FragmentShaderID = StartCompile(GL_FRAGMENT_SHADER, fragment_source);
+	GLuint ProgramID = StartLink(VertexShaderID, FragmentShaderID, false);
+	if(!ReportProgram(ProgramID)){
+		// Only look at the shaders when linking failed, their status queries block
+		ReportShader(VertexShaderID, GL_VERTEX_SHADER, name);
+		ReportShader(FragmentShaderID, GL_FRAGMENT_SHADER, name);
+	}
+	FinishLink(ProgramID, VertexShaderID, FragmentShaderID);
 	return ProgramID;
-}
\ No newline at end of file
+}
+
+GLuint LoadFallbackShader(){
+	return LoadShaderSource(FallbackVertexShader, FallbackFragmentShader, "fallback");
+}
+
+void ShutdownShaderCompiler(){
+	if(WorkerWindow != NULL){
+		{
+			std::lock_guard<std::mutex> Lock(WorkerMutex);
+			WorkerQuit = true;
+		}
+		WorkerWake.notify_one();
+		WorkerThread.join();
+		glfwDestroyWindow(WorkerWindow);
+		WorkerWindow = NULL;
+	}
+
+	for(size_t i = 0; i < Pending.size(); i++){
+		PendingProgram * Program = Pending[i];
+		if(Program->Fence != 0)
+			glDeleteSync(Program->Fence);
+		if(Program->ProgramID != 0)
+			glDeleteProgram(Program->ProgramID);
+		delete Program;
+	}
+	Pending.clear();
+	WorkerQueue.clear();
+	WorkerQuit = false;
+	CompilerInitialized = false;
+	ParallelCompile = false;
+}
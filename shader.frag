@@ -1,5 +1,7 @@
 #version 330 core
 // This is a sample fragment shader.
+// VERTEX_LIGHTING and CACHED_LIGHTING are the lighting levels of detail of ShadingLod, lit per vertex
+// in shader.vert or from a cache. Without either the lighting is per pixel.
 
 struct Material {
     vec3 ambient;
@@ -8,160 +10,43 @@ struct Material {
     float shininess;
 }; 
 
-
-struct DirLight {
-    vec3 direction;
-	
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-struct PointLight {
-    vec3 position;
-    
-    float quadratic;
-	
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
+// Per-draw values from the uniform ring, the same block as in shader.vert
+layout (std140) uniform DrawData {
+    mat4 projection;
+    mat4 modelview;
+    mat4 model;
+    mat4 view;
+    Material material;
 };
 
-struct SpotLight {
-	vec3 direction;
-    vec3 position;
-    
-    float quadratic;
-	
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-
-	float cutOff;
-	float outerCutOff;
-};
-
-uniform DirLight dirLight;
-uniform PointLight pointLight;
-uniform SpotLight spotLight;
-uniform int on;
-uniform Material material;
-
-// Inputs to the fragment shader are the outputs of the same name from the vertex shader.
-// Note that you do not have access to the vertex shader's default output, gl_Position.
-in vec3 FragPos;
-in vec3 Normal;
-
 // You can output many things. The first vec4 type output determines the color of the fragment
 out vec4 color;
 
-// Forward declaration
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
-vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+#if defined(VERTEX_LIGHTING) || defined(CACHED_LIGHTING)
+
+// Already lit, interpolated from the vertices
+in vec3 LitColor;
 
 void main()
 {
-	vec3 norm = normalize(Normal);
-	if (on == 1) {
-		vec3 result = material.ambient;
-		vec3 viewPos = {0.0f, 0.0f, 20.0f};
-		vec3 viewDir = normalize(viewPos - FragPos);
-		
-		// Directional
-		result = CalcDirLight(dirLight, norm, viewDir) * result;
-		
-		// Point Light
-		result += CalcPointLight(pointLight, norm, FragPos, viewDir);
-
-		// Spot Light
-		result += CalcSpotLight(spotLight, norm, FragPos, viewDir);    
-
-		// Output
-		color = vec4(result.r, result.g, result.b, 1.0f);
-	}
-	else {
-		color = vec4(norm.r, norm.g, norm.b, 1.0f);
-	}
+	color = vec4(LitColor, 1.0f);
 }
 
-// Calculates the color when using a directional light.
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
-{
-    vec3 lightDir = normalize(-light.direction);
-
-    // Diffuse shading
-    float diff = max(dot(normal, lightDir), 0.0);
-
-    // Specular shading
-    vec3 reflectDir = reflect(-lightDir, normal);
-
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-
-    // Combine results
-    vec3 ambient = light.ambient * material.diffuse;
-    vec3 diffuse = light.diffuse * diff * material.diffuse;
-    vec3 specular = light.specular * spec * material.specular;
-    return (ambient + diffuse + specular);
-}
+#else
 
+#include "lighting.glsl"
 
+// Inputs to the fragment shader are the outputs of the same name from the vertex shader.
+// Note that you do not have access to the vertex shader's default output, gl_Position.
+in vec3 FragPos;
+in vec3 Normal;
 
-// Calculates the color when using a point light.
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+void main()
 {
-	vec3 lightDir = normalize(light.position - fragPos);
-
-    // Diffuse shading
-    float diff = max(dot(normal, lightDir), 0.0);
-
-    // Specular shading
-    vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+	vec3 result = Shade(normalize(Normal), FragPos);
 
-    // Attenuation
-    float distance = length(light.position - fragPos);
-    float attenuation = 1.0f / (light.quadratic * (distance * distance));    
-
-    // Combine results
-    vec3 ambient = light.ambient * material.diffuse;
-    vec3 diffuse = light.diffuse * diff * material.diffuse;
-    vec3 specular = light.specular * spec * material.specular;
-    ambient *= attenuation;
-    diffuse *= attenuation;
-    specular *= attenuation;
-    return (ambient + diffuse + specular);
-	
+	// Output
+	color = vec4(result.r, result.g, result.b, 1.0f);
 }
 
-
-// Calculates the color when using a spot light.
-vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
-{
-    vec3 lightDir = normalize(light.position - fragPos);
-
-    // Diffuse shading
-    float diff = max(dot(normal, lightDir), 0.0);
-
-    // Specular shading
-    vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-
-    // Attenuation
-    float distance = length(light.position - fragPos);
-    float attenuation = 1.0f / (light.quadratic * (distance * distance));    
-
-    // Spotlight intensity
-    float theta = dot(lightDir, normalize(-light.direction)); 
-    float epsilon = light.cutOff - light.outerCutOff;
-    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
-
-    // Combine results
-    vec3 ambient = light.ambient * material.diffuse;
-    vec3 diffuse = light.diffuse * diff * material.diffuse;
-    vec3 specular = light.specular * spec * material.specular;
-    ambient *= attenuation * intensity;
-    diffuse *= attenuation * intensity;
-    specular *= attenuation * intensity;
-    return (ambient + diffuse + specular);
-}
\ No newline at end of file
+#endif
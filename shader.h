@@ -1,6 +1,30 @@
 #ifndef SHADER_HPP
 #define SHADER_HPP
 
-GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path);
+// Directory that linked program binaries are cached in. Set to NULL to always compile from source.
+extern const char * ShaderCacheDir;
+
+// defines is inserted right after the #version line of both shaders, e.g. "#define FOO 1\n". Lines
+// #include "file" are replaced by the file, found in the directory of the shader including it.
+GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path,const char * defines = "");
+
+// Asynchronous compilation. Submit everything up front, call PollShaders once per frame and draw with
+// GetShaderProgram, which hands out the fallback program until the real one has finished linking.
+typedef int ShaderHandle;
+ShaderHandle SubmitShaders(const char * vertex_file_path,const char * fragment_file_path,const char * defines = "");
+void PollShaders();
+bool ShaderProgramReady(ShaderHandle handle);
+GLuint GetShaderProgram(ShaderHandle handle, GLuint fallback);
+// Blocks until every submitted program is either ready or has failed
+void WaitForShaders();
+// Compiles and links shaders given as source code, synchronously. name is only used in error messages.
+GLuint LoadShaderSource(const char * vertex_source, const char * fragment_source, const char * name);
+// A vertex shader alone whose outputs named in varyings are captured with transform feedback,
+// interleaved. Compiled synchronously and not cached, 0 if it fails.
+GLuint LoadFeedbackShader(const char * vertex_file_path, const char * defines, const char * const * varyings, int count);
+// Minimal program that shades by normal, compiled synchronously
+GLuint LoadFallbackShader();
+// Deletes every program handed out by SubmitShaders
+void ShutdownShaderCompiler();
 
 #endif
@@ -8,23 +8,56 @@
 
 layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 normal;
+#ifdef CACHED_LIGHTING
+layout (location = 2) in vec3 cached_color;
+#endif
 
-// Uniform variables can be updated by fetching their location and passing values to that location
-uniform mat4 projection;
-uniform mat4 modelview;
-uniform mat4 model;
-uniform mat4 view;
+struct Material {
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+    float shininess;
+};
+
+// Per-draw values, written by OBJObject::draw to the uniform ring (DrawUniforms in OBJObject.h).
+// Declared the same way in shader.frag.
+layout (std140) uniform DrawData {
+    mat4 projection;
+    mat4 modelview;
+    mat4 model;
+    mat4 view;
+    Material material;
+};
 
 // Outputs of the vertex shader are the inputs of the same name of the fragment shader.
 // The default output, gl_Position, should be assigned something. You can define as many
 // extra outputs as you need.
+#if defined(VERTEX_LIGHTING) || defined(CACHED_LIGHTING)
+// Lighting levels of detail of ShadingLod: the color is computed per vertex here, or was captured
+// from this shader into a buffer earlier and only passed on
+out vec3 LitColor;
+#else
 out vec3 Normal;
 out vec3 FragPos;
+#endif
+
+#ifdef VERTEX_LIGHTING
+#include "lighting.glsl"
+#endif
+
+// Must match the depth pre-pass exactly, it is tested with GL_EQUAL
+invariant gl_Position;
 
 void main()
 {
     // OpenGL maintains the D matrix so you only need to multiply by P, V (aka C inverse), and M
     gl_Position = projection * view * model * vec4(position.x, position.y, position.z, 1.0);
+#if defined(VERTEX_LIGHTING)
+    LitColor = Shade(normalize(mat3(transpose(inverse(model))) * normal), vec3(model * vec4(position, 1.0f)));
+#elif defined(CACHED_LIGHTING)
+    LitColor = cached_color;
+#else
     FragPos = vec3(model * vec4(position, 1.0f));
 	Normal = mat3(transpose(inverse(model))) * normal;
+#endif
 }
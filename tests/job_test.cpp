@@ -0,0 +1,238 @@
+#define _CRT_SECURE_NO_DEPRECATE
+#include "JobSystem.h"
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Failed checks are counted and printed. Runs one test by name, or all of them without arguments.
+static int failures = 0;
+
+#define CHECK(condition) \
+	do { if (!(condition)) { fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); failures++; } } while (0)
+
+// A chain made with depend runs in order, a continuation made with then runs after everything it
+// depends on, and depending on a finished job does not hold the new one back
+static void test_depend()
+{
+	const int length = 200;
+	std::mutex mutex;
+	std::vector<int> order;
+	std::vector<Job*> chain;
+	for (int i = 0; i < length; i++)
+	{
+		chain.push_back(JobSystem::create([&mutex, &order, i]
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			order.push_back(i);
+		}));
+		if (i > 0)
+			JobSystem::depend(chain[i], chain[i - 1]);
+	}
+	// Submitted last to first, so only the dependencies keep them in order
+	for (int i = length - 1; i >= 0; i--)
+		JobSystem::submit(chain[i]);
+	for (int i = 0; i < length - 1; i++)
+		JobSystem::release(chain[i]);
+	JobSystem::wait(chain[length - 1]);
+	CHECK((int)order.size() == length);
+	for (int i = 0; i < (int)order.size(); i++)
+		CHECK(order[i] == i);
+
+	const int fan = 1000;
+	std::atomic<int> done(0);
+	Job* root = JobSystem::create([] {});
+	std::vector<Job*> leaves;
+	for (int i = 0; i < fan; i++)
+		leaves.push_back(JobSystem::then(root, [&done] { done++; }));
+	std::atomic<int> seen(-1);
+	Job* join = JobSystem::create([&done, &seen] { seen = done.load(); });
+	for (int i = 0; i < fan; i++)
+	{
+		JobSystem::depend(join, leaves[i]);
+		JobSystem::release(leaves[i]);
+	}
+	JobSystem::submit(join);
+	JobSystem::submit(root);
+	JobSystem::release(root);
+	JobSystem::wait(join);
+	CHECK(seen.load() == fan);
+
+	// The handle of finished outlives its run, so the second then sees a finished job
+	bool ran = false;
+	Job* finished = JobSystem::create([] {});
+	Job* marker = JobSystem::then(finished, [] {});
+	JobSystem::submit(finished);
+	JobSystem::wait(marker);
+	Job* after = JobSystem::then(finished, [&ran] { ran = true; });
+	JobSystem::wait(after);
+	JobSystem::release(finished);
+	CHECK(ran);
+}
+
+// Threads that are not workers wait through the shared queue, several at once, and may wait for
+// jobs another thread created
+static void test_wait()
+{
+	const int thread_count = 4;
+	const int jobs = 100;
+	std::atomic<int> done(0);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < thread_count; t++)
+	{
+		threads.push_back(std::thread([&done]
+		{
+			for (int i = 0; i < jobs; i++)
+			{
+				Job* job = JobSystem::create([&done] { done++; });
+				JobSystem::submit(job);
+				JobSystem::wait(job);
+			}
+		}));
+	}
+	for (int t = 0; t < thread_count; t++)
+		threads[t].join();
+	CHECK(done.load() == thread_count * jobs);
+
+	std::atomic<bool> ran(false);
+	Job* job = JobSystem::create([&ran] { ran = true; });
+	std::thread waiter([job] { JobSystem::wait(job); });
+	JobSystem::submit(job);
+	waiter.join();
+	CHECK(ran.load());
+}
+
+// Every index is covered exactly once by ranges no larger than grain
+static void check_cover(size_t count, size_t grain)
+{
+	std::vector<std::atomic<int> > hits(count);
+	for (size_t i = 0; i < count; i++)
+		hits[i] = 0;
+	std::atomic<bool> too_large(false);
+	std::atomic<bool> empty(false);
+	JobSystem::parallel_for(0, count, grain, [&](size_t first, size_t last)
+	{
+		if (last <= first)
+			empty = true;
+		if (last - first > (grain == 0 ? 1 : grain))
+			too_large = true;
+		for (size_t i = first; i < last; i++)
+			hits[i]++;
+	});
+	CHECK(!too_large.load());
+	CHECK(!empty.load());
+	for (size_t i = 0; i < count; i++)
+		CHECK(hits[i].load() == 1);
+}
+
+static void test_parallel_for()
+{
+	const size_t counts[] = { 0, 1, 7, 16, 17, 1000, 100000 };
+	const size_t grains[] = { 0, 1, 16, 4096 };
+	for (size_t g = 0; g < sizeof(grains) / sizeof(grains[0]); g++)
+		for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++)
+			check_cover(counts[c], grains[g]);
+
+	bool called = false;
+	JobSystem::parallel_for(10, 10, 4, [&called](size_t, size_t) { called = true; });
+	JobSystem::parallel_for(10, 5, 4, [&called](size_t, size_t) { called = true; });
+	CHECK(!called);
+
+	// Nested loops wait inside jobs of the outer one
+	const size_t outer = 64;
+	const size_t inner = 1000;
+	std::vector<std::atomic<int> > hits(outer * inner);
+	for (size_t i = 0; i < hits.size(); i++)
+		hits[i] = 0;
+	JobSystem::parallel_for(0, outer, 4, [&](size_t first, size_t last)
+	{
+		for (size_t o = first; o < last; o++)
+		{
+			JobSystem::parallel_for(0, inner, 16, [&hits, o, inner](size_t a, size_t b)
+			{
+				for (size_t i = a; i < b; i++)
+					hits[o * inner + i]++;
+			});
+			// Counts at and below the grain run inline
+			check_cover(o % 3, 16);
+		}
+	});
+	for (size_t i = 0; i < hits.size(); i++)
+		CHECK(hits[i].load() == 1);
+}
+
+static int run_jobs(int count)
+{
+	std::atomic<int> done(0);
+	Job* last = JobSystem::create([] {});
+	for (int i = 0; i < count; i++)
+	{
+		Job* job = JobSystem::create([&done] { done++; });
+		JobSystem::depend(last, job);
+		JobSystem::submit(job);
+		JobSystem::release(job);
+	}
+	JobSystem::submit(last);
+	JobSystem::wait(last);
+	JobSystem::parallel_for(0, 10000, 64, [&done](size_t first, size_t last) { done += (int)(last - first); });
+	return done.load() - 10000;
+}
+
+// The workers restart with other settings, and start again on their own after a shutdown
+static void test_restart()
+{
+	JobSystem::initialize(4, false);
+	CHECK(JobSystem::threads() == 4);
+	CHECK(run_jobs(500) == 500);
+
+	JobSystem::shutdown();
+	JobSystem::shutdown();
+	JobSystem::initialize(2, false);
+	CHECK(JobSystem::threads() == 2);
+	CHECK(run_jobs(500) == 500);
+
+	JobSystem::initialize(1, false);
+	CHECK(JobSystem::threads() == 1);
+	CHECK(run_jobs(500) == 500);
+	check_cover(1000, 16);
+
+	JobSystem::shutdown();
+	JobSystem::thread_count = 3;
+	CHECK(run_jobs(500) == 500);
+	CHECK(JobSystem::threads() == 3);
+	JobSystem::shutdown();
+}
+
+struct Test {
+	const char* name;
+	void (*run)();
+};
+
+static const Test tests[] = {
+	{ "depend", test_depend },
+	{ "wait", test_wait },
+	{ "parallel_for", test_parallel_for },
+	{ "restart", test_restart },
+};
+
+int main(int argc, char** argv)
+{
+	bool found = false;
+	for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++)
+	{
+		if (argc > 1 && strcmp(argv[1], tests[i].name) != 0)
+			continue;
+		found = true;
+		int before = failures;
+		tests[i].run();
+		printf("%s: %s\n", tests[i].name, failures == before ? "passed" : "FAILED");
+	}
+	if (!found)
+	{
+		fprintf(stderr, "unknown test %s\n", argv[1]);
+		return 1;
+	}
+	return failures == 0 ? 0 : 1;
+}